@@ -5,6 +5,7 @@
 #define SL_CATALOG_APP_ASSERT_PRESENT
 #define SL_CATALOG_APP_LOG_PRESENT
 #define SL_CATALOG_BLUETOOTH_CONFIGURATION_PRESENT
+#define SL_CATALOG_BLUETOOTH_FEATURE_ACCEPT_LIST_PRESENT  // hand edit for bluetooth_feature_accept_list in the .slcp, not generated
 #define SL_CATALOG_BLUETOOTH_FEATURE_ADVERTISER_PRESENT
 #define SL_CATALOG_BLUETOOTH_FEATURE_BUILTIN_BONDING_DATABASE_PRESENT
 #define SL_CATALOG_BLUETOOTH_FEATURE_CONNECTION_PRESENT
@@ -12,6 +13,7 @@
 #define SL_CATALOG_BLUETOOTH_FEATURE_GATT_SERVER_PRESENT
 #define SL_CATALOG_BLUETOOTH_FEATURE_LEGACY_ADVERTISER_PRESENT
 #define SL_CATALOG_BLUETOOTH_FEATURE_LEGACY_SCANNER_PRESENT
+#define SL_CATALOG_BLUETOOTH_FEATURE_NVM_PRESENT  // hand edit for bluetooth_feature_nvm in the .slcp, not generated
 #define SL_CATALOG_BLUETOOTH_FEATURE_SCANNER_PRESENT
 #define SL_CATALOG_BLUETOOTH_FEATURE_SM_PRESENT
 #define SL_CATALOG_BLUETOOTH_FEATURE_SYSTEM_PRESENT
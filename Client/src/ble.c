@@ -26,6 +26,10 @@
 #include "gatt_db.h"
 #include <src/lcd.h>
 #include <src/gpio.h>
+#include <src/link.h>
+#include <src/gatt_cache.h>
+#include <src/gatt_queue.h>
+#include <src/scan.h>
 
 #define INDICATION_QUEUE_SIZE 10 // Adjust as needed
 
@@ -65,30 +69,6 @@ typedef enum
 
 static button_sequence_state_t button_sequence_state = WAIT_FOR_PB0_PRESS;
 static bool indication_enabled = true; // Tracks the indication enable state
-
-// Flex Sensor Service UUID: 39b6b0dc-6ee2-4e77-a665-75d0b64649a3
-static const uint8_t flexSensorService_UUID1[16] = {
-    0xa3, 0x49, 0x46, 0xb6, 0xd0, 0x75, 0x65, 0xa6,
-    0x77, 0x4e, 0xe2, 0x6e, 0xdc, 0xb0, 0xb6, 0x39
-};
-
-// Flex Sensor Characteristic UUID: b1082442-5cb6-4d30-9d8c-12094979f6be
-static const uint8_t flexSensorChar_UUID1[16] = {
-    0xbe, 0xf6, 0x79, 0x49, 0x09, 0x12, 0x8c, 0x9d,
-    0x30, 0x4d, 0xb6, 0x5c, 0x42, 0x24, 0x08, 0xb1
-};
-
-// Accelerometer Service UUID: aa6321f1-ee79-4f7c-833f-0f6bfcdc0d32
-static const uint8_t accelService_UUID1[16] = {
-    0x32, 0x0d, 0xdc, 0xfc, 0x6b, 0x0f, 0x3f, 0x83,
-    0x7c, 0x4f, 0x79, 0xee, 0xf1, 0x21, 0x63, 0xaa
-};
-
-// Accelerometer Characteristic UUID: 5bb27a07-3455-4576-bfb6-f7ae4e45aca9
-static const uint8_t accelChar_UUID1[16] = {
-    0xa9, 0xac, 0x45, 0x4e, 0xae, 0xf7, 0xb6, 0xbf,
-    0x76, 0x45, 0x55, 0x34, 0x07, 0x7a, 0xb2, 0x5b
-};
 #endif
 // ---------------------------------------------------------------------
 // Private function used only by this .c file.
@@ -278,6 +258,75 @@ int32_t FLOAT_TO_INT32(const uint8_t *buffer_ptr)
     return (int32_t)(pow(10, exponent) * mantissa);
 } // FLOAT_TO_INT32
 
+/**
+ * @brief Displays the tilt reported by the server's accelerometer characteristic.
+ *
+ * The value is pitch then roll, each an int16 in 0.1 degree steps, little endian.
+ *
+ * @param value Characteristic value from the GATT event.
+ */
+static void displayTilt(const uint8_t *data, uint8_t length)
+{
+    int16_t pitch;
+    int16_t roll;
+
+    if (length < 4)
+    {
+        return;
+    }
+
+    pitch = (int16_t)(data[0] | (data[1] << 8));
+    roll = (int16_t)(data[2] | (data[3] << 8));
+    displayPrintf(DISPLAY_ROW_10, "Pitch:%d Roll:%d", pitch / 10, roll / 10);
+}
+
+/**
+ * @brief Shows a value read from the server, from a read or a Read Multiple response.
+ *
+ * @param characteristic Characteristic handle on the server.
+ * @param data Value.
+ * @param length Value length in bytes.
+ */
+static void displayPolledValue(uint16_t characteristic, const uint8_t *data, uint8_t length)
+{
+    if ((characteristic == ble_data.flex_characteristic_handle) && (length >= 1))
+    {
+        displayPrintf(DISPLAY_ROW_9, "Flex Angle:%dDeg", data[0]);
+    }
+    if (characteristic == ble_data.accel_characteristic_handle)
+    {
+        displayTilt(data, length);
+    }
+}
+
+/**
+ * @brief Shows the posture broadcast from a server's advertising data.
+ *
+ * A repeated sequence number is the same sample advertised again and is skipped.
+ *
+ * @param data Advertising data from the scanner report.
+ */
+static void decodeBroadcast(const uint8array *data)
+{
+    static bool have_sequence = false;
+    static uint8_t last_sequence;
+    broadcast_sample_t sample;
+
+    if (!broadcastDecode(data->data, data->len, &sample))
+    {
+        return;
+    }
+    if (have_sequence && (sample.sequence == last_sequence))
+    {
+        return;
+    }
+    have_sequence = true;
+    last_sequence = sample.sequence;
+
+    displayPrintf(DISPLAY_ROW_9, "Flex:%d Pos:%d", sample.flex / 10, sample.posture);
+    displayPrintf(DISPLAY_ROW_10, "Pitch:%d Roll:%d", sample.pitch / 10, sample.roll / 10);
+}
+
 /**
  * @brief Handles Bluetooth Low Energy (BLE) events for both server and client devices.
  *
@@ -676,69 +725,40 @@ void handle_ble_event(sl_bt_msg_t *evt)
             LOG_ERROR("Error setting connection parameters");
         }
 
-        // Set the scanner parameters using the defined macros
-        status = sl_bt_scanner_set_parameters(
-            SCANNER_POLICY, // Scanner filter policy
-            SCAN_INTERVAL,  // Scan interval
-            SCAN_WINDOW     // Scan window
-        );
-
-        if (status != SL_STATUS_OK)
-        {
-            LOG_ERROR("Error setting the parameters for scanning");
-        }
-
-        // Start scanning with the specified PHY and discovery mode using the defined macros
-        status = sl_bt_scanner_start(
-            SCANNING_PHY,  // Scanning PHY to be used
-            DISCOVERY_MODE // Discovery mode for scanning
-        );
+        // Offer the largest ATT MTU so the server can fill its notifications
+        linkInit();
 
-        if (status != SL_STATUS_OK)
-        {
-            LOG_ERROR("Error starting scanner");
-        }
         // Enable bonding and increase security
         sl_bt_sm_configure(SM_CONFIG_BONDING_FLAGS, sl_bt_sm_io_capability_displayyesno);
         ble_data.bonding_handle = false;
-        sl_bt_sm_delete_bondings();           // Ensure fresh bonding each time
+        // Keep the bond across resets, the server is reconnected without a passkey
+        sl_bt_sm_set_bondable_mode(1);
+        // Handles discovered on earlier connections, validated by the server's database hash
+        gattCacheInit();
+        // Fast scan for any server of the fleet, backing off if none turns up
+        scanStart();
         GPIO_PinOutClear(LED_port, LED0_pin); // Turn off LED0
         GPIO_PinOutClear(LED_port, LED1_pin); // Turn off LED1
         break;
 
     case sl_bt_evt_scanner_legacy_advertisement_report_id:
-        if (is_target_device(evt->data.evt_scanner_scan_report.address)) // Check address
+        // Posture broadcast works without a connection, decode it from every report
+        decodeBroadcast(&evt->data.evt_scanner_legacy_advertisement_report.data);
+
+        // Any server of the fleet, matched by service UUID or broadcast tag and RSSI
+        if (scanMatch(&evt->data.evt_scanner_legacy_advertisement_report))
         {
-            // Check if the address type is Public Address (0x00)
-            if ((evt->data.evt_scanner_scan_report.address_type == PUBLIC_DEVICE_ADDRESS)) // Check address type
+            // Save the scanned device address before connection
+            memcpy(ble_data.connectedDeviceAddress.addr, evt->data.evt_scanner_legacy_advertisement_report.address.addr, sizeof(bd_addr));
+
+            scanStop();
+            status = sl_bt_connection_open(evt->data.evt_scanner_legacy_advertisement_report.address,
+                                           evt->data.evt_scanner_legacy_advertisement_report.address_type,
+                                           sl_bt_gap_phy_1m,
+                                           NULL);
+            if (status != SL_STATUS_OK)
             {
-                // Save the scanned device address before connection
-                memcpy(ble_data.connectedDeviceAddress.addr, evt->data.evt_scanner_scan_report.address.addr, sizeof(bd_addr));
-
-                // 0x00 corresponds to the Public Device Address as per Bluetooth specification
-
-                // Check if the advertisement is both connectable and scannable.
-                // - Bit 0 (0x01): Set to 1 if the advertisement is scannable (can be discovered).
-                // - Bit 1 (0x02): Set to 1 if the advertisement is connectable (can initiate a connection).
-
-                // The bitwise AND operation with 0x03 checks if both bit 0 and bit 1 are set.
-                if ((evt->data.evt_scanner_legacy_advertisement_report.event_flags & ADVERTISEMENT_CONNECTABLE_SCANNABLE) == ADVERTISEMENT_CONNECTABLE_SCANNABLE) // Check if it is connectable and scannble
-                {
-                    status = sl_bt_scanner_stop();
-
-                    if (status != SL_STATUS_OK)
-                    {
-                        LOG_ERROR("Error stopping scanner: 0x%lx", status);
-                    }
-                    status = sl_bt_connection_open(evt->data.evt_scanner_scan_report.address,
-                                                   evt->data.evt_scanner_scan_report.address_type,
-                                                   sl_bt_gap_phy_1m,
-                                                   NULL);
-                    if (status != SL_STATUS_OK)
-                    {
-                        LOG_ERROR("Error opening connection: 0x%lx", status);
-                    }
-                }
+                LOG_ERROR("Error opening connection: 0x%lx", status);
             }
         }
         break;
@@ -757,6 +777,41 @@ void handle_ble_event(sl_bt_msg_t *evt)
                       ble_data.connectedDeviceAddress.addr[4],
                       ble_data.connectedDeviceAddress.addr[5]);
 
+        // Move the link to 2M PHY and long PDUs, the results arrive as events
+        linkOnOpened(ble_data.connection_handle);
+
+        // Known server, encrypt with the stored keys straight away instead of
+        // waiting for an insufficient encryption error
+        if (evt->data.evt_connection_opened.bonding != SL_BT_INVALID_BONDING_HANDLE)
+        {
+            sl_bt_sm_increase_security(ble_data.connection_handle);
+        }
+        break;
+
+    case sl_bt_evt_connection_parameters_id:
+        // Encryption with a stored bond does not raise sl_bt_evt_sm_bonded_id
+        if ((evt->data.evt_connection_parameters.security_mode != sl_bt_connection_mode1_level1) &&
+            (ble_data.bonding_handle == false))
+        {
+            ble_data.bonding_handle = true;
+            displayPrintf(DISPLAY_ROW_CONNECTION, BLE_BONDED);
+        }
+        break;
+
+    case sl_bt_evt_connection_phy_status_id:
+        linkOnPhy(evt->data.evt_connection_phy_status.connection,
+                  evt->data.evt_connection_phy_status.phy);
+        break;
+
+    case sl_bt_evt_connection_data_length_id:
+        linkOnDataLength(evt->data.evt_connection_data_length.connection,
+                         evt->data.evt_connection_data_length.tx_data_len,
+                         evt->data.evt_connection_data_length.rx_data_len);
+        break;
+
+    case sl_bt_evt_gatt_mtu_exchanged_id:
+        linkOnMtu(evt->data.evt_gatt_mtu_exchanged.connection,
+                  evt->data.evt_gatt_mtu_exchanged.mtu);
         break;
 
     case sl_bt_evt_connection_closed_id:
@@ -767,18 +822,15 @@ void handle_ble_event(sl_bt_msg_t *evt)
         displayPrintf(DISPLAY_ROW_PASSKEY, "");
         ble_data.connection_open = false;
         ble_data.bonding_handle = false;
-        // Start scanning with the specified PHY and discovery mode using the defined macros
-        status = sl_bt_scanner_start(
-            SCANNING_PHY,  // Scanning PHY to be used
-            DISCOVERY_MODE // Discovery mode for scanning
-        );
-        if (status != SL_STATUS_OK)
-        {
-            LOG_ERROR("Error starting scanner");
-        }
+        // The next server may lay out its database differently
+        ble_data.flex_characteristic_handle = 0;
+        ble_data.accel_characteristic_handle = 0;
+        linkOnClosed(evt->data.evt_connection_closed.connection);
+        gattQueueOnClosed(evt->data.evt_connection_closed.connection);
+        // Look for the server again, fast first
+        scanStart();
         GPIO_PinOutClear(LED_port, LED1_pin); // Turn off LED1
         GPIO_PinOutClear(LED_port, LED0_pin); // Turn off LED0
-        sl_bt_sm_delete_bondings();           // Ensure fresh bonding each time
         break;
 
     case sl_bt_evt_system_external_signal_id:
@@ -798,8 +850,16 @@ void handle_ble_event(sl_bt_msg_t *evt)
         if ((evt->data.evt_system_external_signal.extsignals & PB1_EXT_SIGNAL) && (button0_state == BUTTON_RELEASED_VALUE))
         {
 
-            sl_bt_gatt_read_characteristic_value(ble_data.connection_handle, gattdb_flex_data);
-            sl_bt_gatt_read_characteristic_value(ble_data.connection_handle, gattdb_accelerometer_data);
+            // Both values in one round trip, the flex state has a fixed size of 1 byte.
+            // The handles are the server's, known once discovery has filled them in.
+            uint16_t poll_handles[] = {ble_data.flex_characteristic_handle, ble_data.accel_characteristic_handle};
+            uint8_t poll_sizes[] = {sizeof(uint8_t), 0};
+
+            if ((poll_handles[0] != 0) && (poll_handles[1] != 0))
+            {
+                gattQueueReadMultiple(ble_data.connection_handle, sizeof(poll_handles) / sizeof(poll_handles[0]),
+                                      poll_handles, poll_sizes, NULL);
+            }
         }
 
         if ((evt->data.evt_system_external_signal.extsignals & PB0_EXT_SIGNAL) || (evt->data.evt_system_external_signal.extsignals & PB1_EXT_SIGNAL))
@@ -857,20 +917,16 @@ void handle_ble_event(sl_bt_msg_t *evt)
                     indication_enabled = !indication_enabled;
                     if (indication_enabled)
                       {
-                        sl_status_t status = sl_bt_gatt_set_characteristic_notification(
-                            getBleDataPtr()->connection_handle,
-                            getBleDataPtr()->flex_characteristic_handle,
-                            sl_bt_gatt_indication);
-                        if (status != SL_STATUS_OK)
+                        if (!gattQueueSetNotification(getBleDataPtr()->connection_handle,
+                                                      getBleDataPtr()->flex_characteristic_handle,
+                                                      sl_bt_gatt_indication, NULL))
                           {
                             LOG_ERROR("Error setting notifications");
                             return;
                           }
-                         status = sl_bt_gatt_set_characteristic_notification(
-                            getBleDataPtr()->connection_handle,
-                            getBleDataPtr()->accel_characteristic_handle,
-                            sl_bt_gatt_indication);
-                        if (status != SL_STATUS_OK)
+                         if (!gattQueueSetNotification(getBleDataPtr()->connection_handle,
+                                                      getBleDataPtr()->accel_characteristic_handle,
+                                                      sl_bt_gatt_indication, NULL))
                           {
                             LOG_ERROR("Error setting notifications");
                             return;
@@ -878,20 +934,16 @@ void handle_ble_event(sl_bt_msg_t *evt)
                       }
                     else
                       {
-                        sl_status_t status = sl_bt_gatt_set_characteristic_notification(
-                            getBleDataPtr()->connection_handle,
-                            getBleDataPtr()->flex_characteristic_handle,
-                            sl_bt_gatt_disable);
-                        if (status != SL_STATUS_OK)
+                        if (!gattQueueSetNotification(getBleDataPtr()->connection_handle,
+                                                      getBleDataPtr()->flex_characteristic_handle,
+                                                      sl_bt_gatt_disable, NULL))
                           {
                             LOG_ERROR("Error setting notifications");
                             return;
                           }
-                         status = sl_bt_gatt_set_characteristic_notification(
-                            getBleDataPtr()->connection_handle,
-                            getBleDataPtr()->accel_characteristic_handle,
-                            sl_bt_gatt_disable);
-                        if (status != SL_STATUS_OK)
+                         if (!gattQueueSetNotification(getBleDataPtr()->connection_handle,
+                                                      getBleDataPtr()->accel_characteristic_handle,
+                                                      sl_bt_gatt_disable, NULL))
                           {
                             LOG_ERROR("Error setting notifications");
                             return;
@@ -936,6 +988,7 @@ void handle_ble_event(sl_bt_msg_t *evt)
 
     case sl_bt_evt_sm_bonded_id:
         ble_data.bonding_handle = true;
+        scanOnBonded(evt->data.evt_sm_bonded.bonding);
         displayPrintf(DISPLAY_ROW_CONNECTION, BLE_BONDED);
         break;
 
@@ -946,42 +999,14 @@ void handle_ble_event(sl_bt_msg_t *evt)
         displayPrintf(DISPLAY_ROW_ACTION, "");
         break;
 
-    case sl_bt_evt_gatt_service_id:
-      {
-        uint8_t *uuid_data = evt->data.evt_gatt_service.uuid.data;
-
-        if (memcmp(uuid_data, flexSensorService_UUID1, 16) == 0)
-          {
-            ble_data.flex_service_handle = evt->data.evt_gatt_service.service;
-          }
-
-
-        if (memcmp(uuid_data, accelService_UUID1, 16) == 0)
-          {
-            ble_data.accel_service_handle = evt->data.evt_gatt_service.service;
-          }
-      }
-    break;
-
-    case sl_bt_evt_gatt_characteristic_id:
-      {
-        uint8_t *uuid_data = evt->data.evt_gatt_characteristic.uuid.data;
-
-        if (memcmp(uuid_data, flexSensorChar_UUID1, 16) == 0)
-          {
-            ble_data.flex_characteristic_handle = evt->data.evt_gatt_characteristic.characteristic;
-          }
-
-        if (memcmp(uuid_data, accelChar_UUID1, 16) == 0)
-          {
-            ble_data.accel_characteristic_handle = evt->data.evt_gatt_characteristic.characteristic;
-          }
-      }
-    break;
-
     case sl_bt_evt_gatt_characteristic_value_id:
+    {
+        // Values the server pushed, read responses are shown by displayPolledValue() below
+        bool pushed = (evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_handle_value_notification) ||
+                      (evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_handle_value_indication);
 
-        if (evt->data.evt_gatt_characteristic_value.characteristic == ble_data.flex_characteristic_handle)
+        if (pushed && (evt->data.evt_gatt_characteristic_value.characteristic == ble_data.flex_characteristic_handle) &&
+            (evt->data.evt_gatt_characteristic_value.value.len >= 1))
         {
 
             uint8_t *value = evt->data.evt_gatt_characteristic_value.value.data;
@@ -999,34 +1024,36 @@ void handle_ble_event(sl_bt_msg_t *evt)
             }
         }
 
-        if (evt->data.evt_gatt_characteristic_value.characteristic == ble_data.accel_characteristic_handle)
+        if (pushed && (evt->data.evt_gatt_characteristic_value.characteristic == ble_data.accel_characteristic_handle))
           {
 
-            uint8_t *value = evt->data.evt_gatt_characteristic_value.value.data;
-
-            uint8_t tiltCount = value[0];
-            displayPrintf(DISPLAY_ROW_10, "Tilt Count:%d", tiltCount);
+            displayTilt(evt->data.evt_gatt_characteristic_value.value.data,
+                        evt->data.evt_gatt_characteristic_value.value.len);
           }
 
         if (evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_read_response)
         {
 
-            if (evt->data.evt_gatt_characteristic_value.characteristic == ble_data.flex_characteristic_handle)
-              {
-                uint8_t *value = evt->data.evt_gatt_characteristic_value.value.data;
-                uint8_t angle = value[0];
-                displayPrintf(DISPLAY_ROW_9, "Flex Angle:%dDeg",angle);
-              }
-            if (evt->data.evt_gatt_characteristic_value.characteristic == ble_data.accel_characteristic_handle)
-              {
-                uint8_t *value = evt->data.evt_gatt_characteristic_value.value.data;
-                uint8_t tiltCount = value[0];
-                displayPrintf(DISPLAY_ROW_10, "Tilt Count:%d", tiltCount);
-              }
+            displayPolledValue(evt->data.evt_gatt_characteristic_value.characteristic,
+                               evt->data.evt_gatt_characteristic_value.value.data,
+                               evt->data.evt_gatt_characteristic_value.value.len);
+        }
+
+        // One response for the whole PB1 poll, split back per characteristic
+        if (evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_read_multiple_response)
+        {
+            gattQueueOnReadMultiple(evt->data.evt_gatt_characteristic_value.connection,
+                                    &evt->data.evt_gatt_characteristic_value.value,
+                                    displayPolledValue);
+        }
+        // Read responses need no confirmation
+        if (evt->data.evt_gatt_characteristic_value.att_opcode == sl_bt_gatt_handle_value_indication)
+        {
+            gattQueueConfirm(evt->data.evt_gatt_characteristic_value.connection);
         }
-        status = sl_bt_gatt_send_characteristic_confirmation(evt->data.evt_gatt_characteristic_value.connection);
 
         break;
+    }
 
     case sl_bt_evt_gatt_procedure_completed_id:
         // Check for encryption error and handle bonding
@@ -1034,9 +1061,22 @@ void handle_ble_event(sl_bt_msg_t *evt)
         {
             sl_bt_sm_increase_security(ble_data.connection_handle);
         }
+        // Report the result to whoever queued the procedure and issue the next one
+        gattQueueOnProcedureCompleted(evt->data.evt_gatt_procedure_completed.connection,
+                                      evt->data.evt_gatt_procedure_completed.result);
         break;
 
     case sl_bt_evt_system_soft_timer_id:
+        if (evt->data.evt_system_soft_timer.handle == GATT_QUEUE_TIMER_HANDLE)
+        {
+            gattQueueOnTimeout();
+            break;
+        }
+        if (evt->data.evt_system_soft_timer.handle == SCAN_TIMER_HANDLE)
+        {
+            scanOnTimer();
+            break;
+        }
         displayUpdate();
         break;
 
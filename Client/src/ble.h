@@ -7,6 +7,7 @@
 #include "sl_bt_api.h"
 #include <math.h>
 #include <src/gpio.h>
+#include <src/broadcast_rx.h>
 #include <string.h> // for memcpy()
 
 #define UINT8_TO_BITSTREAM(p, n) \
@@ -57,10 +58,6 @@
 // Reserved value
 #define RESERVED_VALUE 6.4
 
-// Define macros for scan interval and scan window
-#define SCAN_INTERVAL 80    // Scan interval (80 * 0.625ms = 50ms)
-#define SCAN_WINDOW 40      // Scan window (40 * 0.625ms = 25ms)
-#define SCANNER_POLICY 0x00 // Scanner filter policy: 0x00 = No filter (accept all advertisements)
 // Define macros for scanning PHY and discovery mode
 #define SCANNING_PHY 0x1   // Scanning PHY: 0x1 = 1M PHY, 0x4 = Coded PHY, 0x5 = Both 1M and Coded PHY
 #define DISCOVERY_MODE 0x1 // Discovery mode: 0x0 = Limited discoverable devices,
@@ -104,9 +101,10 @@ typedef struct
 #define BUTTON_PRESSED_VALUE 0x01
 // Define macros for Bluetooth address types
 #define PUBLIC_DEVICE_ADDRESS 0x00
-// Define macros for advertisement event flags
-#define ADVERTISEMENT_SCANNABLE 0x01
-#define ADVERTISEMENT_CONNECTABLE 0x02
+// Define macros for advertisement event flags, as reported by the scanner
+#define ADVERTISEMENT_CONNECTABLE SL_BT_SCANNER_EVENT_FLAG_CONNECTABLE
+#define ADVERTISEMENT_SCANNABLE SL_BT_SCANNER_EVENT_FLAG_SCANNABLE
+#define ADVERTISEMENT_DIRECTED SL_BT_SCANNER_EVENT_FLAG_DIRECTED
 #define ADVERTISEMENT_CONNECTABLE_SCANNABLE (ADVERTISEMENT_SCANNABLE | ADVERTISEMENT_CONNECTABLE)
 
 typedef struct
@@ -0,0 +1,51 @@
+/*
+  File: broadcast_rx.c
+
+  Author: Samiksha Patil
+  Description:
+   This file (broadcast_rx.c) decodes the posture broadcast a server puts in its
+   advertising data. It only depends on the AD format, so the server's host tests
+   build the packet with the server code and decode it with this file.
+  References:
+  - Bluetooth Core Specification Supplement, Part A 1.4 Manufacturer Specific Data
+*/
+#include "broadcast_rx.h"
+
+/*
+ * Function: broadcastDecode
+ * Description: Walks the AD structures for manufacturer specific data with our
+ *              company id and format. The payload is company id, format, sequence,
+ *              then flex angle, pitch and roll as int16 in 0.1 degree steps and the
+ *              posture state, all little endian.
+ */
+bool broadcastDecode(const uint8_t *data, uint8_t len, broadcast_sample_t *sample)
+{
+    const uint8_t *p;
+    uint8_t i = 0;
+    uint8_t ad_len;
+
+    while ((i + 1) < len)
+    {
+        ad_len = data[i];
+        if ((ad_len == 0) || ((i + 1 + ad_len) > len))
+        {
+            return false; // End of data or malformed structure
+        }
+
+        p = &data[i + 2];
+        if ((data[i + 1] == AD_TYPE_MANUFACTURER) &&
+            ((ad_len - 1) >= BROADCAST_PAYLOAD_SIZE) &&
+            ((p[0] | (p[1] << 8)) == BROADCAST_COMPANY_ID) &&
+            (p[2] == BROADCAST_FORMAT))
+        {
+            sample->sequence = p[3];
+            sample->flex = (int16_t)(p[4] | (p[5] << 8));
+            sample->pitch = (int16_t)(p[6] | (p[7] << 8));
+            sample->roll = (int16_t)(p[8] | (p[9] << 8));
+            sample->posture = p[10];
+            return true;
+        }
+        i += ad_len + 1;
+    }
+    return false;
+}
@@ -0,0 +1,25 @@
+#ifndef BROADCAST_RX_H
+#define BROADCAST_RX_H
+
+#include <stdint.h>
+#include "stdbool.h"
+
+// Posture broadcast in the server's manufacturer specific advertising data
+#define AD_TYPE_MANUFACTURER 0xFF
+#define BROADCAST_COMPANY_ID 0xFFFF // Bluetooth SIG id reserved for testing
+#define BROADCAST_FORMAT 0x01
+#define BROADCAST_PAYLOAD_SIZE 11   // company id 2, format 1, sequence 1, flex 2, pitch 2, roll 2, posture 1
+
+typedef struct
+{
+    uint8_t sequence;
+    int16_t flex;    // 0.1 degree
+    int16_t pitch;   // 0.1 degree
+    int16_t roll;    // 0.1 degree
+    uint8_t posture; // 0, 45 or 90
+} broadcast_sample_t;
+
+// True if the advertising data carries a posture broadcast, decoded into sample
+bool broadcastDecode(const uint8_t *data, uint8_t len, broadcast_sample_t *sample);
+
+#endif // BROADCAST_RX_H
@@ -0,0 +1,175 @@
+/*
+  File: gatt_cache.c
+
+  Author: Samiksha Patil
+  Description:
+   This file (gatt_cache.c) remembers the service and characteristic handles discovered
+   on a server, keyed by its address. The server has GATT caching enabled and exposes the
+   Database Hash characteristic, the hash read at discovery time is stored with the
+   handles. On a reconnect the discovery state machine reads the hash from its cached
+   handle, and when it still matches the stored one the handles are reused and the
+   client goes straight to enabling the indications. The entries are kept in user NVM
+   keys so they survive a reset just like the bond.
+  References:
+  - Bluetooth Core Specification v5.3, Vol 3, Part G, 2.5.2 Attribute Caching
+  - Silicon Labs Bluetooth API documentation
+*/
+#include "gatt_cache.h"
+#include <string.h>
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+static gatt_cache_entry_t cache[GATT_CACHE_ENTRIES];
+
+/*
+ * Function: gattCacheFind
+ * Description: Index of the entry of a server, -1 if there is none.
+ */
+static int gattCacheFind(bd_addr address, uint8_t addressType)
+{
+    for (int i = 0; i < GATT_CACHE_ENTRIES; i++)
+    {
+        if (cache[i].valid && (cache[i].addressType == addressType) &&
+            (memcmp(cache[i].address.addr, address.addr, sizeof(bd_addr)) == 0))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Function: gattCacheSave
+ * Description: Writes one entry to its NVM key.
+ */
+static void gattCacheSave(int index)
+{
+    sl_status_t status;
+
+    status = sl_bt_nvm_save(GATT_CACHE_NVM_KEY + index, sizeof(gatt_cache_entry_t),
+                            (const uint8_t *)&cache[index]);
+    if (status != SL_STATUS_OK)
+    {
+        LOG_ERROR("Error saving GATT cache entry: 0x%lx", status);
+    }
+}
+
+/*
+ * Function: gattCacheTouch
+ * Description: Makes an entry the most recently used one. The entries that were
+ *              more recent than it age by one, so the ages stay a ranking and the
+ *              least recently used entry is the one replaced. The caller saves the
+ *              touched entry itself.
+ */
+static void gattCacheTouch(int index)
+{
+    for (int i = 0; i < GATT_CACHE_ENTRIES; i++)
+    {
+        if ((i != index) && cache[i].valid && (cache[i].age < cache[index].age))
+        {
+            cache[i].age++;
+            gattCacheSave(i);
+        }
+    }
+
+    cache[index].age = 0;
+}
+
+/*
+ * Function: gattCacheInit
+ * Description: Loads the entries stored in NVM. A missing or short key leaves the
+ *              entry empty, the server is then discovered in full once.
+ */
+void gattCacheInit(void)
+{
+    size_t length;
+
+    for (int i = 0; i < GATT_CACHE_ENTRIES; i++)
+    {
+        length = 0;
+        if ((sl_bt_nvm_load(GATT_CACHE_NVM_KEY + i, sizeof(gatt_cache_entry_t), &length,
+                            (uint8_t *)&cache[i]) != SL_STATUS_OK) ||
+            (length != sizeof(gatt_cache_entry_t)))
+        {
+            memset(&cache[i], 0, sizeof(gatt_cache_entry_t));
+        }
+    }
+}
+
+/*
+ * Function: gattCacheLookup
+ * Description: Returns the entry of a server, NULL if it was never discovered. A
+ *              hit makes the entry the most recently used one.
+ */
+const gatt_cache_entry_t *gattCacheLookup(bd_addr address, uint8_t addressType)
+{
+    int index = gattCacheFind(address, addressType);
+
+    if (index < 0)
+    {
+        return NULL;
+    }
+
+    // Only write the NVM keys when the ranking changes
+    if (cache[index].age != 0)
+    {
+        gattCacheTouch(index);
+        gattCacheSave(index);
+    }
+    return &cache[index];
+}
+
+/*
+ * Function: gattCacheStore
+ * Description: Stores the handles of a server, replacing its previous entry or
+ *              else the least recently used one.
+ */
+void gattCacheStore(const gatt_cache_entry_t *entry)
+{
+    int index = gattCacheFind(entry->address, entry->addressType);
+    uint8_t previousAge = UINT8_MAX;
+
+    if (index >= 0)
+    {
+        previousAge = cache[index].age;
+    }
+    else
+    {
+        index = 0;
+        for (int i = 0; i < GATT_CACHE_ENTRIES; i++)
+        {
+            if (!cache[i].valid)
+            {
+                index = i;
+                break;
+            }
+            if (cache[i].age > cache[index].age)
+            {
+                index = i;
+            }
+        }
+    }
+
+    cache[index] = *entry;
+    cache[index].valid = true;
+    cache[index].age = previousAge;
+    gattCacheTouch(index);
+    gattCacheSave(index);
+}
+
+/*
+ * Function: gattCacheRemove
+ * Description: Drops the entry of a server whose database hash changed.
+ */
+void gattCacheRemove(bd_addr address, uint8_t addressType)
+{
+    int index = gattCacheFind(address, addressType);
+
+    if (index < 0)
+    {
+        return;
+    }
+
+    memset(&cache[index], 0, sizeof(gatt_cache_entry_t));
+    gattCacheSave(index);
+}
@@ -0,0 +1,40 @@
+#ifndef GATT_CACHE_H
+#define GATT_CACHE_H
+
+#include <stdint.h>
+#include "stdbool.h"
+#include "sl_bt_api.h"
+
+// Discovered handles of the servers we bonded with
+#define GATT_CACHE_ENTRIES 2          // Servers remembered, the oldest entry is replaced
+#define GATT_CACHE_NVM_KEY 0x4000     // User NVM key of entry 0, one key per entry
+#define GATT_CACHE_HASH_SIZE 16       // Database Hash characteristic, 128-bit AES-CMAC
+
+// Generic Attribute service and Database Hash characteristic, little-endian
+#define GATT_SERVICE_UUID 0x1801
+#define GATT_DATABASE_HASH_UUID 0x2B2A
+
+typedef struct
+{
+    bool valid;
+    bd_addr address;
+    uint8_t addressType;
+    uint8_t hash[GATT_CACHE_HASH_SIZE];  // Database hash the handles were discovered with
+    uint16_t hashHandle;                 // Database Hash characteristic
+    uint32_t flexServiceHandle;
+    uint16_t flexCharacteristicHandle;
+    uint32_t accelServiceHandle;
+    uint16_t accelCharacteristicHandle;
+    uint8_t age;                         // 0 for the most recently used entry
+} gatt_cache_entry_t;
+
+// Load the entries stored in NVM, call on boot
+void gattCacheInit(void);
+// Entry of a server, NULL if it was never discovered
+const gatt_cache_entry_t *gattCacheLookup(bd_addr address, uint8_t addressType);
+// Store the handles of a server after a full discovery
+void gattCacheStore(const gatt_cache_entry_t *entry);
+// Drop the entry of a server whose database changed
+void gattCacheRemove(bd_addr address, uint8_t addressType);
+
+#endif // GATT_CACHE_H
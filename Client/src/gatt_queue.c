@@ -0,0 +1,393 @@
+/*
+  File: gatt_queue.c
+
+  Author: Samiksha Patil
+  Description:
+   This file (gatt_queue.c) serialises the GATT client procedures. The stack runs one
+   procedure per connection at a time and refuses the next call until
+   sl_bt_evt_gatt_procedure_completed_id arrives, so two reads issued back to back lose
+   the second one. Every discovery, read, write and CCCD update goes through this queue
+   instead: the head command is issued, the next one waits for the completion event.
+   Each command can carry a callback that gets the result, which is how the discovery
+   state machine follows its own procedures.
+   Several characteristics can be polled with one ATT Read Multiple. The stack hands the
+   response over as one concatenated value, it is split back per handle here using the
+   sizes given when the command was queued. The stack has no Read Multiple Variable
+   Length command, so every value but the last one needs a fixed size.
+   A procedure that does not complete within GATT_QUEUE_TIMEOUT_MS is reported to its
+   caller as SL_STATUS_TIMEOUT. The stack still owns it, so the queue stays stalled until
+   the late completion arrives or the link drops on the 30 s ATT timeout.
+  References:
+  - Silicon Labs Bluetooth API documentation
+*/
+#include "gatt_queue.h"
+#include <string.h>
+#include "sl_sleeptimer.h"
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+static gatt_command_t queue[GATT_QUEUE_DEPTH + 1];  // Head entry is the one in flight
+static uint8_t head = 0;
+static uint8_t count = 0;
+static bool inFlight = false;
+static bool stalled = false;      // Timed out procedure still pending in the stack
+static gatt_queue_stats_t stats;
+
+/*
+ * Function: gattQueueNow
+ * Description: Milliseconds since boot for the latency stats.
+ */
+static uint32_t gattQueueNow(void)
+{
+    return sl_sleeptimer_tick_to_ms(sl_sleeptimer_get_tick_count());
+}
+
+/*
+ * Function: gattQueueFinish
+ * Description: Removes the head command and reports its result.
+ */
+static void gattQueueFinish(uint16_t result)
+{
+    gatt_command_t command = queue[head];
+    uint32_t latency = gattQueueNow() - command.queuedAt;
+
+    head = (head + 1) % (GATT_QUEUE_DEPTH + 1);
+    count--;
+    inFlight = false;
+
+    if (result == SL_STATUS_OK)
+    {
+        stats.completed++;
+    }
+    else if (result != SL_STATUS_TIMEOUT)
+    {
+        stats.failed++;
+    }
+    stats.lastLatencyMs = latency;
+    stats.totalLatencyMs += latency;
+    if (latency > stats.maxLatencyMs)
+    {
+        stats.maxLatencyMs = latency;
+    }
+
+    if (command.callback != NULL)
+    {
+        command.callback(result);
+    }
+}
+
+/*
+ * Function: gattQueueIssue
+ * Description: Hands the head command to the stack if nothing is in flight. A command the
+ *              stack refuses is reported failed and the next one is tried.
+ */
+static void gattQueueIssue(void)
+{
+    sl_status_t status;
+
+    while ((count > 0) && !inFlight && !stalled)
+    {
+        gatt_command_t *command = &queue[head];
+
+        switch (command->type)
+        {
+        case GATT_COMMAND_DISCOVER_SERVICES:
+            status = sl_bt_gatt_discover_primary_services(command->connection);
+            break;
+        case GATT_COMMAND_DISCOVER_CHARACTERISTICS:
+            status = sl_bt_gatt_discover_characteristics(command->connection, command->handle);
+            break;
+        case GATT_COMMAND_READ:
+            status = sl_bt_gatt_read_characteristic_value(command->connection, (uint16_t)command->handle);
+            break;
+        case GATT_COMMAND_READ_MULTIPLE:
+            status = sl_bt_gatt_read_multiple_characteristic_values(command->connection, command->length,
+                                                                    command->data);
+            break;
+        case GATT_COMMAND_WRITE:
+            status = sl_bt_gatt_write_characteristic_value(command->connection, (uint16_t)command->handle,
+                                                           command->length, command->data);
+            break;
+        case GATT_COMMAND_SET_NOTIFICATION:
+            status = sl_bt_gatt_set_characteristic_notification(command->connection, (uint16_t)command->handle,
+                                                                command->flags);
+            break;
+        default:
+            status = SL_STATUS_INVALID_PARAMETER;
+            break;
+        }
+
+        if (status == SL_STATUS_OK)
+        {
+            inFlight = true;
+            status = sl_bt_system_set_lazy_soft_timer((GATT_QUEUE_TIMEOUT_MS * 32768) / 1000, 0,
+                                                      GATT_QUEUE_TIMER_HANDLE, 1);
+            if (status != SL_STATUS_OK)
+            {
+                LOG_ERROR("Error starting GATT timeout: 0x%lx", status);
+            }
+            return;
+        }
+
+        LOG_ERROR("GATT command %d refused: 0x%lx", command->type, (unsigned long)status);
+        gattQueueFinish((uint16_t)status);
+    }
+}
+
+/*
+ * Function: gattQueuePush
+ * Description: Appends a command and issues it when the stack is idle.
+ */
+static bool gattQueuePush(const gatt_command_t *command)
+{
+    if (count > GATT_QUEUE_DEPTH)
+    {
+        stats.dropped++;
+        LOG_ERROR("GATT queue full, command %d dropped", command->type);
+        return false;
+    }
+
+    queue[(head + count) % (GATT_QUEUE_DEPTH + 1)] = *command;
+    queue[(head + count) % (GATT_QUEUE_DEPTH + 1)].queuedAt = gattQueueNow();
+    count++;
+    stats.queued++;
+    if (count > stats.maxDepth)
+    {
+        stats.maxDepth = count;
+    }
+
+    gattQueueIssue();
+    return true;
+}
+
+/*
+ * Function: gattQueueDiscoverServices
+ * Description: Queues the discovery of all primary services.
+ */
+bool gattQueueDiscoverServices(uint8_t connection, gatt_queue_callback_t callback)
+{
+    gatt_command_t command = {.type = GATT_COMMAND_DISCOVER_SERVICES, .connection = connection,
+                              .callback = callback};
+
+    return gattQueuePush(&command);
+}
+
+/*
+ * Function: gattQueueDiscoverCharacteristics
+ * Description: Queues the discovery of all characteristics of a service.
+ */
+bool gattQueueDiscoverCharacteristics(uint8_t connection, uint32_t service, gatt_queue_callback_t callback)
+{
+    gatt_command_t command = {.type = GATT_COMMAND_DISCOVER_CHARACTERISTICS, .connection = connection,
+                              .handle = service, .callback = callback};
+
+    return gattQueuePush(&command);
+}
+
+/*
+ * Function: gattQueueRead
+ * Description: Queues a read, the value arrives as sl_bt_evt_gatt_characteristic_value_id.
+ */
+bool gattQueueRead(uint8_t connection, uint16_t characteristic, gatt_queue_callback_t callback)
+{
+    gatt_command_t command = {.type = GATT_COMMAND_READ, .connection = connection,
+                              .handle = characteristic, .callback = callback};
+
+    return gattQueuePush(&command);
+}
+
+/*
+ * Function: gattQueueReadMultiple
+ * Description: Queues one Read Multiple for a list of characteristics. The Silicon Labs
+ *              server refuses a Read Multiple of a single handle, one handle is read plainly.
+ */
+bool gattQueueReadMultiple(uint8_t connection, uint8_t count, const uint16_t *characteristics,
+                           const uint8_t *sizes, gatt_queue_callback_t callback)
+{
+    gatt_command_t command = {.type = GATT_COMMAND_READ_MULTIPLE, .connection = connection,
+                              .callback = callback};
+
+    if ((count == 0) || (count > GATT_QUEUE_MAX_READ_MULTIPLE))
+    {
+        LOG_ERROR("GATT read multiple of %d handles", count);
+        return false;
+    }
+    if (count == 1)
+    {
+        return gattQueueRead(connection, characteristics[0], callback);
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        command.data[2 * i] = characteristics[i] & 0xFF;
+        command.data[2 * i + 1] = characteristics[i] >> 8;
+        command.sizes[i] = sizes[i];
+    }
+    command.length = 2 * count;
+
+    return gattQueuePush(&command);
+}
+
+/*
+ * Function: gattQueueWrite
+ * Description: Queues a write with response, the value is copied.
+ */
+bool gattQueueWrite(uint8_t connection, uint16_t characteristic, uint8_t length, const uint8_t *data,
+                    gatt_queue_callback_t callback)
+{
+    gatt_command_t command = {.type = GATT_COMMAND_WRITE, .connection = connection,
+                              .handle = characteristic, .callback = callback};
+
+    if (length > GATT_QUEUE_MAX_WRITE)
+    {
+        LOG_ERROR("GATT write of %d bytes too long", length);
+        return false;
+    }
+    command.length = length;
+    memcpy(command.data, data, length);
+
+    return gattQueuePush(&command);
+}
+
+/*
+ * Function: gattQueueSetNotification
+ * Description: Queues a CCCD update.
+ */
+bool gattQueueSetNotification(uint8_t connection, uint16_t characteristic, uint8_t flags,
+                              gatt_queue_callback_t callback)
+{
+    gatt_command_t command = {.type = GATT_COMMAND_SET_NOTIFICATION, .connection = connection,
+                              .handle = characteristic, .flags = flags, .callback = callback};
+
+    return gattQueuePush(&command);
+}
+
+/*
+ * Function: gattQueueConfirm
+ * Description: Confirms a received indication. Confirmations do not occupy the
+ *              procedure slot, holding them back would only delay the server.
+ */
+void gattQueueConfirm(uint8_t connection)
+{
+    sl_status_t status = sl_bt_gatt_send_characteristic_confirmation(connection);
+
+    if (status != SL_STATUS_OK)
+    {
+        LOG_ERROR("Error confirming indication: 0x%lx", status);
+        return;
+    }
+    stats.confirmations++;
+}
+
+/*
+ * Function: gattQueueOnProcedureCompleted
+ * Description: Completes the command in flight and issues the next one.
+ */
+void gattQueueOnProcedureCompleted(uint8_t connection, uint16_t result)
+{
+    (void)connection;
+
+    if (stalled)
+    {
+        // Late completion of a command already reported as timed out
+        stalled = false;
+    }
+    else if (inFlight)
+    {
+        sl_bt_system_set_lazy_soft_timer(0, 0, GATT_QUEUE_TIMER_HANDLE, 1);
+        gattQueueFinish(result);
+    }
+
+    gattQueueIssue();
+}
+
+/*
+ * Function: gattQueueOnTimeout
+ * Description: The command in flight took too long, its caller gets SL_STATUS_TIMEOUT.
+ */
+void gattQueueOnTimeout(void)
+{
+    if (!inFlight)
+    {
+        return;
+    }
+
+    stats.timedOut++;
+    LOG_ERROR("GATT command %d timed out", queue[head].type);
+    stalled = true;
+    gattQueueFinish(SL_STATUS_TIMEOUT);
+}
+
+/*
+ * Function: gattQueueOnReadMultiple
+ * Description: Splits the response of the Read Multiple in flight and hands each value to
+ *              the handler with its characteristic. A response cut short by the MTU only
+ *              delivers the values that arrived complete.
+ */
+void gattQueueOnReadMultiple(uint8_t connection, const uint8array *value, gatt_queue_value_handler_t handler)
+{
+    gatt_command_t *command = &queue[head];
+    uint8_t count;
+    uint8_t offset = 0;
+
+    if (!inFlight || (command->type != GATT_COMMAND_READ_MULTIPLE) || (command->connection != connection))
+    {
+        return;
+    }
+
+    count = command->length / 2;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint16_t characteristic = command->data[2 * i] | (command->data[2 * i + 1] << 8);
+        uint8_t size = (i == count - 1) ? (value->len - offset) : command->sizes[i];
+
+        if ((offset + size) > value->len)
+        {
+            break;
+        }
+        handler(characteristic, &value->data[offset], size);
+        offset += size;
+    }
+}
+
+/*
+ * Function: gattQueueOnClosed
+ * Description: Drops the commands of a closed connection, their callbacks are not
+ *              called as the connection state is reset on close anyway.
+ */
+void gattQueueOnClosed(uint8_t connection)
+{
+    uint8_t kept = 0;
+
+    if (inFlight && (queue[head].connection == connection))
+    {
+        sl_bt_system_set_lazy_soft_timer(0, 0, GATT_QUEUE_TIMER_HANDLE, 1);
+        inFlight = false;
+    }
+    // The client runs a single connection, a stalled procedure went with it
+    stalled = false;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        gatt_command_t *command = &queue[(head + i) % (GATT_QUEUE_DEPTH + 1)];
+
+        if (command->connection != connection)
+        {
+            queue[(head + kept) % (GATT_QUEUE_DEPTH + 1)] = *command;
+            kept++;
+        }
+    }
+
+    count = kept;
+
+    gattQueueIssue();
+}
+
+/*
+ * Function: gattQueueGetStats
+ * Description: Counters and latencies since boot.
+ */
+const gatt_queue_stats_t *gattQueueGetStats(void)
+{
+    return &stats;
+}
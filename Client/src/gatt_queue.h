@@ -0,0 +1,79 @@
+#ifndef GATT_QUEUE_H
+#define GATT_QUEUE_H
+
+#include <stdint.h>
+#include "stdbool.h"
+#include "sl_bt_api.h"
+
+// GATT client command queue
+#define GATT_QUEUE_DEPTH 8               // Commands waiting behind the one in flight
+#define GATT_QUEUE_MAX_WRITE 20          // Largest value a queued write carries
+#define GATT_QUEUE_MAX_READ_MULTIPLE (GATT_QUEUE_MAX_WRITE / 2) // Handles in one Read Multiple
+#define GATT_QUEUE_TIMEOUT_MS 5000       // Time a procedure may take before it is reported failed
+#define GATT_QUEUE_TIMER_HANDLE 0x02     // Soft timer handle of the command timeout
+
+typedef enum
+{
+    GATT_COMMAND_DISCOVER_SERVICES,
+    GATT_COMMAND_DISCOVER_CHARACTERISTICS,
+    GATT_COMMAND_READ,
+    GATT_COMMAND_READ_MULTIPLE,
+    GATT_COMMAND_WRITE,
+    GATT_COMMAND_SET_NOTIFICATION
+} gatt_command_type_t;
+
+// Called once per command with the procedure result, SL_STATUS_TIMEOUT if it timed out
+typedef void (*gatt_queue_callback_t)(uint16_t result);
+// Called per characteristic with its part of a Read Multiple response
+typedef void (*gatt_queue_value_handler_t)(uint16_t characteristic, const uint8_t *data, uint8_t length);
+
+typedef struct
+{
+    gatt_command_type_t type;
+    uint8_t connection;
+    uint32_t handle;                     // Service or characteristic, by command type
+    uint8_t flags;                       // sl_bt_gatt_client_config_flag_t for notifications
+    uint8_t length;
+    uint8_t data[GATT_QUEUE_MAX_WRITE];  // Write value, or the handle list of a Read Multiple
+    uint8_t sizes[GATT_QUEUE_MAX_READ_MULTIPLE]; // Value size per handle of a Read Multiple
+    gatt_queue_callback_t callback;      // NULL if the caller does not care
+    uint32_t queuedAt;                   // Milliseconds when queued
+} gatt_command_t;
+
+typedef struct
+{
+    uint32_t queued;
+    uint32_t completed;                  // Procedures that ended with SL_STATUS_OK
+    uint32_t failed;                     // Refused by the stack or ended with an error
+    uint32_t timedOut;
+    uint32_t dropped;                    // Queue was full
+    uint32_t confirmations;
+    uint8_t maxDepth;
+    uint32_t lastLatencyMs;              // Queued to completed, includes the wait in the queue
+    uint32_t maxLatencyMs;
+    uint32_t totalLatencyMs;             // Divide by completed + failed for the mean
+} gatt_queue_stats_t;
+
+// Queue a command, false if the queue is full
+bool gattQueueDiscoverServices(uint8_t connection, gatt_queue_callback_t callback);
+bool gattQueueDiscoverCharacteristics(uint8_t connection, uint32_t service, gatt_queue_callback_t callback);
+bool gattQueueRead(uint8_t connection, uint16_t characteristic, gatt_queue_callback_t callback);
+// One ATT Read Multiple for several characteristics. Every value but the last one
+// must have the fixed size given in sizes, the last one takes the rest of the response.
+bool gattQueueReadMultiple(uint8_t connection, uint8_t count, const uint16_t *characteristics,
+                           const uint8_t *sizes, gatt_queue_callback_t callback);
+bool gattQueueWrite(uint8_t connection, uint16_t characteristic, uint8_t length, const uint8_t *data,
+                    gatt_queue_callback_t callback);
+bool gattQueueSetNotification(uint8_t connection, uint16_t characteristic, uint8_t flags,
+                              gatt_queue_callback_t callback);
+// Confirm an indication, not a GATT procedure so it is sent right away
+void gattQueueConfirm(uint8_t connection);
+// Call from the matching stack events
+void gattQueueOnProcedureCompleted(uint8_t connection, uint16_t result);
+void gattQueueOnTimeout(void);
+void gattQueueOnReadMultiple(uint8_t connection, const uint8array *value, gatt_queue_value_handler_t handler);
+void gattQueueOnClosed(uint8_t connection);
+// Counters since boot
+const gatt_queue_stats_t *gattQueueGetStats(void);
+
+#endif // GATT_QUEUE_H
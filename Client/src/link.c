@@ -0,0 +1,122 @@
+/*
+  File: link.c
+
+  Author: Samiksha Patil
+  Description:
+   This file (link.c) negotiates the link capabilities of a connection. Links open on
+   1M PHY with 27 octet link layer PDUs and a 23 byte ATT MTU. Once the connection is
+   opened the 2M PHY and the largest data length are requested, and the stack runs the
+   ATT MTU exchange itself from the maximum set at boot. The results are recorded as the
+   events arrive so the GATT code can size its payloads from linkGetPayloadBudget().
+  References:
+  - Silicon Labs Bluetooth API documentation
+*/
+#include "link.h"
+#include "sl_bt_api.h"
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+static link_info_t link_info;
+
+/*
+ * Function: linkInit
+ * Description: Sets the largest ATT MTU the client offers in the exchange.
+ */
+void linkInit(void)
+{
+    sl_status_t status;
+    uint16_t max_mtu;
+
+    link_info.open = false;
+
+    status = sl_bt_gatt_set_max_mtu(LINK_MAX_MTU, &max_mtu);
+    if (status != SL_STATUS_OK)
+    {
+        LOG_ERROR("Error setting max MTU: 0x%lx", status);
+    }
+}
+
+/*
+ * Function: linkOnOpened
+ * Description: Requests 2M PHY and the largest link layer PDU. The server may refuse
+ *              either, the link then stays on whatever the events report.
+ */
+void linkOnOpened(uint8_t connection)
+{
+    sl_status_t status;
+
+    link_info.open = true;
+    link_info.connection = connection;
+    link_info.phy = sl_bt_gap_phy_1m;
+    link_info.mtu = LINK_DEFAULT_MTU;
+    link_info.txDataLen = LINK_DEFAULT_DATA_LEN;
+    link_info.rxDataLen = LINK_DEFAULT_DATA_LEN;
+
+    // Coded PHY is not accepted, it would lower the throughput instead of raising it
+    status = sl_bt_connection_set_preferred_phy(connection, sl_bt_gap_phy_2m,
+                                                sl_bt_gap_phy_1m | sl_bt_gap_phy_2m);
+    if (status != SL_STATUS_OK)
+    {
+        LOG_ERROR("Error setting preferred PHY: 0x%lx", status);
+    }
+
+    status = sl_bt_connection_set_data_length(connection, LINK_MAX_DATA_LEN, LINK_MAX_TX_TIME_US);
+    if (status != SL_STATUS_OK)
+    {
+        LOG_ERROR("Error setting data length: 0x%lx", status);
+    }
+}
+
+void linkOnClosed(uint8_t connection)
+{
+    if (link_info.connection == connection)
+    {
+        link_info.open = false;
+    }
+}
+
+void linkOnPhy(uint8_t connection, uint8_t phy)
+{
+    if (link_info.open && (link_info.connection == connection))
+    {
+        link_info.phy = phy;
+        LOG_INFO("Link PHY %d", phy);
+    }
+}
+
+void linkOnDataLength(uint8_t connection, uint16_t txDataLen, uint16_t rxDataLen)
+{
+    if (link_info.open && (link_info.connection == connection))
+    {
+        link_info.txDataLen = txDataLen;
+        link_info.rxDataLen = rxDataLen;
+        LOG_INFO("Link data length tx %d rx %d", txDataLen, rxDataLen);
+    }
+}
+
+void linkOnMtu(uint8_t connection, uint16_t mtu)
+{
+    if (link_info.open && (link_info.connection == connection))
+    {
+        link_info.mtu = mtu;
+        LOG_INFO("Link MTU %d", mtu);
+    }
+}
+
+const link_info_t *linkGetInfo(void)
+{
+    return &link_info;
+}
+
+/*
+ * Function: linkGetPayloadBudget
+ * Description: ATT MTU less the 3 byte opcode and handle header.
+ */
+uint16_t linkGetPayloadBudget(uint8_t connection)
+{
+    if (!link_info.open || (link_info.connection != connection))
+    {
+        return LINK_DEFAULT_MTU - 3;
+    }
+    return link_info.mtu - 3;
+}
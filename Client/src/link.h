@@ -0,0 +1,40 @@
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdint.h>
+#include "stdbool.h"
+
+// Link capability limits
+#define LINK_MAX_MTU 247          // Largest ATT MTU the stack supports
+#define LINK_MAX_DATA_LEN 251     // Link layer payload octets with DLE
+#define LINK_MAX_TX_TIME_US 2120  // Air time of a 251 octet PDU on 1M PHY
+#define LINK_DEFAULT_MTU 23       // ATT MTU before the exchange
+#define LINK_DEFAULT_DATA_LEN 27  // Link layer payload octets before DLE
+
+// Negotiated capabilities of the open connection
+typedef struct
+{
+    bool open;
+    uint8_t connection;
+    uint8_t phy;          // sl_bt_gap_phy_1m, sl_bt_gap_phy_2m or sl_bt_gap_phy_coded
+    uint16_t mtu;         // ATT MTU
+    uint16_t txDataLen;   // Link layer payload octets sent per PDU
+    uint16_t rxDataLen;   // Link layer payload octets accepted per PDU
+} link_info_t;
+
+// Set the largest MTU for the exchange, call on boot
+void linkInit(void);
+// Request 2M PHY and long PDUs, call on connection opened
+void linkOnOpened(uint8_t connection);
+// Forget the link, call on connection closed
+void linkOnClosed(uint8_t connection);
+// Record the results reported by the stack
+void linkOnPhy(uint8_t connection, uint8_t phy);
+void linkOnDataLength(uint8_t connection, uint16_t txDataLen, uint16_t rxDataLen);
+void linkOnMtu(uint8_t connection, uint16_t mtu);
+// Negotiated link state
+const link_info_t *linkGetInfo(void);
+// Largest characteristic value that fits one ATT PDU on the connection
+uint16_t linkGetPayloadBudget(uint8_t connection);
+
+#endif // LINK_H
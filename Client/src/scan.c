@@ -0,0 +1,229 @@
+/*
+  File: scan.c
+
+  Author: Samiksha Patil
+  Description:
+   This file (scan.c) finds the server to connect to. Instead of one compiled in
+   address, any server of the fleet is accepted: the scan response carries the flex
+   sensor service UUID and the advertising packet carries the posture broadcast, whose
+   company id and format are the device class tag. Either one identifies a server, and
+   its RSSI has to be above SCAN_MIN_RSSI. A bonded server calling back with directed
+   advertising is accepted as it is, the controller only reports it to the device it
+   is directed to.
+   Scanning is active so the scan responses are received. It runs at a 50% duty cycle
+   for SCAN_FAST_PHASE_MS, then backs off to a 1.28s interval with a short window,
+   which still catches a server advertising at 100ms within a few seconds.
+   With SCAN_USE_ACCEPT_LIST the bonded servers are put on the controller's Filter
+   Accept List and the scanner only reports them, new servers are then not found.
+  References:
+  - Bluetooth Core Specification v5.3, Vol 6, Part B, 4.3.3 Scanning filter policy
+  - Silicon Labs Bluetooth API documentation
+*/
+#include "scan.h"
+#include <string.h>
+#include "ble.h"
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+// Flex Sensor Service UUID: 39b6b0dc-6ee2-4e77-a665-75d0b64649a3
+static const uint8_t flexSensorService_UUID[16] = {
+    0xa3, 0x49, 0x46, 0xb6, 0xd0, 0x75, 0x65, 0xa6,
+    0x77, 0x4e, 0xe2, 0x6e, 0xdc, 0xb0, 0xb6, 0x39
+};
+
+static uint8_t filter_policy = sl_bt_scanner_filter_policy_basic_unfiltered;
+
+/*
+ * Function: scanConfigure
+ * Description: (Re)starts the scanner with the given timing.
+ */
+static void scanConfigure(uint16_t interval, uint16_t window)
+{
+    sl_status_t status;
+
+    // Parameters only change while the scanner is stopped
+    sl_bt_scanner_stop();
+
+    status = sl_bt_scanner_set_parameters_and_filter(sl_bt_scanner_scan_mode_active, interval, window,
+                                                     0, filter_policy);
+    if (status != SL_STATUS_OK)
+    {
+        LOG_ERROR("Error setting the parameters for scanning: 0x%lx", (unsigned long)status);
+    }
+
+    status = sl_bt_scanner_start(SCANNING_PHY, DISCOVERY_MODE);
+    if (status != SL_STATUS_OK)
+    {
+        LOG_ERROR("Error starting scanner: 0x%lx", (unsigned long)status);
+    }
+}
+
+/*
+ * Function: scanLoadAcceptList
+ * Description: The controller forgets its accept list on reset, the bonded servers are
+ *              added again. Handles without a bond are refused and skipped.
+ */
+static void scanLoadAcceptList(void)
+{
+#if SCAN_USE_ACCEPT_LIST
+    static bool loaded = false;
+
+    if (loaded)
+    {
+        return;
+    }
+    loaded = true;
+
+    for (uint8_t bonding = 0; bonding < SCAN_MAX_BONDINGS; bonding++)
+    {
+        scanOnBonded(bonding);
+    }
+#endif
+}
+
+/*
+ * Function: scanStart
+ * Description: Starts the fast phase and the timer that ends it.
+ */
+void scanStart(void)
+{
+    sl_status_t status;
+
+    scanLoadAcceptList();
+    scanConfigure(SCAN_FAST_INTERVAL, SCAN_FAST_WINDOW);
+
+    status = sl_bt_system_set_lazy_soft_timer((SCAN_FAST_PHASE_MS * 32768ULL) / 1000, 0,
+                                              SCAN_TIMER_HANDLE, 1);
+    if (status != SL_STATUS_OK)
+    {
+        LOG_ERROR("Error starting scan timer: 0x%lx", (unsigned long)status);
+    }
+}
+
+/*
+ * Function: scanStop
+ * Description: Stops scanning and the phase timer.
+ */
+void scanStop(void)
+{
+    sl_status_t status;
+
+    sl_bt_system_set_lazy_soft_timer(0, 0, SCAN_TIMER_HANDLE, 1);
+
+    status = sl_bt_scanner_stop();
+    if (status != SL_STATUS_OK)
+    {
+        LOG_ERROR("Error stopping scanner: 0x%lx", (unsigned long)status);
+    }
+}
+
+/*
+ * Function: scanOnTimer
+ * Description: No server turned up in the fast phase, back off to save energy.
+ */
+void scanOnTimer(void)
+{
+    scanConfigure(SCAN_SLOW_INTERVAL, SCAN_SLOW_WINDOW);
+}
+
+/*
+ * Function: scanOnBonded
+ * Description: Puts a bonded server on the accept list and filters the scan with it.
+ *              The new policy applies the next time the scanner is started.
+ */
+void scanOnBonded(uint8_t bonding)
+{
+#if SCAN_USE_ACCEPT_LIST
+    if (sl_bt_accept_list_add_device_by_bonding(bonding) == SL_STATUS_OK)
+    {
+        filter_policy = sl_bt_scanner_filter_policy_basic_filtered;
+    }
+#else
+    (void)bonding;
+#endif
+}
+
+/*
+ * Function: scanHasServerTag
+ * Description: Walks the AD structures for the flex service UUID or the posture
+ *              broadcast of a server.
+ */
+static bool scanHasServerTag(const uint8array *data)
+{
+    const uint8_t *p;
+    uint8_t i = 0;
+    uint8_t ad_len;
+
+    while ((i + 1) < data->len)
+    {
+        ad_len = data->data[i];
+        if ((ad_len == 0) || ((i + 1 + ad_len) > data->len))
+        {
+            return false; // End of data or malformed structure
+        }
+
+        p = &data->data[i + 2];
+        switch (data->data[i + 1])
+        {
+        case AD_TYPE_UUID128_SOME:
+        case AD_TYPE_UUID128_ALL:
+            for (uint8_t u = 0; (u + sizeof(flexSensorService_UUID)) <= (uint8_t)(ad_len - 1); u += sizeof(flexSensorService_UUID))
+            {
+                if (memcmp(&p[u], flexSensorService_UUID, sizeof(flexSensorService_UUID)) == 0)
+                {
+                    return true;
+                }
+            }
+            break;
+
+        case AD_TYPE_MANUFACTURER:
+            // Device class tag: our company id and broadcast format
+            if (((ad_len - 1) >= 3) &&
+                ((p[0] | (p[1] << 8)) == BROADCAST_COMPANY_ID) &&
+                (p[2] == BROADCAST_FORMAT))
+            {
+                return true;
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        i += ad_len + 1;
+    }
+    return false;
+}
+
+/*
+ * Function: scanMatch
+ * Description: True if the report is connectable and comes from a server of ours
+ *              within range.
+ */
+bool scanMatch(const sl_bt_evt_scanner_legacy_advertisement_report_t *report)
+{
+    if (!(report->event_flags & SL_BT_SCANNER_EVENT_FLAG_CONNECTABLE))
+    {
+        return false;
+    }
+
+#if SCAN_MATCH_SERVER_ADDRESS
+    if (!is_target_device(report->address))
+    {
+        return false;
+    }
+#endif
+
+    // A bonded server calling us back, directed advertising carries no data
+    if (report->event_flags & SL_BT_SCANNER_EVENT_FLAG_DIRECTED)
+    {
+        return true;
+    }
+
+    if (report->rssi < SCAN_MIN_RSSI)
+    {
+        return false;
+    }
+
+    return scanHasServerTag(&report->data);
+}
@@ -0,0 +1,37 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdint.h>
+#include "stdbool.h"
+#include "sl_bt_api.h"
+
+// Scan policy: a fast phase to find a server quickly, then a slow duty cycle
+#define SCAN_FAST_INTERVAL 80         // 80 * 0.625ms = 50ms
+#define SCAN_FAST_WINDOW 40           // 40 * 0.625ms = 25ms, 50% duty cycle
+#define SCAN_FAST_PHASE_MS 30000      // Fast phase after boot and after every disconnect
+#define SCAN_SLOW_INTERVAL 2048       // 2048 * 0.625ms = 1.28s
+#define SCAN_SLOW_WINDOW 18           // 18 * 0.625ms = 11.25ms, below 1% duty cycle
+#define SCAN_TIMER_HANDLE 0x03        // Soft timer handle of the phase switch
+
+// Server match
+#define SCAN_MIN_RSSI -85             // Weaker servers are out of reach of the wearer
+#define SCAN_MATCH_SERVER_ADDRESS 0   // 1: only connect to SERVER_BT_ADDRESS from ble_device_type.h
+#define SCAN_USE_ACCEPT_LIST 0        // 1: once bonded, the controller only reports bonded servers
+#define SCAN_MAX_BONDINGS 4           // Bonding handles tried when the accept list is rebuilt
+
+// AD types used by the match
+#define AD_TYPE_UUID128_SOME 0x06
+#define AD_TYPE_UUID128_ALL 0x07
+
+// Start the fast phase, the slow phase follows on its own
+void scanStart(void);
+// Stop scanning, call before opening a connection
+void scanStop(void);
+// Call on sl_bt_evt_system_soft_timer_id with SCAN_TIMER_HANDLE
+void scanOnTimer(void);
+// Add a new bond to the accept list
+void scanOnBonded(uint8_t bonding);
+// True if the report comes from a connectable server of ours
+bool scanMatch(const sl_bt_evt_scanner_legacy_advertisement_report_t *report);
+
+#endif // SCAN_H
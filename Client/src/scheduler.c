@@ -17,6 +17,9 @@
 #include "log.h"
 #include "i2c.h"
 #include "timers.h"
+#include "gatt_cache.h"
+#include "gatt_queue.h"
+#include <string.h>
 
 #include <src/lcd.h>
 uint8_t const htm_service_uuid[] = {0x09, 0x18};        // Little-endian format for 0x1809 uuid
@@ -62,19 +65,81 @@ typedef enum
 } SensorState_t;
 
 static SensorState_t sensorState = STATE_IDLE;
-static bool initial_stage = true; // To enable button indications
 
 typedef enum
 {
-  DISCOVERING_HTM_SERVICE,
-  DISCOVERING_HTM_CHARACTERISTICS,
-  DISCOVERING_BUTTON_SERVICE,
-  DISCOVERING_BUTTON_CHARACTERISTICS,
-  DISCOVERING_BUTTON_NOTIFICATION,
+  VALIDATING_CACHE,
+  DISCOVERING_SERVICES,
+  DISCOVERING_CHARACTERISTICS,
+  SUBSCRIBING,
+  WAITING_FOR_SECURITY,
+  DISCOVERING_HASH_CHARACTERISTIC,
+  READING_DATABASE_HASH,
   WAIT_FOR_DATA
 } discovery_state_t;
 
-static discovery_state_t current_state = DISCOVERING_HTM_SERVICE;
+static discovery_state_t current_state = WAIT_FOR_DATA;
+
+// Handle cache, the server's database hash decides whether the cached handles still apply
+static uint8_t const gatt_service_uuid[] = {GATT_SERVICE_UUID & 0xFF, GATT_SERVICE_UUID >> 8};
+static uint8_t const database_hash_uuid[] = {GATT_DATABASE_HASH_UUID & 0xFF, GATT_DATABASE_HASH_UUID >> 8};
+static gatt_cache_entry_t discovered;      // Server being discovered, stored once the hash is read
+static uint8_t database_hash[GATT_CACHE_HASH_SIZE];
+static bool database_hash_read = false;
+static bool cache_hit = false;
+
+// Services and characteristics the client looks for. All services come from one
+// "discover all primary services" pass, then one characteristics pass per service
+// found, matched against these tables. Services are listed in the order their
+// characteristics are discovered, the GATT service only serves the handle cache
+// so it comes last, after the subscriptions.
+typedef enum
+{
+  SERVICE_FLEX,
+  SERVICE_ACCEL,
+  SERVICE_GATT,
+  SERVICE_COUNT
+} discovery_service_t;
+
+typedef enum
+{
+  CHARACTERISTIC_FLEX,
+  CHARACTERISTIC_ACCEL,
+  CHARACTERISTIC_DATABASE_HASH,
+  CHARACTERISTIC_COUNT
+} discovery_characteristic_t;
+
+typedef struct
+{
+  const uint8_t *uuid;
+  uint8_t uuidLength;
+} discovery_uuid_t;
+
+typedef struct
+{
+  const uint8_t *uuid;
+  uint8_t uuidLength;
+  discovery_service_t service;
+  uint8_t subscribe;          // sl_bt_gatt_indication, sl_bt_gatt_notification or 0
+} discovery_wanted_t;
+
+static const discovery_uuid_t wanted_services[SERVICE_COUNT] = {
+  [SERVICE_FLEX]  = {flexSensorService_UUID, sizeof(flexSensorService_UUID)},
+  [SERVICE_ACCEL] = {accelService_UUID, sizeof(accelService_UUID)},
+  [SERVICE_GATT]  = {gatt_service_uuid, sizeof(gatt_service_uuid)},
+};
+
+static const discovery_wanted_t wanted_characteristics[CHARACTERISTIC_COUNT] = {
+  [CHARACTERISTIC_FLEX]          = {flexSensorChar_UUID, sizeof(flexSensorChar_UUID), SERVICE_FLEX, sl_bt_gatt_indication},
+  [CHARACTERISTIC_ACCEL]         = {accelChar_UUID, sizeof(accelChar_UUID), SERVICE_ACCEL, sl_bt_gatt_indication},
+  [CHARACTERISTIC_DATABASE_HASH] = {database_hash_uuid, sizeof(database_hash_uuid), SERVICE_GATT, 0},
+};
+
+static uint32_t service_handles[SERVICE_COUNT];
+static uint16_t characteristic_handles[CHARACTERISTIC_COUNT];
+static uint8_t next_service;          // Next service whose characteristics are discovered
+static uint8_t next_subscription;     // Next entry of wanted_characteristics to subscribe
+static uint8_t pending_subscription;  // Entry whose CCCD write is in flight
 
 /**
  * @brief Initializes the event flags for the scheduler.
@@ -225,130 +290,326 @@ void I2CStateMachine(sl_bt_msg_t *evt)
 }
 
 /**
- * @brief Handles Bluetooth Low Energy (BLE) discovery events.
+ * @brief Index of the table entry matching a discovered UUID, -1 if none does.
+ */
+static int discovery_match(const uint8_t *uuid, uint8_t length, bool service)
+{
+  int count = service ? SERVICE_COUNT : CHARACTERISTIC_COUNT;
+
+  for (int i = 0; i < count; i++)
+  {
+    const uint8_t *wanted = service ? wanted_services[i].uuid : wanted_characteristics[i].uuid;
+    uint8_t wantedLength = service ? wanted_services[i].uuidLength : wanted_characteristics[i].uuidLength;
+
+    if ((length == wantedLength) && (memcmp(uuid, wanted, length) == 0))
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void discovery_on_completed(uint16_t result);
+
+/**
+ * @brief Queues the characteristics pass of the next service that was found,
+ *        up to but not including service last. The caller sets current_state first,
+ *        a command the stack refuses completes before this returns.
  *
- * This function processes various Bluetooth events related to device discovery and GATT procedures.
- * It handles events such as connection opened, connection closed, GATT procedure completion,
- * service discovery, characteristic discovery, and characteristic value notifications.
- * Based on the event, it performs actions like starting service discovery, opening connections,
- * and processing received data. It also updates the display with relevant information and handles
- * errors during Bluetooth operations.
+ * @return false once those services have been searched.
+ */
+static bool discovery_next_service(uint8_t last)
+{
+  while (next_service < last)
+  {
+    uint32_t service = service_handles[next_service++];
+
+    if (service == 0)
+    {
+      continue;
+    }
+    if (gattQueueDiscoverCharacteristics(getBleDataPtr()->connection_handle, service,
+                                         discovery_on_completed))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Queues the CCCD write of the next characteristic to subscribe. The writes
+ *        follow each other through the GATT queue.
  *
- * @param evt The Bluetooth event message that contains event data and details.
- * @return None
+ * @return false once every subscription has been written.
  */
-void discovery_state_machine(sl_bt_msg_t *evt)
+static bool discovery_next_subscription(void)
 {
-  sl_status_t status;
-  switch (SL_BT_MSG_ID(evt->header))
+  while (next_subscription < CHARACTERISTIC_COUNT)
   {
+    const discovery_wanted_t *wanted = &wanted_characteristics[next_subscription];
+    uint16_t characteristic = characteristic_handles[next_subscription++];
 
-  case sl_bt_evt_connection_opened_id:
+    if ((wanted->subscribe == 0) || (characteristic == 0))
+    {
+      continue;
+    }
+    pending_subscription = next_subscription - 1;
+    if (gattQueueSetNotification(getBleDataPtr()->connection_handle, characteristic,
+                                 wanted->subscribe, discovery_on_completed))
+    {
+      return true;
+    }
+  }
+  return false;
+}
 
-    // // - 2: The length of the UUID (in this case, 2 bytes for the service UUID)
-    status = sl_bt_gatt_discover_primary_services_by_uuid(getBleDataPtr()->connection_handle,
-                                                          sizeof(flexSensorService_UUID),
-                                                          flexSensorService_UUID);
+/**
+ * @brief Publishes the handles and starts the subscriptions.
+ */
+static void discovery_subscribe(void)
+{
+  getBleDataPtr()->flex_service_handle = service_handles[SERVICE_FLEX];
+  getBleDataPtr()->accel_service_handle = service_handles[SERVICE_ACCEL];
+  getBleDataPtr()->flex_characteristic_handle = characteristic_handles[CHARACTERISTIC_FLEX];
+  getBleDataPtr()->accel_characteristic_handle = characteristic_handles[CHARACTERISTIC_ACCEL];
+
+  displayPrintf(DISPLAY_ROW_CONNECTION, BLE_HANDLING_INDICATIONS);
+  next_subscription = 0;
+  current_state = SUBSCRIBING;
+  if (!discovery_next_subscription())
+  {
+    current_state = WAIT_FOR_DATA;
+  }
+}
+
+/**
+ * @brief Starts the full discovery, all primary services in one pass.
+ */
+static void discovery_start(void)
+{
+  memset(service_handles, 0, sizeof(service_handles));
+  memset(characteristic_handles, 0, sizeof(characteristic_handles));
+  next_service = 0;
+
+  current_state = DISCOVERING_SERVICES;
+  if (!gattQueueDiscoverServices(getBleDataPtr()->connection_handle, discovery_on_completed))
+  {
+    current_state = WAIT_FOR_DATA;
+  }
+}
+
+/**
+ * @brief Advances the discovery when one of its GATT commands completes.
+ *
+ * @param result Procedure result, SL_STATUS_TIMEOUT if the GATT queue gave up on it.
+ */
+static void discovery_on_completed(uint16_t result)
+{
+  switch (current_state)
+  {
+  case VALIDATING_CACHE:
+  {
+    const gatt_cache_entry_t *cached = gattCacheLookup(discovered.address, discovered.addressType);
 
-    if (status != SL_STATUS_OK)
+    if ((result == SL_STATUS_OK) && (cached != NULL) && database_hash_read &&
+        (memcmp(database_hash, cached->hash, GATT_CACHE_HASH_SIZE) == 0))
     {
-      LOG_ERROR("Error starting primary service discovery");
+      // Same database as last time, skip straight to enabling the indications
+      service_handles[SERVICE_FLEX] = cached->flexServiceHandle;
+      service_handles[SERVICE_ACCEL] = cached->accelServiceHandle;
+      characteristic_handles[CHARACTERISTIC_FLEX] = cached->flexCharacteristicHandle;
+      characteristic_handles[CHARACTERISTIC_ACCEL] = cached->accelCharacteristicHandle;
+      cache_hit = true;
+      discovery_subscribe();
+      break;
     }
-    current_state = DISCOVERING_HTM_SERVICE;
-    // current_state = DISCOVERING_BUTTON_CHARACTERISTICS;
+
+    // The server's database changed, forget the handles and discover again
+    gattCacheRemove(discovered.address, discovered.addressType);
+    database_hash_read = false;
+    discovery_start();
     break;
+  }
 
-  case sl_bt_evt_connection_closed_id:
-    current_state = DISCOVERING_HTM_SERVICE; //
-    // current_state = DISCOVERING_BUTTON_CHARACTERISTICS;
+  case DISCOVERING_SERVICES:
+  case DISCOVERING_CHARACTERISTICS:
+
+    // The flex and accel characteristics are subscribed to as soon as they are
+    // known, the GATT service is searched afterwards for the cache
+    current_state = DISCOVERING_CHARACTERISTICS;
+    if (!discovery_next_service(SERVICE_GATT))
+    {
+      discovery_subscribe();
+    }
     break;
 
-  case sl_bt_evt_gatt_procedure_completed_id:
-    switch (current_state)
+  case SUBSCRIBING:
+
+    // The CCCDs need a bonded link, ble.c raises the security on this error and
+    // the write is repeated once the link is encrypted
+    if ((result == SL_STATUS_BT_ATT_INSUFFICIENT_ENCRYPTION) ||
+        (result == SL_STATUS_BT_ATT_INSUFFICIENT_AUTHENTICATION))
     {
-    case DISCOVERING_HTM_SERVICE:
+      next_subscription = pending_subscription;
+      current_state = WAITING_FOR_SECURITY;
+      break;
+    }
 
-      status = sl_bt_gatt_discover_characteristics_by_uuid(
-          getBleDataPtr()->connection_handle,  // Connection handle
-          getBleDataPtr()->flex_service_handle, // GATT service handle
-          sizeof(flexSensorChar_UUID),     // UUID length (2 bytes)
-          flexSensorChar_UUID              // Pointer to UUID
-      );
+    if (discovery_next_subscription())
+    {
+      break;
+    }
 
-      if (status != SL_STATUS_OK)
+    // Indications are running, find the database hash for the cache entry of a fresh discovery
+    current_state = WAIT_FOR_DATA;
+    if (!cache_hit)
+    {
+      next_service = SERVICE_GATT;
+      current_state = DISCOVERING_HASH_CHARACTERISTIC;
+      if (!discovery_next_service(SERVICE_COUNT))
       {
-        LOG_ERROR("Error discovering charc by UUID");
+        current_state = WAIT_FOR_DATA;
       }
-      current_state = DISCOVERING_HTM_CHARACTERISTICS;
-      break;
+    }
+    break;
 
-    case DISCOVERING_HTM_CHARACTERISTICS:
+  case DISCOVERING_HASH_CHARACTERISTIC:
 
-      status = sl_bt_gatt_set_characteristic_notification(evt->data.evt_gatt_characteristic.connection,
-                                                          getBleDataPtr()->flex_characteristic_handle,
-                                                          sl_bt_gatt_indication);
-      if (status != SL_STATUS_OK)
+    // Servers without GATT caching have no hash, their handles are not cached
+    current_state = WAIT_FOR_DATA;
+    if (characteristic_handles[CHARACTERISTIC_DATABASE_HASH] != 0)
+    {
+      current_state = READING_DATABASE_HASH;
+      if (!gattQueueRead(getBleDataPtr()->connection_handle,
+                         characteristic_handles[CHARACTERISTIC_DATABASE_HASH], discovery_on_completed))
       {
-        LOG_ERROR("Error starting notifications");
+        current_state = WAIT_FOR_DATA;
       }
+    }
+    break;
 
-      current_state = DISCOVERING_BUTTON_SERVICE;
-      break;
+  case READING_DATABASE_HASH:
 
-    case DISCOVERING_BUTTON_SERVICE:
+    if ((result == SL_STATUS_OK) && database_hash_read)
+    {
+      memcpy(discovered.hash, database_hash, GATT_CACHE_HASH_SIZE);
+      discovered.hashHandle = characteristic_handles[CHARACTERISTIC_DATABASE_HASH];
+      discovered.flexServiceHandle = service_handles[SERVICE_FLEX];
+      discovered.flexCharacteristicHandle = characteristic_handles[CHARACTERISTIC_FLEX];
+      discovered.accelServiceHandle = service_handles[SERVICE_ACCEL];
+      discovered.accelCharacteristicHandle = characteristic_handles[CHARACTERISTIC_ACCEL];
+      gattCacheStore(&discovered);
+    }
+    current_state = WAIT_FOR_DATA;
+    break;
 
-      status = sl_bt_gatt_discover_primary_services_by_uuid(getBleDataPtr()->connection_handle,
-                                                            sizeof(accelService_UUID),
-                                                            accelService_UUID);
-      if (status != SL_STATUS_OK)
-      {
-        LOG_ERROR("Error starting primary service discovery");
-      }
-      current_state = DISCOVERING_BUTTON_CHARACTERISTICS;
-      break;
+  default:
+    // A late completion after the connection was reset, nothing left to discover
+    break;
+  }
+}
 
-    case DISCOVERING_BUTTON_CHARACTERISTICS:
+/**
+ * @brief Handles Bluetooth Low Energy (BLE) discovery events.
+ *
+ * This function processes various Bluetooth events related to device discovery and GATT procedures.
+ * A known server with an unchanged database hash is subscribed to from the handle cache. Otherwise
+ * all primary services are discovered in one pass, then the characteristics of each wanted service,
+ * both matched against the wanted tables, and the CCCD writes follow back to back. The database
+ * hash is read last and the handles are cached for the next connection. Every procedure goes
+ * through the GATT queue and its completion arrives in discovery_on_completed().
+ *
+ * @param evt The Bluetooth event message that contains event data and details.
+ * @return None
+ */
+void discovery_state_machine(sl_bt_msg_t *evt)
+{
+  int index;
 
-      status = sl_bt_gatt_discover_characteristics_by_uuid(
-          getBleDataPtr()->connection_handle,     // Connection handle
-          getBleDataPtr()->accel_service_handle, // GATT service handle
-          sizeof(accelChar_UUID),     // UUID length (2 bytes)
-          accelChar_UUID              // Pointer to UUID
-      );
-      if (status != SL_STATUS_OK)
+  switch (SL_BT_MSG_ID(evt->header))
+  {
+
+  case sl_bt_evt_connection_opened_id:
+  {
+    const gatt_cache_entry_t *cached = gattCacheLookup(evt->data.evt_connection_opened.address,
+                                                       evt->data.evt_connection_opened.address_type);
+
+    memset(&discovered, 0, sizeof(discovered));
+    memset(service_handles, 0, sizeof(service_handles));
+    memset(characteristic_handles, 0, sizeof(characteristic_handles));
+    discovered.address = evt->data.evt_connection_opened.address;
+    discovered.addressType = evt->data.evt_connection_opened.address_type;
+    database_hash_read = false;
+    cache_hit = false;
+
+    // Known server, one read of the database hash tells whether the cached handles are still valid
+    if (cached != NULL)
+    {
+      characteristic_handles[CHARACTERISTIC_DATABASE_HASH] = cached->hashHandle;
+      current_state = VALIDATING_CACHE;
+      if (gattQueueRead(getBleDataPtr()->connection_handle, cached->hashHandle, discovery_on_completed))
       {
-        LOG_ERROR("Error discovering charc by UUID");
+        break;
       }
+    }
 
-      current_state = DISCOVERING_BUTTON_NOTIFICATION;
-      break;
+    discovery_start();
+    break;
+  }
 
-    case DISCOVERING_BUTTON_NOTIFICATION:
-      if (initial_stage)
+  case sl_bt_evt_connection_closed_id:
+    current_state = WAIT_FOR_DATA;
+    break;
+
+  case sl_bt_evt_connection_parameters_id:
+    if ((current_state == WAITING_FOR_SECURITY) &&
+        (evt->data.evt_connection_parameters.security_mode != sl_bt_connection_mode1_level1))
+    {
+      current_state = SUBSCRIBING;
+      if (!discovery_next_subscription())
       {
-        displayPrintf(DISPLAY_ROW_CONNECTION, BLE_HANDLING_INDICATIONS);
-        status = sl_bt_gatt_set_characteristic_notification(evt->data.evt_gatt_characteristic.connection,
-                                                            getBleDataPtr()->accel_characteristic_handle,
-                                                            sl_bt_gatt_indication);
-        if (status != SL_STATUS_OK)
-        {
-          LOG_ERROR("Error starting notifications");
-        }
-
-        initial_stage = false;
+        current_state = WAIT_FOR_DATA;
       }
-      current_state = WAIT_FOR_DATA;
-      break;
+    }
+    break;
 
-    case WAIT_FOR_DATA:
-      current_state = DISCOVERING_HTM_CHARACTERISTICS;
+  case sl_bt_evt_gatt_service_id:
+    if (current_state != DISCOVERING_SERVICES)
+    {
       break;
+    }
+    index = discovery_match(evt->data.evt_gatt_service.uuid.data,
+                            evt->data.evt_gatt_service.uuid.len, true);
+    if (index >= 0)
+    {
+      service_handles[index] = evt->data.evt_gatt_service.service;
+    }
+    break;
 
-    default:
-      // Handle unexpected state
-      LOG_ERROR("Unexpected state");
+  case sl_bt_evt_gatt_characteristic_id:
+    if ((current_state != DISCOVERING_CHARACTERISTICS) && (current_state != DISCOVERING_HASH_CHARACTERISTIC))
+    {
       break;
     }
+    index = discovery_match(evt->data.evt_gatt_characteristic.uuid.data,
+                            evt->data.evt_gatt_characteristic.uuid.len, false);
+    if (index >= 0)
+    {
+      characteristic_handles[index] = evt->data.evt_gatt_characteristic.characteristic;
+    }
+    break;
+
+  case sl_bt_evt_gatt_characteristic_value_id:
+    if (((current_state == VALIDATING_CACHE) || (current_state == READING_DATABASE_HASH)) &&
+        (evt->data.evt_gatt_characteristic_value.characteristic == characteristic_handles[CHARACTERISTIC_DATABASE_HASH]) &&
+        (evt->data.evt_gatt_characteristic_value.value.len == GATT_CACHE_HASH_SIZE))
+    {
+      memcpy(database_hash, evt->data.evt_gatt_characteristic_value.value.data, GATT_CACHE_HASH_SIZE);
+      database_hash_read = true;
+    }
+    break;
+
   } // end switch
 }
 /**
@@ -64,6 +64,9 @@
 #include "src/lcd.h"
 #include "src/i2c.h"
 #include "src/adc.h"
+#include "src/accel_fifo.h"
+#include "src/conn_policy.h"
+#include "src/lcd_dma.h"
 #include "src/scheduler.h"
 #include <stdint.h>
 
@@ -145,7 +148,8 @@
 
 bool app_is_ok_to_sleep(void)
 {
-  return APP_IS_OK_TO_SLEEP;
+  // Stay awake until logDrain() has sent the deferred log entries
+  return APP_IS_OK_TO_SLEEP && !logPending();
 } // app_is_ok_to_sleep()
 
 sl_power_manager_on_isr_exit_t app_sleep_on_isr_exit(void)
@@ -167,6 +171,23 @@ SL_WEAK void app_init(void)
   // This is called once during start-up.
   // Don't call any Bluetooth API functions until after the boot event.
 
+  schedulerInit(); // Clear events before any ISR can raise one
+  schedulerRegisterHandler(EVENT_PB0 | EVENT_0DEGREE | EVENT_45DEGREE | EVENT_90DEGREE | EVENT_FLEXANGLE |
+                           EVENT_TILT,
+                           handle_ble_scheduler_event);
+  schedulerRegisterHandler(EVENT_ACCELINT | EVENT_BLEDONE | EVENT_LETIMER_UF, stateMachinePostureDetection);
+  schedulerRegisterHandler(EVENT_I2CTransfer_Done, i2cAsyncHandler);
+#if ACCEL_FIFO_ENABLE
+  schedulerRegisterHandler(EVENT_ACCELDATA, tiltHandler);
+#endif
+#if ADC_USE_LDMA
+  schedulerRegisterHandler(EVENT_ADCBLOCK, adcBlockHandler);
+#endif
+  schedulerRegisterHandler(CONN_POLICY_ACTIVITY_EVENTS, connPolicyActivityHandler);
+#if LCD_DMA_ENABLE
+  schedulerRegisterHandler(EVENT_LCD_DONE, lcdDmaHandler);
+#endif
+
   CMU_init(); // Initialize Oscillator and Clock
   gpioInit(); // Initialize LED0 and LED1
   LETIMER0Init(); // Configure LETIMER
@@ -177,6 +198,9 @@ SL_WEAK void app_init(void)
   NVIC_EnableIRQ(GPIO_EVEN_IRQn);
  // NVIC_EnableIRQ(GPIO_ODD_IRQn);
   set_acc_sensor();
+#if ACCEL_FIFO_ENABLE
+  accelFifoStart();
+#endif
 //  clear_interrupt_flag();
 
 #if   LOWEST_ENERGY_MODE == EM1
@@ -231,6 +255,9 @@ SL_WEAK void app_process_action(void)
   //timerWaitUs_irq_UnitTest(evt);
   //timerWaitUs_poll_UnitTest();
 
+  // Idle time, send the log entries recorded since the last wakeup
+  logDrain();
+
 } // app_process_action()
 
 
@@ -261,10 +288,10 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
   // sequence through states driven by events
   // state_machine(evt);    // put this code in scheduler.c/.h
 
+  // Scheduler events are dispatched from handle_ble_event() on the
+  // external signal event.
 #if (DEVICE_IS_BLE_SERVER == 0)
    discovery_state_machine(evt);
-#else
-   stateMachinePostureDetection(evt);
 #endif
 
 } // sl_bt_on_event()
@@ -75,7 +75,11 @@
 #endif
 
 #define LETIMER_ON_TIME_MS  175
-#define LETIMER_PERIOD_MS   3000
+#define LETIMER_PERIOD_MS   1000  // also the LCD EXTCOMIN inversion period
+// EVENT_LETIMER_UF on every 3rd underflow. Its only handler checks the end of
+// the broadcast sample window (the Si7021 read is compiled out), which needs
+// seconds, not a stack wake up and dispatch every period.
+#define LETIMER_UF_EVENT_DIV 3
 
 /**************************************************************************//**
  * Application Init.
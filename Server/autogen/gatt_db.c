@@ -31,24 +31,44 @@ GATT_DATA(const uint8_t gattdb_uuidtable_128_map[]) =
 {
   0xbe, 0xf6, 0x79, 0x49, 0x09, 0x12, 0x8c, 0x9d, 0x30, 0x4d, 0xb6, 0x5c, 0x42, 0x24, 0x08, 0xb1, 
   0x02, 0x40, 0xa2, 0x6b, 0xc2, 0x33, 0x9f, 0x88, 0x69, 0x41, 0x8a, 0x5b, 0x37, 0xe4, 0x3b, 0x74, 
+  0xa5, 0x32, 0xa3, 0x5c, 0x00, 0xf8, 0x0a, 0xb3, 0x74, 0x43, 0xe9, 0x44, 0x79, 0xf2, 0x9c, 0xd5, 
+  0xe0, 0x43, 0xe9, 0x52, 0xbe, 0x50, 0x35, 0xb0, 0x86, 0x41, 0x94, 0x7b, 0xcd, 0x90, 0xcb, 0x70, 
+  0xe5, 0x07, 0x61, 0xb2, 0x3c, 0x0a, 0xb9, 0x80, 0x62, 0x4d, 0x41, 0x25, 0x0c, 0x35, 0x1b, 0x76, 
   0xa9, 0xac, 0x45, 0x4e, 0xae, 0xf7, 0xb6, 0xbf, 0x76, 0x45, 0x55, 0x34, 0x07, 0x7a, 0xb2, 0x5b, 
   0xda, 0x84, 0x6c, 0xf4, 0x0d, 0xd7, 0x95, 0x84, 0xd1, 0x4b, 0xf4, 0x7b, 0xc3, 0xb3, 0x6b, 0xca, 
 };
-GATT_DATA(sli_bt_gattdb_attribute_chrvalue_t gattdb_attribute_field_39) = {
+GATT_DATA(sli_bt_gattdb_attribute_chrvalue_t gattdb_attribute_field_47) = {
   .properties = 0x0a,
   .max_len = 2,
   .data = { 0x00, 0x00, },
 };
-GATT_DATA(sli_bt_gattdb_attribute_chrvalue_t gattdb_attribute_field_37) = {
+GATT_DATA(sli_bt_gattdb_attribute_chrvalue_t gattdb_attribute_field_45) = {
   .properties = 0x22,
-  .max_len = 1,
-  .len = 1,
-  .data = { 0x00, }
+  .max_len = 4,
+  .len = 4,
+  .data = { 0x00, 0x00, 0x00, 0x00, }
 };
-GATT_DATA(const sli_bt_gattdb_value_t gattdb_attribute_field_35) = {
+GATT_DATA(const sli_bt_gattdb_value_t gattdb_attribute_field_43) = {
   .len = 16,
   .data = { 0x32, 0x0d, 0xdc, 0xfc, 0x6b, 0x0f, 0x3f, 0x83, 0x7c, 0x4f, 0x79, 0xee, 0xf1, 0x21, 0x63, 0xaa, }
 };
+GATT_DATA(sli_bt_gattdb_attribute_chrvalue_t gattdb_attribute_field_41) = {
+  .properties = 0x10,
+  .max_len = 244,
+  .len = 0,
+  .data = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, }
+};
+GATT_DATA(sli_bt_gattdb_attribute_chrvalue_t gattdb_attribute_field_39) = {
+  .properties = 0x08,
+  .max_len = 3,
+  .len = 3,
+  .data = { 0x00, 0x00, 0x00, }
+};
+GATT_DATA(sli_bt_gattdb_attribute_chrvalue_t gattdb_attribute_field_36) = {
+  .properties = 0x12,
+  .max_len = 2,
+  .data = { 0x00, 0x00, },
+};
 GATT_DATA(sli_bt_gattdb_attribute_chrvalue_t gattdb_attribute_field_34) = {
   .properties = 0x0a,
   .max_len = 2,
@@ -174,24 +194,32 @@ GATT_DATA(const sli_bt_gattdb_attribute_t gattdb_attributes_map[]) = {
   { .handle = 0x21, .uuid = 0x8000, .permissions = 0x4841, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_32 },
   { .handle = 0x22, .uuid = 0x000f, .permissions = 0xc03, .caps = 0xffff, .state = 0x00, .datatype = 0x03, .configdata = { .flags = 0x02, .clientconfig_index = 0x03 } },
   { .handle = 0x23, .uuid = 0x8001, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_34 },
-  { .handle = 0x24, .uuid = 0x0000, .permissions = 0x8801, .caps = 0xffff, .state = 0x00, .datatype = 0x00, .constdata = &gattdb_attribute_field_35 },
-  { .handle = 0x25, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x22, .char_uuid = 0x8002 } },
-  { .handle = 0x26, .uuid = 0x8002, .permissions = 0x4841, .caps = 0xffff, .state = 0x00, .datatype = 0x02, .dynamicdata = &gattdb_attribute_field_37 },
-  { .handle = 0x27, .uuid = 0x000f, .permissions = 0xc03, .caps = 0xffff, .state = 0x00, .datatype = 0x03, .configdata = { .flags = 0x02, .clientconfig_index = 0x04 } },
-  { .handle = 0x28, .uuid = 0x8003, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_39 },
+  { .handle = 0x24, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x12, .char_uuid = 0x8002 } },
+  { .handle = 0x25, .uuid = 0x8002, .permissions = 0x4841, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_36 },
+  { .handle = 0x26, .uuid = 0x000f, .permissions = 0xc03, .caps = 0xffff, .state = 0x00, .datatype = 0x03, .configdata = { .flags = 0x01, .clientconfig_index = 0x04 } },
+  { .handle = 0x27, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x08, .char_uuid = 0x8003 } },
+  { .handle = 0x28, .uuid = 0x8003, .permissions = 0xc02, .caps = 0xffff, .state = 0x00, .datatype = 0x02, .dynamicdata = &gattdb_attribute_field_39 },
+  { .handle = 0x29, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x10, .char_uuid = 0x8004 } },
+  { .handle = 0x2a, .uuid = 0x8004, .permissions = 0x4800, .caps = 0xffff, .state = 0x00, .datatype = 0x02, .dynamicdata = &gattdb_attribute_field_41 },
+  { .handle = 0x2b, .uuid = 0x000f, .permissions = 0xc03, .caps = 0xffff, .state = 0x00, .datatype = 0x03, .configdata = { .flags = 0x01, .clientconfig_index = 0x05 } },
+  { .handle = 0x2c, .uuid = 0x0000, .permissions = 0x8801, .caps = 0xffff, .state = 0x00, .datatype = 0x00, .constdata = &gattdb_attribute_field_43 },
+  { .handle = 0x2d, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x22, .char_uuid = 0x8005 } },
+  { .handle = 0x2e, .uuid = 0x8005, .permissions = 0x4841, .caps = 0xffff, .state = 0x00, .datatype = 0x02, .dynamicdata = &gattdb_attribute_field_45 },
+  { .handle = 0x2f, .uuid = 0x000f, .permissions = 0xc03, .caps = 0xffff, .state = 0x00, .datatype = 0x03, .configdata = { .flags = 0x02, .clientconfig_index = 0x06 } },
+  { .handle = 0x30, .uuid = 0x8006, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_47 },
 };
 
 GATT_HEADER(const sli_bt_gattdb_t gattdb) = {
   .attributes = gattdb_attributes_map,
-  .attribute_table_size = 40,
-  .attribute_num = 40,
+  .attribute_table_size = 48,
+  .attribute_num = 48,
   .uuid16 = gattdb_uuidtable_16_map,
   .uuid16_table_size = 16,
   .uuid16_num = 16,
   .uuid128 = gattdb_uuidtable_128_map,
-  .uuid128_table_size = 4,
-  .uuid128_num = 4,
-  .num_ccfg = 5,
+  .uuid128_table_size = 7,
+  .uuid128_num = 7,
+  .num_ccfg = 7,
   .caps_mask = 0xffff,
   .enabled_caps = 0xffff,
 };
@@ -25,8 +25,11 @@ extern const sli_bt_gattdb_t gattdb;
 #define gattdb_valid_range                    30
 #define gattdb_flex_data                      33
 #define gattdb_custom_descriptor              35
-#define gattdb_accelerometer_data             38
-#define gattdb_custom_descriptor1             40
+#define gattdb_flex_angle                     37
+#define gattdb_flex_calibration               40
+#define gattdb_sample_batch                   42
+#define gattdb_accelerometer_data             46
+#define gattdb_custom_descriptor1             48
 
 
 #endif // __GATT_DB_H
@@ -0,0 +1,327 @@
+/***********************************************************************
+ * @file      accel_fifo.c
+ * @version   0.1
+ * @brief     ICM-20948 FIFO streaming.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      April 28, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources ICM-20948 datasheet, FIFO and interrupt registers
+ *
+ * The device buffers samples in its FIFO and asserts INT1 on the FIFO
+ * watermark, on FIFO overflow and on wake-on-motion. The GPIO ISR only
+ * queues a read of the interrupt status and FIFO count, everything else is
+ * chained from the I2C completion callbacks in the main loop:
+ *
+ *   INT1 -> read INT_STATUS..INT_STATUS_3 and FIFO_COUNT
+ *        -> burst read FIFO_R_W -> parse frames into the sample ring
+ *        -> read FIFO_COUNT again, until less than a frame is left
+ *
+ * Only one drain is in flight at a time, a request arriving meanwhile is
+ * folded into the count re-read at its end. The watermark level is not
+ * programmable on the ICM-20948, so a soft timer also requests a drain every
+ * ACCEL_FIFO_DRAIN_MS, well before the FIFO fills up.
+ */
+
+#define INCLUDE_LOG_DEBUG     1
+#include "log.h"
+#include "src/accel_fifo.h"
+#include "src/i2c.h"
+#include "src/scheduler.h"
+#include "em_core.h"
+
+// Bank 0 registers
+#define REG_USER_CTRL       0x03
+#define REG_PWR_MGMT_2      0x07
+#define REG_INT_ENABLE_2    0x12
+#define REG_INT_ENABLE_3    0x13
+#define REG_INT_STATUS      0x19
+#define REG_FIFO_EN_2       0x67
+#define REG_FIFO_RST        0x68
+#define REG_FIFO_MODE       0x69
+#define REG_FIFO_COUNTH     0x70
+#define REG_FIFO_R_W        0x72
+#define REG_FIFO_CFG        0x76
+// Bank 2 registers
+#define REG_GYRO_SMPLRT_DIV   0x00
+#define REG_ACCEL_SMPLRT_DIV1 0x10
+
+#define INT_STATUS_WOM        0x08
+#define INT_STATUS_2_OVERFLOW 0x01
+
+// Largest multiple of the frame size that fits one I2C read
+#define FIFO_CHUNK  ((255 / ACCEL_FIFO_FRAME_SIZE) * ACCEL_FIFO_FRAME_SIZE)
+
+static const icm20948_reg_t fifoStartTable[] = {
+    {0, REG_USER_CTRL,    0x40, 0x40}, // FIFO_EN
+#if ACCEL_FIFO_GYRO
+    {0, REG_PWR_MGMT_2,   0x00, 0x00}, // accel and gyro on
+#endif
+    {0, REG_INT_ENABLE_2, 0x01, 0x00}, // FIFO_OVERFLOW_EN for FIFO 0
+    {0, REG_INT_ENABLE_3, 0x01, 0x00}, // FIFO_WM_EN for FIFO 0
+#if ACCEL_FIFO_GYRO
+    {0, REG_FIFO_EN_2,    0x1E, 0x1E}, // ACCEL_FIFO_EN, GYRO_{X,Y,Z}_FIFO_EN
+#else
+    {0, REG_FIFO_EN_2,    0x10, 0x1E}, // ACCEL_FIFO_EN
+#endif
+    {0, REG_FIFO_RST,     0x1F, 0x00}, // assert reset ...
+    {0, REG_FIFO_RST,     0x00, 0x00}, // ... and release
+    {0, REG_FIFO_MODE,    0x00, 0x00}, // stream, oldest data is overwritten
+    {0, REG_FIFO_CFG,     0x00, 0x00}, // single FIFO
+#if ACCEL_FIFO_GYRO
+    {2, REG_GYRO_SMPLRT_DIV,       ACCEL_FIFO_SMPLRT_DIV & 0xFF,        0x00},
+#endif
+    {2, REG_ACCEL_SMPLRT_DIV1,     (ACCEL_FIFO_SMPLRT_DIV >> 8) & 0x0F, 0x00},
+    {2, REG_ACCEL_SMPLRT_DIV1 + 1, ACCEL_FIFO_SMPLRT_DIV & 0xFF,        0xFF},
+};
+
+static const icm20948_reg_t fifoResetTable[] = {
+    {0, REG_FIFO_RST, 0x1F, 0x00},
+    {0, REG_FIFO_RST, 0x00, 0x00},
+};
+
+static uint8_t intStatus[4];             // INT_STATUS, INT_STATUS_1, _2, _3
+static uint8_t fifoCount[2];             // FIFO_COUNTH, FIFO_COUNTL
+static uint8_t fifoRaw[ACCEL_FIFO_SIZE]; // burst read destination
+
+static volatile bool countQueued = false; // FIFO_COUNT read on the bus, fifoCountDone() pending
+static volatile bool drainBusy = false;   // FIFO_R_W burst reads on the bus, fifoDataDone() pending
+static volatile bool overflowSeen = false;
+
+static accel_sample_t ring[ACCEL_RING_SIZE];
+static uint16_t ringHead = 0;
+static uint16_t ringTail = 0;
+static uint16_t ringCount = 0;
+
+static accel_fifo_stats_t stats;
+
+/**
+ * @brief Stores one sample, the oldest is overwritten when the ring is full.
+ */
+static void ringPush(const accel_sample_t *sample)
+{
+  ring[ringHead] = *sample;
+  ringHead = (ringHead + 1) % ACCEL_RING_SIZE;
+  if (ringCount == ACCEL_RING_SIZE) {
+      ringTail = (ringTail + 1) % ACCEL_RING_SIZE;
+      stats.ring_drops++;
+  } else {
+      ringCount++;
+  }
+  stats.samples++;
+}
+
+static void fifoCountDone(I2C_TransferReturn_TypeDef status, void *userParam);
+
+/**
+ * @brief Queues a FIFO_COUNT read unless a count read or a drain is already
+ *        in flight, which re-reads the count when it completes anyway.
+ *        Safe to call from an ISR.
+ */
+static void fifoRequestCount(void)
+{
+  uint8_t reg = REG_FIFO_COUNTH;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  if (!countQueued && !drainBusy) {
+      countQueued = icm20948QueueBanked(0, I2C_FLAG_WRITE_READ, &reg, 1, fifoCount, sizeof(fifoCount),
+                                        fifoCountDone, NULL);
+  }
+  CORE_EXIT_CRITICAL();
+}
+
+/**
+ * @brief Last chunk of a drain is in, parse the frames into the ring.
+ */
+static void fifoDataDone(I2C_TransferReturn_TypeDef status, void *userParam)
+{
+  uint32_t len = (uint32_t) userParam;
+  accel_sample_t sample;
+  const uint8_t *p;
+  uint32_t i;
+
+  drainBusy = false;
+
+  if (status != i2cTransferDone) {
+      return;
+  }
+
+  for (i = 0; i + ACCEL_FIFO_FRAME_SIZE <= len; i += ACCEL_FIFO_FRAME_SIZE) {
+      p = &fifoRaw[i];
+      sample.ax = (int16_t) ((p[0] << 8) | p[1]);
+      sample.ay = (int16_t) ((p[2] << 8) | p[3]);
+      sample.az = (int16_t) ((p[4] << 8) | p[5]);
+#if ACCEL_FIFO_GYRO
+      sample.gx = (int16_t) ((p[6] << 8) | p[7]);
+      sample.gy = (int16_t) ((p[8] << 8) | p[9]);
+      sample.gz = (int16_t) ((p[10] << 8) | p[11]);
+#endif
+      ringPush(&sample);
+  }
+
+  schedulerSetEvent(EVENT_ACCELDATA);
+
+  // Samples kept arriving during the burst read
+  fifoRequestCount();
+}
+
+/**
+ * @brief FIFO count is in, queue the burst read of whole frames.
+ */
+static void fifoCountDone(I2C_TransferReturn_TypeDef status, void *userParam)
+{
+  uint8_t reg = REG_FIFO_R_W;
+  uint32_t count;
+  uint32_t offset;
+  uint32_t chunk;
+
+  (void) userParam;
+
+  countQueued = false;
+
+  if (status != i2cTransferDone) {
+      return;
+  }
+
+  if (overflowSeen) {
+      // The FIFO wrapped in the middle of a frame, so none of the bytes it
+      // holds can be aligned any more. Resetting drops only those.
+      overflowSeen = false;
+      stats.overflows++;
+      icm20948ApplyTable(fifoResetTable, sizeof(fifoResetTable) / sizeof(fifoResetTable[0]));
+      return;
+  }
+
+  count = ((fifoCount[0] & 0x1F) << 8) | fifoCount[1];
+  if (count > ACCEL_FIFO_SIZE) {
+      count = ACCEL_FIFO_SIZE;
+  }
+  count -= count % ACCEL_FIFO_FRAME_SIZE;
+  if (count == 0) {
+      return;
+  }
+
+  stats.drains++;
+  drainBusy = true;
+
+  // FIFO_R_W does not auto-increment, each chunk reads the next bytes out
+  for (offset = 0; offset < count; offset += chunk) {
+      chunk = count - offset;
+      if (chunk > FIFO_CHUNK) {
+          chunk = FIFO_CHUNK;
+      }
+      if (!icm20948QueueBanked(0, I2C_FLAG_WRITE_READ, &reg, 1, &fifoRaw[offset], chunk,
+                               (offset + chunk == count) ? fifoDataDone : NULL,
+                               (void *) count)) {
+          // Queue full, fifoDataDone() will not run. The next timer or INT1 retries.
+          drainBusy = false;
+          break;
+      }
+  }
+}
+
+/**
+ * @brief Interrupt status is in, forward wake-on-motion to the posture state
+ *        machine. The FIFO count read queued with it drains the FIFO.
+ */
+static void intStatusDone(I2C_TransferReturn_TypeDef status, void *userParam)
+{
+  (void) userParam;
+
+  if (status != i2cTransferDone) {
+      return;
+  }
+
+  if (intStatus[2] & INT_STATUS_2_OVERFLOW) {
+      // Handled by the FIFO count read queued right behind this one
+      overflowSeen = true;
+  }
+  if (intStatus[0] & INT_STATUS_WOM) {
+      schedulerSetEventAccelINT();
+  }
+}
+
+/**
+ * @brief Enables FIFO streaming, call after set_acc_sensor().
+ */
+void accelFifoStart(void)
+{
+  icm20948ApplyTable(fifoStartTable, sizeof(fifoStartTable) / sizeof(fifoStartTable[0]));
+}
+
+/**
+ * @brief Starts the periodic drain, call once the Bluetooth stack booted.
+ */
+void accelFifoStartTimer(void)
+{
+  sl_bt_system_set_lazy_soft_timer((ACCEL_FIFO_DRAIN_MS * 32768) / 1000, 0, TIMER_HANDLE_ACCEL_FIFO, 0);
+}
+
+/**
+ * @brief TIMER_HANDLE_ACCEL_FIFO lapsed, drain whatever the FIFO holds.
+ */
+void accelFifoOnTimer(void)
+{
+  fifoRequestCount();
+}
+
+/**
+ * @brief Called from the GPIO ISR when INT1 asserts. Only queues I2C reads,
+ *        reading the status registers also clears the interrupt.
+ */
+void accelFifoOnInterrupt(void)
+{
+  uint8_t reg;
+
+  stats.interrupts++;
+
+  reg = REG_INT_STATUS;
+  icm20948QueueBanked(0, I2C_FLAG_WRITE_READ, &reg, 1, intStatus, sizeof(intStatus), intStatusDone, NULL);
+  fifoRequestCount();
+}
+
+/**
+ * @brief Copies the oldest samples out of the ring.
+ *
+ * @param samples    Destination.
+ * @param maxSamples Capacity of the destination.
+ * @return Number of samples copied.
+ */
+uint16_t accelFifoRead(accel_sample_t *samples, uint16_t maxSamples)
+{
+  uint16_t n = 0;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  while ((n < maxSamples) && (ringCount > 0)) {
+      samples[n++] = ring[ringTail];
+      ringTail = (ringTail + 1) % ACCEL_RING_SIZE;
+      ringCount--;
+  }
+  CORE_EXIT_CRITICAL();
+
+  return n;
+}
+
+uint16_t accelFifoAvailable(void)
+{
+  uint16_t n;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  n = ringCount;
+  CORE_EXIT_CRITICAL();
+
+  return n;
+}
+
+const accel_fifo_stats_t* accelFifoGetStats(void)
+{
+  return &stats;
+}
@@ -0,0 +1,66 @@
+/***********************************************************************
+ * @file      accel_fifo.h
+ * @version   0.1
+ * @brief     Function header/interface file.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      April 28, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources ICM-20948 datasheet, FIFO and interrupt registers
+ *
+ */
+
+#ifndef SRC_ACCEL_FIFO_H_
+#define SRC_ACCEL_FIFO_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 1 = stream accelerometer samples through the ICM-20948 FIFO, 0 = wake-on-motion only
+#define ACCEL_FIFO_ENABLE       1
+// Output data rate = 1125 Hz / (1 + ACCEL_FIFO_SMPLRT_DIV), 9 -> 112.5 Hz
+#define ACCEL_FIFO_SMPLRT_DIV   9
+#define ACCEL_FIFO_PERIOD_US    ((1000000 * (1 + ACCEL_FIFO_SMPLRT_DIV)) / 1125)
+// 1 = also queue gyro samples, doubles the FIFO frame size
+#define ACCEL_FIFO_GYRO         0
+#define ACCEL_RING_SIZE         128 // samples kept for the application
+// Periodic drain, the 512 byte FIFO fills in ~760ms at 112.5 Hz
+#define ACCEL_FIFO_DRAIN_MS     250
+#define TIMER_HANDLE_ACCEL_FIFO 0x05
+
+#if ACCEL_FIFO_GYRO
+#define ACCEL_FIFO_FRAME_SIZE   12  // accel XYZ then gyro XYZ, big endian
+#else
+#define ACCEL_FIFO_FRAME_SIZE   6   // accel XYZ, big endian
+#endif
+#define ACCEL_FIFO_SIZE         512 // bytes of FIFO on the device
+
+typedef struct {
+  int16_t ax, ay, az;
+#if ACCEL_FIFO_GYRO
+  int16_t gx, gy, gz;
+#endif
+} accel_sample_t;
+
+typedef struct {
+  uint32_t interrupts;   // INT1 assertions handled
+  uint32_t drains;       // burst reads of the FIFO
+  uint32_t samples;      // samples pushed to the ring
+  uint32_t ring_drops;   // samples overwritten before they were read
+  uint32_t overflows;    // device FIFO overflowed and was reset
+} accel_fifo_stats_t;
+
+void accelFifoStart(void);
+void accelFifoStartTimer(void);
+void accelFifoOnTimer(void);
+void accelFifoOnInterrupt(void);
+uint16_t accelFifoRead(accel_sample_t *samples, uint16_t maxSamples);
+uint16_t accelFifoAvailable(void);
+const accel_fifo_stats_t* accelFifoGetStats(void);
+
+#endif /* SRC_ACCEL_FIFO_H_ */
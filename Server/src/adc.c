@@ -15,18 +15,70 @@
 #define INCLUDE_LOG_DEBUG     1
 #include "log.h"
 #include "src/adc.h"
+#include "src/batch.h"
+#include "src/irq.h"
 
 // Init to max ADC clock for Series 1
 #define adcFreq   32768
 
 #define NUM_INPUTS  1
-#define CHANGE_THRESHOLD_MV 150  // Minimum difference to trigger new event
 
 uint32_t input;
 uint32_t input;             // Current voltage in mV
 //static uint32_t lastInput = 0;  // Previous voltage in mV
 //static uint8_t lastEvent = 0xFF;  // 0 for 0°, 1 for 45°, 2 for 90°, 0xFF for none
 
+#if ADC_USE_LDMA
+static uint16_t adcBuffer[2][ADC_BLOCK_SIZE];      // LDMA ping-pong destination
+static volatile const uint16_t *readyBlock = NULL; // last completed half, NULL once consumed
+static unsigned int adcDmaChannel;
+static bool streaming = false;
+static adc_stream_stats_t streamStats;
+#endif
+
+#if !ADC_USE_LDMA
+// Conversions still to run after an ACCELINT, enough to replace the median
+// window, let the IIR follow a full step and confirm the debounced angle
+#define ADC_SETTLE_SAMPLES  (FLEX_MEDIAN_LEN + FLEX_IIR_SETTLE_SAMPLES + FLEX_DEBOUNCE_SAMPLES)
+static volatile uint8_t settleSamples = 0;
+#endif
+
+static volatile int16_t flexAngle = 0;          // calibrated angle, 0.1 degree
+static int16_t publishedFlexAngle = INT16_MIN;  // last angle handed to EVENT_FLEXANGLE
+
+/**
+ * @brief Runs a flex sensor voltage through the filter and raises the
+ *        scheduler event for the bend angle once a change is confirmed.
+ *        The calibrated angle is updated every sample and published through
+ *        EVENT_FLEXANGLE when it moves by FLEX_ANGLE_REPORT_DELTA.
+ *
+ * @param mv Flex sensor voltage in millivolts.
+ */
+static void adcFilterSample(uint32_t mv)
+{
+  flex_angle_t angle;
+  bool changed;
+
+  changed = flexFilterUpdate(mv, &angle);
+
+  flexAngle = flexAngleFromMv(flexFilterGetOutput());
+  if (abs(flexAngle - publishedFlexAngle) >= FLEX_ANGLE_REPORT_DELTA) {
+      publishedFlexAngle = flexAngle;
+      schedulerSetEvent(EVENT_FLEXANGLE);
+  }
+
+  if (!changed) {
+      return;
+  }
+
+  switch (angle) {
+    case FLEX_ANGLE_0:  schedulerSetEvent0(); break;
+    case FLEX_ANGLE_45: schedulerSetEvent45(); break;
+    case FLEX_ANGLE_90: schedulerSetEvent90(); break;
+    default: break;
+  }
+}
+
 void initADC (void)
 {
 
@@ -34,8 +86,20 @@ void initADC (void)
   ADC_Init_TypeDef init = ADC_INIT_DEFAULT;
   ADC_InitScan_TypeDef initScan = ADC_INITSCAN_DEFAULT;
 
+  flexFilterInit();
+  flexAngleInit();
+
   // Modify init structs
+#if ADC_USE_LDMA
+  // Run the ADC from AUXHFRCO on demand so PRS triggered scans complete in EM2
+  CMU_AUXHFRCOBandSet(cmuAUXHFRCOFreq_4M0Hz);
+  CMU_OscillatorEnable(cmuOsc_AUXHFRCO, true, true);
+  CMU_ClockSelectSet(cmuClock_ADC0ASYNC, cmuSelect_AUXHFRCO);
+  init.em2ClockConfig = adcEm2ClockOnDemand;
+  init.prescale   = ADC_PrescaleCalc(adcFreq, cmuAUXHFRCOFreq_4M0Hz);
+#else
   init.prescale   = ADC_PrescaleCalc(adcFreq, 0);
+#endif
   init.timebase = ADC_TimebaseCalc(0);
 
   initScan.diff       = 0;            // single ended
@@ -43,6 +107,11 @@ void initADC (void)
   initScan.resolution = adcRes12Bit;  // 12-bit resolution
   initScan.acqTime    = adcAcqTime16;  // set acquisition time to meet minimum requirement
   initScan.fifoOverwrite = true;      // FIFO overflow overwrites old data
+#if ADC_USE_LDMA
+  initScan.prsEnable  = true;         // each CRYOTIMER period starts one scan
+  initScan.prsSel     = (ADC_PRSSEL_TypeDef) ADC_PRS_CHANNEL;
+  initScan.scanDmaEm2Wu = true;       // let the LDMA move SCANDATA in EM2
+#endif
 
   // Select ADC input. See README for corresponding EXP header pin.
   // *Note that internal channels are unavailable in ADC scan mode
@@ -59,18 +128,176 @@ void initADC (void)
   ADC_Init(ADC0, &init);
   ADC_InitScan(ADC0, &initScan);
 
+#if ADC_USE_LDMA
+  // CRYOTIMER period output drives the ADC scan trigger through PRS
+  CMU_ClockEnable(cmuClock_CRYOTIMER, true);
+  CMU_ClockEnable(cmuClock_PRS, true);
+  CRYOTIMER->CTRL = CRYOTIMER_CTRL_OSCSEL_ULFRCO | CRYOTIMER_CTRL_PRESC_DIV1;
+  CRYOTIMER->PERIODSEL = ADC_CRYOTIMER_PERIODSEL & _CRYOTIMER_PERIODSEL_PERIODSEL_MASK;
+  PRS_SourceAsyncSignalSet(ADC_PRS_CHANNEL, PRS_CH_CTRL_SOURCESEL_CRYOTIMER,
+                           PRS_CH_CTRL_SIGSEL_CRYOTIMERPERIOD);
+
+  // DMADRV may already be up for the VCOM driver
+  Ecode_t ecode = DMADRV_Init();
+  if (ecode != ECODE_EMDRV_DMADRV_OK && ecode != ECODE_EMDRV_DMADRV_ALREADY_INITIALIZED) {
+      LOG_ERROR("DMADRV_Init failed: 0x%04x\n\r", (unsigned int) ecode);
+  }
+  ecode = DMADRV_AllocateChannel(&adcDmaChannel, NULL);
+  if (ecode != ECODE_EMDRV_DMADRV_OK) {
+      LOG_ERROR("DMADRV_AllocateChannel failed: 0x%04x\n\r", (unsigned int) ecode);
+  }
+#else
   // Enable Scan interrupts
   ADC_IntEnable(ADC0, ADC_IEN_SCAN);
 
   // Enable ADC interrupts
   NVIC_ClearPendingIRQ(ADC0_IRQn);
   NVIC_EnableIRQ(ADC0_IRQn);
+#endif
+}
+
+#if ADC_USE_LDMA
+/**
+ * @brief LDMA callback, runs in interrupt context once per completed block.
+ *
+ * The ping-pong transfer alternates between the two halves of adcBuffer, odd
+ * sequence numbers complete adcBuffer[0]. The block is handed to the main loop
+ * through EVENT_ADCBLOCK, the LDMA is already filling the other half.
+ */
+static bool adcDmaCallback(unsigned int channel, unsigned int sequenceNo, void *userParam)
+{
+  (void) channel;
+  (void) userParam;
+
+  if (readyBlock != NULL) {
+      streamStats.blocks_missed++;
+  }
+  readyBlock = adcBuffer[(sequenceNo & 1) ? 0 : 1];
+  streamStats.blocks++;
+
+  schedulerSetEvent(EVENT_ADCBLOCK);
+
+  return true; // keep the ping-pong running
+}
+
+/**
+ * @brief Runs one block of raw samples through the flex filter.
+ *
+ * @param samples Raw 12-bit scan results.
+ * @param len     Number of samples in the block.
+ */
+void adcProcessBlock(const uint16_t *samples, uint32_t len)
+{
+  // The last sample of the block was converted just before the LDMA callback
+  uint32_t now = letimerMilliseconds();
+  uint32_t i;
+
+  // Convert to millivolts using 2.5V reference (12-bit ADC: 4096 steps)
+  for (i = 0; i < len; i++) {
+      adcFilterSample(((samples[i] & 0x0FFF) * 2500) / 4096);
+      batchRecordFlex(now - (len - 1 - i) * ADC_SAMPLE_PERIOD_MS, flexAngle);
+  }
+
+  input = flexFilterGetOutput();
+}
+
+/**
+ * @brief Scheduler handler for EVENT_ADCBLOCK.
+ */
+void adcBlockHandler(Events_t evt)
+{
+  const uint16_t *block;
+
+  CORE_DECLARE_IRQ_STATE;
+
+  if (evt != EVENT_ADCBLOCK) {
+      return;
+  }
+
+  CORE_ENTER_CRITICAL();
+  block = (const uint16_t *) readyBlock;
+  readyBlock = NULL;
+  CORE_EXIT_CRITICAL();
+
+  if (block != NULL) {
+      adcProcessBlock(block, ADC_BLOCK_SIZE);
+  }
 }
 
+const adc_stream_stats_t* adcGetStreamStats(void)
+{
+  return &streamStats;
+}
+#endif
+
+/**
+ * @brief Starts flex sensor sampling.
+ *
+ * With ADC_USE_LDMA the continuous stream is started if it is not running,
+ * otherwise a short burst of scan conversions is started, long enough for
+ * the flex filter to confirm the angle.
+ *
+ * The filter is only reset by initADC(). It keeps its state across stops
+ * and bursts, so a posture that did not change is not reported again.
+ */
+void adcStartSampling(void)
+{
+#if ADC_USE_LDMA
+  Ecode_t ecode;
+
+  if (streaming) {
+      return;
+  }
+
+  ADC0->SCANFIFOCLEAR = ADC_SCANFIFOCLEAR_SCANFIFOCLEAR;
+  readyBlock = NULL;
+
+  ecode = DMADRV_PeripheralMemoryPingPong(adcDmaChannel, dmadrvPeripheralSignal_ADC0_SCAN,
+                                          adcBuffer[0], adcBuffer[1], (void *) &ADC0->SCANDATA,
+                                          true, ADC_BLOCK_SIZE, dmadrvDataSize2,
+                                          adcDmaCallback, NULL);
+  if (ecode != ECODE_EMDRV_DMADRV_OK) {
+      LOG_ERROR("DMADRV_PeripheralMemoryPingPong failed: 0x%04x\n\r", (unsigned int) ecode);
+      return;
+  }
+
+  CRYOTIMER->CTRL |= CRYOTIMER_CTRL_EN;
+  streaming = true;
+#else
+  settleSamples = ADC_SETTLE_SAMPLES - 1;
+  ADC_Start(ADC0, adcStartScan);
+#endif
+}
+
+/**
+ * @brief Stops the continuous stream. No-op in per-sample interrupt mode.
+ */
+void adcStopSampling(void)
+{
+#if ADC_USE_LDMA
+  if (!streaming) {
+      return;
+  }
+
+  CRYOTIMER->CTRL &= ~CRYOTIMER_CTRL_EN;
+  DMADRV_StopTransfer(adcDmaChannel);
+  readyBlock = NULL;
+  streaming = false;
+#endif
+}
+
+/**
+ * @brief Latest calibrated flex angle in 0.1 degree steps.
+ */
+int16_t adcGetFlexAngle(void)
+{
+  return flexAngle;
+}
+
+#if !ADC_USE_LDMA
 void ADC0_IRQHandler(void)
 {
   uint32_t data,id;
-  uint8_t currentEvent;
 
   // Check if scan data is ready (optional safety check)
   if (ADC_IntGet(ADC0) & ADC_IEN_SCAN)
@@ -81,26 +308,17 @@ void ADC0_IRQHandler(void)
       // Convert to millivolts using 2.5V reference (12-bit ADC: 4096 steps)
       input = (data * 2500) / 4096;
 
-      // Classify voltage into bend ranges
-      if (input <= 1400) {
-          currentEvent = 0; // 0°
-      } else if (input <= 1550) {
-          currentEvent = 1; // 45°
-      } else if (input <= 1700) {
-          currentEvent = 2; // 90°
-      }
-      else{
-          currentEvent = 0;
-      }
-
-      switch (currentEvent) {
-        case 0: schedulerSetEvent0(); break;
-        case 1: schedulerSetEvent45(); break;
-        case 2: schedulerSetEvent90(); break;
-      }
+      adcFilterSample(input);
 
       // Clear the interrupt flag
       ADC_IntClear(ADC0, ADC_IF_SCAN);
 
+      // Keep converting until the filter has settled on an angle
+      if (settleSamples > 0) {
+          settleSamples--;
+          ADC_Start(ADC0, adcStartScan);
+      }
+
     }
 }
+#endif
@@ -22,7 +22,37 @@
 #include "em_cmu.h"
 #include "em_adc.h"
 #include "src/scheduler.h"
+#include "src/flex_filter.h"
+#include "src/flex_angle.h"
+
+// 1 = stream scan results through LDMA into a ping-pong buffer and wake the
+//     CPU once per block, 0 = one ADC0 interrupt per conversion.
+#define ADC_USE_LDMA              1
+
+#if ADC_USE_LDMA
+#include "em_prs.h"
+#include "dmadrv.h"
+
+// CRYOTIMER runs off the 1 kHz ULFRCO so it keeps triggering in EM2/EM3.
+// Sample rate = 1000 Hz / 2^ADC_CRYOTIMER_PERIODSEL, i.e. 3 -> ~125 Hz.
+#define ADC_CRYOTIMER_PERIODSEL   3
+#define ADC_PRS_CHANNEL           0
+#define ADC_SAMPLE_PERIOD_MS      (1 << ADC_CRYOTIMER_PERIODSEL)
+#define ADC_BLOCK_SIZE            32   // samples per ping-pong half, one wakeup each
+
+typedef struct {
+  uint32_t blocks;        // blocks completed by the LDMA
+  uint32_t blocks_missed; // blocks overwritten before the main loop processed them
+} adc_stream_stats_t;
+
+void adcProcessBlock(const uint16_t *samples, uint32_t len);
+void adcBlockHandler(Events_t evt);
+const adc_stream_stats_t* adcGetStreamStats(void);
+#endif
 
 void initADC (void);
+void adcStartSampling(void);
+void adcStopSampling(void);
+int16_t adcGetFlexAngle(void);
 
 #endif /* SRC_ADC_H_ */
@@ -0,0 +1,261 @@
+/***********************************************************************
+ * @file      batch.c
+ * @version   0.1
+ * @brief     Timestamped sample batches over one notification per PDU.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 4, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ * Every filtered flex sample and every accelerometer FIFO sample is packed,
+ * with the time it was taken, into the sample batch characteristic until
+ * the PDU for the negotiated ATT MTU is full or the oldest sample is
+ * BATCH_MAX_AGE_MS old, then sent as one notification to every subscribed
+ * central. Until every subscriber's MTU fits BATCH_MIN_RECORDS, which the
+ * default MTU of 23 does not, nothing is batched.
+ */
+
+#define INCLUDE_LOG_DEBUG     1
+#include "log.h"
+#include "src/batch.h"
+#include "gatt_db.h"
+#include "sl_bt_api.h"
+
+#define ATT_HEADER_SIZE   3    // opcode + handle of a notification
+
+// Centrals that may receive the batch
+typedef struct {
+  bool     used;
+  uint8_t  connection;
+  uint16_t mtu;
+  bool     enabled;     // notifications enabled on the sample batch
+} batch_peer_t;
+
+static uint8_t  pdu[BATCH_MAX_MTU - ATT_HEADER_SIZE];
+static uint8_t  count = 0;
+static uint8_t  capacity = 0;
+static uint32_t firstTimestamp;
+static batch_peer_t peers[LINK_MAX_CONNECTIONS];
+static batch_stats_t stats;
+
+static void putU16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t) v;
+  p[1] = (uint8_t) (v >> 8);
+}
+
+static batch_peer_t* batchFindPeer(uint8_t connection)
+{
+  uint8_t i;
+
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      if (peers[i].used && (peers[i].connection == connection)) {
+          return &peers[i];
+      }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Sends the pending samples to every subscribed central and starts
+ *        a new batch.
+ */
+static void batchFlush(void)
+{
+  sl_status_t rc;
+  uint8_t i;
+
+  if (count == 0) {
+      return;
+  }
+
+  pdu[0] = count;
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      if (!peers[i].used || !peers[i].enabled) {
+          continue;
+      }
+      rc = sl_bt_gatt_server_send_notification(peers[i].connection, gattdb_sample_batch,
+                                               BATCH_HEADER_SIZE + count * BATCH_RECORD_SIZE, pdu);
+      if (rc != SL_STATUS_OK) {
+          stats.send_errors++;
+          LOG_ERROR("sl_bt_gatt_server_send_notification() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+      }
+  }
+
+  count = 0;
+  sl_bt_system_set_lazy_soft_timer(0, 0, TIMER_HANDLE_BATCH, 1); // stop the age timer
+}
+
+/**
+ * @brief One PDU goes to every subscriber, so the batch is sized for the
+ *        smallest MTU among them. 0 when nobody is subscribed or the
+ *        smallest MTU holds fewer than BATCH_MIN_RECORDS.
+ */
+static void batchResize(void)
+{
+  uint16_t mtu = BATCH_MAX_MTU;
+  bool any = false;
+  uint8_t i;
+
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      if (peers[i].used && peers[i].enabled) {
+          any = true;
+          if (peers[i].mtu < mtu) {
+              mtu = peers[i].mtu;
+          }
+      }
+  }
+
+  if (!any) {
+      count = 0;
+      capacity = 0;
+      return;
+  }
+
+  capacity = (mtu - ATT_HEADER_SIZE - BATCH_HEADER_SIZE) / BATCH_RECORD_SIZE;
+
+  // At the default MTU a notification per sample would cost more than the
+  // batch saves, wait for the MTU exchange
+  if (capacity < BATCH_MIN_RECORDS) {
+      capacity = 0;
+  }
+}
+
+/**
+ * @brief Records the negotiated MTU of a connection, call on connection
+ *        open and on sl_bt_evt_gatt_mtu_exchanged_id.
+ */
+void batchConfigure(uint8_t connection, uint16_t mtu)
+{
+  batch_peer_t *peer = batchFindPeer(connection);
+  uint8_t i;
+
+  for (i = 0; (peer == NULL) && (i < LINK_MAX_CONNECTIONS); i++) {
+      if (!peers[i].used) {
+          peer = &peers[i];
+          peer->used = true;
+          peer->connection = connection;
+          peer->enabled = false;
+      }
+  }
+  if (peer == NULL) {
+      return;
+  }
+
+  // The pending samples were sized for the old MTU
+  batchFlush();
+  peer->mtu = (mtu > BATCH_MAX_MTU) ? BATCH_MAX_MTU : mtu;
+  batchResize();
+}
+
+/**
+ * @brief Adds or removes a subscriber, follows the client's notification
+ *        setting.
+ */
+void batchEnable(uint8_t connection, bool enable)
+{
+  batch_peer_t *peer = batchFindPeer(connection);
+
+  if (peer != NULL) {
+      // A new subscriber may have a smaller MTU than the pending batch
+      batchFlush();
+      peer->enabled = enable;
+      batchResize();
+  }
+}
+
+/**
+ * @brief Forgets a connection, call when it closes.
+ */
+void batchRemove(uint8_t connection)
+{
+  batch_peer_t *peer = batchFindPeer(connection);
+
+  if (peer != NULL) {
+      peer->used = false;
+      batchResize();
+  }
+}
+
+/**
+ * @brief Appends one record to the batch. Sends the batch when the PDU is
+ *        full.
+ */
+static void batchAppend(uint32_t timestamp, int16_t flex, int16_t pitch, int16_t roll)
+{
+  uint8_t *p;
+
+  if (capacity == 0) {
+      return;
+  }
+
+  if (count == 0) {
+      firstTimestamp = timestamp;
+      pdu[1] = (uint8_t) timestamp;
+      pdu[2] = (uint8_t) (timestamp >> 8);
+      pdu[3] = (uint8_t) (timestamp >> 16);
+      pdu[4] = (uint8_t) (timestamp >> 24);
+      // Single shot timer bounds the latency of a slowly filling batch
+      sl_bt_system_set_lazy_soft_timer((BATCH_MAX_AGE_MS * 32768) / 1000, 0, TIMER_HANDLE_BATCH, 1);
+  }
+
+  p = &pdu[BATCH_HEADER_SIZE + count * BATCH_RECORD_SIZE];
+  putU16(&p[0], (uint16_t) (int16_t) (timestamp - firstTimestamp));
+  putU16(&p[2], (uint16_t) flex);
+  putU16(&p[4], (uint16_t) pitch);
+  putU16(&p[6], (uint16_t) roll);
+  count++;
+  stats.records++;
+
+  if (count >= capacity) {
+      stats.flush_full++;
+      batchFlush();
+  }
+}
+
+/**
+ * @brief Records one filtered flex sample.
+ *
+ * @param timestamp When the sample was taken, letimerMilliseconds() time base.
+ * @param flex      Calibrated angle, 0.1 degree.
+ */
+void batchRecordFlex(uint32_t timestamp, int16_t flex)
+{
+  batchAppend(timestamp, flex, BATCH_NO_VALUE, BATCH_NO_VALUE);
+}
+
+/**
+ * @brief Records the pitch/roll of one accelerometer sample.
+ *
+ * @param timestamp When the sample was taken, letimerMilliseconds() time base.
+ * @param pitch     0.1 degree.
+ * @param roll      0.1 degree.
+ */
+void batchRecordTilt(uint32_t timestamp, int16_t pitch, int16_t roll)
+{
+  batchAppend(timestamp, BATCH_NO_VALUE, pitch, roll);
+}
+
+/**
+ * @brief Call on the TIMER_HANDLE_BATCH soft timer, sends a batch that has
+ *        reached BATCH_MAX_AGE_MS.
+ */
+void batchOnTimer(void)
+{
+  if (count > 0) {
+      stats.flush_age++;
+      batchFlush();
+  }
+}
+
+const batch_stats_t* batchGetStats(void)
+{
+  return &stats;
+}
@@ -0,0 +1,58 @@
+/***********************************************************************
+ * @file      batch.h
+ * @version   0.1
+ * @brief     Function header/interface file.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 4, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ */
+
+#ifndef SRC_BATCH_H_
+#define SRC_BATCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "src/link.h"
+
+#define BATCH_MAX_MTU          LINK_MAX_MTU
+#define BATCH_MAX_AGE_MS       500   // oldest sample is never held longer than this
+#define TIMER_HANDLE_BATCH     0x02  // soft timer for the age flush
+
+// Notification layout, all fields little endian:
+//   uint8  sample count
+//   uint32 timestamp of the first sample, ms
+//   count x { int16 ms relative to the first sample, int16 flex, int16 pitch, int16 roll }
+// Angles are in 0.1 degree. Each record is one flex sample or one
+// accelerometer sample, the fields it does not carry are BATCH_NO_VALUE.
+// Flex and accelerometer samples reach the batch in separate blocks, so a
+// record may be older than the first one.
+#define BATCH_HEADER_SIZE      5
+#define BATCH_RECORD_SIZE      8
+#define BATCH_MAX_RECORDS      ((BATCH_MAX_MTU - 3 - BATCH_HEADER_SIZE) / BATCH_RECORD_SIZE)
+#define BATCH_MIN_RECORDS      4     // smaller PDUs are not batched, needs an ATT MTU of 40
+#define BATCH_NO_VALUE         INT16_MIN
+
+typedef struct {
+  uint32_t records;       // samples recorded
+  uint32_t flush_full;    // notifications sent because the PDU was full
+  uint32_t flush_age;     // notifications sent because the oldest sample aged out
+  uint32_t send_errors;   // notifications the stack refused, batch is dropped
+} batch_stats_t;
+
+void batchConfigure(uint8_t connection, uint16_t mtu);
+void batchEnable(uint8_t connection, bool enable);
+void batchRemove(uint8_t connection);
+void batchRecordFlex(uint32_t timestamp, int16_t flex);
+void batchRecordTilt(uint32_t timestamp, int16_t pitch, int16_t roll);
+void batchOnTimer(void);
+const batch_stats_t* batchGetStats(void);
+
+#endif /* SRC_BATCH_H_ */
@@ -44,59 +44,88 @@
 #define BUTTON_PRESSED 0x01
 #define BUTTON_RELEASED 0x00
 
-#define MAX_QUEUE_SIZE 16
-
 uint8_t flexData=0;
-uint8_t accelData=0;
 uint8_t flag=0;
 
-typedef struct {
-  uint16_t charHandle;      // Characteristic handle from gatt_db.h
-  size_t bufferLength;      // Length of the buffer
-  uint8_t buffer[5];        // Data buffer (max size 5 bytes for HTM + button state)
-} indication_t;
-
-typedef struct {
-  indication_t queue[MAX_QUEUE_SIZE];  // Circular queue for storing indications
-  uint8_t readPointer;                 // Index to the oldest entry
-  uint8_t writePointer;                // Index to the newest entry
-  uint8_t size;                        // Number of indications in the queue
-} indication_queue_t;
-
-indication_queue_t indicationQueue;
-
-bool enqueue(indication_queue_t* q, indication_t indication) {
-  if (q->size < MAX_QUEUE_SIZE) {
-      q->queue[q->writePointer] = indication;
-      q->writePointer = (q->writePointer + 1) % MAX_QUEUE_SIZE;
-      q->size++;
-      return true;
-  } else {
-      // Queue is full, discard or overwrite the oldest indication
-      q->readPointer = (q->readPointer + 1) % MAX_QUEUE_SIZE;
-      q->queue[q->writePointer] = indication;
-      q->writePointer = (q->writePointer + 1) % MAX_QUEUE_SIZE;
-      return false;  // Indication discarded
-  }
+static ble_data_struct_t ble_data = {.advertisingSetHandle = 0xff};
+
+int32_t FLOAT_TO_INT32(const uint8_t *value_start_little_endian);
+
+ble_data_struct_t*  get_ble_data_struct(void){
+
+  return &ble_data;
 }
 
-bool dequeue(indication_queue_t* q, indication_t* indication) {
-  if (q->size == 0) {
-      return false;  // Queue is empty
+/**
+ * @brief Entry of an open connection, NULL if the handle is unknown.
+ */
+static ble_conn_t* ble_conn_find(uint8_t handle){
+
+  uint8_t i;
+
+  for(i = 0; i < LINK_MAX_CONNECTIONS; i++){
+      if(ble_data.conns[i].open && (ble_data.conns[i].handle == handle)){
+          return &ble_data.conns[i];
+      }
   }
-  *indication = q->queue[q->readPointer];
-  q->readPointer = (q->readPointer + 1) % MAX_QUEUE_SIZE;
-  q->size--;
-  return true;
+  return NULL;
 }
 
-static ble_data_struct_t ble_data = {.advertisingSetHandle = 0xff};
+/**
+ * @brief Subscriptions of a central as BOND_CCCD_* bits.
+ */
+static uint8_t ble_conn_cccd(const ble_conn_t *conn){
 
-int32_t FLOAT_TO_INT32(const uint8_t *value_start_little_endian);
+  return (conn->indicate_flex ? BOND_CCCD_FLEX_DATA : 0) |
+         (conn->indicate_accel ? BOND_CCCD_ACCEL_DATA : 0) |
+         (conn->notify_flex_angle ? BOND_CCCD_FLEX_ANGLE : 0) |
+         (conn->notify_batch ? BOND_CCCD_SAMPLE_BATCH : 0);
+}
 
-ble_data_struct_t*  get_ble_data_struct(void){
+/**
+ * @brief A bonded central encrypted the link, picks up the subscriptions it
+ *        had so the data flows without it writing the CCCDs again.
+ */
+static void ble_conn_secured(ble_conn_t *conn){
 
-  return &ble_data;
+  uint8_t cccd;
+
+  if(conn->bonded || (conn->bonding == SL_BT_INVALID_BONDING_HANDLE)){
+      return;
+  }
+  conn->bonded = true;
+
+  cccd = bondLoadCccd(conn->bonding);
+  conn->indicate_flex |= ((cccd & BOND_CCCD_FLEX_DATA) != 0);
+  conn->indicate_accel |= ((cccd & BOND_CCCD_ACCEL_DATA) != 0);
+  conn->notify_flex_angle |= ((cccd & BOND_CCCD_FLEX_ANGLE) != 0);
+  if(cccd & BOND_CCCD_SAMPLE_BATCH){
+      conn->notify_batch = true;
+      batchEnable(conn->handle, true);
+  }
+
+  bondSetLastPeer(conn->address, conn->addressType);
+  displayPrintf(DISPLAY_ROW_CONNECTION, "Bonded");
+}
+
+/**
+ * @brief Takes a free entry for a new connection, NULL if the table is full.
+ */
+static ble_conn_t* ble_conn_add(uint8_t handle){
+
+  uint8_t i;
+
+  for(i = 0; i < LINK_MAX_CONNECTIONS; i++){
+      if(!ble_data.conns[i].open){
+          memset(&ble_data.conns[i], 0, sizeof(ble_conn_t));
+          ble_data.conns[i].open = true;
+          ble_data.conns[i].handle = handle;
+          ble_data.conns[i].bonding = SL_BT_INVALID_BONDING_HANDLE;
+          ble_data.numConnections++;
+          return &ble_data.conns[i];
+      }
+  }
+  return NULL;
 }
 
 /**
@@ -135,10 +164,24 @@ void handle_ble_event(sl_bt_msg_t *evt){
       // Initialize connection state
       ble_data.connection_open = false;
       ble_data.ok_to_send_htm_connections = false;
-      ble_data.ok_to_send_bs_connections = false;
-      ble_data.indication_in_flight =false;
+      ble_data.numConnections = 0;
+      memset(ble_data.conns, 0, sizeof(ble_data.conns));
       ble_data.expecting_passkey_confirmation = false;
 
+      // One indication queue per characteristic, both carry state so only
+      // the latest pending value is kept
+      indicationReset();
+      indicationAddChannel(gattdb_flex_data, true);
+      indicationAddChannel(gattdb_accelerometer_data, true);
+
+      // Allow the client to negotiate an MTU large enough for a full sample batch
+      linkInit();
+
+#if ACCEL_FIFO_ENABLE
+      // Drain the accelerometer FIFO before it can overflow between watermarks
+      accelFifoStartTimer();
+#endif
+
       // 1. Read the Bluetooth identity address used by the device
       rc = sl_bt_system_get_identity_address(&ble_data.myAddress, NULL);
       if(rc != SL_STATUS_OK){
@@ -168,25 +211,8 @@ void handle_ble_event(sl_bt_msg_t *evt){
 #endif
       }
 
-      rc = sl_bt_legacy_advertiser_generate_data(
-          ble_data.advertisingSetHandle,
-          sl_bt_advertiser_general_discoverable);
-      if(rc != SL_STATUS_OK){
-#if ENABLE_ERROR_LOGS
-          LOG_ERROR("Bluetooth: advertiser generate data = %d\r\n", (unsigned int) rc);
-#endif
-      }
-
-      // 4. Start advertising on the advertising set with the specified discovery and connection modes.
-      rc = sl_bt_legacy_advertiser_start(
-          ble_data.advertisingSetHandle,
-          sl_bt_legacy_advertiser_connectable);
-
-      if(rc != SL_STATUS_OK){
-#if ENABLE_ERROR_LOGS
-          LOG_ERROR("Bluetooth: Advertiser start error = %d\r\n", (unsigned int) rc);
-#endif
-      }
+      // 4. Start advertising, the packet carries the posture broadcast
+      broadcastStart(ble_data.advertisingSetHandle);
 
       // Initialize the display
       displayInit();
@@ -198,28 +224,23 @@ void handle_ble_event(sl_bt_msg_t *evt){
       displayPrintf(DISPLAY_ROW_CONNECTION, ADVERTISING_STRING);
       displayPrintf(DISPLAY_ROW_ASSIGNMENT, ASSIGNMENT_NUMBER);
       displayPrintf(DISPLAY_ROW_9, "FlexAngle: 0 Deg");
-      displayPrintf(DISPLAY_ROW_10, "Tilt Count:%d",accelData);
+      displayPrintf(DISPLAY_ROW_10, "Pitch:0 Roll:0");
 
 #if ENABLE_BLE_LOGS
       LOG_INFO("Advertising started...\r\n");
 #endif
 
-      rc = sl_bt_sm_delete_bondings();
-
-      if(rc != SL_STATUS_OK){
-#if ENABLE_ERROR_LOGS
-          LOG_ERROR("Bluetooth: sl_bt_sm_delete_bondings error = %d\r\n", (unsigned int) rc);
-#endif
-      }
-
       rc = sl_bt_sm_configure(0x0F, sm_io_capability_displayyesno);
 
       if(rc != SL_STATUS_OK){
 #if ENABLE_ERROR_LOGS
-          LOG_ERROR("Bluetooth: sl_bt_sm_delete_bondings error = %d\r\n", (unsigned int) rc);
+          LOG_ERROR("Bluetooth: sl_bt_sm_configure error = %d\r\n", (unsigned int) rc);
 #endif
       }
 
+      // Bonds are kept, a returning central reconnects without the passkey
+      bondInit();
+
       break;
 
       /*Indication of a new connection opening.*/
@@ -231,39 +252,50 @@ void handle_ble_event(sl_bt_msg_t *evt){
 
       // Save connection Handle
       ble_data.connectionHandle = evt->data.evt_connection_opened.connection;
+      {
+        ble_conn_t *conn = ble_conn_add(ble_data.connectionHandle);
 
-      // 1. Stop the advertisement
-      rc = sl_bt_advertiser_stop(ble_data.advertisingSetHandle);
-      if(rc != SL_STATUS_OK){
+        if(conn == NULL){
 #if ENABLE_ERROR_LOGS
-          LOG_ERROR("Bluetooth: Advertiser stop error = %d\r\n", (unsigned int) rc);
+            LOG_ERROR("Bluetooth: No free entry for connection %d\r\n", ble_data.connectionHandle);
 #endif
+            sl_bt_connection_close(ble_data.connectionHandle);
+            break;
+        }
+
+        // A returning bond is recognized here, it is trusted once the link is encrypted
+        conn->address = evt->data.evt_connection_opened.address;
+        conn->addressType = evt->data.evt_connection_opened.address_type;
+        conn->bonding = evt->data.evt_connection_opened.bonding;
+      }
+
+      // 1. The stack stops a connectable advertiser once a central connects,
+      //    keep advertising for the next one until the limit is reached
+      if(ble_data.numConnections < LINK_MAX_CONNECTIONS){
+          broadcastStart(ble_data.advertisingSetHandle);
+      }
+      else{
+          broadcastStop();
       }
 
       // Update the connection state
       ble_data.connection_open = true;
       ble_data.ok_to_send_htm_connections = false;
-      ble_data.indication_in_flight =false;
+      indicationOpen(ble_data.connectionHandle);
+      batchConfigure(ble_data.connectionHandle, LINK_DEFAULT_MTU);
+
+      // Move the link to 2M PHY and long PDUs, the results arrive as events
+      linkOnOpened(ble_data.connectionHandle);
 
 #if ENABLE_BLE_LOGS
       LOG_INFO("connection_open is true...\r\n");
 #endif
-      // 2. Set connection parameters
-      rc = sl_bt_connection_set_parameters(ble_data.connectionHandle,
-                                           MIN_CONNECTION_INTERVAL_VAL,
-                                           MAX_CONNECTION_INTERVAL_VAL,
-                                           MAX_LATENCY_VAL,
-                                           80,
-                                           0,
-                                           0xffff);
-      if(rc != SL_STATUS_OK){
-#if ENABLE_ERROR_LOGS
-          LOG_ERROR("Bluetooth: Connection set parameter = 0x%X\r\n", (unsigned int) rc);
-#endif
-      }
+      // 2. Set connection parameters, starts in the fast profile and follows
+      //    the wearer's activity from here on
+      connPolicyOnOpened(ble_data.connectionHandle);
 
       // Add LCD prints
-      displayPrintf(DISPLAY_ROW_CONNECTION, CONNECTED_STRING);
+      displayPrintf(DISPLAY_ROW_CONNECTION, "%s %d", CONNECTED_STRING, ble_data.numConnections);
 
       break;
 
@@ -273,53 +305,65 @@ void handle_ble_event(sl_bt_msg_t *evt){
 #if ENABLE_BLE_LOGS
       LOG_INFO("Connection closed!\r\n");
 #endif
-      // 1. Set the connection lost event
-      schedulerSetEventBleConnectionClose();
-
-      // 2. Set current connection open status & ok_to_send_indication to false
-      ble_data.connection_open = false;
-      ble_data.ok_to_send_htm_connections = false;
-      ble_data.indication_in_flight = false;
-
+      {
+        uint8_t closed = evt->data.evt_connection_closed.connection;
+        ble_conn_t *conn = ble_conn_find(closed);
+        bool wasBonded;
+
+        if(conn == NULL){
+            break;
+        }
+        conn->open = false;
+        wasBonded = conn->bonded;
+        ble_data.numConnections--;
+
+        // 1. Drop everything held for this central
+        indicationClose(closed);
+        batchRemove(closed);
+        linkOnClosed(closed);
+        connPolicyOnClosed(closed);
+        if(ble_data.expecting_passkey_confirmation && (ble_data.passkeyConnection == closed)){
+            ble_data.expecting_passkey_confirmation = false;
+            displayPrintf(DISPLAY_ROW_PASSKEY, " ");
+            displayPrintf(DISPLAY_ROW_ACTION, " ");
+        }
+
+        // 2. Call a bonded central straight back with directed advertising,
+        //    otherwise advertise for the free slot again. The undirected
+        //    advertising resumes on sl_bt_evt_advertiser_timeout_id.
+        if(wasBonded){
+            if(broadcastIsActive()){
+                broadcastStop();
+            }
+            if(!bondReconnect(ble_data.advertisingSetHandle)){
+                broadcastStart(ble_data.advertisingSetHandle);
+            }
+        }
+        else if(!broadcastIsActive()){
+            broadcastStart(ble_data.advertisingSetHandle);
 #if ENABLE_BLE_LOGS
-      LOG_INFO("connection_open is false...\r\n");
-#endif
-
-      rc = sl_bt_legacy_advertiser_generate_data(
-          ble_data.advertisingSetHandle,
-          sl_bt_advertiser_general_discoverable);
-      if(rc != SL_STATUS_OK){
-#if ENABLE_ERROR_LOGS
-          LOG_ERROR("Bluetooth: advertiser generate data = %d\r\n", (unsigned int) rc);
-#endif
-      }
-
-      // 4. Start advertising on the advertising set with the specified discovery and connection modes.
-      rc = sl_bt_legacy_advertiser_start(
-          ble_data.advertisingSetHandle,
-          sl_bt_legacy_advertiser_connectable);
-
-      if(rc != SL_STATUS_OK){
-          LOG_ERROR("Bluetooth: Advertiser start error = %d\r\n", (unsigned int) rc);
-      }
-
-      rc = sl_bt_sm_delete_bondings();
-
-      if(rc != SL_STATUS_OK){
-#if ENABLE_ERROR_LOGS
-          LOG_ERROR("Bluetooth: sl_bt_sm_delete_bondings error = %d\r\n", (unsigned int) rc);
+            LOG_INFO("Advertising started...\r\n");
 #endif
-      }
+        }
 
-      // Add LCD prints.
-      displayPrintf(DISPLAY_ROW_CONNECTION, ADVERTISING_STRING);
-      displayPrintf(DISPLAY_ROW_TEMPVALUE, " ");
+        if(ble_data.numConnections > 0){
+            displayPrintf(DISPLAY_ROW_CONNECTION, "%s %d", CONNECTED_STRING, ble_data.numConnections);
+            break;
+        }
 
+        // 3. Last central gone, set the connection lost event
+        schedulerSetEventBleConnectionClose();
+        ble_data.connection_open = false;
+        ble_data.ok_to_send_htm_connections = false;
 
 #if ENABLE_BLE_LOGS
-      LOG_INFO("Advertising started...\r\n");
+        LOG_INFO("connection_open is false...\r\n");
 #endif
 
+        // Add LCD prints.
+        displayPrintf(DISPLAY_ROW_CONNECTION, ADVERTISING_STRING);
+        displayPrintf(DISPLAY_ROW_TEMPVALUE, " ");
+      }
       break;
 
       /*Informational. Triggered whenever the connection parameters are changed and at any time a connection is established*/
@@ -334,6 +378,17 @@ void handle_ble_event(sl_bt_msg_t *evt){
       LOG_INFO("LATENCY - %d\r\n", evt->data.evt_connection_parameters.latency);
       LOG_INFO("TIMEOUT - %d\r\n", evt->data.evt_connection_parameters.timeout*10);
 #endif
+      connPolicyOnParameters(evt->data.evt_connection_parameters.connection,
+                             evt->data.evt_connection_parameters.interval,
+                             evt->data.evt_connection_parameters.latency);
+
+      // A returning bond encrypted the link with its stored keys
+      if(evt->data.evt_connection_parameters.security_mode != sl_bt_connection_mode1_level1){
+          ble_conn_t *conn = ble_conn_find(evt->data.evt_connection_parameters.connection);
+          if(conn != NULL){
+              ble_conn_secured(conn);
+          }
+      }
 
       break;
 
@@ -343,168 +398,117 @@ void handle_ble_event(sl_bt_msg_t *evt){
       I.e. we sent an indication from our server to the client with sl_bt_gatt_server_send_indication()*/
     case sl_bt_evt_gatt_server_characteristic_status_id:
 
-      //For button  state characteristic, see if client characteristic configuration changed
-      if((evt->data.evt_gatt_server_characteristic_status.characteristic == gattdb_flex_data)
-          && (evt->data.evt_gatt_server_characteristic_status.status_flags == sl_bt_gatt_server_client_config)){
+      {
+        sl_bt_evt_gatt_server_characteristic_status_t *status = &evt->data.evt_gatt_server_characteristic_status;
+        ble_conn_t *conn = ble_conn_find(status->connection);
 
-          //Check if indications were enabled from the client
-          if(evt->data.evt_gatt_server_characteristic_status.client_config_flags == 0x02){
-              ble_data.ok_to_send_bs_connections = true;
-#if ENABLE_BLE_LOGS
-              LOG_INFO("ok_to_send_htm_connections is true...\r\n");
-#endif
-          }
+        if(conn == NULL){
+            break;
+        }
+
+        // Client characteristic configuration is per central
+        if(status->status_flags == sl_bt_gatt_server_client_config){
 
-          //Check if indications were disabled from the client
-          if(evt->data.evt_gatt_server_characteristic_status.client_config_flags == 0x00){
-              ble_data.ok_to_send_bs_connections = false;
+            //For flex state characteristic, see if indications were enabled or disabled
+            if(status->characteristic == gattdb_flex_data){
+                conn->indicate_flex = (status->client_config_flags == sl_bt_gatt_indication);
 #if ENABLE_BLE_LOGS
-              LOG_INFO("ok_to_send_htm_connections is false...\r\n");
+                LOG_INFO("Connection %d flex indications %d\r\n", conn->handle, conn->indicate_flex);
 #endif
-          }
+            }
 
-      }
-
-      //For button  state characteristic, see if client characteristic configuration changed
-      if((evt->data.evt_gatt_server_characteristic_status.characteristic == gattdb_accelerometer_data)
-          && (evt->data.evt_gatt_server_characteristic_status.status_flags == sl_bt_gatt_server_client_config)){
-
-          //Check if indications were enabled from the client
-          if(evt->data.evt_gatt_server_characteristic_status.client_config_flags == 0x02){
-              ble_data.ok_to_send_bs_connections = true;
+            //For accelerometer characteristic, see if indications were enabled or disabled
+            if(status->characteristic == gattdb_accelerometer_data){
+                conn->indicate_accel = (status->client_config_flags == sl_bt_gatt_indication);
 #if ENABLE_BLE_LOGS
-              LOG_INFO("ok_to_send_htm_connections is true...\r\n");
+                LOG_INFO("Connection %d accel indications %d\r\n", conn->handle, conn->indicate_accel);
 #endif
-          }
-
-          //Check if indications were disabled from the client
-          if(evt->data.evt_gatt_server_characteristic_status.client_config_flags == 0x00){
-              ble_data.ok_to_send_bs_connections = false;
+            }
+
+            //For flex angle characteristic, see if notifications were enabled or disabled
+            if(status->characteristic == gattdb_flex_angle){
+                conn->notify_flex_angle = (status->client_config_flags == sl_bt_gatt_notification);
+            }
+
+            //For sample batch characteristic, batching only runs while a central has notifications enabled
+            if(status->characteristic == gattdb_sample_batch){
+                conn->notify_batch = (status->client_config_flags == sl_bt_gatt_notification);
+                batchEnable(conn->handle, conn->notify_batch);
+            }
+
+            // Remember the subscriptions for the next time this bond connects
+            bondSaveCccd(conn->bonding, ble_conn_cccd(conn));
+        }
+
+        // Confirmation of any indication frees the connection for the next one
+        if(status->status_flags == sl_bt_gatt_server_confirmation){
+            indicationConfirmed(conn->handle);
 #if ENABLE_BLE_LOGS
-              LOG_INFO("ok_to_send_htm_connections is false...\r\n");
+            LOG_INFO("Indication confirmed...\r\n");
 #endif
-          }
-
+        }
       }
+      break;
 
-      if((evt->data.evt_gatt_server_characteristic_status.characteristic == gattdb_flex_data)
-          && (evt->data.evt_gatt_server_characteristic_status.status_flags == sl_bt_gatt_server_confirmation)){
-          ble_data.indication_in_flight = false;
+      // Client wrote the flex calibration characteristic
+    case sl_bt_evt_gatt_server_attribute_value_id:
 
-          indication_t dequeuedIndication;
+      if(evt->data.evt_gatt_server_attribute_value.attribute == gattdb_flex_calibration){
+          uint8array *value = &evt->data.evt_gatt_server_attribute_value.value;
 
-          if(dequeue(&indicationQueue, &dequeuedIndication)){
-              if(dequeuedIndication.charHandle == gattdb_flex_data){
-                  // Send the indication to the client
-                  rc = sl_bt_gatt_server_send_indication(
-                      ble_data.connectionHandle,
-                      gattdb_flex_data, // handle from gatt_db.h
-                      1,
-                      &dequeuedIndication.buffer[0] // in IEEE-11073 format
-                  );
-                  if (rc != SL_STATUS_OK) {
+          if((value->len == 1) && (value->data[0] == FLEX_CAL_RESET)){
+              flexAngleResetCalibration();
+          }
+          else if(value->len == 3){
+              // Capture the current filtered reading as the voltage for this angle
+              if(!flexAngleSetCalPoint(value->data[0], (uint16_t) flexFilterGetOutput(),
+                                       (int16_t) (value->data[1] | (value->data[2] << 8)))){
 #if ENABLE_ERROR_LOGS
-                      LOG_ERROR("Error Sending client data:%X\r\n",(unsigned int) rc);
+                  LOG_ERROR("Calibration point %d not applied\r\n", value->data[0]);
 #endif
-                  } else {
-                      // Set the flag that an indication is in flight
-                      ble_data.indication_in_flight = true;
-                  }
               }
           }
-#if ENABLE_BLE_LOGS
-          LOG_INFO("indication_in_flight is false...\r\n");
-#endif
       }
+      break;
 
-      if((evt->data.evt_gatt_server_characteristic_status.characteristic == gattdb_accelerometer_data)
-          && (evt->data.evt_gatt_server_characteristic_status.status_flags == sl_bt_gatt_server_confirmation)){
-          ble_data.indication_in_flight = false;
-
-          indication_t dequeuedIndication;
+      // Directed advertising to the last bond ran out without a connection
+    case sl_bt_evt_advertiser_timeout_id:
 
-          if(dequeue(&indicationQueue, &dequeuedIndication)){
-              if(dequeuedIndication.charHandle == gattdb_accelerometer_data){
-                  // Send the indication to the client
-                  rc = sl_bt_gatt_server_send_indication(
-                      ble_data.connectionHandle,
-                      gattdb_accelerometer_data, // handle from gatt_db.h
-                      1,
-                      &dequeuedIndication.buffer[0] // in IEEE-11073 format
-                  );
-                  if (rc != SL_STATUS_OK) {
-#if ENABLE_ERROR_LOGS
-                      LOG_ERROR("Error Sending client data:%X\r\n",(unsigned int) rc);
-#endif
-                  } else {
-                      // Set the flag that an indication is in flight
-                      ble_data.indication_in_flight = true;
-                  }
-              }
-          }
-#if ENABLE_BLE_LOGS
-          LOG_INFO("indication_in_flight is false...\r\n");
-#endif
+      if((evt->data.evt_advertiser_timeout.handle == ble_data.advertisingSetHandle)
+          && (ble_data.numConnections < LINK_MAX_CONNECTIONS)){
+          broadcastStart(ble_data.advertisingSetHandle);
       }
+      break;
+
+      // Controller switched the PHY of the connection
+    case sl_bt_evt_connection_phy_status_id:
+
+      linkOnPhy(evt->data.evt_connection_phy_status.connection,
+                evt->data.evt_connection_phy_status.phy);
+      break;
 
+      // Link layer PDU size changed
+    case sl_bt_evt_connection_data_length_id:
+
+      linkOnDataLength(evt->data.evt_connection_data_length.connection,
+                       evt->data.evt_connection_data_length.tx_data_len,
+                       evt->data.evt_connection_data_length.rx_data_len);
+      break;
+
+      // Client and server agreed on an ATT MTU, resize the sample batch to fill it
+    case sl_bt_evt_gatt_mtu_exchanged_id:
+
+      linkOnMtu(evt->data.evt_gatt_mtu_exchanged.connection,
+                evt->data.evt_gatt_mtu_exchanged.mtu);
+      batchConfigure(evt->data.evt_gatt_mtu_exchanged.connection,
+                     evt->data.evt_gatt_mtu_exchanged.mtu);
       break;
 
     case sl_bt_evt_system_external_signal_id:
 
-      if (evt->data.evt_system_external_signal.extsignals == EVENT_PB0) {
-#if ENABLE_BLE_LOGS
-          LOG_INFO("Buton event...\r\n");
-#endif
-          if(ble_data.expecting_passkey_confirmation == true){
-              // Confirm pairing when PB0 is pressed
-              sl_bt_sm_passkey_confirm(ble_data.connectionHandle, 1);
-              ble_data.expecting_passkey_confirmation = false;
-          }
-      }
-      if (evt->data.evt_system_external_signal.extsignals == EVENT_0DEGREE){
-          flexData = 0;
-          rc = sl_bt_gatt_server_write_attribute_value(gattdb_flex_data, 0, sizeof(uint8_t),&flexData);
-          if (rc == SL_STATUS_OK && ble_data.bonded && ble_data.connection_open) {
-              send_next_indication_flex(flexData);
-          }
-          displayPrintf(DISPLAY_ROW_9, "Flex Angle:0Deg");
-          accelData++;
-          rc = sl_bt_gatt_server_write_attribute_value(gattdb_accelerometer_data, 0, sizeof(uint8_t),&accelData);
-          if (rc == SL_STATUS_OK && ble_data.bonded && ble_data.connection_open) {
-              send_next_indication_accel(accelData);
-          }
-          displayPrintf(DISPLAY_ROW_10, "Tilt Count:%d",accelData);
-      }
-      else if (evt->data.evt_system_external_signal.extsignals == EVENT_45DEGREE){
-          flexData = 45;
-          rc = sl_bt_gatt_server_write_attribute_value(gattdb_flex_data, 0, sizeof(uint8_t), &flexData);
-          if (rc == SL_STATUS_OK && ble_data.bonded && ble_data.connection_open) {
-              send_next_indication_flex(flexData);
-          }
-          displayPrintf(DISPLAY_ROW_9, "Flex Angle:45Deg");
-          accelData++;
-          rc = sl_bt_gatt_server_write_attribute_value(gattdb_accelerometer_data, 0, sizeof(uint8_t),&accelData);
-          if (rc == SL_STATUS_OK && ble_data.bonded && ble_data.connection_open) {
-              send_next_indication_accel(accelData);
-          }
-          displayPrintf(DISPLAY_ROW_10, "Tilt Count:%d",accelData);
-          schedulerSetEventBLEDONE();
-      }
-      else if (evt->data.evt_system_external_signal.extsignals == EVENT_90DEGREE){
-          flexData = 90;
-          rc = sl_bt_gatt_server_write_attribute_value(gattdb_flex_data, 0, sizeof(uint8_t), &flexData);
-          if (rc == SL_STATUS_OK && ble_data.bonded && ble_data.connection_open) {
-              send_next_indication_flex(flexData);
-          }
-          displayPrintf(DISPLAY_ROW_9, "Flex Angle:90Deg");
-          accelData++;
-          rc = sl_bt_gatt_server_write_attribute_value(gattdb_accelerometer_data, 0, sizeof(uint8_t),&accelData);
-          if (rc == SL_STATUS_OK && ble_data.bonded && ble_data.connection_open) {
-              send_next_indication_accel(accelData);
-          }
-          displayPrintf(DISPLAY_ROW_10, "Tilt Count:%d",accelData);
-          schedulerSetEventBLEDONE();
-      }
+      // The signal only says that a batch of scheduler events is pending,
+      // the scheduler hands each event to its registered handler.
+      schedulerDispatch();
       break;
 
       /*Possible event from calling sl_bt_gatt_server_send_indication() - i.e. we never received a confirmation
@@ -515,12 +519,16 @@ void handle_ble_event(sl_bt_msg_t *evt){
       LOG_INFO("Confirmation not received for a previously transmitted event\r\n");
 #endif
 
-      //Check if an indication is in flight, If yes then reset it since a timeout has occurred
-      if(ble_data.indication_in_flight == true){
-          ble_data.indication_in_flight = false;
-#if ENABLE_BLE_LOGS
-          LOG_INFO("indication_in_flight is false...\r\n");
-#endif
+      // No further ATT traffic is possible on this connection after a timeout,
+      // drop whatever is still queued and stop indicating to it
+      {
+        ble_conn_t *conn = ble_conn_find(evt->data.evt_gatt_server_indication_timeout.connection);
+
+        indicationClose(evt->data.evt_gatt_server_indication_timeout.connection);
+        if(conn != NULL){
+            conn->indicate_flex = false;
+            conn->indicate_accel = false;
+        }
       }
 
       break;
@@ -532,7 +540,23 @@ void handle_ble_event(sl_bt_msg_t *evt){
           // Update the display @ 1Hz
           displayUpdate();
       }
-
+      else if(evt->data.evt_system_soft_timer.handle == TIMER_HANDLE_BATCH){
+          // Oldest sample in the batch reached BATCH_MAX_AGE_MS
+          batchOnTimer();
+      }
+      else if(evt->data.evt_system_soft_timer.handle == TIMER_HANDLE_CONN_POLICY){
+          // Drop to the idle profile once the wearer has been still
+          connPolicyOnTimer();
+      }
+      else if(evt->data.evt_system_soft_timer.handle == TIMER_HANDLE_DISPLAY_IDLE){
+          // Nothing for the user to look at, blank the LCD
+          displayIdleTimeout();
+      }
+#if ACCEL_FIFO_ENABLE
+      else if(evt->data.evt_system_soft_timer.handle == TIMER_HANDLE_ACCEL_FIFO){
+          accelFifoOnTimer();
+      }
+#endif
 
       break;
 
@@ -542,7 +566,11 @@ void handle_ble_event(sl_bt_msg_t *evt){
 #endif
       displayPrintf(DISPLAY_ROW_PASSKEY, "%06lu", evt->data.evt_sm_confirm_passkey.passkey);
       displayPrintf(DISPLAY_ROW_ACTION, "Confirm with PB0");
+      // The user is waiting for the passkey, don't hold it until the next tick
+      displayActivity();
+      displayFlush();
       ble_data.expecting_passkey_confirmation = true;
+      ble_data.passkeyConnection = evt->data.evt_sm_confirm_passkey.connection;
       break;
 
     case sl_bt_evt_sm_confirm_bonding_id:
@@ -556,7 +584,15 @@ void handle_ble_event(sl_bt_msg_t *evt){
 #if ENABLE_BLE_LOGS
       LOG_INFO("Bonded...\r\n");
 #endif
-      ble_data.bonded = true;
+      {
+        ble_conn_t *conn = ble_conn_find(evt->data.evt_sm_bonded.connection);
+        if(conn != NULL){
+            conn->bonded = true;
+            conn->bonding = evt->data.evt_sm_bonded.bonding;
+            bondSaveCccd(conn->bonding, ble_conn_cccd(conn));
+            bondSetLastPeer(conn->address, conn->addressType);
+        }
+      }
       displayPrintf(DISPLAY_ROW_ACTION, " ");
       displayPrintf(DISPLAY_ROW_PASSKEY, " ");
       displayPrintf(DISPLAY_ROW_CONNECTION, "Bonded");
@@ -566,7 +602,12 @@ void handle_ble_event(sl_bt_msg_t *evt){
 #if ENABLE_BLE_LOGS
       LOG_INFO("Bonding Failed...\r\n");
 #endif
-      ble_data.bonded = false;
+      {
+        ble_conn_t *conn = ble_conn_find(evt->data.evt_sm_bonding_failed.connection);
+        if(conn != NULL){
+            conn->bonded = false;
+        }
+      }
       displayPrintf(DISPLAY_ROW_CONNECTION, "Bonding Failed");
       break;
 #else
@@ -814,63 +855,170 @@ void handle_ble_event(sl_bt_msg_t *evt){
 }
 
 /**
- * @brief Sends the next indication from the queue if available.
+ * @brief Writes the calibrated flex angle to the GATT database and notifies
+ *        the client if it enabled notifications.
  *
- * This function checks if there is any pending indication in the queue and
- * sends it using the GATT server API. If the indication is sent successfully,
- * the queue is updated and the `indication_in_flight` flag is set.
+ * @param deciDeg Flex angle in 0.1 degree steps.
  */
-void send_next_indication_flex(uint8_t state) {
+static void send_flex_angle(int16_t deciDeg){
 
-  indication_t newIndication;
-  newIndication.charHandle = gattdb_flex_data;
-  newIndication.bufferLength = 1;
-  newIndication.buffer[0] = state;
+  sl_status_t rc;
+  uint8_t buffer[2];
+  uint8_t i;
 
-  if (ble_data.indication_in_flight == false) {
-      sl_status_t rc = sl_bt_gatt_server_send_indication(
-          ble_data.connectionHandle,
-          gattdb_flex_data,
-          sizeof(uint8_t),
-          &state
-      );
-      if (rc == SL_STATUS_OK) {
-          ble_data.indication_in_flight = true;
+  buffer[0] = (uint8_t) deciDeg;
+  buffer[1] = (uint8_t) ((uint16_t) deciDeg >> 8);
 
+  rc = sl_bt_gatt_server_write_attribute_value(gattdb_flex_angle, 0, sizeof(buffer), buffer);
+  if (rc != SL_STATUS_OK) {
+#if ENABLE_ERROR_LOGS
+      LOG_ERROR("sl_bt_gatt_server_write_attribute_value() returned != 0 status=0x%04x\r\n", (unsigned int) rc);
+#endif
+      return;
+  }
+
+  // Notify every bonded central that subscribed
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      ble_conn_t *conn = &ble_data.conns[i];
+
+      if (!conn->open || !conn->bonded || !conn->notify_flex_angle) {
+          continue;
+      }
+      rc = sl_bt_gatt_server_send_notification(conn->handle, gattdb_flex_angle, sizeof(buffer), buffer);
+      if (rc != SL_STATUS_OK) {
+#if ENABLE_ERROR_LOGS
+          LOG_ERROR("sl_bt_gatt_server_send_notification() returned != 0 status=0x%04x\r\n", (unsigned int) rc);
+#endif
       }
   }
-  else{
-      enqueue(&indicationQueue,newIndication);
+}
+
+/**
+ * @brief Writes the flex angle and tilt count to the GATT database and sends
+ *        the indications if a bonded client is connected.
+ *
+ * @param angle Flex angle in degrees.
+ */
+static void update_posture_data(uint8_t angle){
+
+  sl_status_t rc;
+
+  flexData = angle;
+  broadcastSetPosture(angle);
+  rc = sl_bt_gatt_server_write_attribute_value(gattdb_flex_data, 0, sizeof(uint8_t), &flexData);
+  if (rc == SL_STATUS_OK) {
+      send_next_indication_flex(flexData);
   }
+  displayPrintf(DISPLAY_ROW_9, "Flex Angle:%dDeg", flexData);
 }
 
 /**
- * @brief Sends the next indication from the queue if available.
+ * @brief Writes pitch and roll to the accelerometer characteristic and sends
+ *        the indication if a bonded client is connected.
  *
- * This function checks if there is any pending indication in the queue and
- * sends it using the GATT server API. If the indication is sent successfully,
- * the queue is updated and the `indication_in_flight` flag is set.
+ * @param tilt Pitch and roll in 0.1 degree steps.
  */
-void send_next_indication_accel(uint8_t state) {
+static void update_tilt_data(tilt_t tilt){
 
-  indication_t newIndication;
-  newIndication.charHandle = gattdb_accelerometer_data;
-  newIndication.bufferLength = 1;
-  newIndication.buffer[0] = state;
-
-  if (ble_data.indication_in_flight == false) {
-      sl_status_t rc = sl_bt_gatt_server_send_indication(
-          ble_data.connectionHandle,
-          gattdb_accelerometer_data,
-          sizeof(uint8_t),
-          &state
-      );
-      if (rc == SL_STATUS_OK) {
-          ble_data.indication_in_flight = true;
+  sl_status_t rc;
+  uint8_t buffer[4];
+
+  buffer[0] = (uint8_t) tilt.pitch;
+  buffer[1] = (uint8_t) ((uint16_t) tilt.pitch >> 8);
+  buffer[2] = (uint8_t) tilt.roll;
+  buffer[3] = (uint8_t) ((uint16_t) tilt.roll >> 8);
+
+  rc = sl_bt_gatt_server_write_attribute_value(gattdb_accelerometer_data, 0, sizeof(buffer), buffer);
+  if (rc == SL_STATUS_OK) {
+      send_next_indication_accel(buffer, sizeof(buffer));
+  }
+  displayPrintf(DISPLAY_ROW_10, "Pitch:%d Roll:%d", tilt.pitch / 10, tilt.roll / 10);
+}
+
+/**
+ * @brief Scheduler handler for the events owned by the BLE module, registered
+ *        for EVENT_PB0 and the flex angle events.
+ *
+ * @param evt The event being dispatched by the scheduler.
+ */
+void handle_ble_scheduler_event(Events_t evt){
+
+  switch(evt){
+    case EVENT_PB0:
+#if ENABLE_BLE_LOGS
+      LOG_INFO("Buton event...\r\n");
+#endif
+      displayActivity();
+      if(ble_data.expecting_passkey_confirmation == true){
+          // Confirm pairing when PB0 is pressed
+          sl_bt_sm_passkey_confirm(ble_data.passkeyConnection, 1);
+          ble_data.expecting_passkey_confirmation = false;
+      }
+      break;
+
+    case EVENT_0DEGREE:
+      update_posture_data(0);
+      break;
+
+    case EVENT_45DEGREE:
+      update_posture_data(45);
+      displayActivity(); // posture alert, show it
+      schedulerSetEventBLEDONE();
+      break;
+
+    case EVENT_90DEGREE:
+      update_posture_data(90);
+      displayActivity();
+      schedulerSetEventBLEDONE();
+      break;
+
+    case EVENT_FLEXANGLE:
+      send_flex_angle(adcGetFlexAngle());
+      break;
+
+    case EVENT_TILT:
+      update_tilt_data(tiltGet());
+      break;
+
+    default:
+      break;
+  }
+
+  // Observers without a connection follow the same changes
+  if(evt & (EVENT_0DEGREE | EVENT_45DEGREE | EVENT_90DEGREE | EVENT_FLEXANGLE | EVENT_TILT)){
+      broadcastUpdate();
+  }
+}
+
+/**
+ * @brief Queues the flex state indication for every bonded central that
+ *        subscribed, each is sent once the previous indication on that
+ *        connection is confirmed.
+ */
+void send_next_indication_flex(uint8_t state) {
+
+  uint8_t i;
+
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      if (ble_data.conns[i].open && ble_data.conns[i].bonded && ble_data.conns[i].indicate_flex) {
+          indicationSend(ble_data.conns[i].handle, gattdb_flex_data, &state, sizeof(state));
       }
   }
-  else{
-      enqueue(&indicationQueue,newIndication);
+}
+
+/**
+ * @brief Queues the pitch/roll indication for every bonded central that
+ *        subscribed, each is sent once the previous indication on that
+ *        connection is confirmed.
+ */
+void send_next_indication_accel(const uint8_t *data, uint8_t len) {
+
+  uint8_t i;
+
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      if (ble_data.conns[i].open && ble_data.conns[i].bonded && ble_data.conns[i].indicate_accel) {
+          indicationSend(ble_data.conns[i].handle, gattdb_accelerometer_data, data, len);
+      }
   }
 }
 
@@ -31,6 +31,13 @@
 #include <stdbool.h>
 #include "sl_bt_api.h"
 #include "scheduler.h"
+#include "tilt.h"
+#include "indication.h"
+#include "batch.h"
+#include "link.h"
+#include "conn_policy.h"
+#include "broadcast.h"
+#include "bond.h"
 #include "em_gpio.h"
 
 #define UINT8_TO_BITSTREAM(p, n)        { *(p)++ = (uint8_t)(n); }
@@ -38,6 +45,20 @@
                                           *(p)++ = (uint8_t)((n) >> 16); *(p)++ = (uint8_t)((n) >> 24); }
 #define UINT32_TO_FLOAT(m, e)           (((uint32_t)(m) & 0x00FFFFFFU) | ((uint32_t)(e) << 24))
 
+// State of one connected central
+typedef struct {
+ bool open;
+ uint8_t handle;
+ bd_addr address;
+ uint8_t addressType;
+ uint8_t bonding;                    // bonding handle, SL_BT_INVALID_BONDING_HANDLE if not bonded
+ bool bonded;                        // true once the link is bonded and encrypted
+ bool indicate_flex;                 // true when the central enabled flex state indications
+ bool indicate_accel;                // true when the central enabled pitch/roll indications
+ bool notify_flex_angle;             // true when the central enabled flex angle notifications
+ bool notify_batch;                  // true when the central enabled sample batch notifications
+} ble_conn_t;
+
 typedef struct {
  // values that are common to servers and clients
  bd_addr myAddress;
@@ -46,12 +67,12 @@ typedef struct {
  // The advertising set handle allocated from Bluetooth stack.
  uint8_t advertisingSetHandle;
  // Connection current state
- bool connection_open;               // true when connection is open
+ bool connection_open;               // true when at least one connection is open
  bool ok_to_send_htm_connections;    // true when client enabled indications
- bool ok_to_send_bs_connections;    // true when client enabled indications
- bool indication_in_flight;          // true when an indication is in flight
- bool bonded;
+ ble_conn_t conns[LINK_MAX_CONNECTIONS];  // one entry per connected central
+ uint8_t numConnections;
  bool expecting_passkey_confirmation;
+ uint8_t passkeyConnection;          // connection waiting for the PB0 confirmation
 
  // values unique for client
   uint8_t myAddressType;
@@ -62,7 +83,8 @@ typedef struct {
 
 ble_data_struct_t*  get_ble_data_struct(void);
 void handle_ble_event(sl_bt_msg_t *evt);
-void send_next_indication_accel(uint8_t state);
+void handle_ble_scheduler_event(Events_t evt);
+void send_next_indication_accel(const uint8_t *data, uint8_t len);
 void send_next_indication_flex(uint8_t state);
 void enqueue_indication(uint8_t value);
 void send_temp_ble(void);
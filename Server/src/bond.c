@@ -0,0 +1,151 @@
+/***********************************************************************
+ * @file      bond.c
+ * @version   0.1
+ * @brief     Persistent bonds and fast reconnect.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 8, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources AN1135 Using Third Generation NonVolatile Memory (NVM3) Data Storage
+ *
+ * Bonds stay in the stack's bonding database across disconnects and resets,
+ * a returning central encrypts with the stored keys and skips the passkey.
+ * The characteristics a bond subscribed to are kept in a user NVM key per
+ * bonding handle so the indications resume as soon as the link is
+ * encrypted again. When a bonded central drops, high duty directed
+ * advertising to it gets the link back within the 1.28s burst if the
+ * central is still scanning for us.
+ */
+
+#define INCLUDE_LOG_DEBUG     1
+#include "log.h"
+#include "src/bond.h"
+#include <string.h>
+
+static bool     haveLastPeer = false;
+static bd_addr  lastPeer;
+static uint8_t  lastPeerType;
+
+/**
+ * @brief Call on sl_bt_evt_system_boot_id after sl_bt_sm_configure().
+ *        Keeps new bonds and loads the last peer for the reconnect.
+ */
+void bondInit(void)
+{
+  sl_status_t rc;
+  uint8_t buffer[sizeof(bd_addr) + 1];
+  size_t len = 0;
+
+  rc = sl_bt_sm_store_bonding_configuration(BOND_MAX_BONDINGS, BOND_POLICY_LRU);
+  if (rc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_sm_store_bonding_configuration() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+  }
+
+  rc = sl_bt_sm_set_bondable_mode(1);
+  if (rc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_sm_set_bondable_mode() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+  }
+
+  rc = sl_bt_nvm_load(BOND_NVM_KEY_LAST_PEER, sizeof(buffer), &len, buffer);
+  if ((rc == SL_STATUS_OK) && (len == sizeof(buffer))) {
+      memcpy(lastPeer.addr, buffer, sizeof(bd_addr));
+      lastPeerType = buffer[sizeof(bd_addr)];
+      haveLastPeer = true;
+  }
+}
+
+/**
+ * @brief Subscriptions stored for a bond, BOND_CCCD_* bits. 0 when the
+ *        bond has none or the handle is not a bond.
+ */
+uint8_t bondLoadCccd(uint8_t bonding)
+{
+  uint8_t cccd = 0;
+  size_t len = 0;
+
+  if (bonding == SL_BT_INVALID_BONDING_HANDLE) {
+      return 0;
+  }
+
+  if ((sl_bt_nvm_load(BOND_NVM_KEY_CCCD + bonding, sizeof(cccd), &len, &cccd) != SL_STATUS_OK)
+      || (len != sizeof(cccd))) {
+      return 0;
+  }
+
+  return cccd;
+}
+
+/**
+ * @brief Stores the subscriptions of a bond, only written when they change
+ *        to spare the flash.
+ */
+void bondSaveCccd(uint8_t bonding, uint8_t cccd)
+{
+  sl_status_t rc;
+
+  if ((bonding == SL_BT_INVALID_BONDING_HANDLE) || (bondLoadCccd(bonding) == cccd)) {
+      return;
+  }
+
+  rc = sl_bt_nvm_save(BOND_NVM_KEY_CCCD + bonding, sizeof(cccd), &cccd);
+  if (rc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_nvm_save() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+  }
+}
+
+/**
+ * @brief Remembers the central to reconnect to, call once its link is
+ *        bonded and encrypted.
+ */
+void bondSetLastPeer(bd_addr address, uint8_t addressType)
+{
+  sl_status_t rc;
+  uint8_t buffer[sizeof(bd_addr) + 1];
+
+  if (haveLastPeer && (lastPeerType == addressType)
+      && (memcmp(lastPeer.addr, address.addr, sizeof(bd_addr)) == 0)) {
+      return;
+  }
+
+  lastPeer = address;
+  lastPeerType = addressType;
+  haveLastPeer = true;
+
+  memcpy(buffer, address.addr, sizeof(bd_addr));
+  buffer[sizeof(bd_addr)] = addressType;
+  rc = sl_bt_nvm_save(BOND_NVM_KEY_LAST_PEER, sizeof(buffer), buffer);
+  if (rc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_nvm_save() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+  }
+}
+
+/**
+ * @brief Starts high duty directed advertising to the last bonded central.
+ *        The stack ends it after 1.28s with sl_bt_evt_advertiser_timeout_id,
+ *        the caller then goes back to undirected advertising.
+ *
+ * @return false if there is no bonded peer or the advertiser did not start.
+ */
+bool bondReconnect(uint8_t advertisingSet)
+{
+  sl_status_t rc;
+
+  if (!haveLastPeer) {
+      return false;
+  }
+
+  rc = sl_bt_legacy_advertiser_start_directed(advertisingSet,
+                                              sl_bt_legacy_advertiser_high_duty_directed_connectable,
+                                              lastPeer, lastPeerType);
+  if (rc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_legacy_advertiser_start_directed() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+      return false;
+  }
+
+  return true;
+}
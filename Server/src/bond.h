@@ -0,0 +1,44 @@
+/***********************************************************************
+ * @file      bond.h
+ * @version   0.1
+ * @brief     Function header/interface file.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 8, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ */
+
+#ifndef SRC_BOND_H_
+#define SRC_BOND_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sl_bt_api.h"
+
+#define BOND_MAX_BONDINGS        4       // bonds kept in the stack's database
+#define BOND_POLICY_LRU          2       // a new bond replaces the one used the longest time ago
+
+// User NVM keys, sl_bt_nvm_save() accepts 0x4000 - 0x407F
+#define BOND_NVM_KEY_CCCD        0x4000  // + bonding handle, subscriptions of that bond
+#define BOND_NVM_KEY_LAST_PEER   0x4020  // address of the last bonded central
+
+// Subscriptions restored for a returning bond
+#define BOND_CCCD_FLEX_DATA      (1 << 0)
+#define BOND_CCCD_ACCEL_DATA     (1 << 1)
+#define BOND_CCCD_FLEX_ANGLE     (1 << 2)
+#define BOND_CCCD_SAMPLE_BATCH   (1 << 3)
+
+void bondInit(void);
+uint8_t bondLoadCccd(uint8_t bonding);
+void bondSaveCccd(uint8_t bonding, uint8_t cccd);
+void bondSetLastPeer(bd_addr address, uint8_t addressType);
+bool bondReconnect(uint8_t advertisingSet);
+
+#endif /* SRC_BOND_H_ */
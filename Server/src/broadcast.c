@@ -0,0 +1,214 @@
+/***********************************************************************
+ * @file      broadcast.c
+ * @version   0.1
+ * @brief     Posture broadcast in the advertising data.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 7, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources Bluetooth Core Supplement, Part A 1.4 Manufacturer Specific Data
+ *
+ * The current flex angle, pitch, roll and posture are carried in a
+ * manufacturer specific AD structure of the legacy advertising packet, so
+ * any number of passive scanners can follow the wearer without a
+ * connection. The packet is rewritten in place on every posture change,
+ * the sequence number lets an observer drop repeats of the same sample.
+ * The scan response carries the flex sensor service UUID and the device
+ * name, clients of the fleet match the service instead of an address.
+ */
+
+#define INCLUDE_LOG_DEBUG     1
+#include "log.h"
+#include "src/broadcast.h"
+#include "src/adc.h"
+#include "src/tilt.h"
+#include "sl_bt_api.h"
+#include "gatt_db.h"
+#include <string.h>
+
+#define AD_TYPE_FLAGS            0x01
+#define AD_TYPE_MANUFACTURER     0xFF
+#define AD_TYPE_UUID128_SOME     0x06    // Incomplete list of 128-bit service UUIDs
+#define AD_TYPE_SHORT_NAME       0x08
+#define AD_FLAGS_LE_GENERAL      0x06    // LE general discoverable, BR/EDR not supported
+
+// Flex Sensor Data service 39b6b0dc-6ee2-4e77-a665-75d0b64649a3, little endian
+static const uint8_t flexServiceUuid[16] = {
+  0xa3, 0x49, 0x46, 0xb6, 0xd0, 0x75, 0x65, 0xa6,
+  0x77, 0x4e, 0xe2, 0x6e, 0xdc, 0xb0, 0xb6, 0x39
+};
+
+static uint8_t advHandle;
+static bool    active = false;
+static uint8_t sequence = 0;
+static uint8_t posture = 0;
+
+/**
+ * @brief Builds the advertising packet: flags, then the manufacturer data
+ *        if BROADCAST_ENABLE.
+ *
+ * @return Packet length.
+ */
+static uint8_t broadcastBuild(uint8_t *p)
+{
+  tilt_t tilt = tiltGet();
+  int16_t flex = adcGetFlexAngle();
+  uint8_t *start = p;
+
+  *p++ = 2;
+  *p++ = AD_TYPE_FLAGS;
+  *p++ = AD_FLAGS_LE_GENERAL;
+
+#if BROADCAST_ENABLE
+  *p++ = BROADCAST_PAYLOAD_SIZE + 1;
+  *p++ = AD_TYPE_MANUFACTURER;
+  *p++ = (uint8_t) BROADCAST_COMPANY_ID;
+  *p++ = (uint8_t) (BROADCAST_COMPANY_ID >> 8);
+  *p++ = BROADCAST_FORMAT;
+  *p++ = sequence;
+  *p++ = (uint8_t) flex;
+  *p++ = (uint8_t) ((uint16_t) flex >> 8);
+  *p++ = (uint8_t) tilt.pitch;
+  *p++ = (uint8_t) ((uint16_t) tilt.pitch >> 8);
+  *p++ = (uint8_t) tilt.roll;
+  *p++ = (uint8_t) ((uint16_t) tilt.roll >> 8);
+  *p++ = posture;
+#else
+  (void) tilt;
+  (void) flex;
+#endif
+
+  return (uint8_t) (p - start);
+}
+
+/**
+ * @brief Builds the scan response, the flex sensor service UUID followed by
+ *        the device name, shortened to what is left of the 31 bytes.
+ *
+ * @return Length of the scan response.
+ */
+static uint8_t broadcastBuildScanResponse(uint8_t *p)
+{
+  uint8_t *start = p;
+  size_t nameLen = 0;
+  uint8_t room;
+
+  *p++ = sizeof(flexServiceUuid) + 1;
+  *p++ = AD_TYPE_UUID128_SOME;
+  memcpy(p, flexServiceUuid, sizeof(flexServiceUuid));
+  p += sizeof(flexServiceUuid);
+
+  room = BROADCAST_SCAN_RESPONSE_MAX - (uint8_t) (p - start) - 2;
+  if (sl_bt_gatt_server_read_attribute_value(gattdb_device_name, 0, room, &nameLen, p + 2) == SL_STATUS_OK
+      && nameLen > 0) {
+      *p++ = (uint8_t) nameLen + 1;
+      *p++ = AD_TYPE_SHORT_NAME;
+      p += nameLen;
+  }
+
+  return (uint8_t) (p - start);
+}
+
+/**
+ * @brief Sets the advertising data and starts advertising. Replaces the
+ *        sl_bt_legacy_advertiser_start() calls on boot and connection close.
+ */
+bool broadcastStart(uint8_t advertisingSet)
+{
+  sl_status_t rc;
+  uint8_t packet[3 + 2 + BROADCAST_PAYLOAD_SIZE];
+  uint8_t scanResponse[BROADCAST_SCAN_RESPONSE_MAX];
+  uint8_t len;
+
+  advHandle = advertisingSet;
+
+  // Active scanners find the server by its service in the scan response
+  len = broadcastBuildScanResponse(scanResponse);
+  rc = sl_bt_legacy_advertiser_set_data(advHandle, sl_bt_advertiser_scan_response_packet, len, scanResponse);
+  if (rc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_legacy_advertiser_set_data() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+  }
+
+  len = broadcastBuild(packet);
+  rc = sl_bt_legacy_advertiser_set_data(advHandle, sl_bt_advertiser_advertising_data_packet, len, packet);
+  if (rc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_legacy_advertiser_set_data() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+  }
+
+#if BROADCAST_ONLY
+  rc = sl_bt_legacy_advertiser_start(advHandle, sl_bt_legacy_advertiser_scannable);
+#else
+  rc = sl_bt_legacy_advertiser_start(advHandle, sl_bt_legacy_advertiser_connectable);
+#endif
+  if (rc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_legacy_advertiser_start() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+      return false;
+  }
+
+  active = true;
+  return true;
+}
+
+/**
+ * @brief Stops advertising, a client connected.
+ */
+void broadcastStop(void)
+{
+  sl_status_t rc;
+
+  active = false;
+  rc = sl_bt_advertiser_stop(advHandle);
+  if (rc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_advertiser_stop() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+  }
+}
+
+/**
+ * @brief Latest posture state, 0, 45 or 90.
+ */
+void broadcastSetPosture(uint8_t state)
+{
+  posture = state;
+}
+
+/**
+ * @brief Rewrites the advertising packet with the current readings. The
+ *        stack picks it up on the next advertising event, advertising
+ *        keeps running.
+ */
+void broadcastUpdate(void)
+{
+  sl_status_t rc;
+  uint8_t packet[3 + 2 + BROADCAST_PAYLOAD_SIZE];
+  uint8_t len;
+
+  if (!active || !BROADCAST_ENABLE) {
+      return;
+  }
+
+  sequence++;
+  len = broadcastBuild(packet);
+  rc = sl_bt_legacy_advertiser_set_data(advHandle, sl_bt_advertiser_advertising_data_packet, len, packet);
+  if (rc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_legacy_advertiser_set_data() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+  }
+}
+
+bool broadcastIsActive(void)
+{
+  return active;
+}
+
+/**
+ * @brief True if observers may be following the broadcast, i.e. the mode
+ *        is built in and the advertiser is running.
+ */
+bool broadcastWantsSamples(void)
+{
+  return BROADCAST_ENABLE && active;
+}
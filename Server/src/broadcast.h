@@ -0,0 +1,60 @@
+/***********************************************************************
+ * @file      broadcast.h
+ * @version   0.1
+ * @brief     Function header/interface file.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 7, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ */
+
+#ifndef SRC_BROADCAST_H_
+#define SRC_BROADCAST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 1: the advertising data carries the posture broadcast, and without a
+// connection the flex sensor is sampled for BROADCAST_SAMPLE_WINDOW_MS
+// after every wake-on-motion interrupt. 0: plain advertising, the sensor
+// is only sampled while a client is connected.
+#define BROADCAST_ENABLE         1
+#define BROADCAST_SAMPLE_WINDOW_MS  10000
+
+// 1: advertise scannable but not connectable, observers only see the
+// broadcast. 0: the broadcast rides on the connectable advertising and
+// stops while a client is connected.
+#define BROADCAST_ONLY           0
+
+#if BROADCAST_ONLY && !BROADCAST_ENABLE
+#error "BROADCAST_ONLY requires BROADCAST_ENABLE"
+#endif
+
+#define BROADCAST_COMPANY_ID     0xFFFF  // Bluetooth SIG id reserved for testing
+#define BROADCAST_FORMAT         0x01
+
+// Manufacturer specific data after the AD length and type, little endian:
+//   uint16 company id, uint8 format, uint8 sequence,
+//   int16 flex, int16 pitch, int16 roll (0.1 degree), uint8 posture (0/45/90)
+// The client decodes it in Client/src/broadcast_rx.c.
+#define BROADCAST_PAYLOAD_SIZE   11
+
+// Scan response: the flex sensor service UUID so clients can find any
+// server of the fleet by service, then as much of the device name as fits
+#define BROADCAST_SCAN_RESPONSE_MAX  31
+
+bool broadcastStart(uint8_t advertisingSet);
+void broadcastStop(void);
+void broadcastSetPosture(uint8_t posture);
+void broadcastUpdate(void);
+bool broadcastIsActive(void);
+bool broadcastWantsSamples(void);
+
+#endif /* SRC_BROADCAST_H_ */
@@ -0,0 +1,247 @@
+/***********************************************************************
+ * @file      conn_policy.c
+ * @version   0.1
+ * @brief     Activity driven connection parameters.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 6, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ * The link is kept in one of two profiles. A posture change or a button
+ * press asks for the fast profile, a periodic check asks for the idle
+ * profile once nothing has happened for CONN_POLICY_IDLE_AFTER_MS and no
+ * indication is waiting. Either request goes out at once unless the last
+ * switch is less than CONN_POLICY_MIN_SWITCH_MS old, then the periodic
+ * check sends it when that time is up. A wearer moving on and off a
+ * threshold therefore cannot keep the central renegotiating. Every
+ * connected central is kept in the same profile.
+ */
+
+#define INCLUDE_LOG_DEBUG     1
+#include "log.h"
+#include "src/conn_policy.h"
+#include "src/indication.h"
+#include "src/irq.h"
+#include "src/link.h"
+#include "sl_bt_api.h"
+
+static conn_policy_link_t links[LINK_MAX_CONNECTIONS];
+static conn_profile_t profile = CONN_PROFILE_NONE;
+static conn_profile_t wanted = CONN_PROFILE_NONE;
+static uint32_t       lastActivity;
+static uint32_t       lastSwitch;
+static conn_policy_stats_t stats;
+
+/**
+ * @brief Entry of an open connection, NULL if the handle is unknown.
+ */
+static conn_policy_link_t* connPolicyFind(uint8_t connection)
+{
+  uint8_t i;
+
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      if (links[i].open && (links[i].connection == connection)) {
+          return &links[i];
+      }
+  }
+
+  return NULL;
+}
+
+static bool connPolicyAnyOpen(void)
+{
+  uint8_t i;
+
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      if (links[i].open) {
+          return true;
+      }
+  }
+
+  return false;
+}
+
+/**
+ * @brief Requests the parameters of a profile from one central. The
+ *        central has the final say, the values it applies are reported in
+ *        sl_bt_evt_connection_parameters_id.
+ */
+static bool connPolicyRequest(uint8_t connection, conn_profile_t next)
+{
+  sl_status_t rc;
+
+  if (next == CONN_PROFILE_FAST) {
+      rc = sl_bt_connection_set_parameters(connection, CONN_FAST_INTERVAL, CONN_FAST_INTERVAL,
+                                           CONN_FAST_LATENCY, CONN_FAST_TIMEOUT, 0, 0xffff);
+  } else {
+      rc = sl_bt_connection_set_parameters(connection, CONN_IDLE_INTERVAL, CONN_IDLE_INTERVAL,
+                                           CONN_IDLE_LATENCY, CONN_IDLE_TIMEOUT, 0, 0xffff);
+  }
+
+  if (rc != SL_STATUS_OK) {
+      stats.request_errors++;
+      LOG_ERROR("sl_bt_connection_set_parameters() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+      return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Moves every open connection to the profile, all centrals follow
+ *        the same wearer so they share it.
+ */
+static void connPolicyApply(conn_profile_t next)
+{
+  uint8_t i;
+
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      if (links[i].open) {
+          connPolicyRequest(links[i].connection, next);
+      }
+  }
+
+  if (next == CONN_PROFILE_FAST) {
+      stats.to_fast++;
+  } else {
+      stats.to_idle++;
+  }
+
+  profile = next;
+  lastSwitch = letimerMilliseconds();
+}
+
+/**
+ * @brief Switches to the wanted profile unless the last switch was too
+ *        recent, the periodic check retries a held back switch.
+ */
+static void connPolicyUpdate(void)
+{
+  if (!connPolicyAnyOpen() || (wanted == profile)) {
+      return;
+  }
+
+  if ((letimerMilliseconds() - lastSwitch) < CONN_POLICY_MIN_SWITCH_MS) {
+      stats.rate_limited++;
+      return;
+  }
+
+  connPolicyApply(wanted);
+}
+
+/**
+ * @brief Call on sl_bt_evt_connection_opened_id. Discovery and bonding
+ *        run in the fast profile, so the whole link set goes fast when a
+ *        central joins. The periodic idle check runs while any is open.
+ */
+void connPolicyOnOpened(uint8_t connection)
+{
+  uint8_t i;
+
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      if (!links[i].open) {
+          links[i].open = true;
+          links[i].connection = connection;
+          links[i].interval = 0;
+          links[i].latency = 0;
+          break;
+      }
+  }
+
+  wanted = CONN_PROFILE_FAST;
+  lastActivity = letimerMilliseconds();
+
+  if (profile == CONN_PROFILE_FAST) {
+      // The others are fast already, only the new one needs the request
+      connPolicyRequest(connection, CONN_PROFILE_FAST);
+  } else {
+      connPolicyApply(CONN_PROFILE_FAST);
+  }
+
+  sl_bt_system_set_lazy_soft_timer((CONN_POLICY_CHECK_MS * 32768) / 1000, 0, TIMER_HANDLE_CONN_POLICY, 0);
+}
+
+void connPolicyOnClosed(uint8_t connection)
+{
+  conn_policy_link_t *link = connPolicyFind(connection);
+
+  if (link != NULL) {
+      link->open = false;
+  }
+
+  if (!connPolicyAnyOpen()) {
+      profile = CONN_PROFILE_NONE;
+      wanted = CONN_PROFILE_NONE;
+      sl_bt_system_set_lazy_soft_timer(0, 0, TIMER_HANDLE_CONN_POLICY, 0); // stop the idle check
+  }
+}
+
+/**
+ * @brief Call on sl_bt_evt_connection_parameters_id, records what the
+ *        central of that connection applied.
+ */
+void connPolicyOnParameters(uint8_t connection, uint16_t interval, uint16_t latency)
+{
+  conn_policy_link_t *link = connPolicyFind(connection);
+
+  if (link != NULL) {
+      link->interval = interval;
+      link->latency = latency;
+  }
+}
+
+/**
+ * @brief Scheduler handler for CONN_POLICY_ACTIVITY_EVENTS, asks for the
+ *        fast profile subject to CONN_POLICY_MIN_SWITCH_MS.
+ */
+void connPolicyActivityHandler(Events_t evt)
+{
+  if ((evt & CONN_POLICY_ACTIVITY_EVENTS) == 0) {
+      return;
+  }
+
+  lastActivity = letimerMilliseconds();
+  wanted = CONN_PROFILE_FAST;
+  connPolicyUpdate();
+}
+
+/**
+ * @brief Call on the TIMER_HANDLE_CONN_POLICY soft timer.
+ */
+void connPolicyOnTimer(void)
+{
+  // Pending indications need the short interval to drain
+  if (indicationInFlight()) {
+      lastActivity = letimerMilliseconds();
+      wanted = CONN_PROFILE_FAST;
+  } else if ((letimerMilliseconds() - lastActivity) >= CONN_POLICY_IDLE_AFTER_MS) {
+      wanted = CONN_PROFILE_IDLE;
+  }
+
+  connPolicyUpdate();
+}
+
+conn_profile_t connPolicyGetProfile(void)
+{
+  return profile;
+}
+
+/**
+ * @brief Parameters the central last applied to a connection, NULL if the
+ *        handle is not open.
+ */
+const conn_policy_link_t* connPolicyGetLink(uint8_t connection)
+{
+  return connPolicyFind(connection);
+}
+
+const conn_policy_stats_t* connPolicyGetStats(void)
+{
+  return &stats;
+}
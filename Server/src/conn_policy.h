@@ -0,0 +1,75 @@
+/***********************************************************************
+ * @file      conn_policy.h
+ * @version   0.1
+ * @brief     Function header/interface file.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 6, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ */
+
+#ifndef SRC_CONN_POLICY_H_
+#define SRC_CONN_POLICY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "src/scheduler.h"
+
+// Fast profile, posture is changing or data is waiting to go out
+#define CONN_FAST_INTERVAL          12    // 12 * 1.25 = 15ms
+#define CONN_FAST_LATENCY           0
+#define CONN_FAST_TIMEOUT           100   // 100 * 10 = 1s
+
+// Idle profile, the wearer is still. Effective wake up is every
+// (1 + latency) * interval = 1.5s, the timeout has to exceed twice that.
+#define CONN_IDLE_INTERVAL          120   // 120 * 1.25 = 150ms
+#define CONN_IDLE_LATENCY           9
+#define CONN_IDLE_TIMEOUT           400   // 400 * 10 = 4s
+
+#define CONN_POLICY_IDLE_AFTER_MS   5000  // quiet time before dropping to idle
+#define CONN_POLICY_MIN_SWITCH_MS   2000  // minimum time between two requests
+#define TIMER_HANDLE_CONN_POLICY    0x03  // periodic idle check
+#define CONN_POLICY_CHECK_MS        1000
+
+// Scheduler events that count as wearer activity. Only debounced posture
+// changes and the button: the flex angle, tilt and wake-on-motion events
+// fire on every small movement and would keep the link fast for good.
+#define CONN_POLICY_ACTIVITY_EVENTS (EVENT_PB0 | EVENT_0DEGREE | EVENT_45DEGREE | EVENT_90DEGREE)
+
+typedef enum {
+  CONN_PROFILE_NONE,
+  CONN_PROFILE_FAST,
+  CONN_PROFILE_IDLE
+} conn_profile_t;
+
+typedef struct {
+  uint32_t to_fast;         // fast profile requests
+  uint32_t to_idle;         // idle profile requests
+  uint32_t rate_limited;    // switches held back by CONN_POLICY_MIN_SWITCH_MS
+  uint32_t request_errors;  // sl_bt_connection_set_parameters() failures
+} conn_policy_stats_t;
+
+typedef struct {
+  bool     open;
+  uint8_t  connection;      // stack connection handle
+  uint16_t interval;        // interval the central last applied, 1.25ms units
+  uint16_t latency;         // latency the central last applied
+} conn_policy_link_t;
+
+void connPolicyOnOpened(uint8_t connection);
+void connPolicyOnClosed(uint8_t connection);
+void connPolicyOnParameters(uint8_t connection, uint16_t interval, uint16_t latency);
+void connPolicyActivityHandler(Events_t evt);
+void connPolicyOnTimer(void);
+conn_profile_t connPolicyGetProfile(void);
+const conn_policy_link_t* connPolicyGetLink(uint8_t connection);
+const conn_policy_stats_t* connPolicyGetStats(void);
+
+#endif /* SRC_CONN_POLICY_H_ */
@@ -0,0 +1,192 @@
+/***********************************************************************
+ * @file      flex_angle.c
+ * @version   0.1
+ * @brief     Calibrated flex sensor voltage to angle conversion.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      April 26, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources CMSIS-DSP interpolation functions
+ *
+ * The calibration points describe a piecewise linear mV -> angle curve. It
+ * is resampled into a uniform Q15 table whenever the calibration changes, so
+ * the per sample conversion is one multiply and arm_linear_interp_q15(), no
+ * search and no division.
+ */
+
+#define INCLUDE_LOG_DEBUG     1
+#include "log.h"
+#include "src/flex_angle.h"
+#include "arm_math.h"
+
+#define FLEX_LUT_FRAC_BITS  20  // arm_linear_interp_q15() takes a 12.20 table index
+
+// Defaults sit in the middle of the 0/45/90 degree buckets of flex_filter.h
+static const flex_cal_point_t defaultPoints[] = {
+  { 1325,   0, true },
+  { 1475, 450, true },
+  { 1625, 900, true },
+};
+
+static flex_cal_point_t calPoints[FLEX_CAL_MAX_POINTS];
+static q15_t    lut[FLEX_LUT_SIZE];
+static uint32_t lutMinMv;
+static uint32_t lutMaxMv;
+static uint32_t lutScale;   // table index per mV, Q20
+
+/**
+ * @brief Angle of the calibration curve at a table node, only used to build
+ *        the table.
+ *
+ * The voltage is given in 1/(FLEX_LUT_SIZE-1) mV steps, so nodes that fall
+ * between two whole millivolts are evaluated where they really are.
+ *
+ * @param sorted   Valid calibration points, ascending mV.
+ * @param count    Number of points, at least 2.
+ * @param mvScaled Voltage times (FLEX_LUT_SIZE-1).
+ */
+static int32_t calCurveAt(const flex_cal_point_t *sorted, uint8_t count, uint32_t mvScaled)
+{
+  uint8_t i;
+
+  for (i = 1; i < count - 1; i++) {
+      if (mvScaled <= (uint32_t) sorted[i].mv * (FLEX_LUT_SIZE - 1)) {
+          break;
+      }
+  }
+
+  // Points i-1 and i bound the segment, the end segments are extrapolated
+  int64_t dMv  = ((int64_t) sorted[i].mv - sorted[i - 1].mv) * (FLEX_LUT_SIZE - 1);
+  int64_t dDeg = (int64_t) sorted[i].deciDeg - sorted[i - 1].deciDeg;
+  int64_t num  = ((int64_t) mvScaled - (int64_t) sorted[i - 1].mv * (FLEX_LUT_SIZE - 1)) * dDeg;
+
+  // Round to the nearest 0.1 degree
+  return sorted[i - 1].deciDeg + (int32_t) ((num + (num < 0 ? -dMv : dMv) / 2) / dMv);
+}
+
+/**
+ * @brief Rebuilds the uniform table from the valid calibration points.
+ *
+ * @return false if fewer than 2 valid points or two points share a voltage,
+ *         the previous table is kept in that case.
+ */
+static bool lutBuild(void)
+{
+  flex_cal_point_t sorted[FLEX_CAL_MAX_POINTS];
+  flex_cal_point_t point;
+  uint8_t count = 0;
+  uint8_t i, j;
+
+  // Insertion sort the valid points by voltage
+  for (i = 0; i < FLEX_CAL_MAX_POINTS; i++) {
+      if (!calPoints[i].valid) {
+          continue;
+      }
+      point = calPoints[i];
+      for (j = count; (j > 0) && (sorted[j - 1].mv > point.mv); j--) {
+          sorted[j] = sorted[j - 1];
+      }
+      sorted[j] = point;
+      count++;
+  }
+
+  if (count < 2) {
+      return false;
+  }
+  for (i = 1; i < count; i++) {
+      if (sorted[i].mv == sorted[i - 1].mv) {
+          return false;
+      }
+  }
+
+  lutMinMv = sorted[0].mv;
+  lutMaxMv = sorted[count - 1].mv;
+  lutScale = ((uint32_t) (FLEX_LUT_SIZE - 1) << FLEX_LUT_FRAC_BITS) / (lutMaxMv - lutMinMv);
+
+  for (i = 0; i < FLEX_LUT_SIZE; i++) {
+      uint32_t mvScaled = lutMinMv * (FLEX_LUT_SIZE - 1) + (lutMaxMv - lutMinMv) * i;
+      lut[i] = (q15_t) __SSAT(calCurveAt(sorted, count, mvScaled), 16);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Loads the default calibration.
+ */
+void flexAngleResetCalibration(void)
+{
+  uint8_t i;
+
+  for (i = 0; i < FLEX_CAL_MAX_POINTS; i++) {
+      if (i < sizeof(defaultPoints) / sizeof(defaultPoints[0])) {
+          calPoints[i] = defaultPoints[i];
+      } else {
+          calPoints[i].valid = false;
+      }
+  }
+
+  lutBuild();
+}
+
+void flexAngleInit(void)
+{
+  flexAngleResetCalibration();
+}
+
+/**
+ * @brief Stores one calibration point and rebuilds the table.
+ *
+ * @param index   Calibration point, 0 to FLEX_CAL_MAX_POINTS-1.
+ * @param mv      Sensor voltage measured at the reference angle.
+ * @param deciDeg Reference angle in 0.1 degree steps.
+ * @return true if the table was rebuilt. On false the point is not stored,
+ *         the previous calibration and table stay in use.
+ */
+bool flexAngleSetCalPoint(uint8_t index, uint16_t mv, int16_t deciDeg)
+{
+  flex_cal_point_t previous;
+
+  if (index >= FLEX_CAL_MAX_POINTS) {
+      LOG_ERROR("Invalid calibration point %d\n\r", index);
+      return false;
+  }
+
+  previous = calPoints[index];
+  calPoints[index].mv = mv;
+  calPoints[index].deciDeg = deciDeg;
+  calPoints[index].valid = true;
+
+  if (!lutBuild()) {
+      // e.g. the voltage of another point, keep the last good calibration
+      calPoints[index] = previous;
+      return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Converts a flex sensor voltage to a calibrated angle.
+ *
+ * Inputs outside the calibrated range are clamped to the end points.
+ *
+ * @param mv Flex sensor voltage in mV.
+ * @return Angle in 0.1 degree steps.
+ */
+int16_t flexAngleFromMv(uint32_t mv)
+{
+  if (mv <= lutMinMv) {
+      return lut[0];
+  }
+  if (mv >= lutMaxMv) {
+      return lut[FLEX_LUT_SIZE - 1];
+  }
+
+  return arm_linear_interp_q15(lut, (q31_t) ((mv - lutMinMv) * lutScale), FLEX_LUT_SIZE);
+}
@@ -0,0 +1,40 @@
+/***********************************************************************
+ * @file      flex_angle.h
+ * @version   0.1
+ * @brief     Function header/interface file.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      April 26, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources CMSIS-DSP interpolation functions
+ *
+ */
+
+#ifndef SRC_FLEX_ANGLE_H_
+#define SRC_FLEX_ANGLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FLEX_CAL_MAX_POINTS      5    // calibration points the client can set
+#define FLEX_LUT_SIZE            33   // uniform table entries, 32 segments
+#define FLEX_CAL_RESET           0xFF // calibration write that restores the defaults
+#define FLEX_ANGLE_REPORT_DELTA  10   // 1 degree, smaller changes are not published
+
+typedef struct {
+  uint16_t mv;        // flex sensor voltage in mV
+  int16_t  deciDeg;   // angle in 0.1 degree steps
+  bool     valid;
+} flex_cal_point_t;
+
+void flexAngleInit(void);
+void flexAngleResetCalibration(void);
+bool flexAngleSetCalPoint(uint8_t index, uint16_t mv, int16_t deciDeg);
+int16_t flexAngleFromMv(uint32_t mv);
+
+#endif /* SRC_FLEX_ANGLE_H_ */
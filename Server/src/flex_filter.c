@@ -0,0 +1,190 @@
+/***********************************************************************
+ * @file      flex_filter.c
+ * @version   0.1
+ * @brief     Streaming fixed-point filter and hysteresis classifier for the
+ *            flex sensor.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      April 24, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ * Each sample goes through a moving median, which removes single sample
+ * spikes, then a first order IIR low pass kept in Q4. The filtered value is
+ * bucketed with a dead band around each threshold and a change is only
+ * reported once the new bucket has been seen FLEX_DEBOUNCE_SAMPLES times
+ * in a row.
+ */
+
+#include "src/flex_filter.h"
+#include <string.h>
+
+#define FLEX_IIR_FRAC_BITS  4
+#define FLEX_NUM_LEVELS     4   // 3 angle buckets plus the out of range level above 90 deg
+#define FLEX_LEVEL_NONE     0xFF
+
+static const uint16_t thresholds[FLEX_NUM_LEVELS - 1] = {
+  FLEX_THRESHOLD_0_MV, FLEX_THRESHOLD_45_MV, FLEX_THRESHOLD_90_MV
+};
+
+// Above the 90 deg threshold the sensor reading is out of range, it is
+// reported as 0 deg like the original classifier did.
+static const flex_angle_t levelToAngle[FLEX_NUM_LEVELS] = {
+  FLEX_ANGLE_0, FLEX_ANGLE_45, FLEX_ANGLE_90, FLEX_ANGLE_0
+};
+
+static uint16_t medianWindow[FLEX_MEDIAN_LEN];
+static uint8_t  medianIndex;
+static uint8_t  medianCount;
+static uint32_t iirState;         // filter output in mV, Q4
+static bool     iirPrimed;
+static uint8_t  confirmedLevel;
+static uint8_t  candidateLevel;
+static uint8_t  candidateCount;
+static flex_filter_stats_t stats;
+
+/**
+ * @brief Resets the filter state, once at power up from initADC(). The next
+ *        confirmed level is always reported.
+ */
+void flexFilterInit(void)
+{
+  memset(medianWindow, 0, sizeof(medianWindow));
+  medianIndex = 0;
+  medianCount = 0;
+  iirState = 0;
+  iirPrimed = false;
+  confirmedLevel = FLEX_LEVEL_NONE;
+  candidateLevel = FLEX_LEVEL_NONE;
+  candidateCount = 0;
+  memset(&stats, 0, sizeof(stats));
+}
+
+/**
+ * @brief Median of the samples currently in the window.
+ */
+static uint16_t medianGet(void)
+{
+  uint16_t sorted[FLEX_MEDIAN_LEN];
+  uint16_t value;
+  uint8_t  i, j;
+
+  // Insertion sort, the window is only a handful of samples
+  for (i = 0; i < medianCount; i++) {
+      value = medianWindow[i];
+      for (j = i; (j > 0) && (sorted[j - 1] > value); j--) {
+          sorted[j] = sorted[j - 1];
+      }
+      sorted[j] = value;
+  }
+
+  return sorted[medianCount / 2];
+}
+
+/**
+ * @brief Maps a filtered value to a level, moving a threshold away from the
+ *        current level by FLEX_HYSTERESIS_MV so that noise around a boundary
+ *        does not flip the result.
+ */
+static uint8_t levelGet(uint32_t mv)
+{
+  uint8_t  level;
+  uint32_t threshold;
+
+  for (level = 0; level < FLEX_NUM_LEVELS - 1; level++) {
+      threshold = thresholds[level];
+      if (confirmedLevel != FLEX_LEVEL_NONE) {
+          if (confirmedLevel <= level) {
+              threshold += FLEX_HYSTERESIS_MV;  // leaving upwards
+          } else {
+              threshold -= FLEX_HYSTERESIS_MV;  // leaving downwards
+          }
+      }
+      if (mv <= threshold) {
+          break;
+      }
+  }
+
+  return level;
+}
+
+/**
+ * @brief Feeds one sample through the filter.
+ *
+ * @param mv    Raw flex sensor voltage in millivolts.
+ * @param angle Set to the new angle when a change is confirmed.
+ * @return true if the angle changed and an event should be emitted.
+ */
+bool flexFilterUpdate(uint32_t mv, flex_angle_t *angle)
+{
+  uint8_t level;
+  bool    changed = false;
+
+  stats.samples++;
+
+  medianWindow[medianIndex] = (uint16_t) mv;
+  medianIndex = (medianIndex + 1) % FLEX_MEDIAN_LEN;
+  if (medianCount < FLEX_MEDIAN_LEN) {
+      medianCount++;
+  }
+
+  if (!iirPrimed) {
+      iirState = (uint32_t) medianGet() << FLEX_IIR_FRAC_BITS;
+      iirPrimed = true;
+  } else {
+      int32_t delta = ((int32_t) medianGet() << FLEX_IIR_FRAC_BITS) - (int32_t) iirState;
+      iirState = (uint32_t) ((int32_t) iirState + (delta >> FLEX_IIR_SHIFT));
+  }
+
+  level = levelGet(flexFilterGetOutput());
+
+  if (level == confirmedLevel) {
+      if (candidateCount != 0) {
+          stats.rejected++;
+      }
+      candidateCount = 0;
+      return false;
+  }
+
+  if (level != candidateLevel) {
+      if (candidateCount != 0) {
+          stats.rejected++;
+      }
+      candidateLevel = level;
+      candidateCount = 0;
+  }
+
+  if (++candidateCount >= FLEX_DEBOUNCE_SAMPLES) {
+      // Levels 0 and 3 both read as 0 deg, only report a real angle change
+      changed = (confirmedLevel == FLEX_LEVEL_NONE) ||
+                (levelToAngle[level] != levelToAngle[confirmedLevel]);
+      confirmedLevel = level;
+      candidateCount = 0;
+      if (changed) {
+          stats.transitions++;
+          if (angle != NULL) {
+              *angle = levelToAngle[level];
+          }
+      }
+  }
+
+  return changed;
+}
+
+/**
+ * @brief Filtered flex sensor voltage in millivolts.
+ */
+uint32_t flexFilterGetOutput(void)
+{
+  return (iirState + (1 << (FLEX_IIR_FRAC_BITS - 1))) >> FLEX_IIR_FRAC_BITS;
+}
+
+const flex_filter_stats_t* flexFilterGetStats(void)
+{
+  return &stats;
+}
@@ -0,0 +1,53 @@
+/***********************************************************************
+ * @file      flex_filter.h
+ * @version   0.1
+ * @brief     Function header/interface file.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      April 24, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ */
+
+#ifndef SRC_FLEX_FILTER_H_
+#define SRC_FLEX_FILTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FLEX_MEDIAN_LEN         5    // moving median window, odd
+#define FLEX_IIR_SHIFT          2    // y += (x - y) / 2^FLEX_IIR_SHIFT
+#define FLEX_IIR_SETTLE_SAMPLES 9    // samples for the IIR to close 90% of a step, (3/4)^9 = 0.075
+#define FLEX_HYSTERESIS_MV      30   // half width of the dead band around each threshold
+#define FLEX_DEBOUNCE_SAMPLES   4    // consecutive filtered samples needed to confirm a change
+
+// Bucket thresholds in mV, a sample <= threshold belongs to the bucket
+#define FLEX_THRESHOLD_0_MV    1400
+#define FLEX_THRESHOLD_45_MV   1550
+#define FLEX_THRESHOLD_90_MV   1700
+
+typedef enum {
+  FLEX_ANGLE_0,
+  FLEX_ANGLE_45,
+  FLEX_ANGLE_90,
+  FLEX_ANGLE_NONE
+} flex_angle_t;
+
+typedef struct {
+  uint32_t samples;      // samples fed to the filter
+  uint32_t transitions;  // confirmed angle changes, i.e. events emitted
+  uint32_t rejected;     // candidate changes dropped by the debounce
+} flex_filter_stats_t;
+
+void flexFilterInit(void);
+bool flexFilterUpdate(uint32_t mv, flex_angle_t *angle);
+uint32_t flexFilterGetOutput(void);
+const flex_filter_stats_t* flexFilterGetStats(void);
+
+#endif /* SRC_FLEX_FILTER_H_ */
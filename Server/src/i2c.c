@@ -20,7 +20,10 @@
 #include "sl_i2cspm.h"
 #include "em_i2c.h"
 #include <stdint.h>
+#include <string.h>
 #include "scheduler.h"
+#include "sl_power_manager.h"
+#include "em_core.h"
 
 #define ICM20948_ADDR 0x69         // Replace if AD0 = HIGH
 #define ICM20948_WHO_AM_I_REG 0x00 // Example register to read
@@ -45,143 +48,378 @@ void initI2C(void)
         .i2cMaxFreq = I2C_FREQ_STANDARD_MAX,
         .i2cClhr = i2cClockHLRStandard};
     I2CSPM_Init(&I2C_Config);
+
+    // Transfers are driven from I2C0_IRQHandler, see i2cQueueTransfer()
+    NVIC_ClearPendingIRQ(I2C0_IRQn);
+    NVIC_EnableIRQ(I2C0_IRQn);
 }
 
+static i2c_transaction_t i2cQueue[I2C_ASYNC_QUEUE_SIZE];
+// Entries [doneIdx, activeIdx) are finished and wait for their callback in
+// the main loop, [activeIdx, writeIdx) are queued or on the bus.
+static volatile uint8_t doneIdx = 0;
+static volatile uint8_t activeIdx = 0;
+static volatile uint8_t writeIdx = 0;
+static volatile bool busBusy = false;
+static I2C_TransferSeq_TypeDef activeSeq;
+
 /**
- * @brief Perform an I2C data transfer (read or write).
- * @param dataBuffer Pointer to the data buffer
- * @param transferMode I2C_FLAG_WRITE or I2C_FLAG_READ
- * @param dataLength Number of bytes to transfer
- * @return Transfer status (0 = success, 1 = failure)
-//  */
-uint8_t transferI2C(uint8_t *dataBuffer, uint8_t transferMode, uint8_t dataLength)
+ * @brief Start the transaction at activeIdx. Called with interrupts masked.
+ */
+static void i2cStartActive(void)
 {
-
-    // Copied from lecture slides
-    I2C_TransferReturn_TypeDef transferStatus; // make this global for IRQs in A4
-    I2C_TransferSeq_TypeDef transferSequence;  // this one can be local
-
-    transferSequence.addr = ICM20948_ADDR << 1; // shift device address left
-    transferSequence.flags = transferMode;
-    transferSequence.buf[0].data = dataBuffer; // pointer to data to write
-    transferSequence.buf[0].len = dataLength;
-
-    transferStatus = I2CSPM_Transfer(I2C0, &transferSequence);
-    if (transferStatus != i2cTransferDone)
+    i2c_transaction_t *t = &i2cQueue[activeIdx];
+    I2C_TransferReturn_TypeDef status;
+
+    activeSeq.addr = ICM20948_ADDR << 1;
+    activeSeq.flags = t->flags;
+    activeSeq.buf[0].data = t->writeData;
+    activeSeq.buf[0].len = t->writeLen;
+    activeSeq.buf[1].data = t->readData;
+    activeSeq.buf[1].len = t->readLen;
+
+    status = I2C_TransferInit(I2C0, &activeSeq);
+    if (status != i2cTransferInProgress)
     {
-        LOG_ERROR("I2CSPM_Transfer: I2C bus write of cmd=0x%02X with status code: %d", dataBuffer[0], transferStatus);
-        return 1;
+        // Failed to start, complete it right away so the queue keeps moving
+        t->status = status;
+        activeIdx = (activeIdx + 1) % I2C_ASYNC_QUEUE_SIZE;
+        schedulerSetEventI2CDone();
+        if (activeIdx != writeIdx)
+        {
+            i2cStartActive();
+        }
+        else
+        {
+            busBusy = false;
+            sl_power_manager_remove_em_requirement(SL_POWER_MANAGER_EM1);
+        }
     }
-    return 0;
 }
 
-uint8_t readRegister(uint8_t regAddr)
+/**
+ * @brief Queue an I2C transaction with the ICM-20948.
+ *        Can be called from ISRs. The core stays in EM1 while the queue is
+ *        busy, the completion callback runs from the main loop.
+ * @param flags I2C_FLAG_WRITE, I2C_FLAG_READ or I2C_FLAG_WRITE_READ
+ * @param writeData Bytes to write, copied into the queue
+ * @param writeLen Number of bytes to write, up to I2C_ASYNC_WRITE_MAX
+ * @param readData Destination of the read, must stay valid until the callback
+ * @param readLen Number of bytes to read
+ * @param callback Completion callback, may be NULL
+ * @param userParam Passed to the callback
+ * @return true if queued, false if the queue is full
+ */
+bool i2cQueueTransfer(uint16_t flags, const uint8_t *writeData, uint8_t writeLen,
+                      uint8_t *readData, uint8_t readLen,
+                      i2c_callback_t callback, void *userParam)
 {
-    uint8_t data;
-    I2C_TransferSeq_TypeDef transfer;
-    I2C_TransferReturn_TypeDef result;
+    i2c_transaction_t *t;
+    uint8_t next;
 
-    transfer.addr = ICM20948_ADDR << 1;
-    transfer.flags = I2C_FLAG_WRITE_READ;
+    if (writeLen > I2C_ASYNC_WRITE_MAX)
+    {
+        LOG_ERROR("i2cQueueTransfer: write of %d bytes too long", writeLen);
+        return false;
+    }
 
-    transfer.buf[0].data = &regAddr;
-    transfer.buf[0].len = 1;
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
 
-    transfer.buf[1].data = &data;
-    transfer.buf[1].len = 1;
+    next = (writeIdx + 1) % I2C_ASYNC_QUEUE_SIZE;
+    if (next == doneIdx)
+    {
+        CORE_EXIT_CRITICAL();
+        LOG_ERROR("i2cQueueTransfer: queue full");
+        return false;
+    }
 
-    result = I2CSPM_Transfer(I2C0, &transfer);
-    if (result != i2cTransferDone)
+    t = &i2cQueue[writeIdx];
+    t->flags = flags;
+    memcpy(t->writeData, writeData, writeLen);
+    t->writeLen = writeLen;
+    t->readData = readData;
+    t->readLen = readLen;
+    t->callback = callback;
+    t->userParam = userParam;
+    t->status = i2cTransferInProgress;
+    writeIdx = next;
+
+    if (!busBusy)
     {
-        LOG_ERROR("Read failed for reg 0x%02X, error %d", regAddr, result);
-        return 0xFF;
+        busBusy = true;
+        // Keep HF clocks running for the I2C while the queue drains
+        sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM1);
+        i2cStartActive();
     }
 
-    return data;
+    CORE_EXIT_CRITICAL();
+
+    return true;
 }
 
-void reg_bank_sel(uint8_t bank)
+/**
+ * @brief Queue a register write.
+ */
+bool i2cWriteRegAsync(uint8_t regAddr, uint8_t value)
 {
-    uint8_t writeData[4];
-    writeData[0] = 0x7F;      // Bank select register
-    writeData[1] = bank << 4; // Bank number shifted into bits [5:4]
-    transferI2C(writeData, I2C_FLAG_WRITE, 2);
+    uint8_t writeData[2] = {regAddr, value};
+
+    return i2cQueueTransfer(I2C_FLAG_WRITE, writeData, 2, NULL, 0, NULL, NULL);
 }
 
-void enable_interrupt(void)
+/**
+ * @brief Queue a register read as one write-read transaction.
+ */
+bool i2cReadRegsAsync(uint8_t regAddr, uint8_t *data, uint8_t len,
+                      i2c_callback_t callback, void *userParam)
 {
-    reg_bank_sel(0);
-    // Example: Enable Wake-on-Motion interrupt
-    uint8_t int_enable[2] = {0x10, 0x08}; // 0x08 = 0b00001000 (WOM_INT_EN)
-    transferI2C(int_enable, I2C_FLAG_WRITE, 2);
+    return i2cQueueTransfer(I2C_FLAG_WRITE_READ, &regAddr, 1, data, len, callback, userParam);
 }
 
-void select_WOM_algorithm(void)
+/**
+ * @brief I2C0 interrupt, advances the active transaction and starts the next
+ *        one back to back when it finishes.
+ */
+void I2C0_IRQHandler(void)
 {
-    reg_bank_sel(2);
-    // Example: Enable Wake-on-Motion interrupt
-    uint8_t wom_algo[2] = {0x12, 0x01}; // 0x08 = 0b00001000 (WOM_INT_EN)
-    transferI2C(wom_algo, I2C_FLAG_WRITE, 2);
+    I2C_TransferReturn_TypeDef status;
+
+    status = I2C_Transfer(I2C0);
+    if (status == i2cTransferInProgress)
+    {
+        return;
+    }
+
+    i2cQueue[activeIdx].status = status;
+    activeIdx = (activeIdx + 1) % I2C_ASYNC_QUEUE_SIZE;
+    schedulerSetEventI2CDone();
+
+    if (activeIdx != writeIdx)
+    {
+        i2cStartActive();
+    }
+    else
+    {
+        busBusy = false;
+        sl_power_manager_remove_em_requirement(SL_POWER_MANAGER_EM1);
+    }
 }
 
-void WOM_Threshold(void)
+/**
+ * @brief Scheduler handler for EVENT_I2CTransfer_Done, runs the callbacks of
+ *        finished transactions in the main loop.
+ */
+void i2cAsyncHandler(Events_t evt)
 {
-    reg_bank_sel(2);
-    uint8_t wom_thr[2] = {0x13, 0x14};
-    transferI2C(wom_thr, I2C_FLAG_WRITE, 2); // while Bank 2 is selected
+    i2c_transaction_t *t;
+
+    if (evt != EVENT_I2CTransfer_Done)
+    {
+        return;
+    }
+
+    while (doneIdx != activeIdx)
+    {
+        t = &i2cQueue[doneIdx];
+        if (t->status != i2cTransferDone)
+        {
+            LOG_ERROR("I2C transfer of reg 0x%02X failed with status %d", t->writeData[0], t->status);
+        }
+        if (t->callback != NULL)
+        {
+            t->callback(t->status, t->userParam);
+        }
+        doneIdx = (doneIdx + 1) % I2C_ASYNC_QUEUE_SIZE;
+    }
 }
 
-void LP_Config(void)
+/**
+ * @brief Returns true when no transaction is queued or on the bus.
+ */
+bool i2cAsyncIdle(void)
 {
-    reg_bank_sel(0);
-    uint8_t ip_config[2] = {0x05, 0x00};
-    transferI2C(ip_config, I2C_FLAG_WRITE, 2); // while Bank 2 is selected
+    return !busBusy;
 }
 
-void accel_intel_config(void)
+static uint8_t currentBank = ICM20948_BANK_UNKNOWN; // bank the queued writes leave selected
+
+// Boot configuration: wake the device, set up wake-on-motion in bank 2 and
+// enable the interrupt last. Kept grouped by bank and in ascending register
+// order so icm20948ApplyTable() needs 3 bank switches and 3 burst writes.
+static const icm20948_reg_t accelInitTable[] = {
+    {0, 0x05, 0x00, 0x00}, // LP_CONFIG
+    {0, 0x06, 0x29, 0x7F}, // PWR_MGMT_1, DEVICE_RESET self clears
+    {0, 0x07, 0x07, 0xFF}, // PWR_MGMT_2 = 0b00000111, gyro off
+    {2, 0x12, 0x03, 0x03}, // ACCEL_INTEL_CTRL → Enable WOM + mode = compare to previous
+    {2, 0x13, 0x14, 0xFF}, // ACCEL_WOM_THR
+    {0, 0x0F, 0x00, 0x00}, // INT_PIN_CFG
+    {0, 0x10, 0x08, 0x08}, // INT_ENABLE = 0b00001000 (WOM_INT_EN)
+};
+
+// One slot per read back on the bus. Slots are taken when a table is
+// queued and given back by verify_done(), so tables queued back to back,
+// e.g. set_acc_sensor() then accelFifoStart(), do not share a slot.
+typedef struct
+{
+    const icm20948_reg_t *entry; // NULL while the slot is free
+    uint8_t readBack;
+} icm20948_verify_t;
+
+static icm20948_verify_t verifySlots[ICM20948_MAX_VERIFY];
+static uint8_t verifyErrors;
+
+/**
+ * @brief Select a register bank, skipped if the queue already leaves the
+ *        bank selected.
+ */
+void reg_bank_sel(uint8_t bank)
 {
-    reg_bank_sel(2);
-    uint8_t accel_intel_ctrl[2] = {0x12, 0x03}; // 0b00000011 → Enable WOM + mode = compare to previous
-    transferI2C(accel_intel_ctrl, I2C_FLAG_WRITE, 2);
+    if (bank == currentBank)
+    {
+        return;
+    }
+    // Bank number shifted into bits [5:4] of the bank select register
+    if (i2cWriteRegAsync(0x7F, bank << 4))
+    {
+        currentBank = bank;
+    }
+    else
+    {
+        currentBank = ICM20948_BANK_UNKNOWN;
+    }
 }
 
-void int_pin_config(void)
+/**
+ * @brief Forget the cached bank, e.g. after a device reset.
+ */
+void icm20948InvalidateBank(void)
 {
-    reg_bank_sel(0);
-    uint8_t int_pin_cfg[2] = {0x0F, 0x00}; // 0b00100000
-    transferI2C(int_pin_cfg, I2C_FLAG_WRITE, 2);
+    currentBank = ICM20948_BANK_UNKNOWN;
 }
 
-void power_mng(void)
+/**
+ * @brief Queue a transfer to a register of the given bank. The bank switch
+ *        and the transfer are queued together, so an ISR using a different
+ *        bank cannot slip in between.
+ */
+bool icm20948QueueBanked(uint8_t bank, uint16_t flags, const uint8_t *writeData, uint8_t writeLen,
+                         uint8_t *readData, uint8_t readLen,
+                         i2c_callback_t callback, void *userParam)
 {
-    reg_bank_sel(0);
-    uint8_t ip_config[2] = {0x06, 0x29};
-    transferI2C(ip_config, I2C_FLAG_WRITE, 2); // while Bank 2 is selected
+    bool ok;
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    reg_bank_sel(bank);
+    ok = i2cQueueTransfer(flags, writeData, writeLen, readData, readLen, callback, userParam);
+    CORE_EXIT_CRITICAL();
 
-    uint8_t pwr_mgmt_2[2] = {0x07, 0x07}; // 0b00000111
-    transferI2C(pwr_mgmt_2, I2C_FLAG_WRITE, 2);
+    return ok;
 }
 
-void set_acc_sensor(void)
+static void verify_done(I2C_TransferReturn_TypeDef status, void *userParam)
 {
-    who_am_i();
-    //    select_WOM_algorithm();
-    LOG_INFO("WOM Algorithm set\n");
+    icm20948_verify_t *slot = (icm20948_verify_t *)userParam;
+    const icm20948_reg_t *entry = slot->entry;
+    uint8_t readBack = slot->readBack;
 
-    WOM_Threshold();
+    slot->entry = NULL;
 
-    accel_intel_config();
-    LOG_INFO("WoM logic and sets the comparison mode\n");
+    if ((status != i2cTransferDone) ||
+        ((readBack & entry->verifyMask) != (entry->value & entry->verifyMask)))
+    {
+        verifyErrors++;
+        LOG_ERROR("ICM-20948 bank %d reg 0x%02X reads 0x%02X, expected 0x%02X",
+                  entry->bank, entry->reg, readBack, entry->value);
+    }
+}
 
-    int_pin_config();
+/**
+ * @brief Queue the writes of a register table.
+ *        Consecutive registers of the same bank are merged into one burst
+ *        write, the ICM-20948 auto-increments the register address. Entries
+ *        with a verify mask are read back once the whole table is written,
+ *        each into its own verify slot, so tables may be queued back to back.
+ * @param table Register table
+ * @param count Number of entries
+ * @return true if everything was queued
+ */
+bool icm20948ApplyTable(const icm20948_reg_t *table, uint8_t count)
+{
+    uint8_t burst[I2C_ASYNC_WRITE_MAX];
+    uint8_t burstLen;
+    uint8_t i = 0;
+    uint8_t slot = 0;
+    bool ok = true;
+    bool queued;
+
+    while (i < count)
+    {
+        burst[0] = table[i].reg;
+        burst[1] = table[i].value;
+        burstLen = 2;
+        i++;
+
+        while ((i < count) && (burstLen < I2C_ASYNC_WRITE_MAX) &&
+               (table[i].bank == table[i - 1].bank) &&
+               (table[i].reg == table[i - 1].reg + 1))
+        {
+            burst[burstLen++] = table[i].value;
+            i++;
+        }
+
+        ok &= icm20948QueueBanked(table[i - 1].bank, I2C_FLAG_WRITE, burst, burstLen, NULL, 0, NULL, NULL);
+    }
 
-    enable_interrupt();
+    for (i = 0; i < count; i++)
+    {
+        if (table[i].verifyMask == 0)
+        {
+            continue;
+        }
+        while ((slot < ICM20948_MAX_VERIFY) && (verifySlots[slot].entry != NULL))
+        {
+            slot++;
+        }
+        if (slot >= ICM20948_MAX_VERIFY)
+        {
+            LOG_ERROR("icm20948ApplyTable: too many read backs in flight");
+            ok = false;
+            break;
+        }
+        verifySlots[slot].entry = &table[i];
+        queued = icm20948QueueBanked(table[i].bank, I2C_FLAG_WRITE_READ, &table[i].reg, 1,
+                                     &verifySlots[slot].readBack, 1, verify_done, &verifySlots[slot]);
+        if (!queued)
+        {
+            verifySlots[slot].entry = NULL;
+        }
+        ok &= queued;
+    }
 
-    LP_Config();
+    return ok;
+}
 
-    power_mng();
+/**
+ * @brief Number of registers that failed read-back verification.
+ */
+uint8_t icm20948VerifyErrors(void)
+{
+    return verifyErrors;
+}
 
-    LOG_INFO("Set done\n");
+/**
+ * @brief Queue the ICM-20948 wake-on-motion configuration.
+ *        The writes go out back to back from the I2C interrupt.
+ */
+void set_acc_sensor(void)
+{
+    who_am_i();
+
+    icm20948ApplyTable(accelInitTable, sizeof(accelInitTable) / sizeof(accelInitTable[0]));
+
+    LOG_INFO("Accelerometer configuration queued\n");
 }
 /**
  * @brief Enable sensor power.
@@ -189,38 +427,59 @@ void set_acc_sensor(void)
  */
 void enableSensorPower(void)
 {
+    static const icm20948_reg_t wakeTable[] = {
+        {0, 0x06, 0x81, 0x00}, // PWR_MGMT_1 = 0x01 (wake up, clock source auto)
+        {0, 0x07, 0x00, 0x00}, // Enable the accelerometer and gyroscope (PWR_MGMT_2 = 0x00)
+    };
+
     who_am_i();
-    reg_bank_sel(0);
-    LOG_INFO("SELECTED BANK");
 
-    uint8_t wakeCmd[2] = {0x06, 0x81}; // PWR_MGMT_1 = 0x01 (wake up, clock source auto)
-    transferI2C(wakeCmd, I2C_FLAG_WRITE, 2);
+    icm20948ApplyTable(wakeTable, sizeof(wakeTable) / sizeof(wakeTable[0]));
 
-    // Enable the accelerometer and gyroscope (PWR_MGMT_2 = 0x00)
-    uint8_t enableSensors[2] = {0x07, 0x00};
-    transferI2C(enableSensors, I2C_FLAG_WRITE, 2);
+    // 0x81 sets DEVICE_RESET, the bank register is back to 0
+    icm20948InvalidateBank();
 }
 
-void who_am_i(void)
+static uint8_t whoami;
+
+static void who_am_i_done(I2C_TransferReturn_TypeDef status, void *userParam)
 {
-    uint8_t whoami = readRegister(0x00); // WHO_AM_I
-    LOG_INFO("WHO_AM_I: 0x%02X", whoami);
+    (void)userParam;
+    if (status == i2cTransferDone)
+    {
+        LOG_INFO("WHO_AM_I: 0x%02X", whoami);
+    }
 }
-void clear_interrupt_flag(void)
+
+void who_am_i(void)
 {
-    reg_bank_sel(0);
-    uint8_t int_status_reg[1] = {0x19};
-    uint8_t int_status_value[1] = {0x00};
+    uint8_t reg = ICM20948_WHO_AM_I_REG;
+
+    icm20948QueueBanked(0, I2C_FLAG_WRITE_READ, &reg, 1, &whoami, 1, who_am_i_done, NULL);
+}
 
-    transferI2C(int_status_reg, I2C_FLAG_WRITE, 1);
-    transferI2C(int_status_value, I2C_FLAG_READ, 1);
+static uint8_t int_status_value;
 
+static void clear_interrupt_flag_done(I2C_TransferReturn_TypeDef status, void *userParam)
+{
+    (void)userParam;
     // Optionally check if bit 3 is set:
-    if (int_status_value[0] & 0x08)
+    if ((status == i2cTransferDone) && (int_status_value & 0x08))
     {
         LOG_INFO("Wake-on-Motion interrupt detected and cleared.\n");
     }
 }
+
+/**
+ * @brief Queue a read of INT_STATUS_1, which clears the interrupt.
+ *        Safe to call from an ISR, nothing blocks.
+ */
+void clear_interrupt_flag(void)
+{
+    uint8_t reg = 0x19; // INT_STATUS_1
+
+    icm20948QueueBanked(0, I2C_FLAG_WRITE_READ, &reg, 1, &int_status_value, 1, clear_interrupt_flag_done, NULL);
+}
 /**
  * @brief Disable sensor power.
  *        This function wakes up the sensor by writing 0x01 to register 0x06 (PWR_MGMT_1).
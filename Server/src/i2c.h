@@ -1,18 +1,59 @@
 #ifndef I2C_H
 #define I2C_H
 #include <stdint.h>
+#include <stdbool.h>
+#include "em_i2c.h"
+#include "src/scheduler.h"
 // SI7021 I2C Address and Commands
 #define SI7021_DEVICE_ADDR 0x40
 #define SI7021_TEMP_MEASURE_CMD 0xF3
 
+#define I2C_ASYNC_QUEUE_SIZE 24 // transactions, one slot is kept free
+#define I2C_ASYNC_WRITE_MAX  8  // bytes copied per write, register address plus burst
+
+// Completion callback, runs from the main loop on EVENT_I2CTransfer_Done
+typedef void (*i2c_callback_t)(I2C_TransferReturn_TypeDef status, void *userParam);
+
+typedef struct
+{
+    uint16_t flags;
+    uint8_t writeData[I2C_ASYNC_WRITE_MAX];
+    uint8_t writeLen;
+    uint8_t *readData;
+    uint8_t readLen;
+    i2c_callback_t callback;
+    void *userParam;
+    volatile I2C_TransferReturn_TypeDef status;
+} i2c_transaction_t;
+
+#define ICM20948_BANK_UNKNOWN 0xFF
+#define ICM20948_MAX_VERIFY   16 // register read backs in flight, across all queued tables
+
+// One entry of a declarative register table. A non zero verifyMask reads
+// the register back and compares the masked bits.
+typedef struct
+{
+    uint8_t bank;
+    uint8_t reg;
+    uint8_t value;
+    uint8_t verifyMask;
+} icm20948_reg_t;
+
 // Function Prototypes
 // Sensor enable and disbale functions
 void enableSensorPower(void);
 void disableSensorPower(void);
 // I2C Init function
 void initI2C(void);
-// I2C Trnasfer Function
-uint8_t transferI2C(uint8_t *dataBuffer, uint8_t transferMode, uint8_t dataLength);
+// Asynchronous transaction queue
+bool i2cQueueTransfer(uint16_t flags, const uint8_t *writeData, uint8_t writeLen,
+                      uint8_t *readData, uint8_t readLen,
+                      i2c_callback_t callback, void *userParam);
+bool i2cWriteRegAsync(uint8_t regAddr, uint8_t value);
+bool i2cReadRegsAsync(uint8_t regAddr, uint8_t *data, uint8_t len,
+                      i2c_callback_t callback, void *userParam);
+bool i2cAsyncIdle(void);
+void i2cAsyncHandler(Events_t evt);
 // Write temperature command function
 void writeTemperatureCommand(void);
 // Read temperature command function
@@ -26,8 +67,13 @@ void measureAndPrintTemperature(void);
 // Wait for converstion function
 void waitForConversion(void);
 void reg_bank_sel(uint8_t bank);
+void icm20948InvalidateBank(void);
+bool icm20948QueueBanked(uint8_t bank, uint16_t flags, const uint8_t *writeData, uint8_t writeLen,
+                         uint8_t *readData, uint8_t readLen,
+                         i2c_callback_t callback, void *userParam);
+bool icm20948ApplyTable(const icm20948_reg_t *table, uint8_t count);
+uint8_t icm20948VerifyErrors(void);
 void who_am_i(void);
-uint8_t readRegister(uint8_t regAddr);
 void set_acc_sensor(void);
 void clear_interrupt_flag(void);
 #endif // I2C_H
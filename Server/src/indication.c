@@ -0,0 +1,308 @@
+/***********************************************************************
+ * @file      indication.c
+ * @version   0.1
+ * @brief     Per characteristic indication queues.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 2, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ * ATT allows one outstanding indication per connection, so values are
+ * queued per characteristic and the next one is sent when the confirmation
+ * arrives. The channels are served round robin so a burst on one
+ * characteristic cannot starve the others. For state like data the channel
+ * can be set to coalesce, a new value then replaces the one still waiting
+ * instead of building up a stale backlog.
+ *
+ * Every connected central has its own set of queues and its own in flight
+ * indication, a slow peer only holds back its own values.
+ */
+
+#define INCLUDE_LOG_DEBUG     1
+#include "log.h"
+#include "src/indication.h"
+#include "src/irq.h"
+#include "src/link.h"
+#include "sl_bt_api.h"
+#include <string.h>
+
+typedef struct {
+  uint8_t  data[INDICATION_MAX_LEN];
+  uint8_t  len;
+  uint32_t timestamp;   // letimerMilliseconds() when queued, monotonic across LETIMER periods
+} indication_entry_t;
+
+typedef struct {
+  indication_entry_t entries[INDICATION_QUEUE_DEPTH];
+  uint8_t  readIndex;
+  uint8_t  count;
+} indication_queue_t;
+
+// Queues of one connection, one per registered characteristic
+typedef struct {
+  bool     used;
+  uint8_t  connection;
+  bool     inFlight;
+  uint8_t  nextChannel;     // round robin position
+  indication_queue_t queues[INDICATION_MAX_CHANNELS];
+} indication_conn_t;
+
+// Registered characteristic, shared by all connections
+typedef struct {
+  uint16_t charHandle;
+  bool     coalesce;
+  indication_stats_t stats; // summed over all connections
+} indication_channel_t;
+
+static indication_channel_t channels[INDICATION_MAX_CHANNELS];
+static uint8_t numChannels = 0;
+static indication_conn_t conns[LINK_MAX_CONNECTIONS];
+
+static int8_t channelFind(uint16_t charHandle)
+{
+  uint8_t i;
+
+  for (i = 0; i < numChannels; i++) {
+      if (channels[i].charHandle == charHandle) {
+          return (int8_t) i;
+      }
+  }
+
+  return -1;
+}
+
+static indication_conn_t* connFind(uint8_t connection)
+{
+  uint8_t i;
+
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      if (conns[i].used && (conns[i].connection == connection)) {
+          return &conns[i];
+      }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Sends the oldest value of the connection's next non empty queue,
+ *        round robin.
+ */
+static void indicationPump(indication_conn_t *conn)
+{
+  indication_channel_t *ch;
+  indication_queue_t *q;
+  indication_entry_t *entry;
+  sl_status_t rc;
+  uint32_t latency;
+  uint8_t i, c;
+
+  if (conn->inFlight) {
+      return;
+  }
+
+  for (i = 0; i < numChannels; i++) {
+      c = (conn->nextChannel + i) % numChannels;
+      ch = &channels[c];
+      q = &conn->queues[c];
+      if (q->count == 0) {
+          continue;
+      }
+
+      entry = &q->entries[q->readIndex];
+      rc = sl_bt_gatt_server_send_indication(conn->connection, ch->charHandle, entry->len, entry->data);
+      if (rc != SL_STATUS_OK) {
+          // Leave it queued, the next send or confirmation retries
+          LOG_ERROR("sl_bt_gatt_server_send_indication() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+          return;
+      }
+
+      latency = letimerMilliseconds() - entry->timestamp;
+      ch->stats.sent++;
+      ch->stats.latency_sum_ms += latency;
+      if (latency > ch->stats.latency_max_ms) {
+          ch->stats.latency_max_ms = latency;
+      }
+
+      q->readIndex = (q->readIndex + 1) % INDICATION_QUEUE_DEPTH;
+      q->count--;
+      conn->nextChannel = (c + 1) % numChannels;
+      conn->inFlight = true;
+      return;
+  }
+}
+
+/**
+ * @brief Registers a characteristic, every connection gets a queue for it.
+ *
+ * @param charHandle Handle from gatt_db.h.
+ * @param coalesce   true if only the latest pending value matters.
+ * @return false if out of channels.
+ */
+bool indicationAddChannel(uint16_t charHandle, bool coalesce)
+{
+  int8_t c = channelFind(charHandle);
+
+  if (c < 0) {
+      if (numChannels >= INDICATION_MAX_CHANNELS) {
+          LOG_ERROR("indicationAddChannel: no free channel\n\r");
+          return false;
+      }
+      c = (int8_t) numChannels++;
+  }
+
+  memset(&channels[c], 0, sizeof(channels[c]));
+  channels[c].charHandle = charHandle;
+  channels[c].coalesce = coalesce;
+
+  return true;
+}
+
+/**
+ * @brief Gives a new connection its queues, call on connection open.
+ */
+bool indicationOpen(uint8_t connection)
+{
+  indication_conn_t *conn = connFind(connection);
+  uint8_t i;
+
+  for (i = 0; (conn == NULL) && (i < LINK_MAX_CONNECTIONS); i++) {
+      if (!conns[i].used) {
+          conn = &conns[i];
+      }
+  }
+  if (conn == NULL) {
+      LOG_ERROR("indicationOpen: no free entry for connection %d\n\r", connection);
+      return false;
+  }
+
+  memset(conn, 0, sizeof(*conn));
+  conn->used = true;
+  conn->connection = connection;
+
+  return true;
+}
+
+/**
+ * @brief Drops the connection's queues, call when it closes or an
+ *        indication times out (the link is unusable for ATT after that).
+ */
+void indicationClose(uint8_t connection)
+{
+  indication_conn_t *conn = connFind(connection);
+
+  if (conn != NULL) {
+      conn->used = false;
+  }
+}
+
+/**
+ * @brief Queues a value for one connection and sends it right away if
+ *        nothing is in flight on that connection.
+ *
+ * @return false if the connection or characteristic is unknown or the
+ *         value is too long.
+ */
+bool indicationSend(uint8_t connection, uint16_t charHandle, const uint8_t *data, uint8_t len)
+{
+  indication_conn_t *conn = connFind(connection);
+  int8_t c = channelFind(charHandle);
+  indication_channel_t *ch;
+  indication_queue_t *q;
+  indication_entry_t *entry;
+
+  // The value has to fit the connection's ATT MTU as well as the queue entry
+  if ((conn == NULL) || (c < 0) || (len > INDICATION_MAX_LEN) || (len > linkGetPayloadBudget(connection))) {
+      LOG_ERROR("indicationSend: connection %d handle %d not registered or len %d too long\n\r",
+                connection, charHandle, len);
+      return false;
+  }
+
+  ch = &channels[c];
+  q = &conn->queues[c];
+  ch->stats.enqueued++;
+
+  if (ch->coalesce && (q->count > 0)) {
+      // Latest value wins, overwrite the newest pending entry
+      entry = &q->entries[(q->readIndex + q->count - 1) % INDICATION_QUEUE_DEPTH];
+      ch->stats.coalesced++;
+  } else {
+      if (q->count == INDICATION_QUEUE_DEPTH) {
+          // Full, drop the oldest so the queue does not go stale
+          q->readIndex = (q->readIndex + 1) % INDICATION_QUEUE_DEPTH;
+          q->count--;
+          ch->stats.dropped++;
+      }
+      entry = &q->entries[(q->readIndex + q->count) % INDICATION_QUEUE_DEPTH];
+      q->count++;
+      if (q->count > ch->stats.depth_max) {
+          ch->stats.depth_max = q->count;
+      }
+  }
+
+  memcpy(entry->data, data, len);
+  entry->len = len;
+  entry->timestamp = letimerMilliseconds();
+
+  indicationPump(conn);
+
+  return true;
+}
+
+/**
+ * @brief Call on sl_bt_gatt_server_confirmation, sends the connection's
+ *        next value.
+ */
+void indicationConfirmed(uint8_t connection)
+{
+  indication_conn_t *conn = connFind(connection);
+
+  if (conn != NULL) {
+      conn->inFlight = false;
+      indicationPump(conn);
+  }
+}
+
+/**
+ * @brief Drops every connection's queues, call on boot.
+ */
+void indicationReset(void)
+{
+  uint8_t i;
+
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      conns[i].used = false;
+  }
+}
+
+/**
+ * @brief true while any connection has an indication in flight.
+ */
+bool indicationInFlight(void)
+{
+  uint8_t i;
+
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      if (conns[i].used && conns[i].inFlight) {
+          return true;
+      }
+  }
+
+  return false;
+}
+
+/**
+ * @brief Counters of one characteristic, NULL if it was not registered.
+ */
+const indication_stats_t* indicationGetStats(uint16_t charHandle)
+{
+  int8_t c = channelFind(charHandle);
+
+  return (c >= 0) ? &channels[c].stats : NULL;
+}
@@ -0,0 +1,47 @@
+/***********************************************************************
+ * @file      indication.h
+ * @version   0.1
+ * @brief     Function header/interface file.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 2, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ */
+
+#ifndef SRC_INDICATION_H_
+#define SRC_INDICATION_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define INDICATION_MAX_CHANNELS   4   // characteristics that can be indicated
+#define INDICATION_QUEUE_DEPTH    8   // pending values per characteristic and connection
+#define INDICATION_MAX_LEN        8   // bytes per value
+
+typedef struct {
+  uint32_t enqueued;        // values handed to indicationSend()
+  uint32_t sent;            // indications accepted by the stack
+  uint32_t coalesced;       // pending values replaced by a newer one
+  uint32_t dropped;         // oldest values dropped because the queue was full
+  uint32_t depth_max;       // deepest any connection's queue has been
+  uint32_t latency_max_ms;  // longest time from indicationSend() to the stack
+  uint32_t latency_sum_ms;  // divide by sent for the mean
+} indication_stats_t;
+
+bool indicationAddChannel(uint16_t charHandle, bool coalesce);
+bool indicationOpen(uint8_t connection);
+void indicationClose(uint8_t connection);
+bool indicationSend(uint8_t connection, uint16_t charHandle, const uint8_t *data, uint8_t len);
+void indicationConfirmed(uint8_t connection);
+void indicationReset(void);
+bool indicationInFlight(void);
+const indication_stats_t* indicationGetStats(uint16_t charHandle);
+
+#endif /* SRC_INDICATION_H_ */
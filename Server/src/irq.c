@@ -22,11 +22,13 @@
 #include <src/irq.h>
 #include "em_letimer.h"
 #include "em_gpio.h"
+#include "em_core.h"
 #include "src/gpio.h"
 #include "src/timers.h"
 #include "app.h"
 #include "src/scheduler.h"
 #include "src/i2c.h"
+#include "src/accel_fifo.h"
 
 #define INCLUDE_LOG_DEBUG   1
 #include "src/log.h"
@@ -58,12 +60,15 @@ void LETIMER0_IRQHandler(void)
   LETIMER_IntClear(LETIMER0, flags);
 
   // Handle Underflow (UF) event, if necessary
-  if(flags == LETIMER_IEN_UF){
+  if(flags & LETIMER_IEN_UF){
      leCounter++;
-     schedulerSetEventUF();
+     // The period is kept short for EXTCOMIN, the UF handlers do not need it
+     if((leCounter % LETIMER_UF_EVENT_DIV) == 0){
+         schedulerSetEventUF();
+     }
   }
 
-  if(flags == LETIMER_IEN_COMP1){
+  if(flags & LETIMER_IEN_COMP1){
       schedulerSetEventCOMP1();
     }
 }
@@ -71,18 +76,29 @@ void LETIMER0_IRQHandler(void)
 /**
  * @brief Get the elapsed time in milliseconds from the LETIMER.
  *
- * This function calculates the elapsed time in milliseconds using the LETIMER
- * counter and period values.
+ * Whole periods come from the underflow count, the current period from how
+ * far the counter has counted down from COMP0. An underflow the ISR has not
+ * counted yet (inside a critical section, or an ISR of higher priority) is
+ * added here, so the time never steps back.
  *
  * @return uint32_t Elapsed time in milliseconds.
  */
 uint32_t letimerMilliseconds(void){
 
-  uint32_t ret = 0;
+  uint32_t periods, count;
+  CORE_DECLARE_IRQ_STATE;
 
-  ret = (leCounter*LETIMER_PERIOD_MS) + (LETIMER_CounterGet(LETIMER0)/COUNT_PER_US);
+  CORE_ENTER_CRITICAL();
+  periods = leCounter;
+  count = LETIMER_CounterGet(LETIMER0);
+  if(LETIMER_IntGet(LETIMER0) & LETIMER_IF_UF){
+      // Read again, the counter may have been read just before the reload
+      periods++;
+      count = LETIMER_CounterGet(LETIMER0);
+  }
+  CORE_EXIT_CRITICAL();
 
-  return ret;
+  return (periods*LETIMER_PERIOD_MS) + (((LETIMER_COMP0_VAL - count)*1000)/ACTUAL_CLOCK_FREQ);
 }
 
 void GPIO_EVEN_IRQHandler(void) {
@@ -93,8 +109,13 @@ void GPIO_EVEN_IRQHandler(void) {
         schedulerSetEventPB0();
     }
     else if (flags & (1 << ACC_INT_PIN)) {
+#if ACCEL_FIFO_ENABLE
+        // Status read tells wake-on-motion and FIFO watermark apart
+        accelFifoOnInterrupt();
+#else
         schedulerSetEventAccelINT();
 //        clear_interrupt_flag();
+#endif
     }
 }
 
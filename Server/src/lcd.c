@@ -54,6 +54,11 @@
 */
 
 
+// displayPrintf() logs the truncated row text, a RAM string, so this file
+// keeps the synchronous app_log() path. Defined ahead of every include
+// since src/ble.h pulls in log.h.
+#define LOG_DEFERRED 0
+
 #include "stdarg.h" // for arguments
 
 #include "string.h"
@@ -67,6 +72,9 @@
 
 
 #include "lcd.h"
+#include "lcd_dma.h"
+#include "lcd_text.h"
+#include "timers.h"
 
 
 // Include logging specifically for this .c file
@@ -88,6 +96,13 @@ struct display_data {
 	// GLIB_Context required for use with GLIB_ functions
 	GLIB_Context_t           glibContext;
 
+	// Retained text of every row, displayPrintf() only updates these and
+	// displayFlush() draws the rows marked dirty
+	char                     rows[DISPLAY_NUMBER_OF_ROWS][DISPLAY_ROW_LEN+1];
+	uint16_t                 dirtyRows;     // bit n set: row n changed since the last flush
+	bool                     flushArmed;    // single shot TIMER_HANDLE_1HZ pending
+	bool                     asleep;        // blanked by the idle policy, rows stay dirty
+
 };
 
 
@@ -105,6 +120,38 @@ static struct display_data         *displayGetData() {
 }
 
 
+#if DISPLAY_EXTCOMIN_HW
+// With no 1Hz tick running, start a single shot one to draw the change
+static void displayArmFlush(struct display_data *display) {
+	sl_status_t rc;
+
+	if (display->flushArmed || display->asleep) {
+	    return;
+	}
+	rc = sl_bt_system_set_lazy_soft_timer(TIMER_INTERVAL_1HZ, TIMER_SLACK, TIMER_HANDLE_1HZ, 1);
+	if (rc != SL_STATUS_OK) {
+	    LOG_ERROR("Bluetooth: Set lazy soft timer = %d\r\n", (unsigned int) rc);
+	    return;
+	}
+	display->flushArmed = true;
+}
+#endif
+
+
+// Sends the whole framebuffer, used to blank the LCD
+static void displaySendAll() {
+#if LCD_DMA_ENABLE
+	lcdDmaMarkLines(0, LCD_DMA_HEIGHT);
+	lcdDmaStart();
+#else
+	EMSTATUS status = DMD_updateDisplay();
+	if (status != DMD_OK) {
+	    LOG_ERROR("DMD_updateDisplay() returned non-zero error code=0x%04x", (unsigned int) status);
+	}
+#endif
+}
+
+
 
 // ****************************************************************
 // The following routines are the public functions
@@ -119,9 +166,11 @@ static struct display_data         *displayGetData() {
  *    Example:
  *       displayPrintf(DISPLAY_ROW_TEMPVALUE, "Temp=%d", temp);
  *
- *    The implementation always erases a row first before drawing the
- *    string passed in. This is done so that all pixels from the previously
- *    displayed text will be erased.
+ *    Nothing is drawn here, the text is kept in the row buffer and the
+ *    row is marked dirty only if the text changed. displayFlush() draws the
+ *    dirty rows, it runs on the 1Hz display tick or when called directly,
+ *    so event handlers can call displayPrintf() at any rate for the cost
+ *    of a vsnprintf() and a strcmp().
  *    To erase a row, pass in a format string of either "" or " ".
  *
  *    Row indexes >= DISPLAY_NUMBER_OF_ROWS will throw a LOG_ERROR() msg and
@@ -137,11 +186,9 @@ void displayPrintf(enum display_row row, const char *format, ...)
                           // of handling variable number of arguments passed to
                           // a function.
 
-   EMSTATUS               status;
    struct display_data    *display = displayGetData();
    size_t                 strLen;
    char                   strToDisplay[DISPLAY_ROW_LEN+1]; // +1 for null terminator
-   char                   strToErase[DISPLAY_ROW_LEN+1];   // +1 for null terminator
 
    // Range check the row number
    if (row >= DISPLAY_NUMBER_OF_ROWS) {
@@ -186,46 +233,83 @@ void displayPrintf(enum display_row row, const char *format, ...)
    } // else
 
 
-   // We always erase the whole line first, then draw the new string. This way
-   // we don't leave any pixels set from the previous characters.
-   for (int i=0; i<DISPLAY_ROW_LEN; i++) {
-       strToErase[i] = ' ';         // space
-   }
-   strToErase[DISPLAY_ROW_LEN] = 0; // null
-
-   // Erase the row
-   status = GLIB_drawStringOnLine(&display->glibContext,
-                                   &strToErase[0],
-                                   row,
-                                   GLIB_ALIGN_CENTER,
-                                   0,        // x offset
-                                   0,        // y offset
-                                   true);    // opaque
-   if (status != GLIB_OK) {
-       LOG_ERROR("Erase GLIB_drawStringOnLine() returned non-zero error code=0x%04x", (unsigned int) status);
+   // Same text as shown, nothing to redraw
+   if (strcmp(display->rows[row], strToDisplay) == 0) {
+       return;
    }
 
+   strcpy(display->rows[row], strToDisplay);
+   display->dirtyRows |= (1 << row);
 
-   // Draw the new string on the memory lcd display
-   status = GLIB_drawStringOnLine(&display->glibContext,
-                                  &strToDisplay[0],
-                                  row,
-                                  GLIB_ALIGN_CENTER,
-                                  0,        // x offset
-                                  0,        // y offset
-                                  true);    // opaque
-   if (status != GLIB_OK) {
-       LOG_ERROR("Draw GLIB_drawStringOnLine() returned non-zero error code=0x%04x", (unsigned int) status);
+#if DISPLAY_EXTCOMIN_HW
+   displayArmFlush(display);
+#endif
+
+} // displayPrintf()
+
+
+
+
+/**
+ * Draws the rows that changed since the last flush and sends the frame to
+ * the LCD once. With LCD_DMA_ENABLE only the pixel lines of those rows are
+ * sent, by the LDMA, and this returns before the transfer completes.
+ * Each row is padded to the full width with the text centered, so one
+ * opaque draw replaces the old pixels without erasing first.
+ * Does nothing if no row changed.
+ */
+void displayFlush()
+{
+   EMSTATUS               status;
+   struct display_data    *display = displayGetData();
+   char                   strToDraw[DISPLAY_ROW_LEN+1]; // +1 for null terminator
+   size_t                 len;
+   size_t                 pad;
+#if LCD_DMA_ENABLE
+   uint32_t               lineHeight;
+#endif
+
+   // Blanked rows are drawn when the display wakes up
+   if (display->dirtyRows == 0 || display->asleep) {
+       return;
    }
 
+   for (int row=0; row<DISPLAY_NUMBER_OF_ROWS; row++) {
+       if ((display->dirtyRows & (1 << row)) == 0) {
+           continue;
+       }
+
+       len = strlen(display->rows[row]);
+       pad = (DISPLAY_ROW_LEN - len) / 2;
+       memset(strToDraw, ' ', DISPLAY_ROW_LEN);
+       memcpy(&strToDraw[pad], display->rows[row], len);
+       strToDraw[DISPLAY_ROW_LEN] = 0; // null
+
+       // Centered and opaque, same as GLIB_drawStringOnLine()
+       status = lcdTextDrawRow(&display->glibContext, &strToDraw[0], row);
+       if (status != GLIB_OK) {
+           LOG_ERROR("Draw lcdTextDrawRow() returned non-zero error code=0x%04x", (unsigned int) status);
+       }
+#if LCD_DMA_ENABLE
+       // Only the pixel lines of this text row go out to the LCD
+       lineHeight = display->glibContext.font.fontHeight + display->glibContext.font.lineSpacing;
+       lcdDmaMarkLines(row * lineHeight, lineHeight);
+#endif
+   }
+   display->dirtyRows = 0;
+
 
    // Update the data the LCD is displaying
+#if LCD_DMA_ENABLE
+   lcdDmaStart();
+#else
    status = DMD_updateDisplay();
    if (status != DMD_OK) {
        LOG_ERROR("DMD_updateDisplay() returned non-zero error code=0x%04x", (unsigned int) status);
    }
+#endif
 
-} // displayPrintf()
+} // displayFlush()
 
 
 
@@ -298,6 +382,11 @@ void displayInit()
         LOG_ERROR("DMD_updateDisplay() returned non-zero error code=0x%04x", (unsigned int) status);
     }
 
+#if LCD_DMA_ENABLE
+    // Later frames only send the changed lines, through the LDMA
+    lcdDmaInit();
+#endif
+
 
 	  // The BT stack implements timers that we can setup and then have the stack pass back
 	  // events when the timer expires.
@@ -309,6 +398,10 @@ void displayInit()
 	  // We will get a sl_bt_evt_system_soft_timer_id event as a result of calling
 	  // sl_bt_system_set_soft_timer() i.e. starting the timer.
 
+#if DISPLAY_EXTCOMIN_HW
+    // LETIMER0 toggles EXTCOMIN from here on, no repeating timer needed
+    LETIMER0ExtcominEnable(true);
+#else
     // Edit #3
     // Students: Figure out what parameters to pass in to sl_bt_system_set_soft_timer() to
     //           set up a 1 second repeating soft timer and uncomment the following lines
@@ -321,6 +414,10 @@ void displayInit()
 	  if (timer_response != SL_STATUS_OK) {
 	      LOG_ERROR("Bluetooth: Set lazy soft timer = %d\r\n", (unsigned int) timer_response);
      }
+#endif
+
+    // Start the idle timeout
+    displayActivity();
 
 
 
@@ -338,6 +435,10 @@ void displayUpdate()
 {
 	struct display_data *display = displayGetData();
 
+#if DISPLAY_EXTCOMIN_HW
+	// Single shot armed by displayPrintf(), LETIMER0 handles EXTCOMIN
+	display->flushArmed = false;
+#else
 	// toggle the var that remembers the state of EXTCOMIN pin
 	display->last_extcomin_state_high = !display->last_extcomin_state_high;
 
@@ -347,9 +448,76 @@ void displayUpdate()
 	//           Then uncomment the following line.
 	//
 	gpioSetDisplayExtcomin(display->last_extcomin_state_high);
-	
+#endif
+
+	// Draw whatever changed during the last second in one frame update
+	displayFlush();
+
 } // displayUpdate()
 
 
 
+/**
+ * Call this on events the user cares about: a PB0 press, a posture alert or
+ * a passkey to confirm. Restarts the idle timeout and wakes a blanked display,
+ * redrawing every row from the retained text.
+ */
+void displayActivity()
+{
+#if DISPLAY_IDLE_TIMEOUT_MIN > 0
+	struct display_data *display = displayGetData();
+	sl_status_t          rc;
+
+	// Same handle, so this restarts a running timeout
+	rc = sl_bt_system_set_lazy_soft_timer(TIMER_INTERVAL_DISPLAY_IDLE,
+	                                      TIMER_SLACK,
+	                                      TIMER_HANDLE_DISPLAY_IDLE,
+	                                      1); // single shot
+	if (rc != SL_STATUS_OK) {
+	    LOG_ERROR("Bluetooth: Set lazy soft timer = %d\r\n", (unsigned int) rc);
+	}
+
+	if (display->asleep) {
+	    display->asleep = false;
+	    DMD_wakeUp();
+	    display->dirtyRows = (1 << DISPLAY_NUMBER_OF_ROWS) - 1;
+	    displayFlush();
+	}
+#endif
+} // displayActivity()
+
+
 
+
+/**
+ * Call this when TIMER_HANDLE_DISPLAY_IDLE expires. Blanks the LCD and
+ * stops drawing until displayActivity(). displayPrintf() keeps updating the
+ * retained rows meanwhile. With DISPLAY_EXTCOMIN_HW no soft timer runs while
+ * blanked, otherwise the 1Hz timer keeps toggling EXTCOMIN since the panel
+ * stays powered, DISP_ENABLE is shared with the sensor.
+ */
+void displayIdleTimeout()
+{
+	struct display_data *display = displayGetData();
+	EMSTATUS             status;
+
+	if (display->asleep) {
+	    return;
+	}
+	display->asleep = true;
+
+#if DISPLAY_EXTCOMIN_HW
+	if (display->flushArmed) {
+	    sl_bt_system_set_lazy_soft_timer(0, 0, TIMER_HANDLE_1HZ, 0); // stop
+	    display->flushArmed = false;
+	}
+#endif
+
+	status = GLIB_clear(&display->glibContext);
+	if (status != GLIB_OK) {
+	    LOG_ERROR("GLIB_clear() returned non-zero error code=0x%04x", (unsigned int) status);
+	}
+	displaySendAll();
+
+	DMD_sleep();
+} // displayIdleTimeout()
@@ -72,6 +72,16 @@ enum display_row {
 #define TIMER_INTERVAL_1HZ 32768  // 1 second in hardware clock ticks
 #define TIMER_SLACK        500    // Allow some slack for power optimization
 
+// 1 = LETIMER0 toggles EXTCOMIN in hardware, the 1Hz timer only runs as a
+//     single shot after a row changed, 0 = repeating 1Hz timer toggles it
+#define DISPLAY_EXTCOMIN_HW          1
+
+// Blank the LCD after this long without PB0, a posture alert or a passkey,
+// 0 = never blank
+#define DISPLAY_IDLE_TIMEOUT_MIN     5
+#define TIMER_HANDLE_DISPLAY_IDLE    0x04
+#define TIMER_INTERVAL_DISPLAY_IDLE  (DISPLAY_IDLE_TIMEOUT_MIN * 60 * 32768)
+
 
 
 // function prototypes
@@ -79,6 +89,9 @@ enum display_row {
 void displayInit();
 void displayUpdate();
 void displayPrintf(enum display_row row, const char *format, ...);
+void displayFlush();
+void displayActivity();
+void displayIdleTimeout();
 
 
 
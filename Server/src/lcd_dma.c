@@ -0,0 +1,252 @@
+/***********************************************************************
+ * @file      lcd_dma.c
+ * @version   0.1
+ * @brief     LDMA driven partial updates of the Sharp memory LCD.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 9, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources Sharp LS013B7DH03 datasheet, multiple line data update mode
+ *
+ * GLIB still renders into the DMD framebuffer. Instead of DMD_updateDisplay()
+ * clocking every byte out with the CPU, the lines the caller marked are
+ * copied into one multiple line update packet:
+ *
+ *   0x01 | addr | 16 data | 0xFF | addr | 16 data | 0xFF | ... | 0xFF
+ *
+ * and the LDMA feeds it to USART1 on TXBL. The lines need not be adjacent,
+ * every line carries its own address. The CPU sleeps in EM1 until the LDMA
+ * callback raises EVENT_LCD_DONE, the handler then releases SCS and starts
+ * the next packet if more lines were marked meanwhile.
+ */
+#define INCLUDE_LOG_DEBUG     1
+#include "log.h"
+#include "src/lcd_dma.h"
+#include "dmd.h"
+#include "sl_memlcd.h"
+#include "sl_memlcd_usart_config.h"
+#include "sl_udelay.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+#include "em_core.h"
+#include <string.h>
+
+static uint8_t packet[LCD_DMA_MAX_PACKET];        // LDMA source, stable while busy
+static uint32_t pendingLines[LCD_DMA_LINE_WORDS]; // bit n set: LCD line n to send
+static unsigned int lcdDmaChannel;
+static bool channelAllocated = false;
+static volatile bool busy = false;
+static lcd_dma_stats_t stats;
+
+/**
+ * @brief Builds a multiple line update packet from the framebuffer.
+ *
+ * The bits of the lines that are copied are cleared from lines, at most
+ * LCD_DMA_MAX_LINES are taken so the packet fits one LDMA descriptor. The
+ * bytes are in the order they go out on the wire. The USART is switched to
+ * LSB first for the transfer, so the line address needs no bit reversal.
+ *
+ * @param frameBuffer LCD_DMA_HEIGHT lines of LCD_DMA_LINE_BYTES each.
+ * @param lines       LCD_DMA_LINE_WORDS words, bit n set for LCD line n.
+ * @param packet      At least LCD_DMA_MAX_PACKET bytes.
+ * @return Packet length in bytes, 0 if no line was marked.
+ */
+uint32_t lcdDmaBuildPacket(const uint8_t *frameBuffer, uint32_t *lines, uint8_t *packet)
+{
+  uint32_t len = 0;
+  uint32_t count = 0;
+  uint32_t line;
+  uint32_t word;
+
+  for (word = 0; word < LCD_DMA_LINE_WORDS && count < LCD_DMA_MAX_LINES; word++) {
+      while (lines[word] != 0 && count < LCD_DMA_MAX_LINES) {
+          line = word * 32 + __builtin_ctz(lines[word]);
+          lines[word] &= lines[word] - 1;
+
+          if (len == 0) {
+              packet[len++] = LCD_DMA_CMD_UPDATE;
+          }
+          packet[len++] = (uint8_t) (line + 1); // gate lines are numbered from 1
+          memcpy(&packet[len], &frameBuffer[line * LCD_DMA_LINE_BYTES], LCD_DMA_LINE_BYTES);
+          len += LCD_DMA_LINE_BYTES;
+          packet[len++] = LCD_DMA_DUMMY;
+          count++;
+      }
+  }
+
+  if (len != 0) {
+      packet[len++] = LCD_DMA_DUMMY; // end of the multiple line update
+  }
+
+  return len;
+}
+
+/**
+ * @brief LDMA callback, runs in interrupt context once the last byte is in
+ *        the USART transmit buffer. The handler finishes the frame.
+ */
+static bool lcdDmaCallback(unsigned int channel, unsigned int sequenceNo, void *userParam)
+{
+  (void) channel;
+  (void) sequenceNo;
+  (void) userParam;
+
+  schedulerSetEvent(EVENT_LCD_DONE);
+
+  return true;
+}
+
+/**
+ * @brief Allocates the LDMA channel, call after DMD_init().
+ */
+void lcdDmaInit(void)
+{
+  Ecode_t ecode;
+
+  memset(pendingLines, 0, sizeof(pendingLines));
+  memset(&stats, 0, sizeof(stats));
+  busy = false;
+
+  if (channelAllocated) {
+      return;
+  }
+
+  // DMADRV may already be up for the VCOM driver or the ADC stream
+  ecode = DMADRV_Init();
+  if (ecode != ECODE_EMDRV_DMADRV_OK && ecode != ECODE_EMDRV_DMADRV_ALREADY_INITIALIZED) {
+      LOG_ERROR("DMADRV_Init failed: 0x%04x\n\r", (unsigned int) ecode);
+      return;
+  }
+  ecode = DMADRV_AllocateChannel(&lcdDmaChannel, NULL);
+  if (ecode != ECODE_EMDRV_DMADRV_OK) {
+      LOG_ERROR("DMADRV_AllocateChannel failed: 0x%04x\n\r", (unsigned int) ecode);
+      return;
+  }
+  channelAllocated = true;
+}
+
+/**
+ * @brief Marks LCD lines to be sent by the next lcdDmaStart().
+ *
+ * @param first First LCD line, 0 based.
+ * @param count Number of lines, clipped to the display height.
+ */
+void lcdDmaMarkLines(uint32_t first, uint32_t count)
+{
+  uint32_t line;
+
+  for (line = first; line < first + count && line < LCD_DMA_HEIGHT; line++) {
+      pendingLines[line / 32] |= (1UL << (line % 32));
+  }
+}
+
+/**
+ * @brief Starts sending the marked lines.
+ *
+ * Returns at once, the CPU is held in EM1 until the transfer completes since
+ * USART1 needs the HF clock. If a transfer is already running the lines stay
+ * marked and go out when it completes.
+ */
+void lcdDmaStart(void)
+{
+  const sl_memlcd_t *device = sl_memlcd_get();
+  void *frameBuffer;
+  uint32_t len;
+  uint32_t i;
+  Ecode_t ecode;
+
+  if (busy) {
+      stats.deferred++;
+      return;
+  }
+  if (!channelAllocated || device == NULL || DMD_getFrameBuffer(&frameBuffer) != DMD_OK) {
+      return;
+  }
+
+  len = lcdDmaBuildPacket((const uint8_t *) frameBuffer, pendingLines, packet);
+  if (len == 0) {
+      return;
+  }
+
+  busy = true;
+  sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM1);
+
+  // The memlcd driver runs USART1 MSB first and reverses every byte in
+  // software, the LDMA cannot do that so the USART shifts LSB first instead
+  SL_MEMLCD_SPI_PERIPHERAL->CTRL &= ~USART_CTRL_MSBF;
+
+  GPIO_PinOutSet(SL_MEMLCD_SPI_CS_PORT, SL_MEMLCD_SPI_CS_PIN);
+  sl_udelay_wait(device->setup_us);
+
+  ecode = DMADRV_MemoryPeripheral(lcdDmaChannel, dmadrvPeripheralSignal_USART1_TXBL,
+                                  (void *) &SL_MEMLCD_SPI_PERIPHERAL->TXDATA, packet,
+                                  true, len, dmadrvDataSize1,
+                                  lcdDmaCallback, NULL);
+  if (ecode != ECODE_EMDRV_DMADRV_OK) {
+      LOG_ERROR("DMADRV_MemoryPeripheral failed: 0x%04x\n\r", (unsigned int) ecode);
+      stats.errors++;
+
+      // Put the lines of the packet back, they go out with the next refresh
+      for (i = 1; i < len - 1; i += LCD_DMA_LINE_PACKET) {
+          lcdDmaMarkLines(packet[i] - 1, 1);
+      }
+      GPIO_PinOutClear(SL_MEMLCD_SPI_CS_PORT, SL_MEMLCD_SPI_CS_PIN);
+      SL_MEMLCD_SPI_PERIPHERAL->CTRL |= USART_CTRL_MSBF;
+      sl_power_manager_remove_em_requirement(SL_POWER_MANAGER_EM1);
+      busy = false;
+      return;
+  }
+
+  stats.transfers++;
+  stats.lines += (len - 2) / LCD_DMA_LINE_PACKET;
+  stats.bytes += len;
+}
+
+/**
+ * @brief True while a packet is being sent.
+ */
+bool lcdDmaBusy(void)
+{
+  return busy;
+}
+
+/**
+ * @brief Scheduler handler for EVENT_LCD_DONE.
+ *
+ * The LDMA is done once the last byte is loaded, the USART still shifts out
+ * up to two bytes, so wait for TXC before the SCS hold time. Lines marked
+ * while the packet was on the wire are sent right away.
+ */
+void lcdDmaHandler(Events_t evt)
+{
+  const sl_memlcd_t *device = sl_memlcd_get();
+  USART_TypeDef *usart = SL_MEMLCD_SPI_PERIPHERAL;
+
+  if (evt != EVENT_LCD_DONE || !busy) {
+      return;
+  }
+
+  while (!(usart->STATUS & USART_STATUS_TXC))
+    ;
+  sl_udelay_wait(device->hold_us);
+  GPIO_PinOutClear(SL_MEMLCD_SPI_CS_PORT, SL_MEMLCD_SPI_CS_PIN);
+
+  // Restore the driver's settings and drop what was clocked in
+  usart->CTRL |= USART_CTRL_MSBF;
+  usart->CMD = USART_CMD_CLEARRX;
+
+  busy = false;
+  sl_power_manager_remove_em_requirement(SL_POWER_MANAGER_EM1);
+
+  lcdDmaStart();
+}
+
+const lcd_dma_stats_t* lcdDmaGetStats(void)
+{
+  return &stats;
+}
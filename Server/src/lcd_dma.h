@@ -0,0 +1,60 @@
+/***********************************************************************
+ * @file      lcd_dma.h
+ * @version   0.1
+ * @brief     Function header/interface file.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 9, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources Sharp LS013B7DH03 datasheet, multiple line data update mode
+ *
+ */
+
+#ifndef SRC_LCD_DMA_H_
+#define SRC_LCD_DMA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "dmadrv.h"
+#include "src/scheduler.h"
+
+// 1 = send the changed LCD lines through LDMA and sleep in EM1 meanwhile,
+// 0 = blocking DMD_updateDisplay() of the whole dirty area
+#define LCD_DMA_ENABLE          1
+
+#define LCD_DMA_WIDTH           128  // pixels per line, LS013B7DH03
+#define LCD_DMA_HEIGHT          128  // lines
+#define LCD_DMA_LINE_BYTES      (LCD_DMA_WIDTH / 8)
+#define LCD_DMA_LINE_WORDS      (LCD_DMA_HEIGHT / 32)
+
+// Packet: mode byte, then address + data + dummy byte per line, then one
+// trailing dummy byte. Lines past what fits one LDMA descriptor are left
+// pending for the next transfer.
+#define LCD_DMA_CMD_UPDATE      0x01
+#define LCD_DMA_DUMMY           0xFF
+#define LCD_DMA_LINE_PACKET     (1 + LCD_DMA_LINE_BYTES + 1)
+#define LCD_DMA_MAX_LINES       ((DMADRV_MAX_XFER_COUNT - 2) / LCD_DMA_LINE_PACKET)
+#define LCD_DMA_MAX_PACKET      (2 + LCD_DMA_MAX_LINES * LCD_DMA_LINE_PACKET)
+
+typedef struct {
+  uint32_t transfers;       // packets handed to the LDMA
+  uint32_t lines;           // LCD lines sent
+  uint32_t bytes;           // SPI bytes sent, mode and dummy bytes included
+  uint32_t deferred;        // refreshes requested while a transfer was running
+  uint32_t errors;          // DMADRV failures, the lines stay pending
+} lcd_dma_stats_t;
+
+uint32_t lcdDmaBuildPacket(const uint8_t *frameBuffer, uint32_t *lines, uint8_t *packet);
+void lcdDmaInit(void);
+void lcdDmaMarkLines(uint32_t first, uint32_t count);
+void lcdDmaStart(void);
+bool lcdDmaBusy(void);
+void lcdDmaHandler(Events_t evt);
+const lcd_dma_stats_t* lcdDmaGetStats(void);
+
+#endif /* SRC_LCD_DMA_H_ */
@@ -0,0 +1,181 @@
+/***********************************************************************
+ * @file      lcd_text.c
+ * @version   0.1
+ * @brief     Word wide text blitter for the narrow 6x8 font.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 10, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources glib_string.c, dmd_memlcd.c framebuffer layout
+ *
+ * GLIB_drawStringOnLine() goes through GLIB_drawChar(), which clips and
+ * writes every pixel of every glyph with its own DMD_writeColor() call. Our
+ * rows are always one line of fixed width text, so instead each pixel line
+ * of a text row is built once as four 32-bit words of glyph bits, then
+ * merged into the framebuffer under the mask of the text box:
+ *
+ *   framebuffer line: pixel x is bit (x & 7) of byte (x >> 3), 1 = white
+ *
+ * which on this little endian core is bit (x & 31) of word (x >> 5).
+ * Unchanged rows are not redrawn at all, lcd.c keeps the text of every row
+ * and only flushes the ones displayPrintf() changed.
+ */
+#include "src/lcd_text.h"
+#include "src/scheduler.h"
+#include "dmd.h"
+#include <string.h>
+
+#if SCHEDULER_ENABLE_STATS
+#define LCD_TEXT_CYCLES()   (DWT->CYCCNT)   // started by schedulerInit()
+#else
+#define LCD_TEXT_CYCLES()   0
+#endif
+
+// DMD_writeColor() sets a monochrome pixel from the green channel
+#define LCD_TEXT_PIXEL_BIT(color)   ((((color) >> 8) & 0xFF) ? 1 : 0)
+
+static lcd_text_stats_t stats;
+
+/**
+ * @brief ORs up to 32 bits into a pixel line at pixel position pos.
+ */
+static inline void lcdTextOrBits(uint32_t *words, uint32_t pos, uint32_t bits)
+{
+  uint32_t word = pos >> 5;
+  uint32_t shift = pos & 31;
+
+  words[word] |= bits << shift;
+  if (shift != 0 && word + 1 < LCD_TEXT_LINE_WORDS) {
+      words[word + 1] |= bits >> (32 - shift);
+  }
+}
+
+/**
+ * @brief True if the row can be blitted: byte wide FullFont glyphs no wider
+ *        than 8 pixels, on a full width framebuffer, inside the display.
+ */
+static bool lcdTextCanBlit(const GLIB_Context_t *pContext, uint32_t pixels, uint32_t y)
+{
+  const GLIB_Font_t *font = &pContext->font;
+
+  return (font->fontClass == FullFont)
+         && (font->sizeOfMapElement == 1)
+         && (font->fontWidth <= 8)
+         && (font->charSpacing == 0)
+         && (pContext->pDisplayGeometry->xSize == LCD_DMA_WIDTH)
+         && (pixels <= LCD_DMA_WIDTH)
+         && (y + font->fontHeight <= LCD_DMA_HEIGHT);
+}
+
+/**
+ * @brief Draws text opaque at (x0, y) straight into the framebuffer.
+ *
+ * Characters outside the font are drawn as spaces, GLIB would skip them.
+ */
+static EMSTATUS lcdTextBlit(const GLIB_Context_t *pContext, const char *text, uint32_t len,
+                            uint32_t x0, uint32_t y)
+{
+  const GLIB_Font_t *font = &pContext->font;
+  const uint8_t *pixMap = (const uint8_t *) font->pFontPixMap;
+  uint32_t width = font->fontWidth;
+  uint32_t glyphMask = (1UL << width) - 1;
+  uint32_t fgBit = LCD_TEXT_PIXEL_BIT(pContext->foregroundColor);
+  uint32_t bgBit = LCD_TEXT_PIXEL_BIT(pContext->backgroundColor);
+  uint8_t glyph[LCD_TEXT_MAX_CHARS];
+  uint32_t box[LCD_TEXT_LINE_WORDS] = {0};
+  uint32_t ink[LCD_TEXT_LINE_WORDS];
+  uint32_t line[LCD_TEXT_LINE_WORDS];
+  uint32_t pixels;
+  uint8_t *frameBuffer;
+  uint32_t i;
+  uint32_t r;
+  uint32_t w;
+
+  if (DMD_getFrameBuffer((void **) &frameBuffer) != DMD_OK) {
+      return GLIB_ERROR_INVALID_ARGUMENT;
+  }
+
+  // Glyph index and box mask are the same for every pixel line
+  for (i = 0; i < len; i++) {
+      glyph[i] = (uint8_t) (text[i] - ' ');
+      if ((text[i] < ' ') || (glyph[i] >= font->fontRowOffset)) {
+          glyph[i] = 0;
+      }
+      lcdTextOrBits(box, x0 + i * width, glyphMask);
+  }
+
+  for (r = 0; r < font->fontHeight; r++) {
+      memset(ink, 0, sizeof(ink));
+      for (i = 0; i < len; i++) {
+          lcdTextOrBits(ink, x0 + i * width, pixMap[glyph[i] + r * font->fontRowOffset] & glyphMask);
+      }
+
+      memcpy(line, &frameBuffer[(y + r) * LCD_DMA_LINE_BYTES], LCD_DMA_LINE_BYTES);
+      for (w = 0; w < LCD_TEXT_LINE_WORDS; w++) {
+          pixels = (fgBit ? ink[w] : 0) | (bgBit ? ~ink[w] : 0);
+          line[w] = (line[w] & ~box[w]) | (pixels & box[w]);
+      }
+      memcpy(&frameBuffer[(y + r) * LCD_DMA_LINE_BYTES], line, LCD_DMA_LINE_BYTES);
+  }
+
+  return GLIB_OK;
+}
+
+/**
+ * @brief Draws one text row centered and opaque, like
+ *        GLIB_drawStringOnLine(pContext, text, row, GLIB_ALIGN_CENTER, 0, 0, true).
+ *
+ * Falls back to GLIB when the font or geometry is not supported by the
+ * blitter. The cycles of either path are recorded for comparison.
+ *
+ * @param pContext GLIB context holding the font and colors.
+ * @param text     Null terminated text.
+ * @param row      Text row, y = row * (fontHeight + lineSpacing).
+ * @return GLIB_OK or the GLIB error code.
+ */
+EMSTATUS lcdTextDrawRow(GLIB_Context_t *pContext, const char *text, uint8_t row)
+{
+  uint32_t start = LCD_TEXT_CYCLES();
+  uint32_t cycles;
+  uint32_t len = strlen(text);
+  uint32_t pixels = len * pContext->font.fontWidth;
+  uint32_t y = row * (pContext->font.fontHeight + pContext->font.lineSpacing);
+  EMSTATUS status;
+
+#if LCD_TEXT_FAST
+  if ((len <= LCD_TEXT_MAX_CHARS) && lcdTextCanBlit(pContext, pixels, y)) {
+      status = lcdTextBlit(pContext, text, len, (LCD_DMA_WIDTH - pixels) / 2, y);
+
+      cycles = LCD_TEXT_CYCLES() - start;
+      stats.fast_rows++;
+      stats.fast_cycles_last = cycles;
+      if (cycles > stats.fast_cycles_max) {
+          stats.fast_cycles_max = cycles;
+      }
+      return status;
+  }
+#else
+  (void) pixels;
+  (void) y;
+#endif
+
+  status = GLIB_drawStringOnLine(pContext, text, row, GLIB_ALIGN_CENTER, 0, 0, true);
+
+  cycles = LCD_TEXT_CYCLES() - start;
+  stats.glib_rows++;
+  stats.glib_cycles_last = cycles;
+  if (cycles > stats.glib_cycles_max) {
+      stats.glib_cycles_max = cycles;
+  }
+  return status;
+}
+
+const lcd_text_stats_t* lcdTextGetStats(void)
+{
+  return &stats;
+}
@@ -0,0 +1,50 @@
+/***********************************************************************
+ * @file      lcd_text.h
+ * @version   0.1
+ * @brief     Function header/interface file.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 10, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ */
+
+#ifndef SRC_LCD_TEXT_H_
+#define SRC_LCD_TEXT_H_
+
+#include <stdint.h>
+#include "glib.h"
+#include "src/lcd_dma.h"
+
+// 1 = draw text rows straight into the framebuffer a word at a time,
+// 0 = GLIB_drawStringOnLine(), one GLIB_drawPixel() call per pixel.
+// The fast path bypasses the DMD dirty line flags, so it needs the LDMA
+// refresh which is told the lines by displayFlush().
+#define LCD_TEXT_FAST           1
+
+#if LCD_TEXT_FAST && !LCD_DMA_ENABLE
+#error "LCD_TEXT_FAST requires LCD_DMA_ENABLE"
+#endif
+
+#define LCD_TEXT_LINE_WORDS     (LCD_DMA_LINE_BYTES / 4)
+#define LCD_TEXT_MAX_CHARS      32   // longest row the blitter takes, longer rows go to GLIB
+
+typedef struct {
+  uint32_t fast_rows;         // rows drawn by the blitter
+  uint32_t glib_rows;         // rows drawn by GLIB, font or geometry not supported
+  uint32_t fast_cycles_last;  // CPU cycles for the last blitted row
+  uint32_t fast_cycles_max;
+  uint32_t glib_cycles_last;  // CPU cycles for the last GLIB row
+  uint32_t glib_cycles_max;
+} lcd_text_stats_t;
+
+EMSTATUS lcdTextDrawRow(GLIB_Context_t *pContext, const char *text, uint8_t row);
+const lcd_text_stats_t* lcdTextGetStats(void);
+
+#endif /* SRC_LCD_TEXT_H_ */
@@ -0,0 +1,176 @@
+/***********************************************************************
+ * @file      link.c
+ * @version   0.1
+ * @brief     PHY, data length and ATT MTU negotiation.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 5, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ * Connections open on 1M PHY with 27 octet link layer PDUs and a 23 byte
+ * ATT MTU. Once a link is up the 2M PHY and the largest data length are
+ * requested, the stack runs the MTU exchange itself from the maximum set at
+ * boot. Each result is recorded per connection as it arrives so the senders
+ * can size their payloads from linkGetPayloadBudget().
+ */
+
+#define INCLUDE_LOG_DEBUG     1
+#include "log.h"
+#include "src/link.h"
+#include "sl_bt_api.h"
+
+static link_info_t linkInfo[LINK_MAX_CONNECTIONS];
+
+/**
+ * @brief Entry of an open connection, NULL if the handle is unknown.
+ */
+static link_info_t* linkFind(uint8_t connection)
+{
+  uint8_t i;
+
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      if (linkInfo[i].open && (linkInfo[i].connection == connection)) {
+          return &linkInfo[i];
+      }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Call on sl_bt_evt_system_boot_id, sets the largest MTU the server
+ *        accepts in the exchange.
+ */
+void linkInit(void)
+{
+  sl_status_t rc;
+  uint16_t maxMtu;
+  uint8_t i;
+
+  for (i = 0; i < LINK_MAX_CONNECTIONS; i++) {
+      linkInfo[i].open = false;
+  }
+
+  rc = sl_bt_gatt_server_set_max_mtu(LINK_MAX_MTU, &maxMtu);
+  if (rc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_gatt_server_set_max_mtu() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+  }
+}
+
+/**
+ * @brief Call on sl_bt_evt_connection_opened_id, requests 2M PHY and the
+ *        largest link layer PDU. Either request may be refused by the peer,
+ *        the link then stays on what the events report.
+ */
+void linkOnOpened(uint8_t connection)
+{
+  sl_status_t rc;
+  link_info_t *info = linkFind(connection);
+  uint8_t i;
+
+  for (i = 0; (info == NULL) && (i < LINK_MAX_CONNECTIONS); i++) {
+      if (!linkInfo[i].open) {
+          info = &linkInfo[i];
+      }
+  }
+  if (info == NULL) {
+      LOG_ERROR("linkOnOpened: no free entry for connection %d\n\r", connection);
+      return;
+  }
+
+  info->open = true;
+  info->connection = connection;
+  info->phy = sl_bt_gap_phy_1m;
+  info->mtu = LINK_DEFAULT_MTU;
+  info->tx_data_len = LINK_DEFAULT_DATA_LEN;
+  info->rx_data_len = LINK_DEFAULT_DATA_LEN;
+
+  // Coded PHY is left out, it would cut the throughput instead of raising it
+  rc = sl_bt_connection_set_preferred_phy(connection, sl_bt_gap_phy_2m,
+                                          sl_bt_gap_phy_1m | sl_bt_gap_phy_2m);
+  if (rc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_connection_set_preferred_phy() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+  }
+
+  rc = sl_bt_connection_set_data_length(connection, LINK_MAX_DATA_LEN, LINK_MAX_TX_TIME_US);
+  if (rc != SL_STATUS_OK) {
+      LOG_ERROR("sl_bt_connection_set_data_length() returned != 0 status=0x%04x\n\r", (unsigned int) rc);
+  }
+}
+
+void linkOnClosed(uint8_t connection)
+{
+  link_info_t *info = linkFind(connection);
+
+  if (info != NULL) {
+      info->open = false;
+  }
+}
+
+/**
+ * @brief Call on sl_bt_evt_connection_phy_status_id.
+ */
+void linkOnPhy(uint8_t connection, uint8_t phy)
+{
+  link_info_t *info = linkFind(connection);
+
+  if (info != NULL) {
+      info->phy = phy;
+      LOG_INFO("Link %d PHY %d\n\r", connection, phy);
+  }
+}
+
+/**
+ * @brief Call on sl_bt_evt_connection_data_length_id.
+ */
+void linkOnDataLength(uint8_t connection, uint16_t txDataLen, uint16_t rxDataLen)
+{
+  link_info_t *info = linkFind(connection);
+
+  if (info != NULL) {
+      info->tx_data_len = txDataLen;
+      info->rx_data_len = rxDataLen;
+      LOG_INFO("Link %d data length tx %d rx %d\n\r", connection, txDataLen, rxDataLen);
+  }
+}
+
+/**
+ * @brief Call on sl_bt_evt_gatt_mtu_exchanged_id.
+ */
+void linkOnMtu(uint8_t connection, uint16_t mtu)
+{
+  link_info_t *info = linkFind(connection);
+
+  if (info != NULL) {
+      info->mtu = mtu;
+      LOG_INFO("Link %d MTU %d\n\r", connection, mtu);
+  }
+}
+
+/**
+ * @brief Negotiated state of a connection, NULL if it is not open.
+ */
+const link_info_t* linkGetInfo(uint8_t connection)
+{
+  return linkFind(connection);
+}
+
+/**
+ * @brief Largest characteristic value that fits one notification or
+ *        indication on the connection, the ATT MTU less the 3 byte header.
+ */
+uint16_t linkGetPayloadBudget(uint8_t connection)
+{
+  link_info_t *info = linkFind(connection);
+
+  if (info == NULL) {
+      return LINK_DEFAULT_MTU - 3;
+  }
+  return info->mtu - 3;
+}
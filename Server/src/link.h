@@ -0,0 +1,50 @@
+/***********************************************************************
+ * @file      link.h
+ * @version   0.1
+ * @brief     Function header/interface file.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 5, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ */
+
+#ifndef SRC_LINK_H_
+#define SRC_LINK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LINK_MAX_CONNECTIONS   2      // centrals served at once, at most SL_BT_CONFIG_MAX_CONNECTIONS
+#define LINK_MAX_MTU           247    // largest ATT MTU the stack supports
+#define LINK_MAX_DATA_LEN      251    // LL payload octets with DLE
+#define LINK_MAX_TX_TIME_US    2120   // air time of a 251 octet PDU on 1M, the stack shortens it on 2M
+#define LINK_DEFAULT_MTU       23
+#define LINK_DEFAULT_DATA_LEN  27
+
+// Negotiated capabilities of one connection
+typedef struct {
+  bool     open;
+  uint8_t  connection;
+  uint8_t  phy;           // sl_bt_gap_phy_1m, sl_bt_gap_phy_2m or sl_bt_gap_phy_coded
+  uint16_t mtu;           // ATT MTU
+  uint16_t tx_data_len;   // LL payload octets the controller sends per PDU
+  uint16_t rx_data_len;   // LL payload octets the controller accepts per PDU
+} link_info_t;
+
+void linkInit(void);
+void linkOnOpened(uint8_t connection);
+void linkOnClosed(uint8_t connection);
+void linkOnPhy(uint8_t connection, uint8_t phy);
+void linkOnDataLength(uint8_t connection, uint16_t txDataLen, uint16_t rxDataLen);
+void linkOnMtu(uint8_t connection, uint16_t mtu);
+const link_info_t* linkGetInfo(uint8_t connection);
+uint16_t linkGetPayloadBudget(uint8_t connection);
+
+#endif /* SRC_LINK_H_ */
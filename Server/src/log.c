@@ -21,7 +21,15 @@
 */
 
 
+// printSLErrorString() prints a RAM string, so this file keeps the
+// synchronous app_log() path. Defined ahead of every include since
+// src/ble.h pulls in log.h.
+#define LOG_DEFERRED      0
+
 #include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include "em_device.h"
 #include "src/irq.h"
 
 // Include logging for this file
@@ -29,6 +37,21 @@
 #include "log.h"
 
 
+// Entry: header, timestamp, format address, __func__ address, arguments.
+// Header bits 31..24 magic, 23..16 level, 15..8 nargs, 7..0 length in words.
+#define LOG_RING_MASK          (LOG_RING_WORDS - 1)
+#define LOG_HEADER_MAGIC       0xB1000000UL
+#define LOG_HEADER_MAGIC_MASK  0xFF000000UL
+#define LOG_ENTRY_FIXED_WORDS  4
+#define LOG_ENTRY_MAX_WORDS    (LOG_ENTRY_FIXED_WORDS + LOG_MAX_ARGS)
+
+static uint32_t logRing[LOG_RING_WORDS];
+static volatile uint32_t logHead = 0;   // next free word, advanced by producers
+static volatile uint32_t logTail = 0;   // next word to send, advanced by logDrain()
+static log_stats_t logStats;
+static uint32_t droppedReported = 0;
+
+
 
 /**
  * @return a timestamp value for the logging functions, typically based on a
@@ -81,5 +104,156 @@ void printSLErrorString(sl_status_t status) {
 
 
 
+// Increment that can be interrupted by another producer without losing counts
+static void logAtomicInc(volatile uint32_t *counter)
+{
+  uint32_t value;
+
+  do {
+      value = __LDREXW(counter);
+  } while (__STREXW(value + 1, counter) != 0);
+}
+
+
+
+/**
+ * Records one log entry in the ring, callable from ISRs and the main loop.
+ * Use LOG_ERROR(), LOG_WARN() and LOG_INFO(), they pass the level, the
+ * format literal, __func__ and the argument count.
+ *
+ * The words are reserved with LDREX/STREX, so a producer interrupted by
+ * another just ends up one entry earlier in the ring. The header is written
+ * last, logDrain() does not pass an entry whose header is not there yet.
+ * When the ring is full the entry is dropped and counted.
+ */
+void logDeferred(uint32_t level, const char *format, const char *func, uint32_t nargs, ...)
+{
+  va_list     va;
+  uint32_t    len;
+  uint32_t    head;
+  uint32_t    i;
+
+  if (nargs > LOG_MAX_ARGS) {
+      nargs = LOG_MAX_ARGS;
+  }
+  len = LOG_ENTRY_FIXED_WORDS + nargs;
+
+  do {
+      head = __LDREXW((volatile uint32_t *) &logHead);
+      if ((head + len - logTail) > LOG_RING_WORDS) {
+          __CLREX();
+          logAtomicInc(&logStats.dropped);
+          return;
+      }
+  } while (__STREXW(head + len, (volatile uint32_t *) &logHead) != 0);
+
+  logRing[(head + 1) & LOG_RING_MASK] = loggerGetTimestamp();
+  logRing[(head + 2) & LOG_RING_MASK] = (uint32_t) format;
+  logRing[(head + 3) & LOG_RING_MASK] = (uint32_t) func;
+
+  // Every argument is promoted to at least int, all 32 bits on this core
+  va_start(va, nargs);
+  for (i = 0; i < nargs; i++) {
+      logRing[(head + LOG_ENTRY_FIXED_WORDS + i) & LOG_RING_MASK] = va_arg(va, uint32_t);
+  }
+  va_end(va);
+
+  __DMB();
+  logRing[head & LOG_RING_MASK] = LOG_HEADER_MAGIC | (level << 16) | (nargs << 8) | len;
+
+  logAtomicInc(&logStats.logged);
+
+} // logDeferred()
+
+
+
+// Writes one frame: sync bytes, word count, words little endian
+static void logSendFrame(const uint32_t *words, uint32_t len)
+{
+  uint8_t     frame[3 + LOG_ENTRY_MAX_WORDS * 4];
 
+  frame[0] = LOG_FRAME_SYNC0;
+  frame[1] = LOG_FRAME_SYNC1;
+  frame[2] = (uint8_t) len;
+  memcpy(&frame[3], words, len * 4); // little endian core
 
+  sl_iostream_write(app_log_iostream_get(), frame, 3 + len * 4);
+}
+
+
+
+/**
+ * Sends up to LOG_DRAIN_MAX complete entries over VCOM. Call from the main
+ * loop only, app_process_action() calls it before the MCU goes back to
+ * sleep. If entries were dropped since the last call an entry with a zero
+ * format address and the number lost is sent first.
+ */
+void logDrain(void)
+{
+  uint32_t    entry[LOG_ENTRY_MAX_WORDS];
+  uint32_t    dropped;
+  uint32_t    tail;
+  uint32_t    len;
+  uint32_t    i;
+  uint32_t    n;
+
+  dropped = logStats.dropped;
+  if (dropped != droppedReported) {
+      entry[0] = LOG_HEADER_MAGIC | (LOG_LEVEL_WARN << 16) | (1 << 8) | (LOG_ENTRY_FIXED_WORDS + 1);
+      entry[1] = loggerGetTimestamp();
+      entry[2] = 0;
+      entry[3] = 0;
+      entry[4] = dropped - droppedReported;
+      logSendFrame(entry, LOG_ENTRY_FIXED_WORDS + 1);
+      droppedReported = dropped;
+  }
+
+  for (n = 0; n < LOG_DRAIN_MAX; n++) {
+      tail = logTail;
+      if (tail == logHead) {
+          return;
+      }
+
+      entry[0] = logRing[tail & LOG_RING_MASK];
+      if ((entry[0] & LOG_HEADER_MAGIC_MASK) != LOG_HEADER_MAGIC) {
+          return; // reserved, the producer has not finished it
+      }
+      __DMB();
+
+      len = entry[0] & 0xFF;
+      for (i = 1; i < len; i++) {
+          entry[i] = logRing[(tail + i) & LOG_RING_MASK];
+      }
+
+      // Clear every word of the entry. A later entry may put its header on
+      // any of them, and an old argument that looks like a header would be
+      // taken for it before the producer has written the real one.
+      for (i = 0; i < len; i++) {
+          logRing[(tail + i) & LOG_RING_MASK] = 0;
+      }
+      __DMB();
+      logTail = tail + len;
+
+      logSendFrame(entry, len);
+      logStats.sent++;
+  }
+
+} // logDrain()
+
+
+
+/**
+ * True while entries are waiting, app_is_ok_to_sleep() keeps the main loop
+ * running until they are sent.
+ */
+bool logPending(void)
+{
+  return logTail != logHead;
+}
+
+
+
+const log_stats_t* logGetStats(void)
+{
+  return &logStats;
+}
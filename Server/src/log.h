@@ -13,6 +13,9 @@
  * Editor: Feb 26, 2022, Dave Sluiter
  * Change: Added comment about use of .h files.
  *
+ * Editor: May 11, 2025, Damini Gowda
+ * Change: Deferred binary logging, see LOG_DEFERRED.
+ *
  */
 
 // Students: Remember, a header file (a .h file) generally defines an interface
@@ -26,6 +29,7 @@
 #define SRC_LOG_H_
 #include "stdio.h"
 #include <inttypes.h>
+#include <stdbool.h>
 
 #include "app_log.h"   // for LOG_INFO() / printf() / app_log() output the VCOM port
 #include "sl_status.h" // for sl_status_print()
@@ -48,11 +52,77 @@
 
 
 
+// Deferred binary logging. A call only stores the address of the format
+// string, the address of __func__ and the raw 32-bit arguments in a RAM ring,
+// which is safe from ISRs. logDrain() sends the entries over VCOM when the
+// main loop is idle and tools/logdecode.py turns them back into text using
+// the strings in the ELF. At most LOG_MAX_ARGS arguments of 32 bits or
+// smaller: float, double and 64-bit arguments (%f, %lld) fail to compile, as
+// do 9 to 16 arguments. %s only works for strings in flash, a RAM string is
+// decoded as its address. A file that prints RAM strings defines
+// LOG_DEFERRED 0 before including log.h to keep the app_log() path.
+#ifndef LOG_DEFERRED
+#define LOG_DEFERRED        1
+#endif
+
+#define LOG_RING_WORDS      512   // power of two, 2 KB
+#define LOG_MAX_ARGS        8
+#define LOG_DRAIN_MAX       8     // entries sent per logDrain() call
+
+#define LOG_LEVEL_INFO      0
+#define LOG_LEVEL_WARN      1
+#define LOG_LEVEL_ERROR     2
+
+// Wire frame: sync bytes, word count, then the entry words little endian
+#define LOG_FRAME_SYNC0     0xA5
+#define LOG_FRAME_SYNC1     0x5A
+
+// Number of variadic arguments, 0 to 16
+#define LOG_NARGS(...) \
+  LOG_NARGS_(_, ##__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+
+// One argument fits a ring word: not floating point, at most 32 bits after
+// the default promotions. Arrays decay to pointers through the + 0.
+#define LOG_ARG_FITS(x) \
+  _Generic((x), float: 0, double: 0, long double: 0, default: sizeof((x) + 0) <= sizeof(uint32_t))
+#define LOG_ARGS_FIT_(_0, a1, a2, a3, a4, a5, a6, a7, a8, ...) \
+  (LOG_ARG_FITS(a1) && LOG_ARG_FITS(a2) && LOG_ARG_FITS(a3) && LOG_ARG_FITS(a4) && \
+   LOG_ARG_FITS(a5) && LOG_ARG_FITS(a6) && LOG_ARG_FITS(a7) && LOG_ARG_FITS(a8))
+
+// Argument count for logDeferred(), a negative array size stops the build
+// when the arguments do not fit an entry. Nothing is evaluated.
+#define LOG_CHECKED_NARGS(...) \
+  (LOG_NARGS(__VA_ARGS__) + 0 * sizeof(char[((LOG_NARGS(__VA_ARGS__) <= LOG_MAX_ARGS) && \
+    LOG_ARGS_FIT_(_, ##__VA_ARGS__, 0, 0, 0, 0, 0, 0, 0, 0)) ? 1 : -1]))
+
+// "Error", "Warn " and "Info " fold to a constant
+#define LOG_LEVEL_OF(level) \
+  ((level)[0] == 'E' ? LOG_LEVEL_ERROR : (level)[0] == 'W' ? LOG_LEVEL_WARN : LOG_LEVEL_INFO)
+
+typedef struct {
+  uint32_t logged;    // entries stored in the ring
+  uint32_t dropped;   // entries lost because the ring was full
+  uint32_t sent;      // entries written to VCOM by logDrain()
+} log_stats_t;
+
+// format attribute keeps the printf argument checks app_log() had
+void logDeferred(uint32_t level, const char *format, const char *func, uint32_t nargs, ...)
+  __attribute__((format(printf, 2, 5)));
+void logDrain(void);
+bool logPending(void);
+const log_stats_t* logGetStats(void);
+
 // File by file logging control
 #if INCLUDE_LOG_DEBUG
 
+#if LOG_DEFERRED
+#define LOG_DO(message,level, ...) \
+  logDeferred(LOG_LEVEL_OF(level), message, __func__, LOG_CHECKED_NARGS(__VA_ARGS__), ##__VA_ARGS__)
+#else
 #define LOG_DO(message,level, ...) \
   app_log( "%5"PRIu32":%s:%s: " message "\n", loggerGetTimestamp(), level, __func__, ##__VA_ARGS__ )
+#endif
 uint32_t loggerGetTimestamp (void);
 void     printSLErrorString (sl_status_t status);
 
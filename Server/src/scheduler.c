@@ -20,79 +20,93 @@
 
 #define INCLUDE_LOG_DEBUG   1
 #include "src/scheduler.h"
-
-static volatile Events_t event_flags = EVENT_NONE;  // Bit-field to track events
+#include "src/accel_fifo.h"
+#include <string.h>
+
+typedef struct {
+  uint32_t            eventMask;  // events this handler wants
+  scheduler_handler_t handler;
+} scheduler_registration_t;
+
+static volatile uint32_t event_flags = EVENT_NONE;  // Bit-field to track pending events
+static volatile bool     signal_posted = false;     // true while a batch signal is queued in the stack
+static scheduler_registration_t handlers[SCHEDULER_MAX_HANDLERS];
+static uint8_t           num_handlers = 0;
 static volatile uint8_t counter3s =0;
 extern uint8_t flag;
+
+#if SCHEDULER_ENABLE_STATS
+static scheduler_stats_t scheduler_stats;
+#define SCHEDULER_STAT_INC(field)   (scheduler_stats.field++)
+#else
+#define SCHEDULER_STAT_INC(field)
+#endif
+
 /**
- * @brief Sets the LETIMER0 underflow event in the scheduler event flags.
+ * @brief Initializes the scheduler event flags and handler table.
  *
- * This function is called from the interrupt service routine (ISR) for the LETIMER0
- * underflow event to mark that the event has occurred, allowing the main application
- * to process it during the next loop.
- *
- * @note This function modifies the global event flags in a critical section to
- *       prevent race conditions when accessing shared data.
+ * Must be called from app_init() before any interrupt that raises scheduler
+ * events is enabled. With SCHEDULER_ENABLE_STATS the DWT cycle counter is
+ * started so schedulerDispatch() can measure the cost of each batch.
  */
-void schedulerSetEventUF(void) {
-
-  sl_status_t rc = SL_STATUS_OK;
+void schedulerInit(void) {
 
   CORE_DECLARE_IRQ_STATE;
 
   CORE_ENTER_CRITICAL();
 
-  //event_flags |= EVENT_LETIMER_UF;
-  rc = sl_bt_external_signal(EVENT_LETIMER_UF);
-
-  if(rc != SL_STATUS_OK)
-    {
-    //  LOG_ERROR("sl_bt_external_signal failed:EVENT_LETIMER_UF\n\r");
-    }
+  event_flags = EVENT_NONE;
+  signal_posted = false;
+  num_handlers = 0;
 
   CORE_EXIT_CRITICAL();
+
+#if SCHEDULER_ENABLE_STATS
+  memset(&scheduler_stats, 0, sizeof(scheduler_stats));
+
+  // Start the cycle counter used to time dispatch batches
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
 }
 
 /**
- * @brief Sets the LETIMER COMP1 event in the scheduler event flags.
+ * @brief Registers a handler for one or more scheduler events.
  *
- * This function is called from the interrupt service routine (ISR) for the LETIMER0
- * COMP1 event to mark that the event has occurred, allowing the main application
- * to process it during the next loop.
+ * The handler is called from schedulerDispatch() once for every pending event
+ * bit that is set in eventMask. Several handlers may subscribe to the same
+ * event, they are called in registration order.
  *
- * @note This function modifies the global event flags in a critical section to
- *       prevent race conditions when accessing shared data.
+ * @param eventMask OR of the Events_t values the handler is interested in.
+ * @param handler   Function to call.
+ * @return true on success, false if the handler table is full.
  */
-void schedulerSetEventCOMP1(void) {
-
-  sl_status_t rc = SL_STATUS_OK;
+bool schedulerRegisterHandler(uint32_t eventMask, scheduler_handler_t handler) {
 
-  CORE_DECLARE_IRQ_STATE;
-
-  CORE_ENTER_CRITICAL();
-
-  //event_flags |= EVENT_LETIMER_COMP1;
-  rc =  sl_bt_external_signal(EVENT_LETIMER_COMP1);
+  if((handler == NULL) || (num_handlers >= SCHEDULER_MAX_HANDLERS)){
+      LOG_ERROR("schedulerRegisterHandler failed: table full\n\r");
+      return false;
+  }
 
-  if(rc != SL_STATUS_OK)
-    {
-   //   LOG_ERROR("sl_bt_external_signal failed:EVENT_LETIMER_COMP1\n\r");
-    }
+  handlers[num_handlers].eventMask = eventMask;
+  handlers[num_handlers].handler = handler;
+  num_handlers++;
 
-  CORE_EXIT_CRITICAL();
+  return true;
 }
 
 /**
- * @brief Sets the I2C transfer done event in the scheduler event flags.
+ * @brief Raises a scheduler event, callable from ISRs.
  *
- * This function is called from the interrupt service routine (ISR) for the I2C
- * transfer done event to mark that the event has occurred, allowing the main application
- * to process it during the next loop.
+ * The event bit is ORed into the pending set inside a critical section. Only
+ * the first event of a batch posts an external signal to the BLE stack, events
+ * raised before that signal is handled ride along in the same batch. If the
+ * signal cannot be posted the bit stays pending and the next event retries.
  *
- * @note This function modifies the global event flags in a critical section to
- *       prevent race conditions when accessing shared data.
+ * @param evt Event to raise.
  */
-void schedulerSetEventI2CDone(void) {
+void schedulerSetEvent(Events_t evt) {
 
   sl_status_t rc = SL_STATUS_OK;
 
@@ -100,188 +114,196 @@ void schedulerSetEventI2CDone(void) {
 
   CORE_ENTER_CRITICAL();
 
-  //event_flags |= EVENT_I2CTransfer_Done;
-  rc = sl_bt_external_signal(EVENT_I2CTransfer_Done);
-
-  if(rc != SL_STATUS_OK)
-    {
-  //    LOG_ERROR("sl_bt_external_signal failed:EVENT_I2CTransfer_Done\n\r");
-    }
+  SCHEDULER_STAT_INC(events_set);
+  if(event_flags & evt){
+      SCHEDULER_STAT_INC(events_coalesced);
+  }
+  event_flags |= evt;
+
+  if(signal_posted == false){
+      rc = sl_bt_external_signal(evt);
+      if(rc == SL_STATUS_OK){
+          signal_posted = true;
+          SCHEDULER_STAT_INC(signals_sent);
+      }else{
+          SCHEDULER_STAT_INC(signal_errors);
+      }
+  }
 
   CORE_EXIT_CRITICAL();
 }
 
 /**
- * @brief Signals that the BLE connection has been closed.
- *
- * This function sends an external signal to indicate that the BLE connection
- * has been closed. It ensures atomic access using critical section protection.
+ * @brief Sets the LETIMER0 underflow event in the scheduler event flags.
  *
- * @param None
- * @return None
+ * This function is called from the interrupt service routine (ISR) for the LETIMER0
+ * underflow event to mark that the event has occurred, allowing the main application
+ * to process it during the next loop.
  */
-void schedulerSetEventBleConnectionClose(void) {
-
-  sl_status_t rc = SL_STATUS_OK;
-
-  CORE_DECLARE_IRQ_STATE;
-
-  CORE_ENTER_CRITICAL();
+void schedulerSetEventUF(void) {
 
-  rc =  sl_bt_external_signal(EVENT_BLEConnectionClose);
+  schedulerSetEvent(EVENT_LETIMER_UF);
+}
 
-  if(rc != SL_STATUS_OK)
-    {
-//      LOG_ERROR("sl_bt_external_signal failed:EVENT_BLEConnectionClose\n\r");
-    }
+/**
+ * @brief Sets the LETIMER COMP1 event in the scheduler event flags.
+ *
+ * This function is called from the interrupt service routine (ISR) for the LETIMER0
+ * COMP1 event to mark that the event has occurred, allowing the main application
+ * to process it during the next loop.
+ */
+void schedulerSetEventCOMP1(void) {
 
-  CORE_EXIT_CRITICAL();
+  schedulerSetEvent(EVENT_LETIMER_COMP1);
 }
 
 /**
- * @brief Sets the event for PB0 press.
- *
- * This function generates an external signal for the PB0 button press event
- * and reports any errors if the signal fails to be set.
+ * @brief Sets the I2C transfer done event in the scheduler event flags.
  *
- * It enters a critical section to prevent race conditions while setting the signal.
+ * This function is called from the interrupt service routine (ISR) for the I2C
+ * transfer done event to mark that the event has occurred, allowing the main application
+ * to process it during the next loop.
  */
-void schedulerSetEventPB0(void) {
-
-  sl_status_t rc = SL_STATUS_OK;
+void schedulerSetEventI2CDone(void) {
 
-  CORE_DECLARE_IRQ_STATE;
+  schedulerSetEvent(EVENT_I2CTransfer_Done);
+}
 
-  CORE_ENTER_CRITICAL();
+/**
+ * @brief Signals that the BLE connection has been closed.
+ */
+void schedulerSetEventBleConnectionClose(void) {
 
-  rc =  sl_bt_external_signal(EVENT_PB0);
+  schedulerSetEvent(EVENT_BLEConnectionClose);
+}
 
-  if(rc != SL_STATUS_OK)
-    {
- //     LOG_ERROR("sl_bt_external_signal failed:EVENT_PB0\n\r");
-    }
+/**
+ * @brief Sets the event for PB0 press.
+ */
+void schedulerSetEventPB0(void) {
 
-  CORE_EXIT_CRITICAL();
+  schedulerSetEvent(EVENT_PB0);
 }
 
 void schedulerSetEvent0(void){
 
-  sl_status_t rc = SL_STATUS_OK;
-
-  CORE_DECLARE_IRQ_STATE;
-
-  CORE_ENTER_CRITICAL();
-
-  rc =  sl_bt_external_signal(EVENT_0DEGREE);
-
-  if(rc != SL_STATUS_OK)
-    {
- //     LOG_ERROR("sl_bt_external_signal failed:EVENT_0DEGREE\n\r");
-    }
-
-  CORE_EXIT_CRITICAL();
+  schedulerSetEvent(EVENT_0DEGREE);
 }
 
 void schedulerSetEvent45(void){
 
-  sl_status_t rc = SL_STATUS_OK;
-
-  CORE_DECLARE_IRQ_STATE;
-
-  CORE_ENTER_CRITICAL();
-
-  rc =  sl_bt_external_signal(EVENT_45DEGREE);
-
-  if(rc != SL_STATUS_OK)
-    {
-  //    LOG_ERROR("sl_bt_external_signal failed:EVENT_0DEGREE\n\r");
-    }
-
-  CORE_EXIT_CRITICAL();
+  schedulerSetEvent(EVENT_45DEGREE);
 }
 
 void schedulerSetEvent90(void){
 
-  sl_status_t rc = SL_STATUS_OK;
-
-  CORE_DECLARE_IRQ_STATE;
+  schedulerSetEvent(EVENT_90DEGREE);
+}
 
-  CORE_ENTER_CRITICAL();
+void schedulerSetEventAccelINT(void) {
 
-  rc =  sl_bt_external_signal(EVENT_90DEGREE);
+  schedulerSetEvent(EVENT_ACCELINT);
+}
 
-  if(rc != SL_STATUS_OK)
-    {
-//      LOG_ERROR("sl_bt_external_signal failed:EVENT_0DEGREE\n\r");
-    }
+void schedulerSetEventBLEDONE(void) {
 
-  CORE_EXIT_CRITICAL();
+  schedulerSetEvent(EVENT_BLEDONE);
 }
 
-void schedulerSetEventAccelINT(void) {
+/**
+ * @brief Retrieves all pending events and clears the event flags.
+ *
+ * Taking the batch also re-arms the external signal, so an event raised while
+ * the batch is being dispatched posts a new signal.
+ *
+ * @return uint32_t OR of the pending Events_t values, EVENT_NONE if nothing is pending.
+ *
+ * @note This function modifies the global event flags in a critical section to
+ *       ensure atomic access to shared data, preventing race conditions.
+ */
+uint32_t getNextEvent(void) {
 
-  sl_status_t rc = SL_STATUS_OK;
+  uint32_t theEvents = EVENT_NONE;
 
   CORE_DECLARE_IRQ_STATE;
 
   CORE_ENTER_CRITICAL();
 
-  rc =  sl_bt_external_signal(EVENT_ACCELINT);
-
-  if(rc != SL_STATUS_OK)
-    {
- //     LOG_ERROR("sl_bt_external_signal failed:EVENT_ACCELINT\n\r");
-    }
+  theEvents = event_flags;   // Get the current event flags
+  event_flags = EVENT_NONE;  // Clear the event flags
+  signal_posted = false;
 
   CORE_EXIT_CRITICAL();
-}
 
-void schedulerSetEventBLEDONE(void) {
+  return (theEvents);
+}
 
-  sl_status_t rc = SL_STATUS_OK;
+/**
+ * @brief Dispatches every pending event to its registered handlers.
+ *
+ * Call this on sl_bt_evt_system_external_signal_id. Events are delivered in
+ * priority order, lowest bit first, so one signal can carry any number of
+ * events without being misread.
+ */
+void schedulerDispatch(void) {
 
-  CORE_DECLARE_IRQ_STATE;
+  uint32_t pending;
+  uint32_t bit;
+  uint8_t  i;
+  bool     handled;
 
-  CORE_ENTER_CRITICAL();
+#if SCHEDULER_ENABLE_STATS
+  uint32_t startCycles = DWT->CYCCNT;
+#endif
 
-  rc =  sl_bt_external_signal(EVENT_BLEDONE);
+  pending = getNextEvent();
+  if(pending == EVENT_NONE){
+      return;
+  }
 
-  if(rc != SL_STATUS_OK)
-    {
-      LOG_ERROR("sl_bt_external_signal failed:EVENT_BLEDONE\n\r");
-    }
+  SCHEDULER_STAT_INC(batches);
 
-  CORE_EXIT_CRITICAL();
-}
-/**
- * @brief Retrieves the next event to be processed and clears the event flags.
- *
- * This function is used by the main application to fetch the next event that
- * has been set (e.g., LETIMER0 underflow event) and clears the event flag for
- * future use.
- *
- * @return uint32_t The event flags (can be used to check which event occurred).
- *
- * @note This function modifies the global event flags in a critical section to
- *       ensure atomic access to shared data, preventing race conditions.
- */
-Events_t getNextEvent(void) {
+  while(pending != EVENT_NONE){
 
-  Events_t theEvent;
+      // Isolate the lowest set bit, i.e. the highest priority event
+      bit = pending & (~pending + 1);
+      pending &= ~bit;
 
-  CORE_DECLARE_IRQ_STATE;
+      handled = false;
+      for(i = 0; i < num_handlers; i++){
+          if(handlers[i].eventMask & bit){
+              handlers[i].handler((Events_t) bit);
+              handled = true;
+          }
+      }
 
-  CORE_ENTER_CRITICAL();
+      if(handled){
+          SCHEDULER_STAT_INC(events_dispatched);
+      }else{
+          SCHEDULER_STAT_INC(events_unhandled);
+      }
+  }
 
-  if (event_flags != EVENT_NONE) {
-      theEvent = event_flags; // Get the current event flags
-      event_flags = EVENT_NONE;  // Clear the event flags
+#if SCHEDULER_ENABLE_STATS
+  scheduler_stats.dispatch_cycles_last = DWT->CYCCNT - startCycles;
+  if(scheduler_stats.dispatch_cycles_last > scheduler_stats.dispatch_cycles_max){
+      scheduler_stats.dispatch_cycles_max = scheduler_stats.dispatch_cycles_last;
   }
+#endif
+}
 
-  CORE_EXIT_CRITICAL();
+#if SCHEDULER_ENABLE_STATS
+/**
+ * @brief Returns the scheduler counters.
+ *
+ * events_coalesced counts events lost because the same bit was raised again
+ * before it was dispatched, e.g. during an ISR burst.
+ */
+const scheduler_stats_t* schedulerGetStats(void) {
 
-  return (theEvent);
+  return &scheduler_stats;
 }
+#endif
 
 #if (DEVICE_IS_BLE_SERVER == 0)
 
@@ -380,43 +402,58 @@ void discovery_state_machine(sl_bt_msg_t *evt){
 
 #else
 
-bool stateMachinePostureDetection(sl_bt_msg_t *levt){
+/**
+ * @brief Posture detection state machine, registered for EVENT_ACCELINT,
+ *        EVENT_BLEDONE and EVENT_LETIMER_UF.
+ *
+ * @param evt The event being dispatched by the scheduler.
+ */
+void stateMachinePostureDetection(Events_t evt){
 
-  uint32_t ext_sig = 0;
   static StatesP_t next_state = IDLE;
-
-  if(SL_BT_MSG_ID(levt->header) ==  sl_bt_evt_system_external_signal_id){
-      ext_sig =  levt->data.evt_system_external_signal.extsignals;
-  }else{
-      return false;
-  }
+  static uint32_t lastMotionMs;
 
   ble_data_struct_t* ble_params = get_ble_data_struct();
 
-  //Stop taking temperature measurement if BLE connection is closed or HTM indications are disabled.
-  if(ble_params->connection_open == false){
+  if(evt == EVENT_ACCELINT){
+      lastMotionMs = letimerMilliseconds();
+  }
+
+  //Stop sampling when nobody is listening. Without a connected client only
+  //broadcast observers can be, they get BROADCAST_SAMPLE_WINDOW_MS of samples
+  //after each motion. EVENT_LETIMER_UF ends the window once the wearer is still.
+  if((ble_params->connection_open == false) &&
+     (!broadcastWantsSamples() || ((letimerMilliseconds() - lastMotionMs) >= BROADCAST_SAMPLE_WINDOW_MS))){
+      adcStopSampling();
       next_state = IDLE;
-      return true;
+      return;
   }
 
   switch (next_state){
     case IDLE:
       //sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM3);
       next_state = WAIT_ACCELINT;
-      break;
+      if(evt != EVENT_ACCELINT){
+          break;
+      }
+      // fall through, handle the interrupt that woke us up
 
     case WAIT_ACCELINT:
-      if(ext_sig == EVENT_ACCELINT){
+      if(evt == EVENT_ACCELINT){
           //LOG_INFO(" Trasitioning from STATE_IDLE to WAIT_ACCELINT\n\r");
           displayPrintf(DISPLAY_ROW_11, "Tilt:true");
-          // Start first conversion
-          ADC_Start(ADC0, adcStartScan);
+          // Start first conversion, or the LDMA stream if it is not running yet
+          adcStartSampling();
+#if !ACCEL_FIFO_ENABLE
+          // Without FIFO streaming the tilt is sampled once per motion event
+          tiltReadAccelAsync();
+#endif
           next_state = WAIT_ACCELINT;
       }
       break;
 
     case STATE_ADCON:
-      if(ext_sig == EVENT_BLEDONE){
+      if(evt == EVENT_BLEDONE){
           //LOG_INFO(" Trasitioning from WAIT_ACCELINT to STATE_ADCON\n\r");
           displayPrintf(DISPLAY_ROW_11, "Tilt:false");
           //sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM3);
@@ -425,8 +462,6 @@ bool stateMachinePostureDetection(sl_bt_msg_t *levt){
       break;
   }
 
-  return true;
-
 }
 
 
@@ -23,31 +23,61 @@
 #define SRC_SCHEDULER_H_
 
 #include "sl_status.h"
-#include "src/i2c.h"
 #include "sl_power_manager.h"
-#include "src/ble.h"
 #include <stdbool.h>
 #include "em_core.h"
 #include "sl_bt_api.h"
-#include "src/adc.h"
 
 
 #define MAX_EVENTS 4
 
+// Scheduler events are one bit each so that several events raised before the
+// BLE stack delivers the external signal are coalesced into a single batch
+// without aliasing. The bit position is also the dispatch priority, the lowest
+// set bit is dispatched first.
 typedef enum{
-  EVENT_NONE,
-  EVENT_LETIMER_UF,
-  EVENT_LETIMER_COMP1,
-  EVENT_I2CTransfer_Done,
-  EVENT_BLEConnectionClose,
-  EVENT_PB0,
-  EVENT_0DEGREE,
-  EVENT_45DEGREE,
-  EVENT_90DEGREE,
-  EVENT_ACCELINT,
-  EVENT_BLEDONE
+  EVENT_NONE               = 0,
+  EVENT_BLEConnectionClose = (1 << 0),
+  EVENT_PB0                = (1 << 1),
+  EVENT_I2CTransfer_Done   = (1 << 2),
+  EVENT_ACCELINT           = (1 << 3),
+  EVENT_0DEGREE            = (1 << 4),
+  EVENT_45DEGREE           = (1 << 5),
+  EVENT_90DEGREE           = (1 << 6),
+  EVENT_BLEDONE            = (1 << 7),
+  EVENT_LETIMER_UF         = (1 << 8),
+  EVENT_LETIMER_COMP1      = (1 << 9),
+  EVENT_ADCBLOCK           = (1 << 10),
+  EVENT_FLEXANGLE          = (1 << 11),
+  EVENT_ACCELDATA          = (1 << 12),
+  EVENT_TILT               = (1 << 13),
+  EVENT_LCD_DONE           = (1 << 14)
 }Events_t;
 
+#define SCHEDULER_NUM_EVENTS      15  // number of event bits in Events_t
+#define SCHEDULER_MAX_HANDLERS    8   // handler registrations, see schedulerRegisterHandler()
+#define SCHEDULER_ENABLE_STATS    1   // set to 0 to drop the counters and DWT cycle measurement
+
+// Handler invoked by schedulerDispatch() once per pending event bit
+typedef void (*scheduler_handler_t)(Events_t evt);
+
+typedef struct {
+  uint32_t events_set;            // events raised through schedulerSetEvent()
+  uint32_t events_coalesced;      // events raised while the same bit was still pending (lost)
+  uint32_t signals_sent;          // sl_bt_external_signal() calls, one per batch
+  uint32_t signal_errors;         // sl_bt_external_signal() failures, bits stay pending
+  uint32_t batches;               // non-empty schedulerDispatch() calls
+  uint32_t events_dispatched;     // event bits delivered to at least one handler
+  uint32_t events_unhandled;      // event bits that had no registered handler
+  uint32_t dispatch_cycles_last;  // CPU cycles spent in the last batch
+  uint32_t dispatch_cycles_max;   // worst case CPU cycles spent in one batch
+} scheduler_stats_t;
+
+// ble.h, adc.h and i2c.h use Events_t, so they are included once the scheduler types exist
+#include "src/ble.h"
+#include "src/adc.h"
+#include "src/i2c.h"
+
 #if (DEVICE_IS_BLE_SERVER == 1)
 
 typedef enum{
@@ -81,6 +111,11 @@ static const uint8_t tempMeasure_ID[2] = { 0x1c, 0x2a };
 
 #endif
 
+void schedulerInit(void);
+bool schedulerRegisterHandler(uint32_t eventMask, scheduler_handler_t handler);
+void schedulerSetEvent(Events_t evt);
+void schedulerDispatch(void);
+const scheduler_stats_t* schedulerGetStats(void);
 void schedulerSetEventUF(void);
 void schedulerSetEventCOMP1(void);
 void schedulerSetEventI2CDone(void);
@@ -91,8 +126,8 @@ void schedulerSetEvent45(void);
 void schedulerSetEvent90(void);
 void schedulerSetEventAccelINT(void);
 void schedulerSetEventBLEDONE(void);
-bool stateMachinePostureDetection(sl_bt_msg_t *levt);
-Events_t getNextEvent(void);
+void stateMachinePostureDetection(Events_t evt);
+uint32_t getNextEvent(void);
 bool stateMachineTemperatureRead(sl_bt_msg_t *evt);
 void discovery_state_machine(sl_bt_msg_t *evt);
 
@@ -0,0 +1,203 @@
+/***********************************************************************
+ * @file      tilt.c
+ * @version   0.1
+ * @brief     Fixed-point pitch/roll estimation from the accelerometer.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      April 30, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ * atan2 is computed with a 16 iteration CORDIC in vectoring mode, integer
+ * only. Angles are accumulated in 1/256 of 0.1 degree and rounded at the
+ * end, worst case error is well under 0.1 degree.
+ */
+
+#define INCLUDE_LOG_DEBUG     1
+#include "log.h"
+#include "src/tilt.h"
+#include "src/i2c.h"
+#include "src/accel_fifo.h"
+#include "src/batch.h"
+#include "src/irq.h"
+#include <stdlib.h>
+
+#define CORDIC_ITERATIONS   16
+#define CORDIC_ANGLE_SHIFT  8       // table units are 0.1 degree << 8
+#define CORDIC_INPUT_SHIFT  12      // headroom for the 1.647 CORDIC gain on int16 inputs
+#define CORDIC_INV_GAIN_Q16 39797   // 1/1.64676 in Q16
+#define DECIDEG_180         (1800 << CORDIC_ANGLE_SHIFT)
+
+#define REG_ACCEL_XOUT_H    0x2D    // bank 0, XOUT_H .. ZOUT_L
+
+// atan(2^-i) in 0.1 degree << 8
+static const int32_t cordicAtan[CORDIC_ITERATIONS] = {
+  115200, 68007, 35933, 18240, 9155, 4582, 2292, 1146,
+  573, 286, 143, 72, 36, 18, 9, 4
+};
+
+static uint8_t accelRaw[6];
+static tilt_t  currentTilt;
+static tilt_t  publishedTilt = { INT16_MIN, INT16_MIN };
+
+/**
+ * @brief Fixed point atan2.
+ *
+ * @param y         Opposite side.
+ * @param x         Adjacent side.
+ * @param magnitude If not NULL, set to sqrt(x^2 + y^2).
+ * @return Angle in 0.1 degree, -1800 to 1800.
+ */
+int16_t tiltAtan2(int32_t y, int32_t x, uint32_t *magnitude)
+{
+  int32_t angle = 0;
+  int32_t xNew;
+  uint8_t i;
+
+  // Scale up for resolution, callers pass values in int16 range
+  x <<= CORDIC_INPUT_SHIFT;
+  y <<= CORDIC_INPUT_SHIFT;
+
+  // Vectoring only converges for x > 0, rotate the left half plane by 180
+  if (x < 0) {
+      angle = (y >= 0) ? DECIDEG_180 : -DECIDEG_180;
+      x = -x;
+      y = -y;
+  }
+
+  for (i = 0; i < CORDIC_ITERATIONS; i++) {
+      if (y > 0) {
+          xNew   = x + (y >> i);
+          y     -= x >> i;
+          angle += cordicAtan[i];
+      } else {
+          xNew   = x - (y >> i);
+          y     += x >> i;
+          angle -= cordicAtan[i];
+      }
+      x = xNew;
+  }
+
+  if (magnitude != NULL) {
+      // Remove the CORDIC gain and the input scaling
+      *magnitude = (uint32_t) (((int64_t) x * CORDIC_INV_GAIN_Q16) >> (16 + CORDIC_INPUT_SHIFT));
+  }
+
+  if (angle > DECIDEG_180) {
+      angle -= 2 * DECIDEG_180;
+  } else if (angle < -DECIDEG_180) {
+      angle += 2 * DECIDEG_180;
+  }
+
+  return (int16_t) ((angle + (1 << (CORDIC_ANGLE_SHIFT - 1))) >> CORDIC_ANGLE_SHIFT);
+}
+
+/**
+ * @brief Pitch and roll from one accelerometer vector, any consistent units.
+ *
+ * roll  = atan2(ay, az)
+ * pitch = atan2(-ax, sqrt(ay^2 + az^2))
+ */
+void tiltFromAccel(int16_t ax, int16_t ay, int16_t az, tilt_t *tilt)
+{
+  uint32_t yz;
+
+  tilt->roll  = tiltAtan2(ay, az, &yz);
+  tilt->pitch = tiltAtan2(-(int32_t) ax, (int32_t) yz, NULL);
+}
+
+/**
+ * @brief Updates the current tilt and raises EVENT_TILT once it has moved
+ *        by TILT_REPORT_DELTA.
+ */
+static void tiltUpdate(int16_t ax, int16_t ay, int16_t az)
+{
+  tiltFromAccel(ax, ay, az, &currentTilt);
+
+  if ((abs(currentTilt.pitch - publishedTilt.pitch) >= TILT_REPORT_DELTA) ||
+      (abs(currentTilt.roll - publishedTilt.roll) >= TILT_REPORT_DELTA)) {
+      publishedTilt = currentTilt;
+      schedulerSetEvent(EVENT_TILT);
+  }
+}
+
+static void accelReadDone(I2C_TransferReturn_TypeDef status, void *userParam)
+{
+  (void) userParam;
+
+  if (status != i2cTransferDone) {
+      return;
+  }
+
+  tiltUpdate((int16_t) ((accelRaw[0] << 8) | accelRaw[1]),
+             (int16_t) ((accelRaw[2] << 8) | accelRaw[3]),
+             (int16_t) ((accelRaw[4] << 8) | accelRaw[5]));
+}
+
+/**
+ * @brief Queues one write-read of ACCEL_XOUT_H..ACCEL_ZOUT_L. The tilt is
+ *        updated from the I2C completion callback.
+ */
+void tiltReadAccelAsync(void)
+{
+  uint8_t reg = REG_ACCEL_XOUT_H;
+
+  icm20948QueueBanked(0, I2C_FLAG_WRITE_READ, &reg, 1, accelRaw, sizeof(accelRaw), accelReadDone, NULL);
+}
+
+/**
+ * @brief Scheduler handler for EVENT_ACCELDATA. Every drained sample goes to
+ *        the sample batch with its own pitch/roll. The published tilt comes
+ *        from their average, which also filters out vibration.
+ */
+void tiltHandler(Events_t evt)
+{
+  accel_sample_t samples[16];
+  int32_t sum[3] = {0, 0, 0};
+  uint32_t total = 0;
+  uint32_t now;
+  uint16_t pending;
+  uint16_t n, i;
+  tilt_t tilt;
+
+  if (evt != EVENT_ACCELDATA) {
+      return;
+  }
+
+  // The newest sample in the ring was taken about now, the others one
+  // FIFO period apart before it
+  now = letimerMilliseconds();
+  pending = accelFifoAvailable();
+
+  while ((n = accelFifoRead(samples, sizeof(samples) / sizeof(samples[0]))) > 0) {
+      for (i = 0; i < n; i++) {
+          sum[0] += samples[i].ax;
+          sum[1] += samples[i].ay;
+          sum[2] += samples[i].az;
+
+          tiltFromAccel(samples[i].ax, samples[i].ay, samples[i].az, &tilt);
+          if (pending > 0) {
+              pending--;
+          }
+          batchRecordTilt(now - (pending * ACCEL_FIFO_PERIOD_US) / 1000, tilt.pitch, tilt.roll);
+      }
+      total += n;
+  }
+
+  if (total > 0) {
+      tiltUpdate(sum[0] / (int32_t) total, sum[1] / (int32_t) total, sum[2] / (int32_t) total);
+  }
+}
+
+/**
+ * @brief Latest pitch and roll.
+ */
+tilt_t tiltGet(void)
+{
+  return currentTilt;
+}
@@ -0,0 +1,37 @@
+/***********************************************************************
+ * @file      tilt.h
+ * @version   0.1
+ * @brief     Function header/interface file.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      April 30, 2025
+ *
+ *
+ * @institution University of Colorado Boulder (UCB)
+ * @course      ECEN 5823-001: IoT Embedded Firmware
+ * @instructor  Chris Choi
+ *
+ * @resources None
+ *
+ */
+
+#ifndef SRC_TILT_H_
+#define SRC_TILT_H_
+
+#include <stdint.h>
+#include "src/scheduler.h"
+
+#define TILT_REPORT_DELTA   10  // 1 degree, smaller changes are not published
+
+typedef struct {
+  int16_t pitch;  // 0.1 degree, rotation about the y axis
+  int16_t roll;   // 0.1 degree, rotation about the x axis
+} tilt_t;
+
+int16_t tiltAtan2(int32_t y, int32_t x, uint32_t *magnitude);
+void tiltFromAccel(int16_t ax, int16_t ay, int16_t az, tilt_t *tilt);
+void tiltReadAccelAsync(void);
+void tiltHandler(Events_t evt);
+tilt_t tiltGet(void);
+
+#endif /* SRC_TILT_H_ */
@@ -28,8 +28,6 @@
 #include "src/log.h"
 
 
-#define ACTUAL_CLOCK_FREQ (OSC_FREQ/PRESCALER_VAL) // The actual clock frequency to load LETIMER0
-#define LETIMER_COMP0_VAL   ((LETIMER_PERIOD_MS * ACTUAL_CLOCK_FREQ)/1000) // The value for COMP0 (period of the timer)
 #define LETIMER_COMP1_VAL ((LETIMER_ON_TIME_MS * ACTUAL_CLOCK_FREQ)/1000) // The value for COMP1 (on-time of the timer)
 
 /**
@@ -66,6 +64,30 @@ void LETIMER0Init(void)
   LETIMER_CompareSet(LETIMER0, 0, LETIMER_COMP0_VAL);
 }
 
+/**
+ * @brief Drives the LCD EXTCOMIN pin from LETIMER0 output 0.
+ *
+ * OUT0 toggles on every underflow, so EXTCOMIN inverts every
+ * LETIMER_PERIOD_MS (1s, same as the soft timer it replaces) in EM2/EM3
+ * without waking the CPU. In free running mode the output is held idle
+ * while REP0 is zero, so REP0 is loaded as well.
+ *
+ * @param enable true to hand the pin to LETIMER0, false to return it to GPIO.
+ */
+void LETIMER0ExtcominEnable(bool enable)
+{
+  if (enable) {
+      LETIMER0->ROUTELOC0 = (LETIMER0->ROUTELOC0 & ~_LETIMER_ROUTELOC0_OUT0LOC_MASK)
+                            | LETIMER_EXTCOMIN_LOC;
+      LETIMER0->CTRL = (LETIMER0->CTRL & ~_LETIMER_CTRL_UFOA0_MASK) | LETIMER_CTRL_UFOA0_TOGGLE;
+      LETIMER_RepeatSet(LETIMER0, 0, 1);
+      LETIMER0->ROUTEPEN |= LETIMER_ROUTEPEN_OUT0PEN;
+  } else {
+      LETIMER0->ROUTEPEN &= ~LETIMER_ROUTEPEN_OUT0PEN;
+      LETIMER0->CTRL &= ~_LETIMER_CTRL_UFOA0_MASK;
+  }
+}
+
 /**
  * @brief Enables interrupts for LETIMER0 and configures NVIC.
  *
@@ -85,8 +107,9 @@ void LETIMER0EnableIrq(void)
   // Clear any pending IRQ
   NVIC_ClearPendingIRQ(LETIMER0_IRQn);
 
-  // Enable Interrupts in the NVIC for LETIMER0
-  //NVIC_EnableIRQ(LETIMER0_IRQn);
+  // Enable Interrupts in the NVIC for LETIMER0, the UF count is the time
+  // base of letimerMilliseconds()
+  NVIC_EnableIRQ(LETIMER0_IRQn);
 
   // Enable the LETIMER0 peripheral
   LETIMER_Enable(LETIMER0, SET);
@@ -23,10 +23,17 @@
 #define _TIMERS_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "src/scheduler.h"
 
+#define ACTUAL_CLOCK_FREQ (OSC_FREQ/PRESCALER_VAL) // The actual clock frequency to load LETIMER0
+#define LETIMER_COMP0_VAL   ((LETIMER_PERIOD_MS * ACTUAL_CLOCK_FREQ)/1000) // The value for COMP0 (period of the timer)
+
+#define LETIMER_EXTCOMIN_LOC  LETIMER_ROUTELOC0_OUT0LOC_LOC21  // OUT0 on PD13, LCD EXTCOMIN
+
 void LETIMER0Init(void);
 void LETIMER0EnableIrq(void);
+void LETIMER0ExtcominEnable(bool enable);
 void timerWaitUs_poll(uint32_t us_wait);
 void timerWaitUs_irq(uint32_t us_wait);
 void timerWaitUs_poll_UnitTest(void);
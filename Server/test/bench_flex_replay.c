@@ -0,0 +1,238 @@
+/***********************************************************************
+ * @file      bench_flex_replay.c
+ * @version   0.1
+ * @brief     Replays flex sensor traces and reports posture events per
+ *            minute before and after the flex filter.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * Usage: bench_flex_replay [trace ...]
+ *
+ * A trace has one sample per line, either "mv" taken ADC_SAMPLE_PERIOD_MS
+ * apart or "ms,mv". Lines starting with # are skipped. Without arguments
+ * four synthetic traces are generated: rest with noise, a hand resting on
+ * a threshold, slow bends through every bucket, and spikes.
+ *
+ * "before" is the classifier the filter replaced, which raised a posture
+ * event on every conversion, and the same thresholds reporting only bucket
+ * changes. "after" runs the trace through adcProcessBlock() in LDMA sized
+ * blocks and counts the scheduler events it raises.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/scheduler.h"
+#include "test_util.h"
+
+#define TRACE_MAX_SAMPLES  (60 * 60 * 1000 / ADC_SAMPLE_PERIOD_MS)  // one hour
+#define SYNTH_SECONDS      60
+
+typedef struct {
+  const char *name;
+  uint32_t    count;
+  uint32_t    durationMs;
+} trace_t;
+
+static uint16_t traceMv[TRACE_MAX_SAMPLES];
+static uint32_t nowMs;
+static uint32_t postureEvents;
+static uint32_t angleEvents;
+
+uint32_t letimerMilliseconds(void)
+{
+  return nowMs;
+}
+
+static void countHandler(Events_t evt)
+{
+  if (evt == EVENT_FLEXANGLE) {
+      angleEvents++;
+  } else {
+      postureEvents++;
+  }
+}
+
+// The classifier before the filter, one bucket per raw conversion
+static uint8_t rawBucket(uint32_t mv)
+{
+  if (mv <= FLEX_THRESHOLD_0_MV) {
+      return 0;
+  } else if (mv <= FLEX_THRESHOLD_45_MV) {
+      return 1;
+  } else if (mv <= FLEX_THRESHOLD_90_MV) {
+      return 2;
+  }
+  return 0;
+}
+
+static uint16_t clampMv(double mv)
+{
+  if (mv < 0.0) {
+      return 0;
+  }
+  if (mv > 2500.0) {
+      return 2500;
+  }
+  return (uint16_t) mv;
+}
+
+// Roughly gaussian, sum of uniforms
+static double noise(double sigma)
+{
+  double sum = 0.0;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+      sum += (double) rand() / RAND_MAX - 0.5;
+  }
+  return sum * sigma * 1.7;
+}
+
+static void synthesize(trace_t *trace, int kind)
+{
+  static const char *names[] = { "synthetic rest", "synthetic threshold", "synthetic bends", "synthetic spikes" };
+  static const uint16_t bends[] = { 1325, 1475, 1625, 1475 };
+  uint32_t i, seg, count = SYNTH_SECONDS * 1000 / ADC_SAMPLE_PERIOD_MS;
+  double mv, from, to, t;
+
+  srand(5823 + kind);
+  for (i = 0; i < count; i++) {
+      switch (kind) {
+        case 0:
+          mv = 1480.0 + noise(12.0);
+          break;
+        case 1:
+          mv = FLEX_THRESHOLD_0_MV + noise(15.0);
+          break;
+        case 2:
+          // Hold each posture for 5 s, then bend to the next over 1 s
+          t = fmod(i * ADC_SAMPLE_PERIOD_MS / 1000.0, 6.0);
+          seg = (i * ADC_SAMPLE_PERIOD_MS / 6000) % 4;
+          from = bends[seg];
+          to = bends[(seg + 1) % 4];
+          mv = (t < 5.0 ? from : from + (to - from) * (t - 5.0)) + noise(10.0);
+          break;
+        default:
+          mv = 1475.0 + noise(8.0);
+          if (rand() % 100 == 0) {
+              mv = (rand() & 1) ? 2500.0 : 0.0;
+          }
+          break;
+      }
+      traceMv[i] = clampMv(mv);
+  }
+
+  trace->name = names[kind];
+  trace->count = count;
+  trace->durationMs = count * ADC_SAMPLE_PERIOD_MS;
+}
+
+static bool load(trace_t *trace, const char *path)
+{
+  char line[64];
+  uint32_t firstMs = 0, lastMs = 0;
+  unsigned long ms, mv;
+  bool timed = false;
+  FILE *f;
+
+  f = fopen(path, "r");
+  if (f == NULL) {
+      perror(path);
+      return false;
+  }
+
+  trace->count = 0;
+  while ((fgets(line, sizeof(line), f) != NULL) && (trace->count < TRACE_MAX_SAMPLES)) {
+      if (line[0] == '#') {
+          continue;
+      }
+      if (sscanf(line, "%lu,%lu", &ms, &mv) == 2) {
+          if (!timed) {
+              firstMs = (uint32_t) ms;
+          }
+          timed = true;
+          lastMs = (uint32_t) ms;
+      } else if (sscanf(line, "%lu", &mv) != 1) {
+          continue;
+      }
+      traceMv[trace->count++] = clampMv((double) mv);
+  }
+  fclose(f);
+
+  trace->name = path;
+  trace->durationMs = timed ? (lastMs - firstMs + ADC_SAMPLE_PERIOD_MS)
+                            : trace->count * ADC_SAMPLE_PERIOD_MS;
+  return trace->count > 0;
+}
+
+static void replay(const trace_t *trace)
+{
+  uint16_t block[ADC_BLOCK_SIZE];
+  uint32_t everySample = 0, rawChanges = 0;
+  uint8_t bucket, lastBucket = 0xFF;
+  double minutes = trace->durationMs / 60000.0;
+  uint32_t i, len, n;
+
+  for (i = 0; i < trace->count; i++) {
+      bucket = rawBucket(traceMv[i]);
+      everySample++;
+      if (bucket != lastBucket) {
+          rawChanges++;
+          lastBucket = bucket;
+      }
+  }
+
+  schedulerInit();
+  schedulerRegisterHandler(EVENT_0DEGREE | EVENT_45DEGREE | EVENT_90DEGREE | EVENT_FLEXANGLE, countHandler);
+  flexFilterInit();
+  flexAngleInit();
+  postureEvents = 0;
+  angleEvents = 0;
+  nowMs = 0;
+
+  // Back to raw codes, the way the LDMA delivers them
+  for (i = 0; i < trace->count; i += len) {
+      len = trace->count - i;
+      if (len > ADC_BLOCK_SIZE) {
+          len = ADC_BLOCK_SIZE;
+      }
+      for (n = 0; n < len; n++) {
+          block[n] = (uint16_t) ((traceMv[i + n] * 4096u + 1250u) / 2500u);
+      }
+      nowMs += len * ADC_SAMPLE_PERIOD_MS;
+      adcProcessBlock(block, len);
+      schedulerDispatch();
+  }
+
+  printf("  %-22s %6.1f min | before: %8.1f every sample %7.1f bucket changes"
+         " | after: %6.1f posture %6.1f angle\n",
+         trace->name, minutes, everySample / minutes, rawChanges / minutes,
+         postureEvents / minutes, angleEvents / minutes);
+
+  // The filter must never report more posture changes than the raw buckets
+  CHECK(postureEvents <= rawChanges);
+}
+
+int main(int argc, char **argv)
+{
+  trace_t trace;
+  int i;
+
+  printf("Posture events per minute:\n");
+  if (argc > 1) {
+      for (i = 1; i < argc; i++) {
+          if (load(&trace, argv[i])) {
+              replay(&trace);
+          }
+      }
+  } else {
+      for (i = 0; i < 4; i++) {
+          synthesize(&trace, i);
+          replay(&trace);
+      }
+  }
+
+  return testFailures("bench_flex_replay");
+}
@@ -0,0 +1,44 @@
+/***********************************************************************
+ * @file      cmsis_dsp.c
+ * @version   0.1
+ * @brief     Host build of the CMSIS-DSP functions the firmware calls.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * The SDK copy in this project only carries the CMSIS-DSP headers, the
+ * library itself is pulled in by the cmsis_dsp component at build time.
+ * This follows the reference C implementation of the library so the host
+ * tests exercise the same fixed-point arithmetic.
+ */
+
+#include "arm_math.h"
+
+/**
+ * @brief Linear interpolation in a uniform Q15 table, x is a 12.20 index.
+ */
+q15_t arm_linear_interp_q15(q15_t *pYData, q31_t x, uint32_t nValues)
+{
+  q63_t y;
+  q15_t y0, y1;
+  q31_t fract;
+  int32_t index;
+
+  index = (x & (q31_t) 0xFFF00000) >> 20;
+
+  if (index >= (int32_t) (nValues - 1)) {
+      return pYData[nValues - 1];
+  }
+  if (index < 0) {
+      return pYData[0];
+  }
+
+  fract = x & 0x000FFFFF;
+  y0 = pYData[index];
+  y1 = pYData[index + 1];
+
+  y = (q63_t) y0 * (0xFFFFF - fract);
+  y += (q63_t) y1 * fract;
+
+  return (q15_t) (y >> 20);
+}
@@ -0,0 +1,37 @@
+/***********************************************************************
+ * @file      core_cm4.h
+ * @version   0.1
+ * @brief     Host build shim over the CMSIS Cortex-M4 core header.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * The host tests compile the firmware sources unmodified. The real header
+ * still provides every type and bit field, only the core peripherals the
+ * sources touch at run time are redirected to RAM or dropped so the
+ * accesses do not fault on the build machine.
+ */
+
+#ifndef TEST_HOST_CORE_CM4_H_
+#define TEST_HOST_CORE_CM4_H_
+
+#include_next "core_cm4.h"
+
+extern DWT_Type       hostDwt;
+extern CoreDebug_Type hostCoreDebug;
+
+#undef  DWT
+#define DWT       (&hostDwt)
+#undef  CoreDebug
+#define CoreDebug (&hostCoreDebug)
+
+// The NVIC inlines above were compiled against the real address, the tests
+// call the interrupt handlers directly instead
+#undef  NVIC_EnableIRQ
+#define NVIC_EnableIRQ(irq)       ((void) (irq))
+#undef  NVIC_DisableIRQ
+#define NVIC_DisableIRQ(irq)      ((void) (irq))
+#undef  NVIC_ClearPendingIRQ
+#define NVIC_ClearPendingIRQ(irq) ((void) (irq))
+
+#endif /* TEST_HOST_CORE_CM4_H_ */
@@ -0,0 +1,33 @@
+/***********************************************************************
+ * @file      em_device.h
+ * @version   0.1
+ * @brief     Host build shim over the device header.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * Same idea as host/core_cm4.h for the device peripherals. Only the ones
+ * the tested sources write directly are moved to RAM, the others are
+ * only ever passed to the stubbed emlib calls.
+ */
+
+#ifndef TEST_HOST_EM_DEVICE_H_
+#define TEST_HOST_EM_DEVICE_H_
+
+#include_next "em_device.h"
+
+extern ADC_TypeDef       hostAdc0;
+extern CRYOTIMER_TypeDef hostCryotimer;
+extern LETIMER_TypeDef   hostLetimer0;
+extern USART_TypeDef     hostUsart1;
+
+#undef  ADC0
+#define ADC0      (&hostAdc0)
+#undef  CRYOTIMER
+#define CRYOTIMER (&hostCryotimer)
+#undef  LETIMER0
+#define LETIMER0  (&hostLetimer0)
+#undef  USART1
+#define USART1    (&hostUsart1)
+
+#endif /* TEST_HOST_EM_DEVICE_H_ */
@@ -0,0 +1,26 @@
+/***********************************************************************
+ * @file      em_gpio.h
+ * @version   0.1
+ * @brief     Host build shim over the emlib GPIO header.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * The pin set and clear inlines go through the bit set alias of the
+ * peripheral space. They are replaced by a plain array of port outputs
+ * the tests can read, e.g. to see a chip select.
+ */
+
+#ifndef TEST_HOST_EM_GPIO_H_
+#define TEST_HOST_EM_GPIO_H_
+
+#include_next "em_gpio.h"
+
+extern uint32_t hostGpioDout[GPIO_PORT_MAX + 1];
+
+#undef  GPIO_PinOutSet
+#define GPIO_PinOutSet(port, pin)     (hostGpioDout[(port)] |= 1UL << (pin))
+#undef  GPIO_PinOutClear
+#define GPIO_PinOutClear(port, pin)   (hostGpioDout[(port)] &= ~(1UL << (pin)))
+
+#endif /* TEST_HOST_EM_GPIO_H_ */
@@ -0,0 +1,326 @@
+/***********************************************************************
+ * @file      host_stubs.c
+ * @version   0.1
+ * @brief     Weak host stand-ins for the SDK and the firmware modules a
+ *            test does not link.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * Every definition is weak, so a test that links the real module or needs
+ * to observe a call simply defines the function again.
+ */
+
+#include <stdarg.h>
+#include <string.h>
+#include "src/scheduler.h"
+#include "src/accel_fifo.h"
+#include "em_core.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+#include "em_letimer.h"
+#include "dmd.h"
+
+#define HOST_WEAK __attribute__((weak))
+
+int testFailureCount = 0;
+
+DWT_Type          hostDwt;
+CoreDebug_Type    hostCoreDebug;
+ADC_TypeDef       hostAdc0;
+CRYOTIMER_TypeDef hostCryotimer;
+LETIMER_TypeDef   hostLetimer0;
+USART_TypeDef     hostUsart1;
+uint32_t          hostGpioDout[GPIO_PORT_MAX + 1];
+
+static ble_data_struct_t hostBleData;
+
+// The tests are single threaded, an "ISR" is a direct call
+HOST_WEAK CORE_irqState_t CORE_EnterCritical(void)
+{
+  return 0;
+}
+
+HOST_WEAK void CORE_ExitCritical(CORE_irqState_t irqState)
+{
+  (void) irqState;
+}
+
+HOST_WEAK sl_status_t sl_bt_external_signal(uint32_t signals)
+{
+  (void) signals;
+  return SL_STATUS_OK;
+}
+
+HOST_WEAK sl_status_t sl_bt_system_set_lazy_soft_timer(uint32_t time, uint32_t slack, uint8_t handle, uint8_t single_shot)
+{
+  (void) time;
+  (void) slack;
+  (void) handle;
+  (void) single_shot;
+  return SL_STATUS_OK;
+}
+
+HOST_WEAK void logDeferred(uint32_t level, const char *format, const char *func, uint32_t nargs, ...)
+{
+  (void) level;
+  (void) format;
+  (void) func;
+  (void) nargs;
+}
+
+HOST_WEAK void displayPrintf(enum display_row row, const char *format, ...)
+{
+  (void) row;
+  (void) format;
+}
+
+HOST_WEAK ble_data_struct_t* get_ble_data_struct(void)
+{
+  return &hostBleData;
+}
+
+HOST_WEAK bool broadcastIsActive(void)
+{
+  return false;
+}
+
+HOST_WEAK bool broadcastWantsSamples(void)
+{
+  return false;
+}
+
+HOST_WEAK void adcStartSampling(void)
+{
+}
+
+HOST_WEAK void adcStopSampling(void)
+{
+}
+
+HOST_WEAK uint32_t letimerMilliseconds(void)
+{
+  return 0;
+}
+
+HOST_WEAK void accelFifoOnInterrupt(void)
+{
+}
+
+HOST_WEAK void clear_interrupt_flag(void)
+{
+}
+
+HOST_WEAK void batchRecordFlex(uint32_t timestamp, int16_t flex)
+{
+  (void) timestamp;
+  (void) flex;
+}
+
+HOST_WEAK void batchRecordTilt(uint32_t timestamp, int16_t pitch, int16_t roll)
+{
+  (void) timestamp;
+  (void) pitch;
+  (void) roll;
+}
+
+HOST_WEAK bool icm20948QueueBanked(uint8_t bank, uint16_t flags, const uint8_t *writeData, uint8_t writeLen,
+                                   uint8_t *readData, uint8_t readLen,
+                                   i2c_callback_t callback, void *userParam)
+{
+  (void) bank;
+  (void) flags;
+  (void) writeData;
+  (void) writeLen;
+  (void) readData;
+  (void) readLen;
+  (void) callback;
+  (void) userParam;
+  return true;
+}
+
+HOST_WEAK uint16_t accelFifoRead(accel_sample_t *samples, uint16_t maxSamples)
+{
+  (void) samples;
+  (void) maxSamples;
+  return 0;
+}
+
+HOST_WEAK uint16_t accelFifoAvailable(void)
+{
+  return 0;
+}
+
+// Peripheral set up, only reached from the init functions the tests skip
+
+HOST_WEAK void CMU_AUXHFRCOBandSet(CMU_AUXHFRCOFreq_TypeDef setFreq)
+{
+  (void) setFreq;
+}
+
+HOST_WEAK void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable)
+{
+  (void) clock;
+  (void) enable;
+}
+
+HOST_WEAK void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref)
+{
+  (void) clock;
+  (void) ref;
+}
+
+HOST_WEAK void CMU_OscillatorEnable(CMU_Osc_TypeDef osc, bool enable, bool wait)
+{
+  (void) osc;
+  (void) enable;
+  (void) wait;
+}
+
+HOST_WEAK void ADC_Init(ADC_TypeDef *adc, const ADC_Init_TypeDef *init)
+{
+  (void) adc;
+  (void) init;
+}
+
+HOST_WEAK void ADC_InitScan(ADC_TypeDef *adc, const ADC_InitScan_TypeDef *init)
+{
+  (void) adc;
+  (void) init;
+}
+
+HOST_WEAK uint32_t ADC_ScanSingleEndedInputAdd(ADC_InitScan_TypeDef *scanInit,
+                                               ADC_ScanInputGroup_TypeDef inputGroup,
+                                               ADC_PosSel_TypeDef singleEndedSel)
+{
+  (void) scanInit;
+  (void) inputGroup;
+  (void) singleEndedSel;
+  return 0;
+}
+
+HOST_WEAK uint8_t ADC_TimebaseCalc(uint32_t hfperFreq)
+{
+  (void) hfperFreq;
+  return 0;
+}
+
+HOST_WEAK uint8_t ADC_PrescaleCalc(uint32_t adcFreq, uint32_t hfperFreq)
+{
+  (void) adcFreq;
+  (void) hfperFreq;
+  return 0;
+}
+
+HOST_WEAK void PRS_SourceAsyncSignalSet(unsigned int ch, uint32_t source, uint32_t signal)
+{
+  (void) ch;
+  (void) source;
+  (void) signal;
+}
+
+HOST_WEAK Ecode_t DMADRV_Init(void)
+{
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+HOST_WEAK Ecode_t DMADRV_AllocateChannel(unsigned int *channelId, void *capabilities)
+{
+  (void) capabilities;
+  *channelId = 0;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+HOST_WEAK Ecode_t DMADRV_PeripheralMemoryPingPong(unsigned int channelId,
+                                                  DMADRV_PeripheralSignal_t peripheralSignal,
+                                                  void *dst0, void *dst1, void *src, bool dstInc,
+                                                  int len, DMADRV_DataSize_t size,
+                                                  DMADRV_Callback_t callback, void *cbUserParam)
+{
+  (void) channelId;
+  (void) peripheralSignal;
+  (void) dst0;
+  (void) dst1;
+  (void) src;
+  (void) dstInc;
+  (void) len;
+  (void) size;
+  (void) callback;
+  (void) cbUserParam;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+HOST_WEAK Ecode_t DMADRV_MemoryPeripheral(unsigned int channelId,
+                                          DMADRV_PeripheralSignal_t peripheralSignal,
+                                          void *dst, void *src, bool srcInc,
+                                          int len, DMADRV_DataSize_t size,
+                                          DMADRV_Callback_t callback, void *cbUserParam)
+{
+  (void) channelId;
+  (void) peripheralSignal;
+  (void) dst;
+  (void) src;
+  (void) srcInc;
+  (void) len;
+  (void) size;
+  (void) callback;
+  (void) cbUserParam;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+HOST_WEAK Ecode_t DMADRV_StopTransfer(unsigned int channelId)
+{
+  (void) channelId;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+HOST_WEAK uint32_t LETIMER_CounterGet(LETIMER_TypeDef *letimer)
+{
+  return letimer->CNT;
+}
+
+HOST_WEAK void sli_power_manager_update_em_requirement(sl_power_manager_em_t em, bool add)
+{
+  (void) em;
+  (void) add;
+}
+
+HOST_WEAK void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out)
+{
+  (void) port;
+  (void) pin;
+  (void) mode;
+  (void) out;
+}
+
+HOST_WEAK void USART_InitSync(USART_TypeDef *usart, const USART_InitSync_TypeDef *init)
+{
+  usart->CTRL = init->msbf ? USART_CTRL_MSBF : 0;
+}
+
+HOST_WEAK void USART_Enable(USART_TypeDef *usart, USART_Enable_TypeDef enable)
+{
+  (void) usart;
+  (void) enable;
+}
+
+HOST_WEAK void USART_Tx(USART_TypeDef *usart, uint8_t data)
+{
+  usart->TXDATA = data;
+}
+
+HOST_WEAK uint8_t USART_Rx(USART_TypeDef *usart)
+{
+  return (uint8_t) usart->RXDATA;
+}
+
+HOST_WEAK void sl_udelay_wait(unsigned us)
+{
+  (void) us;
+}
+
+HOST_WEAK EMSTATUS DMD_getFrameBuffer(void **framebuffer)
+{
+  (void) framebuffer;
+  return DMD_ERROR_NOT_SUPPORTED;
+}
@@ -0,0 +1,368 @@
+/***********************************************************************
+ * @file      test_adc_block.c
+ * @version   0.1
+ * @brief     Host test and benchmark of the LDMA block path and the flex
+ *            angle lookup table.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * Synthetic ADC blocks go through adcProcessBlock() exactly as
+ * adcBlockHandler() hands them over. The posture events, the per sample
+ * batch records and their timestamps are checked, a block size of 1 must
+ * give the same results as ADC_BLOCK_SIZE, and flexAngleFromMv() is
+ * compared with the piecewise linear calibration curve it resamples.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/scheduler.h"
+#include "test_util.h"
+
+#define STREAM_SAMPLES   4096
+#define BENCH_BLOCKS     20000
+#define BENCH_LUT_CALLS  2000000
+
+static uint32_t nowMs;
+static uint32_t postureEvents[3];
+static uint32_t angleEvents;
+static Events_t lastPosture;
+
+static struct {
+  uint32_t timestamp;
+  int16_t  flex;
+} records[STREAM_SAMPLES];
+static uint32_t recordCount;
+
+uint32_t letimerMilliseconds(void)
+{
+  return nowMs;
+}
+
+void batchRecordFlex(uint32_t timestamp, int16_t flex)
+{
+  if (recordCount < STREAM_SAMPLES) {
+      records[recordCount].timestamp = timestamp;
+      records[recordCount].flex = flex;
+  }
+  recordCount++;
+}
+
+static void flexHandler(Events_t evt)
+{
+  switch (evt) {
+    case EVENT_0DEGREE:   postureEvents[0]++; lastPosture = evt; break;
+    case EVENT_45DEGREE:  postureEvents[1]++; lastPosture = evt; break;
+    case EVENT_90DEGREE:  postureEvents[2]++; lastPosture = evt; break;
+    case EVENT_FLEXANGLE: angleEvents++; break;
+    default: break;
+  }
+}
+
+static uint16_t rawFromMv(uint32_t mv)
+{
+  return (uint16_t) ((mv * 4096 + 1250) / 2500);
+}
+
+static void fillBlock(uint16_t *block, uint32_t len, uint32_t mv)
+{
+  uint32_t i;
+
+  for (i = 0; i < len; i++) {
+      block[i] = rawFromMv(mv);
+  }
+}
+
+/**
+ * Fresh filter, LUT and scheduler state. adcStartSampling() is not used,
+ * it programs ADC0 and the CRYOTIMER.
+ */
+static void reset(void)
+{
+  schedulerInit();
+  schedulerRegisterHandler(EVENT_0DEGREE | EVENT_45DEGREE | EVENT_90DEGREE | EVENT_FLEXANGLE, flexHandler);
+  flexFilterInit();
+  flexAngleInit();
+  memset(postureEvents, 0, sizeof(postureEvents));
+  angleEvents = 0;
+  lastPosture = EVENT_NONE;
+  recordCount = 0;
+  nowMs = 0;
+}
+
+static void processBlock(const uint16_t *block, uint32_t len)
+{
+  nowMs += len * ADC_SAMPLE_PERIOD_MS;
+  adcProcessBlock(block, len);
+  schedulerDispatch();
+}
+
+static void testSteadyPostures(void)
+{
+  static const uint32_t levels[] = { 1325, 1475, 1625, 1475, 1325 };
+  static const Events_t expected[] = {
+      EVENT_0DEGREE, EVENT_45DEGREE, EVENT_90DEGREE, EVENT_45DEGREE, EVENT_0DEGREE,
+  };
+  uint16_t block[ADC_BLOCK_SIZE];
+  uint32_t i, n;
+
+  reset();
+  for (i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+      fillBlock(block, ADC_BLOCK_SIZE, levels[i]);
+      for (n = 0; n < 4; n++) {
+          processBlock(block, ADC_BLOCK_SIZE);
+      }
+      CHECK_EQ(lastPosture, expected[i]);
+      // The default calibration points sit at these voltages
+      CHECK(abs(adcGetFlexAngle() - (int) (i < 3 ? i : 4 - i) * 450) <= 5);
+  }
+
+  CHECK_EQ(postureEvents[0], 2);
+  CHECK_EQ(postureEvents[1], 2);
+  CHECK_EQ(postureEvents[2], 1);
+  CHECK_EQ(flexFilterGetStats()->transitions, 5);
+}
+
+static void testSpikesAreRejected(void)
+{
+  uint16_t block[ADC_BLOCK_SIZE];
+  uint32_t i, n;
+
+  reset();
+  fillBlock(block, ADC_BLOCK_SIZE, 1475);
+  processBlock(block, ADC_BLOCK_SIZE);
+  CHECK_EQ(postureEvents[1], 1);
+
+  // Isolated full scale spikes and dropouts, at most one per median window
+  for (n = 0; n < 50; n++) {
+      fillBlock(block, ADC_BLOCK_SIZE, 1475);
+      for (i = n % 3; i < ADC_BLOCK_SIZE; i += 3 + (n % 3)) {
+          block[i] = (i & 1) ? 0x0FFF : 0;
+      }
+      processBlock(block, ADC_BLOCK_SIZE);
+  }
+
+  CHECK_EQ(postureEvents[0] + postureEvents[1] + postureEvents[2], 1);
+  CHECK(abs(adcGetFlexAngle() - 450) <= 5);
+}
+
+static void testRecordTimestamps(void)
+{
+  uint16_t block[ADC_BLOCK_SIZE];
+  uint32_t i;
+
+  reset();
+  nowMs = 1000;
+  fillBlock(block, ADC_BLOCK_SIZE, 1475);
+  processBlock(block, ADC_BLOCK_SIZE);
+
+  // The last sample was converted at the callback, the others one period apart
+  CHECK_EQ(recordCount, ADC_BLOCK_SIZE);
+  for (i = 0; i < ADC_BLOCK_SIZE; i++) {
+      CHECK_EQ(records[i].timestamp, nowMs - (ADC_BLOCK_SIZE - 1 - i) * ADC_SAMPLE_PERIOD_MS);
+  }
+  CHECK_EQ(records[ADC_BLOCK_SIZE - 1].flex, adcGetFlexAngle());
+}
+
+/**
+ * Stopping and restarting the stream, as a connection close and the next
+ * ACCELINT do, must not reset the filter and report the same posture again.
+ */
+static void testRestartKeepsPosture(void)
+{
+  uint16_t block[ADC_BLOCK_SIZE];
+  uint32_t samples, angles;
+  uint32_t n;
+
+  reset();
+  fillBlock(block, ADC_BLOCK_SIZE, 1475);
+  adcStartSampling();
+  processBlock(block, ADC_BLOCK_SIZE);
+  CHECK_EQ(postureEvents[1], 1);
+  angles = angleEvents;
+
+  for (n = 0; n < 10; n++) {
+      adcStopSampling();
+      adcStartSampling();
+      adcStartSampling();  // ACCELINT while streaming
+      processBlock(block, ADC_BLOCK_SIZE);
+  }
+
+  samples = flexFilterGetStats()->samples;
+  CHECK_EQ(postureEvents[0] + postureEvents[1] + postureEvents[2], 1);
+  CHECK_EQ(angleEvents, angles);
+  CHECK_EQ(flexFilterGetStats()->transitions, 1);
+  CHECK_EQ(samples, 11 * ADC_BLOCK_SIZE);
+
+  // A real change after a restart is still reported
+  adcStopSampling();
+  adcStartSampling();
+  fillBlock(block, ADC_BLOCK_SIZE, 1625);
+  processBlock(block, ADC_BLOCK_SIZE);
+  CHECK_EQ(postureEvents[2], 1);
+  adcStopSampling();
+}
+
+/**
+ * Slow bends with noise, replayed once in LDMA sized blocks and once one
+ * sample per block. The filter runs per sample, so every recorded angle
+ * and every confirmed transition must match.
+ */
+static void testBlockSizeInvariance(void)
+{
+  static uint16_t stream[STREAM_SAMPLES];
+  static int16_t  angles[STREAM_SAMPLES];
+  uint32_t transitions;
+  uint32_t i;
+
+  srand(5823);
+  for (i = 0; i < STREAM_SAMPLES; i++) {
+      double mv = 1500.0 + 180.0 * sin(2.0 * M_PI * i / 700.0) + (rand() % 41) - 20;
+      stream[i] = rawFromMv((uint32_t) mv);
+  }
+
+  reset();
+  for (i = 0; i < STREAM_SAMPLES; i += ADC_BLOCK_SIZE) {
+      processBlock(&stream[i], ADC_BLOCK_SIZE);
+  }
+  transitions = flexFilterGetStats()->transitions;
+  for (i = 0; i < STREAM_SAMPLES; i++) {
+      angles[i] = records[i].flex;
+  }
+  CHECK(transitions >= 6);
+
+  reset();
+  for (i = 0; i < STREAM_SAMPLES; i++) {
+      processBlock(&stream[i], 1);
+  }
+  CHECK_EQ(flexFilterGetStats()->transitions, transitions);
+  CHECK_EQ(recordCount, STREAM_SAMPLES);
+  for (i = 0; i < STREAM_SAMPLES; i++) {
+      if (records[i].flex != angles[i]) {
+          CHECK_EQ(records[i].flex, angles[i]);
+          break;
+      }
+  }
+}
+
+/**
+ * Exact piecewise linear curve through sorted points, extrapolated at the
+ * ends like calCurveAt() and clamped to the end points like flexAngleFromMv().
+ */
+static double curveAt(const uint16_t *mv, const int16_t *deg, uint32_t count, double x)
+{
+  uint32_t i;
+
+  if (x <= mv[0]) {
+      return deg[0];
+  }
+  if (x >= mv[count - 1]) {
+      return deg[count - 1];
+  }
+  for (i = 1; i < count - 1; i++) {
+      if (x <= mv[i]) {
+          break;
+      }
+  }
+  return deg[i - 1] + (x - mv[i - 1]) * (deg[i] - deg[i - 1]) / (mv[i] - mv[i - 1]);
+}
+
+static double maxLutError(const uint16_t *mv, const int16_t *deg, uint32_t count)
+{
+  double err, maxErr = 0.0;
+  uint32_t x;
+
+  for (x = 1000; x <= 2200; x++) {
+      err = fabs(flexAngleFromMv(x) - curveAt(mv, deg, count, x));
+      if (err > maxErr) {
+          maxErr = err;
+      }
+  }
+  return maxErr;
+}
+
+static void testLookupTable(void)
+{
+  static const uint16_t defMv[]  = { 1325, 1475, 1625 };
+  static const int16_t  defDeg[] = { 0, 450, 900 };
+  static const uint16_t calMv[]  = { 1210, 1330, 1470, 1590, 1780 };
+  static const int16_t  calDeg[] = { -50, 120, 430, 700, 950 };
+  double err;
+  uint8_t i;
+
+  reset();
+  err = maxLutError(defMv, defDeg, 3);
+  printf("  default calibration: max LUT error %.2f (0.1 deg)\n", err);
+  CHECK(err <= 1.0);
+  CHECK_EQ(flexAngleFromMv(0), 0);
+  CHECK_EQ(flexAngleFromMv(4000), 900);
+
+  // Uneven spacing puts calibration points inside table segments
+  for (i = 0; i < 5; i++) {
+      CHECK(flexAngleSetCalPoint(i, calMv[i], calDeg[i]));
+  }
+  err = maxLutError(calMv, calDeg, 5);
+  printf("  5 point calibration: max LUT error %.2f (0.1 deg)\n", err);
+  // A table segment spanning a calibration point cuts the corner
+  CHECK(err <= 4.5);
+
+  // A point on the voltage of another one is refused and changes nothing
+  CHECK(!flexAngleSetCalPoint(2, calMv[0], 300));
+  err = maxLutError(calMv, calDeg, 5);
+  CHECK(err <= 4.5);
+
+  // Recalibrating another point is not blocked by the refused one
+  CHECK(flexAngleSetCalPoint(3, 1600, 720));
+  CHECK(abs(flexAngleFromMv(1600) - 720) <= 4);
+  CHECK(abs(flexAngleFromMv(calMv[2]) - calDeg[2]) <= 4);
+  CHECK(!flexAngleSetCalPoint(FLEX_CAL_MAX_POINTS, 1500, 0));
+}
+
+static void benchmark(void)
+{
+  uint16_t block[ADC_BLOCK_SIZE];
+  uint64_t start, blockNs, lutNs;
+  volatile int32_t sink = 0;
+  uint32_t i;
+
+  reset();
+  for (i = 0; i < ADC_BLOCK_SIZE; i++) {
+      block[i] = rawFromMv(1300 + (i * 13) % 400);
+  }
+
+  start = testNanoseconds();
+  for (i = 0; i < BENCH_BLOCKS; i++) {
+      adcProcessBlock(block, ADC_BLOCK_SIZE);
+      (void) getNextEvent();
+  }
+  blockNs = testNanoseconds() - start;
+
+  start = testNanoseconds();
+  for (i = 0; i < BENCH_LUT_CALLS; i++) {
+      sink += flexAngleFromMv(1300 + (i & 511));
+  }
+  lutNs = testNanoseconds() - start;
+  (void) sink;
+
+  printf("  adcProcessBlock: %.1f ns per %d sample block (%.1f ns per sample)\n",
+         (double) blockNs / BENCH_BLOCKS, ADC_BLOCK_SIZE, (double) blockNs / BENCH_BLOCKS / ADC_BLOCK_SIZE);
+  printf("  flexAngleFromMv: %.1f ns\n", (double) lutNs / BENCH_LUT_CALLS);
+}
+
+int main(void)
+{
+  testSteadyPostures();
+  testSpikesAreRejected();
+  testRecordTimestamps();
+  testRestartKeepsPosture();
+  testBlockSizeInvariance();
+
+  printf("Flex angle lookup table:\n");
+  testLookupTable();
+
+  printf("Host block processing cost:\n");
+  benchmark();
+
+  return testFailures("test_adc_block");
+}
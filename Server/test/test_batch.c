@@ -0,0 +1,150 @@
+/***********************************************************************
+ * @file      test_batch.c
+ * @version   0.1
+ * @brief     Host test of the sample batch notifications.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * The notifications batch.c hands to the stack are captured and decoded.
+ * Nothing is sent at the default ATT MTU, a full PDU carries every record
+ * with its time, and a subscriber with a smaller MTU never receives a PDU
+ * sized for a larger one.
+ */
+
+#include <string.h>
+#include "src/scheduler.h"
+#include "src/batch.h"
+#include "gatt_db.h"
+#include "test_util.h"
+
+#define MAX_SENT          8
+
+typedef struct {
+  uint8_t  connection;
+  uint16_t len;
+  uint8_t  data[BATCH_MAX_MTU];
+} sent_t;
+
+static sent_t   sent[MAX_SENT];
+static uint32_t sentCount;
+static uint16_t mtuOf[4];
+
+sl_status_t sl_bt_gatt_server_send_notification(uint8_t connection, uint16_t characteristic,
+                                                size_t value_len, const uint8_t *value)
+{
+  CHECK_EQ(characteristic, gattdb_sample_batch);
+  CHECK(value_len + 3 <= mtuOf[connection]);
+  if (sentCount < MAX_SENT) {
+      sent[sentCount].connection = connection;
+      sent[sentCount].len = (uint16_t) value_len;
+      memcpy(sent[sentCount].data, value, value_len);
+  }
+  sentCount++;
+  return SL_STATUS_OK;
+}
+
+static uint16_t getU16(const uint8_t *p)
+{
+  return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static void connect(uint8_t connection, uint16_t mtu)
+{
+  mtuOf[connection] = mtu;
+  batchConfigure(connection, mtu);
+}
+
+static void testDefaultMtuHolds(void)
+{
+  uint32_t i, records = batchGetStats()->records;
+
+  connect(1, 23);
+  batchEnable(1, true);
+  for (i = 0; i < 10; i++) {
+      batchRecordFlex(1000 + i * 10, (int16_t) i);
+  }
+  batchOnTimer();
+  CHECK_EQ(sentCount, 0);
+  CHECK_EQ(batchGetStats()->records, records);
+}
+
+static void testFullPdu(void)
+{
+  uint32_t capacity = (BATCH_MAX_MTU - 3 - BATCH_HEADER_SIZE) / BATCH_RECORD_SIZE;
+  const uint8_t *p;
+  uint32_t i;
+
+  // The MTU exchange opens the batch
+  connect(1, BATCH_MAX_MTU);
+  sentCount = 0;
+  for (i = 0; i < capacity; i++) {
+      if (i & 1) {
+          batchRecordTilt(5000 + i * 10, (int16_t) (100 + i), (int16_t) -i);
+      } else {
+          batchRecordFlex(5000 + i * 10, (int16_t) (450 + i));
+      }
+  }
+  CHECK_EQ(sentCount, 1);
+  CHECK_EQ(sent[0].connection, 1);
+  CHECK_EQ(sent[0].len, BATCH_HEADER_SIZE + capacity * BATCH_RECORD_SIZE);
+  CHECK_EQ(sent[0].data[0], capacity);
+  CHECK_EQ(sent[0].data[1] | (sent[0].data[2] << 8) | (sent[0].data[3] << 16) | ((uint32_t) sent[0].data[4] << 24),
+           5000);
+
+  for (i = 0; i < capacity; i++) {
+      p = &sent[0].data[BATCH_HEADER_SIZE + i * BATCH_RECORD_SIZE];
+      CHECK_EQ(getU16(&p[0]), i * 10);
+      if (i & 1) {
+          CHECK_EQ((int16_t) getU16(&p[2]), BATCH_NO_VALUE);
+          CHECK_EQ((int16_t) getU16(&p[4]), 100 + i);
+          CHECK_EQ((int16_t) getU16(&p[6]), -(int32_t) i);
+      } else {
+          CHECK_EQ((int16_t) getU16(&p[2]), 450 + i);
+          CHECK_EQ((int16_t) getU16(&p[4]), BATCH_NO_VALUE);
+      }
+  }
+}
+
+static void testSmallerSubscriber(void)
+{
+  uint32_t i;
+
+  sentCount = 0;
+  for (i = 0; i < 10; i++) {
+      batchRecordFlex(9000 + i, (int16_t) i);
+  }
+  CHECK_EQ(sentCount, 0);
+
+  // The pending records go out at the first central's MTU, then the second
+  // central's default MTU holds the batch for both
+  connect(2, 23);
+  batchEnable(2, true);
+  CHECK_EQ(sentCount, 1);
+  CHECK_EQ(sent[0].connection, 1);
+  CHECK_EQ(sent[0].data[0], 10);
+
+  batchRecordFlex(9100, 1);
+  batchOnTimer();
+  CHECK_EQ(sentCount, 1);
+
+  // Both exchanged, the batch follows the smaller MTU
+  connect(2, 64);
+  for (i = 0; i < (64 - 3 - BATCH_HEADER_SIZE) / BATCH_RECORD_SIZE; i++) {
+      batchRecordFlex(9200 + i, (int16_t) i);
+  }
+  CHECK_EQ(sentCount, 3);
+  CHECK_EQ(sent[1].len, BATCH_HEADER_SIZE + ((64 - 3 - BATCH_HEADER_SIZE) / BATCH_RECORD_SIZE) * BATCH_RECORD_SIZE);
+
+  batchRemove(2);
+  batchRemove(1);
+}
+
+int main(void)
+{
+  testDefaultMtuHolds();
+  testFullPdu();
+  testSmallerSubscriber();
+
+  return testFailures("test_batch");
+}
@@ -0,0 +1,166 @@
+/***********************************************************************
+ * @file      test_broadcast.c
+ * @version   0.1
+ * @brief     Host round trip test of the posture broadcast.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * The advertising packet is built by broadcast.c through the stack calls
+ * and decoded by the client's broadcast_rx.c. Every AD length byte must
+ * match the bytes that follow it, and every sample must come back as it
+ * was sent.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "src/scheduler.h"
+#include "src/broadcast.h"
+#include "src/tilt.h"
+#include "../../Client/src/broadcast_rx.h"
+#include "test_util.h"
+
+#define RANDOM_ROUNDS     1000
+
+static uint8_t  advData[31];
+static uint8_t  advLen;
+static uint32_t advWrites;
+static tilt_t   tilt;
+static int16_t  flex;
+
+sl_status_t sl_bt_legacy_advertiser_set_data(uint8_t advertising_set, uint8_t type,
+                                             size_t data_len, const uint8_t *data)
+{
+  (void) advertising_set;
+
+  CHECK(data_len <= sizeof(advData));
+  if (type == sl_bt_advertiser_advertising_data_packet) {
+      memcpy(advData, data, data_len);
+      advLen = (uint8_t) data_len;
+      advWrites++;
+  }
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_legacy_advertiser_start(uint8_t advertising_set, uint8_t connect)
+{
+  (void) advertising_set;
+  (void) connect;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_advertiser_stop(uint8_t advertising_set)
+{
+  (void) advertising_set;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_gatt_server_read_attribute_value(uint16_t attribute, uint16_t offset, size_t max_value_size,
+                                                   size_t *value_len, uint8_t *value)
+{
+  (void) attribute;
+  (void) offset;
+  *value_len = max_value_size < 6 ? max_value_size : 6;
+  memcpy(value, "Server", *value_len);
+  return SL_STATUS_OK;
+}
+
+tilt_t tiltGet(void)
+{
+  return tilt;
+}
+
+int16_t adcGetFlexAngle(void)
+{
+  return flex;
+}
+
+// Every AD structure's length byte covers exactly the bytes that follow it
+static void checkStructures(void)
+{
+  uint8_t i = 0;
+
+  while (i < advLen) {
+      CHECK(advData[i] > 0);
+      CHECK(i + 1 + advData[i] <= advLen);
+      if ((advData[i] == 0) || (i + 1 + advData[i] > advLen)) {
+          return;
+      }
+      i += advData[i] + 1;
+  }
+  CHECK_EQ(i, advLen);
+}
+
+static void roundTrip(uint8_t posture, uint8_t sequence)
+{
+  broadcast_sample_t sample;
+
+  broadcastSetPosture(posture);
+  broadcastUpdate();
+  checkStructures();
+  CHECK(broadcastDecode(advData, advLen, &sample));
+  CHECK_EQ(sample.sequence, sequence);
+  CHECK_EQ(sample.flex, flex);
+  CHECK_EQ(sample.pitch, tilt.pitch);
+  CHECK_EQ(sample.roll, tilt.roll);
+  CHECK_EQ(sample.posture, posture);
+}
+
+static void testRoundTrip(void)
+{
+  static const int16_t edges[] = { 0, 1, -1, 900, -900, 1800, -1800, INT16_MAX, INT16_MIN };
+  uint32_t i, round;
+  uint8_t sequence = 0;
+
+  CHECK(broadcastStart(0));
+  checkStructures();
+  CHECK_EQ(advLen, 3 + 2 + BROADCAST_PAYLOAD_SIZE);
+
+  for (i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+      flex = edges[i];
+      tilt.pitch = edges[(i + 3) % (sizeof(edges) / sizeof(edges[0]))];
+      tilt.roll = edges[(i + 5) % (sizeof(edges) / sizeof(edges[0]))];
+      roundTrip((uint8_t) (45 * (i % 3)), ++sequence);
+  }
+
+  srand(13);
+  for (round = 0; round < RANDOM_ROUNDS; round++) {
+      flex = (int16_t) rand();
+      tilt.pitch = (int16_t) rand();
+      tilt.roll = (int16_t) rand();
+      roundTrip((uint8_t) (45 * (rand() % 3)), ++sequence);
+  }
+  CHECK_EQ(advWrites, 1 + sizeof(edges) / sizeof(edges[0]) + RANDOM_ROUNDS);
+}
+
+static void testRejects(void)
+{
+  broadcast_sample_t sample;
+  uint8_t packet[sizeof(advData)];
+
+  memcpy(packet, advData, advLen);
+
+  // A length byte claiming one byte more than the packet holds
+  packet[3]++;
+  CHECK(!broadcastDecode(packet, advLen, &sample));
+  packet[3]--;
+
+  // Another company id or format
+  packet[5] ^= 1;
+  CHECK(!broadcastDecode(packet, advLen, &sample));
+  packet[5] ^= 1;
+  packet[7]++;
+  CHECK(!broadcastDecode(packet, advLen, &sample));
+  packet[7]--;
+
+  CHECK(broadcastDecode(packet, advLen, &sample));
+  CHECK(!broadcastDecode(packet, 3, &sample));
+}
+
+int main(void)
+{
+  testRoundTrip();
+  testRejects();
+
+  return testFailures("test_broadcast");
+}
@@ -0,0 +1,94 @@
+/***********************************************************************
+ * @file      test_conn_policy.c
+ * @version   0.1
+ * @brief     Host test of the per connection parameter bookkeeping.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * Two centrals are connected and each reports its own parameters. What the
+ * policy records for a handle must be what that central applied, whatever
+ * order the events arrive in and after the other one leaves.
+ */
+
+#include "src/conn_policy.h"
+#include "test_util.h"
+
+static uint32_t requests;
+
+sl_status_t sl_bt_connection_set_parameters(uint8_t connection, uint16_t min_interval, uint16_t max_interval,
+                                            uint16_t latency, uint16_t timeout,
+                                            uint16_t min_ce_length, uint16_t max_ce_length)
+{
+  (void) connection;
+  (void) min_interval;
+  (void) max_interval;
+  (void) latency;
+  (void) timeout;
+  (void) min_ce_length;
+  (void) max_ce_length;
+  requests++;
+  return SL_STATUS_OK;
+}
+
+bool indicationInFlight(void)
+{
+  return false;
+}
+
+static void testKeyedOnHandle(void)
+{
+  const conn_policy_link_t *link;
+
+  connPolicyOnOpened(3);
+  connPolicyOnOpened(7);
+  CHECK_EQ(requests, 2);
+  CHECK_EQ(connPolicyGetProfile(), CONN_PROFILE_FAST);
+
+  connPolicyOnParameters(7, CONN_IDLE_INTERVAL, CONN_IDLE_LATENCY);
+  connPolicyOnParameters(3, CONN_FAST_INTERVAL, CONN_FAST_LATENCY);
+
+  link = connPolicyGetLink(3);
+  CHECK(link != NULL);
+  if (link != NULL) {
+      CHECK_EQ(link->interval, CONN_FAST_INTERVAL);
+      CHECK_EQ(link->latency, CONN_FAST_LATENCY);
+  }
+  link = connPolicyGetLink(7);
+  CHECK(link != NULL);
+  if (link != NULL) {
+      CHECK_EQ(link->interval, CONN_IDLE_INTERVAL);
+      CHECK_EQ(link->latency, CONN_IDLE_LATENCY);
+  }
+
+  // A handle that is not open is ignored
+  connPolicyOnParameters(5, 1, 1);
+  CHECK(connPolicyGetLink(5) == NULL);
+
+  connPolicyOnClosed(3);
+  CHECK(connPolicyGetLink(3) == NULL);
+  link = connPolicyGetLink(7);
+  CHECK(link != NULL);
+  if (link != NULL) {
+      CHECK_EQ(link->interval, CONN_IDLE_INTERVAL);
+  }
+
+  // A new central in the freed entry starts without parameters
+  connPolicyOnOpened(3);
+  link = connPolicyGetLink(3);
+  CHECK(link != NULL);
+  if (link != NULL) {
+      CHECK_EQ(link->interval, 0);
+  }
+
+  connPolicyOnClosed(3);
+  connPolicyOnClosed(7);
+  CHECK_EQ(connPolicyGetProfile(), CONN_PROFILE_NONE);
+}
+
+int main(void)
+{
+  testKeyedOnHandle();
+
+  return testFailures("test_conn_policy");
+}
@@ -0,0 +1,409 @@
+/***********************************************************************
+ * @file      test_i2c_queue.c
+ * @version   0.1
+ * @brief     Host test and benchmark of the interrupt driven I2C queue
+ *            against a simulated ICM-20948.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * I2C_TransferInit() and I2C_Transfer() are replaced by a model of the
+ * device: four register banks selected through REG_BANK_SEL, burst writes
+ * that auto-increment and reads. Each transfer takes a few I2C0 interrupts
+ * like on the bus, and a NACK or a stuck register can be injected. The
+ * callbacks run from schedulerDispatch(), as in the firmware.
+ */
+
+#include <string.h>
+#include "src/scheduler.h"
+#include "src/accel_fifo.h"
+#include "sl_i2cspm.h"
+#include "test_util.h"
+
+#define SIM_BANKS          4
+#define SIM_REGS           128
+#define SIM_REG_BANK_SEL   0x7F
+#define SIM_IRQS_PER_XFER  3        // interrupts before a transfer completes
+#define BENCH_TRANSFERS    200000
+
+static uint8_t  simRegs[SIM_BANKS][SIM_REGS];
+static uint8_t  simBank;
+static uint8_t  simStuckReg = 0xFF;  // register that ignores writes, 0xFF for none
+static I2C_TransferSeq_TypeDef *simSeq;
+static uint32_t simIrqs;
+static uint32_t simTransfers;
+static uint32_t simBankWrites;
+static uint32_t simNackAt = 0;       // transfer number to NACK, 0 for none
+static bool     simFailStart = false;
+
+static int32_t  em1Requests;
+
+static uint8_t *simReg(uint8_t reg)
+{
+  // REG_BANK_SEL is visible in every bank
+  return (reg == SIM_REG_BANK_SEL) ? &simRegs[0][SIM_REG_BANK_SEL] : &simRegs[simBank][reg & (SIM_REGS - 1)];
+}
+
+static I2C_TransferReturn_TypeDef simExecute(I2C_TransferSeq_TypeDef *seq)
+{
+  uint8_t reg;
+  uint16_t i;
+
+  simTransfers++;
+  if (simTransfers == simNackAt) {
+      return i2cTransferNack;
+  }
+
+  reg = seq->buf[0].data[0];
+  if (seq->flags == I2C_FLAG_WRITE) {
+      for (i = 1; i < seq->buf[0].len; i++, reg++) {
+          if (reg == simStuckReg) {
+              continue;
+          }
+          *simReg(reg) = seq->buf[0].data[i];
+          if (reg == SIM_REG_BANK_SEL) {
+              simBank = (seq->buf[0].data[i] >> 4) & 0x03;
+              simBankWrites++;
+          }
+      }
+  } else if (seq->flags == I2C_FLAG_WRITE_READ) {
+      for (i = 0; i < seq->buf[1].len; i++) {
+          seq->buf[1].data[i] = *simReg(reg + i);
+      }
+  } else {
+      return i2cTransferUsageFault;
+  }
+  return i2cTransferDone;
+}
+
+I2C_TransferReturn_TypeDef I2C_TransferInit(I2C_TypeDef *i2c, I2C_TransferSeq_TypeDef *seq)
+{
+  (void) i2c;
+
+  CHECK(simSeq == NULL);
+  CHECK_EQ(seq->addr, 0x69 << 1);
+  if (simFailStart) {
+      return i2cTransferBusErr;
+  }
+  simSeq = seq;
+  simIrqs = 0;
+  return i2cTransferInProgress;
+}
+
+I2C_TransferReturn_TypeDef I2C_Transfer(I2C_TypeDef *i2c)
+{
+  I2C_TransferSeq_TypeDef *seq = simSeq;
+
+  (void) i2c;
+
+  CHECK(seq != NULL);
+  if (++simIrqs < SIM_IRQS_PER_XFER) {
+      return i2cTransferInProgress;
+  }
+  simSeq = NULL;
+  return simExecute(seq);
+}
+
+void I2CSPM_Init(I2CSPM_Init_TypeDef *init)
+{
+  (void) init;
+}
+
+void sli_power_manager_update_em_requirement(sl_power_manager_em_t em, bool add)
+{
+  CHECK_EQ(em, SL_POWER_MANAGER_EM1);
+  em1Requests += add ? 1 : -1;
+}
+
+/**
+ * Lets the bus run until the queue is empty, then the main loop picks up
+ * the completions.
+ */
+static void busRun(void)
+{
+  uint32_t guard = 0;
+
+  while (simSeq != NULL && guard++ < 100000) {
+      I2C0_IRQHandler();
+  }
+  schedulerDispatch();
+}
+
+static void reset(void)
+{
+  schedulerInit();
+  schedulerRegisterHandler(EVENT_I2CTransfer_Done, i2cAsyncHandler);
+  busRun();
+  memset(simRegs, 0, sizeof(simRegs));
+  simBank = 0;
+  simStuckReg = 0xFF;
+  simTransfers = 0;
+  simBankWrites = 0;
+  simNackAt = 0;
+  simFailStart = false;
+  icm20948InvalidateBank();
+}
+
+static uint32_t callbackOrder[I2C_ASYNC_QUEUE_SIZE * 2];
+static uint32_t callbackCount;
+static I2C_TransferReturn_TypeDef callbackStatus[I2C_ASYNC_QUEUE_SIZE * 2];
+
+static void recordCallback(I2C_TransferReturn_TypeDef status, void *userParam)
+{
+  callbackStatus[callbackCount] = status;
+  callbackOrder[callbackCount++] = (uint32_t) (uintptr_t) userParam;
+}
+
+static void testWriteAndRead(void)
+{
+  uint8_t value = 0;
+
+  reset();
+  initI2C();
+  CHECK(i2cAsyncIdle());
+
+  CHECK(i2cWriteRegAsync(0x06, 0x81));
+  CHECK(!i2cAsyncIdle());
+  CHECK_EQ(em1Requests, 1);
+  CHECK(i2cReadRegsAsync(0x06, &value, 1, NULL, NULL));
+  busRun();
+
+  CHECK(i2cAsyncIdle());
+  CHECK_EQ(em1Requests, 0);
+  CHECK_EQ(simRegs[0][0x06], 0x81);
+  CHECK_EQ(value, 0x81);
+  CHECK_EQ(simTransfers, 2);
+}
+
+static void testOrderAndQueueFull(void)
+{
+  uint32_t i, queued = 0;
+
+  reset();
+  callbackCount = 0;
+
+  // Nothing completes until the bus runs, one slot is kept free
+  for (i = 0; i < I2C_ASYNC_QUEUE_SIZE; i++) {
+      uint8_t w[2] = { (uint8_t) i, (uint8_t) (0xA0 + i) };
+      if (i2cQueueTransfer(I2C_FLAG_WRITE, w, 2, NULL, 0, recordCallback, (void *) (uintptr_t) i)) {
+          queued++;
+      }
+  }
+  CHECK_EQ(queued, I2C_ASYNC_QUEUE_SIZE - 1);
+
+  // Too long a write is refused without touching the queue
+  CHECK(!i2cQueueTransfer(I2C_FLAG_WRITE, simRegs[0], I2C_ASYNC_WRITE_MAX + 1, NULL, 0, NULL, NULL));
+
+  busRun();
+  CHECK_EQ(callbackCount, queued);
+  for (i = 0; i < queued; i++) {
+      CHECK_EQ(callbackOrder[i], i);
+      CHECK_EQ(callbackStatus[i], i2cTransferDone);
+      CHECK_EQ(simRegs[0][i], 0xA0 + i);
+  }
+  CHECK_EQ(em1Requests, 0);
+}
+
+/**
+ * A completion that queues the next transfer from its callback, the way
+ * the FIFO drain chains its reads, keeps the bus going.
+ */
+static uint8_t chainLeft;
+
+static void chainCallback(I2C_TransferReturn_TypeDef status, void *userParam)
+{
+  (void) userParam;
+  CHECK_EQ(status, i2cTransferDone);
+  if (chainLeft > 0) {
+      chainLeft--;
+      CHECK(i2cWriteRegAsync(0x20 + chainLeft, chainLeft));
+      CHECK(i2cReadRegsAsync(0x20 + chainLeft, &simRegs[3][chainLeft], 1, chainCallback, NULL));
+  }
+}
+
+static void testChainedFromCallback(void)
+{
+  uint32_t guard = 0;
+
+  reset();
+  chainLeft = 5;
+  CHECK(i2cReadRegsAsync(0x00, &simRegs[3][100], 1, chainCallback, NULL));
+  while (!i2cAsyncIdle() && guard++ < 100) {
+      busRun();
+  }
+  CHECK_EQ(chainLeft, 0);
+  CHECK_EQ(simTransfers, 1 + 5 * 2);
+  CHECK_EQ(simRegs[0][0x20 + 3], 3);
+  CHECK_EQ(em1Requests, 0);
+}
+
+static void testErrorsKeepTheQueueMoving(void)
+{
+  reset();
+  callbackCount = 0;
+
+  // The second transfer is NACKed, the third still runs
+  simNackAt = 2;
+  CHECK(i2cQueueTransfer(I2C_FLAG_WRITE, (const uint8_t[]) {0x10, 1}, 2, NULL, 0, recordCallback, (void *) 1));
+  CHECK(i2cQueueTransfer(I2C_FLAG_WRITE, (const uint8_t[]) {0x11, 2}, 2, NULL, 0, recordCallback, (void *) 2));
+  CHECK(i2cQueueTransfer(I2C_FLAG_WRITE, (const uint8_t[]) {0x12, 3}, 2, NULL, 0, recordCallback, (void *) 3));
+  busRun();
+  CHECK_EQ(callbackCount, 3);
+  CHECK_EQ(callbackStatus[0], i2cTransferDone);
+  CHECK_EQ(callbackStatus[1], i2cTransferNack);
+  CHECK_EQ(callbackStatus[2], i2cTransferDone);
+  CHECK_EQ(simRegs[0][0x11], 0);
+  CHECK_EQ(simRegs[0][0x12], 3);
+
+  // A transfer that cannot start completes at once with the error
+  simFailStart = true;
+  CHECK(i2cQueueTransfer(I2C_FLAG_WRITE, (const uint8_t[]) {0x13, 4}, 2, NULL, 0, recordCallback, (void *) 4));
+  simFailStart = false;
+  CHECK(i2cAsyncIdle());
+  CHECK_EQ(em1Requests, 0);
+  schedulerDispatch();
+  CHECK_EQ(callbackCount, 4);
+  CHECK_EQ(callbackStatus[3], i2cTransferBusErr);
+}
+
+static void testBankCache(void)
+{
+  uint8_t reg[2] = { 0x13, 0x55 };
+
+  reset();
+  CHECK(icm20948QueueBanked(2, I2C_FLAG_WRITE, reg, 2, NULL, 0, NULL, NULL));
+  reg[1] = 0x66;
+  reg[0] = 0x14;
+  CHECK(icm20948QueueBanked(2, I2C_FLAG_WRITE, reg, 2, NULL, 0, NULL, NULL));
+  busRun();
+
+  CHECK_EQ(simBankWrites, 1);
+  CHECK_EQ(simRegs[2][0x13], 0x55);
+  CHECK_EQ(simRegs[2][0x14], 0x66);
+  CHECK_EQ(simRegs[0][0x13], 0x00);
+
+  // After a device reset the cache must not skip the bank switch
+  icm20948InvalidateBank();
+  simBank = 0;
+  CHECK(icm20948QueueBanked(2, I2C_FLAG_WRITE, reg, 2, NULL, 0, NULL, NULL));
+  busRun();
+  CHECK_EQ(simBankWrites, 2);
+}
+
+static void testInitTable(void)
+{
+  reset();
+  set_acc_sensor();
+  busRun();
+
+  CHECK_EQ(simRegs[0][0x06], 0x29);
+  CHECK_EQ(simRegs[0][0x07], 0x07);
+  CHECK_EQ(simRegs[2][0x12], 0x03);
+  CHECK_EQ(simRegs[2][0x13], 0x14);
+  CHECK_EQ(simRegs[0][0x10], 0x08);
+  CHECK_EQ(icm20948VerifyErrors(), 0);
+  // WHO_AM_I, 3 bank switches and 3 burst writes for the table, then 5
+  // read backs in table order, which switch bank twice more
+  CHECK_EQ(simBankWrites, 3 + 2);
+  CHECK_EQ(simTransfers, 1 + 3 + 3 + 5 + 2);
+
+  // A register that does not take the write is reported by the read back
+  reset();
+  simStuckReg = 0x13;
+  set_acc_sensor();
+  busRun();
+  CHECK_EQ(icm20948VerifyErrors(), 1);
+}
+
+static const icm20948_reg_t tableA[] = {
+  { 0, 0x10, 0x11, 0xFF },
+  { 0, 0x11, 0x22, 0xFF },
+  { 0, 0x12, 0x33, 0xFF },
+};
+
+static const icm20948_reg_t tableB[] = {
+  { 2, 0x20, 0x44, 0xFF },
+  { 2, 0x21, 0x55, 0xFF },
+};
+
+static const icm20948_reg_t tableC[ICM20948_MAX_VERIFY / 2] = {
+  { 0, 0x30, 0x01, 0xFF }, { 0, 0x31, 0x02, 0xFF }, { 0, 0x32, 0x03, 0xFF }, { 0, 0x33, 0x04, 0xFF },
+  { 0, 0x34, 0x05, 0xFF }, { 0, 0x35, 0x06, 0xFF }, { 0, 0x36, 0x07, 0xFF }, { 0, 0x37, 0x08, 0xFF },
+};
+
+static void testTablesBackToBack(void)
+{
+  uint8_t errors;
+
+  // Both tables are queued before the first read back completes, each
+  // read back has to be compared against its own table
+  reset();
+  errors = icm20948VerifyErrors();
+  CHECK(icm20948ApplyTable(tableA, 3));
+  CHECK(icm20948ApplyTable(tableB, 2));
+  busRun();
+  CHECK_EQ(simRegs[0][0x12], 0x33);
+  CHECK_EQ(simRegs[2][0x21], 0x55);
+  CHECK_EQ(icm20948VerifyErrors(), errors);
+
+  // The boot sequence, interrupt setup then the FIFO
+  reset();
+  set_acc_sensor();
+  accelFifoStart();
+  busRun();
+  CHECK_EQ(icm20948VerifyErrors(), errors);
+
+  // A stuck register in the second table is reported once
+  reset();
+  simStuckReg = 0x21;
+  CHECK(icm20948ApplyTable(tableA, 3));
+  CHECK(icm20948ApplyTable(tableB, 2));
+  busRun();
+  CHECK_EQ(icm20948VerifyErrors(), (uint8_t) (errors + 1));
+
+  // Read backs in flight are bounded, the slots come back once they complete
+  reset();
+  errors = icm20948VerifyErrors();
+  CHECK(icm20948ApplyTable(tableC, 8));
+  CHECK(icm20948ApplyTable(tableC, 8));
+  CHECK(!icm20948ApplyTable(tableB, 2));
+  busRun();
+  CHECK(icm20948ApplyTable(tableB, 2));
+  busRun();
+  CHECK_EQ(icm20948VerifyErrors(), errors);
+}
+
+static void benchmark(void)
+{
+  uint64_t start, ns;
+  uint8_t value;
+  uint32_t i;
+
+  reset();
+  start = testNanoseconds();
+  for (i = 0; i < BENCH_TRANSFERS; i++) {
+      i2cReadRegsAsync(0x2D, &value, 1, NULL, NULL);
+      busRun();
+  }
+  ns = testNanoseconds() - start;
+  CHECK_EQ(simTransfers, BENCH_TRANSFERS);
+
+  printf("  queue, %d interrupts and callback dispatch: %.1f ns per transfer\n",
+         SIM_IRQS_PER_XFER, (double) ns / BENCH_TRANSFERS);
+}
+
+int main(void)
+{
+  testWriteAndRead();
+  testOrderAndQueueFull();
+  testChainedFromCallback();
+  testErrorsKeepTheQueueMoving();
+  testBankCache();
+  testInitTable();
+  testTablesBackToBack();
+
+  printf("Host I2C queue cost:\n");
+  benchmark();
+
+  return testFailures("test_i2c_queue");
+}
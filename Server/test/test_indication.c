@@ -0,0 +1,101 @@
+/***********************************************************************
+ * @file      test_indication.c
+ * @version   0.1
+ * @brief     Host test of the indication queue latency statistics.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * indication.c is linked with the real LETIMER clock from irq.c, run on a
+ * RAM LETIMER0 as in test_letimer.c. Values queued behind an indication in
+ * flight must report the time they waited, also across LETIMER periods.
+ */
+
+#include "app.h"
+#include "src/scheduler.h"
+#include "src/indication.h"
+#include "src/irq.h"
+#include "src/timers.h"
+#include "em_letimer.h"
+#include "test_util.h"
+
+#define LETIMER_IF        (*(volatile uint32_t *) &hostLetimer0.IF)   // read only on the part
+#define TEST_HANDLE       21
+#define TEST_CONNECTION   1
+
+static uint32_t indicationsSent;
+
+sl_status_t sl_bt_gatt_server_send_indication(uint8_t connection, uint16_t characteristic,
+                                              size_t value_len, const uint8_t *value)
+{
+  (void) value;
+  CHECK_EQ(connection, TEST_CONNECTION);
+  CHECK_EQ(characteristic, TEST_HANDLE);
+  CHECK_EQ(value_len, 1);
+  indicationsSent++;
+  return SL_STATUS_OK;
+}
+
+uint16_t linkGetPayloadBudget(uint8_t connection)
+{
+  (void) connection;
+  return 20;
+}
+
+// Counts the LETIMER down by ms, underflowing and running the ISR like the part
+static void advanceMs(uint32_t ms)
+{
+  uint32_t ticks = (ms * ACTUAL_CLOCK_FREQ) / 1000;
+
+  while (ticks--) {
+      if (hostLetimer0.CNT == 0) {
+          hostLetimer0.CNT = LETIMER_COMP0_VAL;
+          LETIMER_IF |= LETIMER_IF_UF;
+          LETIMER0_IRQHandler();
+          LETIMER_IF &= ~LETIMER_IF_UF;
+      } else {
+          hostLetimer0.CNT--;
+      }
+  }
+}
+
+static void testLatency(uint32_t startCount)
+{
+  const indication_stats_t *stats;
+  uint8_t value = 0;
+  uint32_t i;
+
+  schedulerInit();
+  hostLetimer0.IEN = LETIMER_IEN_UF;
+  hostLetimer0.CNT = startCount;
+  indicationReset();
+  CHECK(indicationAddChannel(TEST_HANDLE, false));
+  CHECK(indicationOpen(TEST_CONNECTION));
+  indicationsSent = 0;
+
+  // The first goes out at once, the others wait for a confirmation each
+  for (i = 0; i < 4; i++) {
+      CHECK(indicationSend(TEST_CONNECTION, TEST_HANDLE, &value, 1));
+  }
+  CHECK_EQ(indicationsSent, 1);
+  for (i = 0; i < 3; i++) {
+      advanceMs(250);
+      indicationConfirmed(TEST_CONNECTION);
+  }
+  CHECK_EQ(indicationsSent, 4);
+
+  // Waited 0, 250, 500 and 750 ms, within a tick of rounding each
+  stats = indicationGetStats(TEST_HANDLE);
+  CHECK_EQ(stats->sent, 4);
+  CHECK((stats->latency_max_ms >= 749) && (stats->latency_max_ms <= 751));
+  CHECK((stats->latency_sum_ms >= 1497) && (stats->latency_sum_ms <= 1503));
+}
+
+int main(void)
+{
+  // Start mid period and just before an underflow
+  testLatency(LETIMER_COMP0_VAL / 2);
+  testLatency(10);
+
+  return testFailures("test_indication");
+}
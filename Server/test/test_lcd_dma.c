@@ -0,0 +1,325 @@
+/***********************************************************************
+ * @file      test_lcd_dma.c
+ * @version   0.1
+ * @brief     Host test of the LDMA memory LCD refresh against the SDK
+ *            memlcd driver.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * The SDK sl_memlcd_draw() is linked unmodified as the reference. Both
+ * paths are captured as the bits leave USART1: the driver writes every
+ * byte bit reversed to an MSB first USART, lcd_dma.c hands the packet to
+ * the LDMA with the USART switched to LSB first. A captured byte holds the
+ * first bit on the wire in bit 0, so the two streams must be identical.
+ * The streams are also fed to a model of the panel, which must end up with
+ * exactly the marked lines of the reference framebuffer.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "src/scheduler.h"
+#include "src/lcd_dma.h"
+#include "sl_memlcd.h"
+#include "sl_memlcd_display.h"
+#include "em_gpio.h"
+#include "dmd.h"
+#include "test_util.h"
+
+#define WIRE_MAX          (LCD_DMA_HEIGHT * LCD_DMA_LINE_PACKET * 2)
+#define PANEL_UNWRITTEN   0xA5
+#define RANDOM_ROUNDS     500
+
+static uint8_t frameBuffer[LCD_DMA_HEIGHT * LCD_DMA_LINE_BYTES];
+static uint8_t panel[LCD_DMA_HEIGHT * LCD_DMA_LINE_BYTES];
+
+static uint8_t  wire[WIRE_MAX];
+static uint32_t wireLen;
+static uint32_t frames;             // packets handed to the LDMA
+static uint32_t frameLen[8];
+static bool     csDuringTransfer;
+static Ecode_t  dmaResult = ECODE_EMDRV_DMADRV_OK;
+static DMADRV_Callback_t dmaCallback;
+
+static sl_memlcd_t device = {
+  .width = SL_MEMLCD_DISPLAY_WIDTH,
+  .height = SL_MEMLCD_DISPLAY_HEIGHT,
+  .bpp = SL_MEMLCD_DISPLAY_BPP,
+  .color_mode = SL_MEMLCD_COLOR_MODE_MONOCHROME,
+  .spi_freq = SL_MEMLCD_SCLK_FREQ,
+  .extcomin_freq = SL_MEMLCD_EXTCOMIN_FREQUENCY,
+  .setup_us = SL_MEMLCD_SCS_SETUP_US,
+  .hold_us = SL_MEMLCD_SCS_HOLD_US,
+};
+
+// The bits of one USART frame in the order they are shifted out
+static uint8_t wireBits(const USART_TypeDef *usart, uint8_t data)
+{
+  uint8_t reversed = 0;
+  int i;
+
+  if (!(usart->CTRL & USART_CTRL_MSBF)) {
+      return data;
+  }
+  for (i = 0; i < 8; i++) {
+      if (data & (1u << i)) {
+          reversed |= 0x80u >> i;
+      }
+  }
+  return reversed;
+}
+
+static bool csAsserted(void)
+{
+  return (hostGpioDout[SL_MEMLCD_SPI_CS_PORT] >> SL_MEMLCD_SPI_CS_PIN) & 1u;
+}
+
+void USART_Tx(USART_TypeDef *usart, uint8_t data)
+{
+  CHECK(csAsserted());
+  if (wireLen < WIRE_MAX) {
+      wire[wireLen++] = wireBits(usart, data);
+  }
+}
+
+Ecode_t DMADRV_MemoryPeripheral(unsigned int channelId, DMADRV_PeripheralSignal_t peripheralSignal,
+                                void *dst, void *src, bool srcInc, int len, DMADRV_DataSize_t size,
+                                DMADRV_Callback_t callback, void *cbUserParam)
+{
+  const uint8_t *bytes = src;
+  int i;
+
+  (void) channelId;
+  (void) cbUserParam;
+
+  CHECK_EQ(peripheralSignal, dmadrvPeripheralSignal_USART1_TXBL);
+  CHECK(dst == (void *) &USART1->TXDATA);
+  CHECK(srcInc);
+  CHECK_EQ(size, dmadrvDataSize1);
+  CHECK(len <= DMADRV_MAX_XFER_COUNT);
+  if (dmaResult != ECODE_EMDRV_DMADRV_OK) {
+      return dmaResult;
+  }
+
+  csDuringTransfer = csAsserted();
+  for (i = 0; i < len && wireLen < WIRE_MAX; i++) {
+      wire[wireLen++] = wireBits(USART1, bytes[i]);
+  }
+  dmaCallback = callback;
+  if (frames < sizeof(frameLen) / sizeof(frameLen[0])) {
+      frameLen[frames] = (uint32_t) len;
+  }
+  frames++;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+EMSTATUS DMD_getFrameBuffer(void **fb)
+{
+  *fb = frameBuffer;
+  return DMD_OK;
+}
+
+/**
+ * Runs the LDMA path to completion: every packet is "sent", its callback
+ * raises EVENT_LCD_DONE and the handler closes the frame and starts the
+ * next one.
+ */
+static void dmaRun(void)
+{
+  uint32_t guard = 0;
+
+  lcdDmaStart();
+  while (lcdDmaBusy() && guard++ < 16) {
+      CHECK(csDuringTransfer);
+      CHECK(!(USART1->CTRL & USART_CTRL_MSBF));
+      dmaCallback(0, 0, NULL);
+      schedulerDispatch();
+  }
+  CHECK(!lcdDmaBusy());
+  CHECK(!csAsserted());
+  CHECK(USART1->CTRL & USART_CTRL_MSBF);
+}
+
+/**
+ * Panel model, multiple line update mode: mode byte, then per line the
+ * gate address, 16 data bytes and a dummy byte, and a final dummy byte.
+ */
+static uint32_t panelReceive(const uint8_t *bytes, uint32_t len)
+{
+  uint32_t i = 0, lines = 0;
+  uint8_t addr;
+
+  CHECK_EQ(bytes[i++], LCD_DMA_CMD_UPDATE);
+  while (i < len) {
+      addr = bytes[i++];
+      if (addr == LCD_DMA_DUMMY) {
+          break;
+      }
+      CHECK((addr >= 1) && (addr <= LCD_DMA_HEIGHT));
+      CHECK(i + LCD_DMA_LINE_BYTES < len);
+      if ((addr < 1) || (addr > LCD_DMA_HEIGHT) || (i + LCD_DMA_LINE_BYTES >= len)) {
+          return lines;
+      }
+      memcpy(&panel[(addr - 1) * LCD_DMA_LINE_BYTES], &bytes[i], LCD_DMA_LINE_BYTES);
+      i += LCD_DMA_LINE_BYTES;
+      CHECK_EQ(bytes[i++], LCD_DMA_DUMMY);
+      lines++;
+  }
+  CHECK_EQ(i, len);
+  return lines;
+}
+
+static void randomFrameBuffer(void)
+{
+  uint32_t i;
+
+  for (i = 0; i < sizeof(frameBuffer); i++) {
+      frameBuffer[i] = (uint8_t) rand();
+  }
+}
+
+static void reset(void)
+{
+  schedulerInit();
+  schedulerRegisterHandler(EVENT_LCD_DONE, lcdDmaHandler);
+  lcdDmaInit();
+  wireLen = 0;
+  frames = 0;
+  dmaResult = ECODE_EMDRV_DMADRV_OK;
+  *(volatile uint32_t *) &USART1->STATUS = USART_STATUS_TXC;  // read only on the part
+}
+
+static void testMatchesDriver(void)
+{
+  static const struct { uint32_t first, count; } runs[] = {
+    { 0, 1 }, { 127, 1 }, { 5, 8 }, { 40, 40 }, { 0, LCD_DMA_MAX_LINES }, { 0, LCD_DMA_HEIGHT },
+  };
+  static uint8_t reference[WIRE_MAX];
+  uint32_t referenceLen, first, count, n, i;
+
+  for (n = 0; n < sizeof(runs) / sizeof(runs[0]); n++) {
+      first = runs[n].first;
+      count = runs[n].count;
+      reset();
+      randomFrameBuffer();
+
+      // DMD_updateDisplay() sends one run of lines per sl_memlcd_draw(),
+      // the LDMA path splits runs longer than one descriptor the same way
+      for (i = 0; i < count; i += LCD_DMA_MAX_LINES) {
+          sl_memlcd_draw(&device, &frameBuffer[(first + i) * LCD_DMA_LINE_BYTES], first + i,
+                         (count - i < LCD_DMA_MAX_LINES) ? count - i : LCD_DMA_MAX_LINES);
+      }
+      memcpy(reference, wire, wireLen);
+      referenceLen = wireLen;
+
+      wireLen = 0;
+      lcdDmaMarkLines(first, count);
+      dmaRun();
+
+      CHECK_EQ(wireLen, referenceLen);
+      CHECK(memcmp(wire, reference, referenceLen) == 0);
+      CHECK_EQ(frames, (count + LCD_DMA_MAX_LINES - 1) / LCD_DMA_MAX_LINES);
+      CHECK_EQ(lcdDmaGetStats()->lines, count);
+      CHECK_EQ(lcdDmaGetStats()->bytes, referenceLen);
+  }
+}
+
+static void testSparseLinesOnPanel(void)
+{
+  bool marked[LCD_DMA_HEIGHT];
+  uint32_t round, line, count, received, frame, pos;
+
+  srand(22);
+  for (round = 0; round < RANDOM_ROUNDS; round++) {
+      reset();
+      randomFrameBuffer();
+      memset(panel, PANEL_UNWRITTEN, sizeof(panel));
+
+      count = 0;
+      for (line = 0; line < LCD_DMA_HEIGHT; line++) {
+          marked[line] = (rand() % (1 + round % 8)) == 0;
+          if (marked[line]) {
+              lcdDmaMarkLines(line, 1);
+              count++;
+          }
+      }
+      dmaRun();
+
+      received = 0;
+      pos = 0;
+      for (frame = 0; frame < frames; frame++) {
+          received += panelReceive(&wire[pos], frameLen[frame]);
+          pos += frameLen[frame];
+      }
+      CHECK_EQ(pos, wireLen);
+      CHECK_EQ(received, count);
+
+      for (line = 0; line < LCD_DMA_HEIGHT; line++) {
+          if (marked[line]) {
+              CHECK(memcmp(&panel[line * LCD_DMA_LINE_BYTES], &frameBuffer[line * LCD_DMA_LINE_BYTES],
+                           LCD_DMA_LINE_BYTES) == 0);
+          } else {
+              CHECK_EQ(panel[line * LCD_DMA_LINE_BYTES], PANEL_UNWRITTEN);
+          }
+      }
+  }
+}
+
+static void testFailedTransferKeepsLines(void)
+{
+  reset();
+  randomFrameBuffer();
+  memset(panel, PANEL_UNWRITTEN, sizeof(panel));
+
+  dmaResult = ECODE_EMDRV_DMADRV_PARAM_ERROR;
+  lcdDmaMarkLines(10, 3);
+  lcdDmaMarkLines(90, 1);
+  lcdDmaStart();
+  CHECK(!lcdDmaBusy());
+  CHECK(!csAsserted());
+  CHECK(USART1->CTRL & USART_CTRL_MSBF);
+  CHECK_EQ(lcdDmaGetStats()->errors, 1);
+  CHECK_EQ(wireLen, 0);
+
+  // The lines of the failed packet go out with the next refresh
+  dmaResult = ECODE_EMDRV_DMADRV_OK;
+  dmaRun();
+  CHECK_EQ(panelReceive(wire, wireLen), 4);
+  CHECK(memcmp(&panel[90 * LCD_DMA_LINE_BYTES], &frameBuffer[90 * LCD_DMA_LINE_BYTES], LCD_DMA_LINE_BYTES) == 0);
+}
+
+static void testMarkedWhileBusy(void)
+{
+  reset();
+  randomFrameBuffer();
+
+  lcdDmaMarkLines(0, 2);
+  lcdDmaStart();
+  CHECK(lcdDmaBusy());
+
+  // A refresh while the packet is on the wire is picked up by the handler
+  lcdDmaMarkLines(50, 2);
+  lcdDmaStart();
+  CHECK_EQ(lcdDmaGetStats()->deferred, 1);
+  CHECK_EQ(frames, 1);
+
+  dmaRun();
+  CHECK_EQ(frames, 2);
+  CHECK_EQ(lcdDmaGetStats()->lines, 4);
+}
+
+int main(void)
+{
+  // The driver sets up USART1 MSB first and clears the panel
+  reset();
+  CHECK_EQ(sl_memlcd_configure(&device), SL_STATUS_OK);
+  CHECK(USART1->CTRL & USART_CTRL_MSBF);
+  CHECK(!csAsserted());
+
+  testMatchesDriver();
+  testSparseLinesOnPanel();
+  testFailedTransferKeepsLines();
+  testMarkedWhileBusy();
+
+  return testFailures("test_lcd_dma");
+}
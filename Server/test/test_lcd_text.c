@@ -0,0 +1,195 @@
+/***********************************************************************
+ * @file      test_lcd_text.c
+ * @version   0.1
+ * @brief     Host test and benchmark of the text row blitter against
+ *            GLIB_drawStringOnLine().
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * GLIB, the narrow 6x8 font and the DMD memory LCD driver are the SDK
+ * sources, linked unmodified. Every row is drawn twice from the same
+ * framebuffer contents, once by GLIB_drawStringOnLine() centered and
+ * opaque and once by lcdTextDrawRow(), and the framebuffers must match
+ * byte for byte. A single GLIB pixel pins down the framebuffer layout the
+ * blitter assumes: pixel x of a line is bit (x & 7) of byte (x >> 3) and
+ * a set bit is white.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "src/scheduler.h"
+#include "src/lcd_text.h"
+#include "dmd.h"
+#include "glib.h"
+#include "test_util.h"
+
+#define FB_BYTES          (LCD_DMA_HEIGHT * LCD_DMA_LINE_BYTES)
+#define RANDOM_ROUNDS     2000
+#define BENCH_ROWS        20000
+
+static GLIB_Context_t context;
+static uint8_t textRows;              // rows of text that fit the display
+static uint8_t *frameBuffer;
+static uint8_t before[FB_BYTES];
+static uint8_t reference[FB_BYTES];
+
+static void testLayout(void)
+{
+  uint32_t x, y;
+
+  for (y = 0; y < LCD_DMA_HEIGHT; y += 37) {
+      for (x = 0; x < LCD_DMA_WIDTH; x += 13) {
+          memset(frameBuffer, 0x00, FB_BYTES);
+          context.foregroundColor = White;
+          CHECK_EQ(GLIB_drawPixel(&context, x, y), GLIB_OK);
+          CHECK_EQ(frameBuffer[y * LCD_DMA_LINE_BYTES + (x >> 3)], 1u << (x & 7));
+
+          memset(frameBuffer, 0xFF, FB_BYTES);
+          context.foregroundColor = Black;
+          CHECK_EQ(GLIB_drawPixel(&context, x, y), GLIB_OK);
+          CHECK_EQ(frameBuffer[y * LCD_DMA_LINE_BYTES + (x >> 3)], (uint8_t) ~(1u << (x & 7)));
+      }
+  }
+}
+
+/**
+ * Draws text on row with both paths from the current framebuffer and
+ * compares. Returns false on a mismatch.
+ */
+static bool compareRow(const char *text, uint8_t row)
+{
+  uint32_t fastRows = lcdTextGetStats()->fast_rows;
+  bool same;
+
+  memcpy(before, frameBuffer, FB_BYTES);
+  // GLIB reports an empty row as nothing to draw, the blitter as done
+  CHECK(GLIB_drawStringOnLine(&context, text, row, GLIB_ALIGN_CENTER, 0, 0, true) <= GLIB_ERROR_NOTHING_TO_DRAW);
+  memcpy(reference, frameBuffer, FB_BYTES);
+
+  memcpy(frameBuffer, before, FB_BYTES);
+  CHECK_EQ(lcdTextDrawRow(&context, text, row), GLIB_OK);
+  CHECK_EQ(lcdTextGetStats()->fast_rows, fastRows + 1);
+
+  same = memcmp(frameBuffer, reference, FB_BYTES) == 0;
+  if (!same) {
+      printf("  mismatch drawing \"%s\" on row %u\n", text, row);
+  }
+  return same;
+}
+
+static void randomFrameBuffer(void)
+{
+  uint32_t i;
+
+  for (i = 0; i < FB_BYTES; i++) {
+      frameBuffer[i] = (uint8_t) rand();
+  }
+}
+
+static void testFixedRows(void)
+{
+  static const char *rows[] = {
+    "", "A", "Server", "Flex: 45 Deg", "Tilt: -12.3 / 170.0",
+    "0123456789 !\"#$%&'()", "*+,-./:;<=>?@[", "\\]^_`{|}~",
+    "abcdefghijklmnopqrstu", "ABCDEFGHIJKLMNOPQRSTU",
+  };
+  static const uint32_t colors[][2] = {
+    { Black, White }, { White, Black }, { Black, Black }, { White, White },
+  };
+  uint32_t i, c;
+  uint8_t row;
+
+  for (c = 0; c < sizeof(colors) / sizeof(colors[0]); c++) {
+      context.foregroundColor = colors[c][0];
+      context.backgroundColor = colors[c][1];
+      for (i = 0; i < sizeof(rows) / sizeof(rows[0]); i++) {
+          for (row = 0; row < textRows; row++) {
+              randomFrameBuffer();
+              CHECK(compareRow(rows[i], row));
+          }
+      }
+  }
+}
+
+static void testRandomRows(void)
+{
+  char text[LCD_DMA_WIDTH / 6 + 1];
+  uint32_t round, len, i;
+  uint8_t row;
+
+  srand(23);
+  for (round = 0; round < RANDOM_ROUNDS; round++) {
+      context.foregroundColor = (rand() & 1) ? White : Black;
+      context.backgroundColor = (rand() & 1) ? White : Black;
+      len = (uint32_t) rand() % sizeof(text);
+      for (i = 0; i < len; i++) {
+          text[i] = (char) (' ' + rand() % 95);
+      }
+      text[len] = '\0';
+      row = (uint8_t) (rand() % textRows);
+
+      randomFrameBuffer();
+      CHECK(compareRow(text, row));
+  }
+}
+
+static void testFallback(void)
+{
+  uint32_t glibRows = lcdTextGetStats()->glib_rows;
+
+  // Wider than the display, GLIB clips it
+  context.foregroundColor = Black;
+  context.backgroundColor = White;
+  CHECK_EQ(lcdTextDrawRow(&context, "this row is far too long for the display", 2), GLIB_OK);
+  CHECK_EQ(lcdTextGetStats()->glib_rows, glibRows + 1);
+}
+
+static void benchmark(void)
+{
+  static const char *rows[] = { "Server", "Flex: 45 Deg", "Tilt: -12.3 / 170.0", "Connected" };
+  uint64_t start, fastNs, glibNs;
+  uint32_t i;
+
+  context.foregroundColor = Black;
+  context.backgroundColor = White;
+
+  start = testNanoseconds();
+  for (i = 0; i < BENCH_ROWS; i++) {
+      lcdTextDrawRow(&context, rows[i & 3], (uint8_t) (i % textRows));
+  }
+  fastNs = testNanoseconds() - start;
+
+  start = testNanoseconds();
+  for (i = 0; i < BENCH_ROWS; i++) {
+      GLIB_drawStringOnLine(&context, rows[i & 3], (uint8_t) (i % textRows), GLIB_ALIGN_CENTER, 0, 0, true);
+  }
+  glibNs = testNanoseconds() - start;
+
+  printf("Host text row cost:\n");
+  printf("  lcdTextDrawRow blitter:  %8.1f ns per row\n", (double) fastNs / BENCH_ROWS);
+  printf("  GLIB_drawStringOnLine:   %8.1f ns per row (%.1fx)\n",
+         (double) glibNs / BENCH_ROWS, (double) glibNs / fastNs);
+}
+
+int main(void)
+{
+  void *fb;
+
+  // The driver clears the panel from DMD_init() and waits for TXC
+  *(volatile uint32_t *) &USART1->STATUS = USART_STATUS_TXC;
+  CHECK_EQ(DMD_init(0), DMD_OK);
+  CHECK_EQ(GLIB_contextInit(&context), GLIB_OK);
+  CHECK_EQ(GLIB_setFont(&context, (GLIB_Font_t *) &GLIB_FontNarrow6x8), GLIB_OK);
+  CHECK_EQ(DMD_getFrameBuffer(&fb), DMD_OK);
+  frameBuffer = fb;
+  textRows = LCD_DMA_HEIGHT / (context.font.fontHeight + context.font.lineSpacing);
+
+  testLayout();
+  testFixedRows();
+  testRandomRows();
+  testFallback();
+  benchmark();
+
+  return testFailures("test_lcd_text");
+}
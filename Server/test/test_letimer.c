@@ -0,0 +1,186 @@
+/***********************************************************************
+ * @file      test_letimer.c
+ * @version   0.1
+ * @brief     Host test of the LETIMER0 millisecond clock.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * LETIMER0 is a RAM copy the test counts down tick by tick the way the part
+ * does in comp0Top mode: COMP0 down to 0, then reload to COMP0 and raise
+ * UF. The ISR in irq.c is called directly, sometimes a few ticks late as
+ * after a critical section. letimerMilliseconds() must never step back and
+ * must match the ticks counted. EVENT_LETIMER_UF is raised on every
+ * LETIMER_UF_EVENT_DIV-th underflow only, and closes the broadcast sample
+ * window on time.
+ */
+
+#include <stdlib.h>
+#include "app.h"
+#include "src/scheduler.h"
+#include "src/irq.h"
+#include "src/timers.h"
+#include "src/broadcast.h"
+#include "em_letimer.h"
+#include "test_util.h"
+
+#define TEST_PERIODS      20
+#define LETIMER_IF        (*(volatile uint32_t *) &hostLetimer0.IF)   // read only on the part
+
+static uint32_t ufPending;          // ticks until the ISR runs, 0 = none pending
+static uint32_t reloads;            // underflows of the modelled counter
+static uint32_t ufEvents;
+static bool     sampling;
+
+void adcStartSampling(void)
+{
+  sampling = true;
+}
+
+void adcStopSampling(void)
+{
+  sampling = false;
+}
+
+bool broadcastWantsSamples(void)
+{
+  return true;
+}
+
+static void reset(void)
+{
+  schedulerInit();
+  hostLetimer0.IEN = LETIMER_IEN_UF;
+  LETIMER_IF = 0;
+  hostLetimer0.CNT = LETIMER_COMP0_VAL;
+  ufPending = 0;
+  reloads = 0;
+}
+
+// Runs the ISR, the part clears the flags on the IFC write
+static void runIsr(void)
+{
+  uint32_t flags = LETIMER_IF & hostLetimer0.IEN;
+
+  LETIMER0_IRQHandler();
+  LETIMER_IF &= ~flags;
+}
+
+// One LETIMER tick, with the ISR delayed by up to maxDelay ticks
+static void tick(uint32_t maxDelay)
+{
+  if (hostLetimer0.CNT == 0) {
+      hostLetimer0.CNT = LETIMER_COMP0_VAL;
+      LETIMER_IF |= LETIMER_IF_UF;
+      reloads++;
+      ufPending = 1 + (maxDelay ? (uint32_t) rand() % maxDelay : 0);
+  } else {
+      hostLetimer0.CNT--;
+  }
+  if (ufPending && (--ufPending == 0)) {
+      runIsr();
+  }
+}
+
+static void testIncreases(uint32_t maxDelay)
+{
+  uint32_t ticks, now, last, expected, start;
+
+  // The ISR's period count carries on from the previous run
+  reset();
+  start = letimerMilliseconds();
+  CHECK_EQ(start % LETIMER_PERIOD_MS, 0);
+  last = start;
+
+  for (ticks = 0; ticks < TEST_PERIODS * (LETIMER_COMP0_VAL + 1); ticks++) {
+      tick(maxDelay);
+      now = letimerMilliseconds();
+      // Whether or not the ISR has run yet
+      expected = start + reloads * LETIMER_PERIOD_MS
+                 + ((LETIMER_COMP0_VAL - hostLetimer0.CNT) * 1000u) / ACTUAL_CLOCK_FREQ;
+      CHECK_EQ(now, expected);
+      CHECK(now >= last);
+      if ((now != expected) || (now < last)) {
+          break;
+      }
+      last = now;
+  }
+  CHECK_EQ(last - start, TEST_PERIODS * LETIMER_PERIOD_MS);
+}
+
+static void countUf(Events_t evt)
+{
+  (void) evt;
+  ufEvents++;
+}
+
+static void testUfEventDivider(void)
+{
+  uint32_t i;
+
+  reset();
+  schedulerRegisterHandler(EVENT_LETIMER_UF, countUf);
+  ufEvents = 0;
+
+  // Runs of underflows start anywhere in the divider's cycle
+  for (i = 0; i < LETIMER_UF_EVENT_DIV * 10; i++) {
+      LETIMER_IF |= LETIMER_IF_UF;
+      runIsr();
+      schedulerDispatch();
+  }
+  CHECK_EQ(ufEvents, 10);
+}
+
+/**
+ * Without a connection the posture state machine samples for
+ * BROADCAST_SAMPLE_WINDOW_MS after a motion, timed by this clock and
+ * closed on EVENT_LETIMER_UF.
+ */
+static void testSampleWindowCloses(void)
+{
+  uint32_t motionMs, stopMs = 0;
+
+  reset();
+  schedulerRegisterHandler(EVENT_ACCELINT | EVENT_BLEDONE | EVENT_LETIMER_UF, stateMachinePostureDetection);
+
+  schedulerSetEventAccelINT();
+  schedulerDispatch();
+  motionMs = letimerMilliseconds();
+  CHECK(sampling);
+
+  while (sampling && (letimerMilliseconds() - motionMs < 2 * BROADCAST_SAMPLE_WINDOW_MS)) {
+      tick(0);
+      schedulerDispatch();
+      stopMs = letimerMilliseconds();
+  }
+  CHECK(!sampling);
+  CHECK(stopMs - motionMs >= BROADCAST_SAMPLE_WINDOW_MS);
+  CHECK(stopMs - motionMs <= BROADCAST_SAMPLE_WINDOW_MS + LETIMER_UF_EVENT_DIV * LETIMER_PERIOD_MS);
+}
+
+static void testBothFlags(void)
+{
+  uint32_t before;
+
+  reset();
+  before = letimerMilliseconds();
+
+  // UF and COMP1 in the same ISR entry are both handled
+  hostLetimer0.IEN = LETIMER_IEN_UF | LETIMER_IEN_COMP1;
+  LETIMER_IF = LETIMER_IF_UF | LETIMER_IF_COMP1;
+  runIsr();
+  CHECK_EQ(letimerMilliseconds(), before + LETIMER_PERIOD_MS);
+  CHECK(getNextEvent() & EVENT_LETIMER_COMP1);
+}
+
+int main(void)
+{
+  srand(12);
+  testIncreases(0);
+  testIncreases(8);
+  testUfEventDivider();
+  testSampleWindowCloses();
+  testBothFlags();
+
+  return testFailures("test_letimer");
+}
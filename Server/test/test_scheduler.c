@@ -0,0 +1,312 @@
+/***********************************************************************
+ * @file      test_scheduler.c
+ * @version   0.1
+ * @brief     Host test and benchmark of the bitmask event scheduler.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * Checks coalescing, priority order, signal re-arming and the retry after
+ * a failed sl_bt_external_signal(), then drives ISR bursts through
+ * schedulerSetEvent() to count the events lost to coalescing, and times
+ * schedulerSetEvent() and schedulerDispatch() on the host. The posture
+ * state machine must only sample while someone can receive the result.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "src/scheduler.h"
+#include "test_util.h"
+
+#define BURST_ROUNDS     10000
+#define BENCH_ROUNDS     200000
+
+static uint32_t signalsPosted;
+static sl_status_t signalResult = SL_STATUS_OK;
+
+static uint32_t nowMs;
+static bool     sampling;
+static bool     observers;
+static ble_data_struct_t bleData;
+
+static Events_t dispatchedOrder[SCHEDULER_NUM_EVENTS * 2];
+static uint32_t dispatchedCount;
+static uint32_t deliveredPerBit[SCHEDULER_NUM_EVENTS];
+
+sl_status_t sl_bt_external_signal(uint32_t signals)
+{
+  (void) signals;
+  signalsPosted++;
+  return signalResult;
+}
+
+uint32_t letimerMilliseconds(void)
+{
+  return nowMs;
+}
+
+void adcStartSampling(void)
+{
+  sampling = true;
+}
+
+void adcStopSampling(void)
+{
+  sampling = false;
+}
+
+bool broadcastWantsSamples(void)
+{
+  return observers;
+}
+
+ble_data_struct_t* get_ble_data_struct(void)
+{
+  return &bleData;
+}
+
+static void recordHandler(Events_t evt)
+{
+  if (dispatchedCount < sizeof(dispatchedOrder) / sizeof(dispatchedOrder[0])) {
+      dispatchedOrder[dispatchedCount] = evt;
+  }
+  dispatchedCount++;
+  deliveredPerBit[__builtin_ctz((uint32_t) evt)]++;
+}
+
+static void countingHandler(Events_t evt)
+{
+  (void) evt;
+}
+
+static void reset(void)
+{
+  schedulerInit();
+  signalsPosted = 0;
+  signalResult = SL_STATUS_OK;
+  dispatchedCount = 0;
+  memset(deliveredPerBit, 0, sizeof(deliveredPerBit));
+}
+
+static void testCoalescedBatchInPriorityOrder(void)
+{
+  reset();
+  CHECK(schedulerRegisterHandler(0xFFFFFFFF, recordHandler));
+
+  schedulerSetEvent(EVENT_LCD_DONE);
+  schedulerSetEvent(EVENT_I2CTransfer_Done);
+  schedulerSetEvent(EVENT_ACCELDATA);
+  CHECK_EQ(signalsPosted, 1);
+
+  schedulerDispatch();
+  CHECK_EQ(dispatchedCount, 3);
+  CHECK_EQ(dispatchedOrder[0], EVENT_I2CTransfer_Done);
+  CHECK_EQ(dispatchedOrder[1], EVENT_ACCELDATA);
+  CHECK_EQ(dispatchedOrder[2], EVENT_LCD_DONE);
+  CHECK_EQ(schedulerGetStats()->batches, 1);
+  CHECK_EQ(schedulerGetStats()->events_dispatched, 3);
+
+  // Taking the batch re-arms the signal
+  schedulerSetEvent(EVENT_PB0);
+  CHECK_EQ(signalsPosted, 2);
+  schedulerDispatch();
+  CHECK_EQ(dispatchedOrder[3], EVENT_PB0);
+
+  // Nothing pending, nothing delivered
+  schedulerDispatch();
+  CHECK_EQ(dispatchedCount, 4);
+  CHECK_EQ(schedulerGetStats()->batches, 2);
+}
+
+static void testRepeatedBitIsCountedAsLost(void)
+{
+  reset();
+  CHECK(schedulerRegisterHandler(EVENT_ADCBLOCK, recordHandler));
+
+  schedulerSetEvent(EVENT_ADCBLOCK);
+  schedulerSetEvent(EVENT_ADCBLOCK);
+  schedulerSetEvent(EVENT_ADCBLOCK);
+  schedulerDispatch();
+
+  CHECK_EQ(dispatchedCount, 1);
+  CHECK_EQ(schedulerGetStats()->events_set, 3);
+  CHECK_EQ(schedulerGetStats()->events_coalesced, 2);
+}
+
+static void testFailedSignalIsRetried(void)
+{
+  reset();
+  CHECK(schedulerRegisterHandler(0xFFFFFFFF, recordHandler));
+
+  signalResult = SL_STATUS_NO_MORE_RESOURCE;
+  schedulerSetEvent(EVENT_TILT);
+  CHECK_EQ(schedulerGetStats()->signal_errors, 1);
+  CHECK_EQ(schedulerGetStats()->signals_sent, 0);
+
+  // The bit stayed pending and the next event posts the signal for both
+  signalResult = SL_STATUS_OK;
+  schedulerSetEvent(EVENT_FLEXANGLE);
+  CHECK_EQ(schedulerGetStats()->signals_sent, 1);
+
+  schedulerDispatch();
+  CHECK_EQ(dispatchedCount, 2);
+  CHECK_EQ(dispatchedOrder[0], EVENT_FLEXANGLE);
+  CHECK_EQ(dispatchedOrder[1], EVENT_TILT);
+}
+
+static void testUnhandledAndFullTable(void)
+{
+  uint8_t i;
+
+  reset();
+  for (i = 0; i < SCHEDULER_MAX_HANDLERS; i++) {
+      CHECK(schedulerRegisterHandler(EVENT_PB0, countingHandler));
+  }
+  CHECK(!schedulerRegisterHandler(EVENT_PB0, countingHandler));
+  CHECK(!schedulerRegisterHandler(EVENT_PB0, NULL));
+
+  schedulerSetEvent(EVENT_LETIMER_UF);
+  schedulerDispatch();
+  CHECK_EQ(schedulerGetStats()->events_unhandled, 1);
+}
+
+/**
+ * Bursts of 1 to burstMax interrupts land between two dispatches, the way
+ * the ADC, FIFO and I2C completions pile up while the stack is busy. Only
+ * a repeat of a bit that is still pending is lost.
+ */
+static void testIsrBursts(uint32_t burstMax)
+{
+  static const Events_t isrEvents[] = {
+      EVENT_I2CTransfer_Done, EVENT_ACCELINT, EVENT_LETIMER_UF,
+      EVENT_ADCBLOCK, EVENT_ACCELDATA, EVENT_LCD_DONE,
+  };
+  uint32_t raisedPerBit[SCHEDULER_NUM_EVENTS] = {0};
+  const scheduler_stats_t *stats;
+  uint32_t round, n, burst, bit;
+  uint32_t delivered = 0;
+
+  reset();
+  srand(burstMax);
+  CHECK(schedulerRegisterHandler(0xFFFFFFFF, recordHandler));
+
+  for (round = 0; round < BURST_ROUNDS; round++) {
+      burst = 1 + (uint32_t) rand() % burstMax;
+      for (n = 0; n < burst; n++) {
+          Events_t evt = isrEvents[(uint32_t) rand() % (sizeof(isrEvents) / sizeof(isrEvents[0]))];
+          raisedPerBit[__builtin_ctz((uint32_t) evt)]++;
+          schedulerSetEvent(evt);
+      }
+      schedulerDispatch();
+  }
+
+  stats = schedulerGetStats();
+  for (bit = 0; bit < SCHEDULER_NUM_EVENTS; bit++) {
+      CHECK(deliveredPerBit[bit] <= raisedPerBit[bit]);
+      delivered += deliveredPerBit[bit];
+  }
+  CHECK_EQ(stats->events_set, stats->events_dispatched + stats->events_coalesced);
+  CHECK_EQ(stats->events_dispatched, delivered);
+  CHECK_EQ(stats->signals_sent, BURST_ROUNDS);
+  CHECK_EQ(stats->batches, BURST_ROUNDS);
+
+  printf("  bursts of 1..%-2u: %6u events, %6u dispatched, %6u coalesced (%.1f%% lost), %u signals\n",
+         (unsigned) burstMax, (unsigned) stats->events_set, (unsigned) stats->events_dispatched,
+         (unsigned) stats->events_coalesced, 100.0 * stats->events_coalesced / stats->events_set,
+         (unsigned) stats->signals_sent);
+}
+
+static void postureAt(uint32_t ms, Events_t evt)
+{
+  nowMs = ms;
+  stateMachinePostureDetection(evt);
+}
+
+static void testSamplingNeedsListeners(void)
+{
+  // A connected client gets samples for as long as it stays
+  bleData.connection_open = true;
+  observers = false;
+  postureAt(1000, EVENT_ACCELINT);
+  CHECK(sampling);
+  postureAt(1000 + 10 * BROADCAST_SAMPLE_WINDOW_MS, EVENT_LETIMER_UF);
+  CHECK(sampling);
+
+  // Nobody listening, motion does not start the ADC
+  bleData.connection_open = false;
+  postureAt(2000 + 10 * BROADCAST_SAMPLE_WINDOW_MS, EVENT_LETIMER_UF);
+  CHECK(!sampling);
+  postureAt(3000 + 10 * BROADCAST_SAMPLE_WINDOW_MS, EVENT_ACCELINT);
+  CHECK(!sampling);
+
+  // Broadcast observers get a window after each motion, not forever
+  observers = true;
+  postureAt(100000, EVENT_ACCELINT);
+  CHECK(sampling);
+  postureAt(100000 + BROADCAST_SAMPLE_WINDOW_MS - 1, EVENT_LETIMER_UF);
+  CHECK(sampling);
+  postureAt(100000 + BROADCAST_SAMPLE_WINDOW_MS, EVENT_LETIMER_UF);
+  CHECK(!sampling);
+  postureAt(100000 + 2 * BROADCAST_SAMPLE_WINDOW_MS, EVENT_ACCELINT);
+  CHECK(sampling);
+
+  // A client leaving ends the sampling once the window is over
+  bleData.connection_open = true;
+  postureAt(200000, EVENT_ACCELINT);
+  bleData.connection_open = false;
+  postureAt(200000 + BROADCAST_SAMPLE_WINDOW_MS, EVENT_LETIMER_UF);
+  CHECK(!sampling);
+}
+
+static void benchmarkDispatch(void)
+{
+  uint64_t start, setNs, dispatchNs;
+  uint32_t round, bit;
+  uint8_t i;
+
+  reset();
+  for (i = 0; i < SCHEDULER_MAX_HANDLERS; i++) {
+      CHECK(schedulerRegisterHandler(0xFFFFFFFF, countingHandler));
+  }
+
+  start = testNanoseconds();
+  for (round = 0; round < BENCH_ROUNDS; round++) {
+      schedulerSetEvent(EVENT_ADCBLOCK);
+      (void) getNextEvent();
+  }
+  setNs = testNanoseconds() - start;
+
+  start = testNanoseconds();
+  for (round = 0; round < BENCH_ROUNDS; round++) {
+      for (bit = 0; bit < SCHEDULER_NUM_EVENTS; bit++) {
+          schedulerSetEvent((Events_t) (1u << bit));
+      }
+      schedulerDispatch();
+  }
+  dispatchNs = testNanoseconds() - start;
+
+  CHECK_EQ(schedulerGetStats()->events_dispatched, (uint32_t) BENCH_ROUNDS * SCHEDULER_NUM_EVENTS);
+  printf("  schedulerSetEvent + take: %.1f ns\n", (double) setNs / BENCH_ROUNDS);
+  printf("  full batch of %d events to %d handlers: %.1f ns (%.1f ns per event)\n",
+         SCHEDULER_NUM_EVENTS, SCHEDULER_MAX_HANDLERS, (double) dispatchNs / BENCH_ROUNDS,
+         (double) dispatchNs / BENCH_ROUNDS / SCHEDULER_NUM_EVENTS);
+}
+
+int main(void)
+{
+  testCoalescedBatchInPriorityOrder();
+  testRepeatedBitIsCountedAsLost();
+  testFailedSignalIsRetried();
+  testUnhandledAndFullTable();
+  testSamplingNeedsListeners();
+
+  printf("ISR bursts between dispatches:\n");
+  testIsrBursts(1);
+  testIsrBursts(4);
+  testIsrBursts(16);
+
+  printf("Host dispatch cost:\n");
+  benchmarkDispatch();
+
+  return testFailures("test_scheduler");
+}
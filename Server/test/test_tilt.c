@@ -0,0 +1,183 @@
+/***********************************************************************
+ * @file      test_tilt.c
+ * @version   0.1
+ * @brief     Host accuracy test and benchmark of the fixed-point CORDIC
+ *            tilt estimator.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * tiltAtan2() is swept over the int16 plane and compared with the libm
+ * atan2() and hypot(), tiltFromAccel() with the floating point pitch and
+ * roll of accelerometer vectors at every orientation. The benchmark puts
+ * the integer path next to the libm one it replaces.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "src/tilt.h"
+#include "test_util.h"
+
+#define ACCEL_1G          16384     // LSB per g at +-2 g
+#define SWEEP_STEP        97
+#define BENCH_CALLS       2000000
+
+#define ATAN2_MAX_ERROR   0.6       // 0.1 degree, 0.5 of it is the rounding of the result
+#define MAG_MAX_ERROR     0.002     // relative
+#define TILT_MAX_ERROR    0.6       // 0.1 degree
+
+static double decidegrees(double rad)
+{
+  return rad * 1800.0 / M_PI;
+}
+
+// Angle difference wrapped to +-1800
+static double angleError(double a, double b)
+{
+  double d = fmod(a - b, 3600.0);
+
+  if (d > 1800.0) {
+      d -= 3600.0;
+  } else if (d < -1800.0) {
+      d += 3600.0;
+  }
+  return fabs(d);
+}
+
+static void testAtan2Sweep(void)
+{
+  double err, maxErr = 0.0, maxMagErr = 0.0, ref;
+  uint32_t magnitude;
+  int32_t x, y;
+
+  for (y = INT16_MIN; y <= INT16_MAX; y += SWEEP_STEP) {
+      for (x = INT16_MIN; x <= INT16_MAX; x += SWEEP_STEP) {
+          err = angleError(tiltAtan2(y, x, &magnitude), decidegrees(atan2(y, x)));
+          if (err > maxErr) {
+              maxErr = err;
+          }
+          ref = hypot(x, y);
+          if (ref >= 1000.0) {
+              err = fabs(magnitude - ref) / ref;
+              if (err > maxMagErr) {
+                  maxMagErr = err;
+              }
+          }
+      }
+  }
+
+  printf("  tiltAtan2 over the int16 plane: max error %.2f (0.1 deg), magnitude %.3f%%\n",
+         maxErr, maxMagErr * 100.0);
+  CHECK(maxErr <= ATAN2_MAX_ERROR);
+  CHECK(maxMagErr <= MAG_MAX_ERROR);
+}
+
+static void testAtan2Edges(void)
+{
+  CHECK_EQ(tiltAtan2(0, 1000, NULL), 0);
+  CHECK_EQ(tiltAtan2(1000, 0, NULL), 900);
+  CHECK_EQ(tiltAtan2(-1000, 0, NULL), -900);
+  CHECK_EQ(abs(tiltAtan2(0, -1000, NULL)), 1800);
+  CHECK_EQ(tiltAtan2(1000, 1000, NULL), 450);
+  CHECK_EQ(tiltAtan2(-1000, -1000, NULL), -1350);
+  CHECK_EQ(tiltAtan2(INT16_MAX, INT16_MIN, NULL), 1800 - 450);
+  CHECK_EQ(tiltAtan2(INT16_MIN, INT16_MIN, NULL), -1800 + 450);
+}
+
+static void testTiltOrientations(void)
+{
+  double pitch, roll, err, maxPitchErr = 0.0, maxRollErr = 0.0;
+  double ax, ay, az;
+  int pitchDeg, rollDeg;
+  tilt_t tilt;
+
+  // Pitch stays within +-90, the accelerometer cannot tell beyond that
+  for (pitchDeg = -89; pitchDeg <= 89; pitchDeg++) {
+      for (rollDeg = -179; rollDeg <= 180; rollDeg++) {
+          pitch = pitchDeg * M_PI / 180.0;
+          roll = rollDeg * M_PI / 180.0;
+          ax = -sin(pitch) * ACCEL_1G;
+          ay = cos(pitch) * sin(roll) * ACCEL_1G;
+          az = cos(pitch) * cos(roll) * ACCEL_1G;
+
+          tiltFromAccel((int16_t) lround(ax), (int16_t) lround(ay), (int16_t) lround(az), &tilt);
+
+          // Compared against the rounded vector the firmware actually sees
+          ax = lround(ax);
+          ay = lround(ay);
+          az = lround(az);
+          err = angleError(tilt.pitch, decidegrees(atan2(-ax, hypot(ay, az))));
+          if (err > maxPitchErr) {
+              maxPitchErr = err;
+          }
+          // Roll is undefined straight up or down
+          if (hypot(ay, az) >= ACCEL_1G / 64) {
+              err = angleError(tilt.roll, decidegrees(atan2(ay, az)));
+              if (err > maxRollErr) {
+                  maxRollErr = err;
+              }
+          }
+      }
+  }
+
+  printf("  tiltFromAccel at 1 g, every degree: max pitch error %.2f, roll %.2f (0.1 deg)\n",
+         maxPitchErr, maxRollErr);
+  CHECK(maxPitchErr <= TILT_MAX_ERROR);
+  CHECK(maxRollErr <= TILT_MAX_ERROR);
+
+  // Full scale vectors must not overflow the CORDIC
+  tiltFromAccel(INT16_MIN, INT16_MAX, INT16_MAX, &tilt);
+  CHECK_EQ(tilt.roll, 450);
+  CHECK(angleError(tilt.pitch, decidegrees(atan2(32768.0, hypot(32767.0, 32767.0)))) <= TILT_MAX_ERROR);
+}
+
+static void benchmark(void)
+{
+  int16_t vectors[256][3];
+  volatile int32_t sink = 0;
+  volatile double sinkFloat = 0.0;
+  uint64_t start, fixedNs, floatNs;
+  tilt_t tilt;
+  uint32_t i;
+  int16_t *v;
+
+  srand(8);
+  for (i = 0; i < 256; i++) {
+      vectors[i][0] = (int16_t) (rand() % 32768 - 16384);
+      vectors[i][1] = (int16_t) (rand() % 32768 - 16384);
+      vectors[i][2] = (int16_t) (rand() % 32768 - 16384);
+  }
+
+  start = testNanoseconds();
+  for (i = 0; i < BENCH_CALLS; i++) {
+      v = vectors[i & 255];
+      tiltFromAccel(v[0], v[1], v[2], &tilt);
+      sink += tilt.pitch + tilt.roll;
+  }
+  fixedNs = testNanoseconds() - start;
+
+  start = testNanoseconds();
+  for (i = 0; i < BENCH_CALLS; i++) {
+      v = vectors[i & 255];
+      sinkFloat += atan2(v[1], v[2]) + atan2(-v[0], hypot(v[1], v[2]));
+  }
+  floatNs = testNanoseconds() - start;
+
+  printf("Host tilt cost:\n");
+  printf("  tiltFromAccel, 2 CORDIC atan2: %.1f ns\n", (double) fixedNs / BENCH_CALLS);
+  printf("  libm atan2, hypot, atan2:      %.1f ns (host FPU, the Cortex-M4 has single precision only)\n",
+         (double) floatNs / BENCH_CALLS);
+  (void) sink;
+  (void) sinkFloat;
+}
+
+int main(void)
+{
+  printf("Tilt accuracy:\n");
+  testAtan2Edges();
+  testAtan2Sweep();
+  testTiltOrientations();
+  benchmark();
+
+  return testFailures("test_tilt");
+}
@@ -0,0 +1,55 @@
+/***********************************************************************
+ * @file      test_util.h
+ * @version   0.1
+ * @brief     Minimal check macros shared by the host tests.
+ *
+ * @author    Damini Gowda, damini.gowda@colorado.edu
+ * @date      May 18, 2025
+ *
+ * A failed CHECK prints the location and keeps going, main() returns
+ * testFailures() so make stops on the first test program with a failure.
+ */
+
+#ifndef TEST_TEST_UTIL_H_
+#define TEST_TEST_UTIL_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+extern int testFailureCount;
+
+#define CHECK(cond)                                                       \
+  do {                                                                    \
+      if (!(cond)) {                                                      \
+          printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);          \
+          testFailureCount++;                                             \
+      }                                                                   \
+  } while (0)
+
+#define CHECK_EQ(actual, expected)                                        \
+  do {                                                                    \
+      long long a_ = (long long) (actual), e_ = (long long) (expected);   \
+      if (a_ != e_) {                                                     \
+          printf("FAIL %s:%d: %s is %lld, expected %lld\n",               \
+                 __FILE__, __LINE__, #actual, a_, e_);                    \
+          testFailureCount++;                                             \
+      }                                                                   \
+  } while (0)
+
+static inline int testFailures(const char *name)
+{
+  printf("%s: %s\n", name, testFailureCount ? "FAILED" : "passed");
+  return testFailureCount ? 1 : 0;
+}
+
+// Monotonic nanoseconds, for the throughput figures the tests print
+static inline uint64_t testNanoseconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+#endif /* TEST_TEST_UTIL_H_ */
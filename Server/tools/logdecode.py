@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""
+@file      logdecode.py
+@brief     Decodes the deferred binary log written by logDrain() (src/log.c).
+
+@author    Damini Gowda, damini.gowda@colorado.edu
+@date      May 11, 2025
+
+Each entry only carries the flash addresses of its format string and of
+__func__, so the strings are looked up in the ELF the firmware was built
+from. Text that is not a binary frame (app_log() output of the files built
+with LOG_DEFERRED 0) is passed through unchanged.
+
+Usage:
+    python3 logdecode.py <firmware.axf> [capture]   capture defaults to stdin
+    e.g. python3 logdecode.py GNU\\ ARM\\ v12.2.1\\ -\\ Default/app.axf < /dev/ttyACM0
+"""
+
+import re
+import struct
+import sys
+
+# Must match src/log.h and src/log.c
+FRAME_SYNC = b"\xa5\x5a"
+HEADER_MAGIC = 0xB1
+ENTRY_FIXED_WORDS = 4
+MAX_ARGS = 8
+LEVELS = {0: "Info ", 1: "Warn ", 2: "Error"}
+
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+
+class Elf:
+    """Allocated sections of a 32-bit little endian ELF, enough to read strings."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+        if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+            raise ValueError("%s: not a 32-bit little endian ELF" % path)
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", data, 0x2E)
+        self.sections = []
+        for i in range(shnum):
+            (_, sh_type, flags, addr, offset, size) = struct.unpack_from(
+                "<IIIIII", data, shoff + i * shentsize)
+            if (flags & SHF_ALLOC) and sh_type != SHT_NOBITS and size:
+                self.sections.append((addr, data[offset:offset + size]))
+
+    def string(self, addr):
+        """C string at addr, None if the address is not in flash."""
+        for base, blob in self.sections:
+            if base <= addr < base + len(blob):
+                end = blob.find(b"\0", addr - base)
+                if end < 0:
+                    end = len(blob)
+                return blob[addr - base:end].decode("ascii", "replace")
+        return None
+
+
+CONVERSION = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+def format_entry(elf, fmt, args):
+    """printf() formatting of the raw 32-bit arguments."""
+    out = []
+    pos = 0
+    argi = 0
+    for m in CONVERSION.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        value = args[argi] if argi < len(args) else 0
+        argi += 1
+        spec = "%" + flags + width + ("." + prec if prec else "")
+        if conv in "di":
+            out.append((spec + "d") % (value - (1 << 32) if value & 0x80000000 else value))
+        elif conv == "u":
+            out.append((spec + "d") % value)
+        elif conv in "oxX":
+            out.append((spec + conv) % value)
+        elif conv == "c":
+            out.append((spec + "c") % chr(value & 0xFF))
+        elif conv == "p":
+            out.append("0x%08x" % value)
+        else:  # s
+            text = elf.string(value)
+            out.append((spec + "s") % (text if text is not None else "<0x%08x>" % value))
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def decode_frame(elf, words):
+    header, timestamp, fmt_addr, func_addr = words[:ENTRY_FIXED_WORDS]
+    level = LEVELS.get((header >> 16) & 0xFF, "?    ")
+    args = words[ENTRY_FIXED_WORDS:]
+    if fmt_addr == 0:
+        return "%5u:%s:logDrain: %u log entries dropped" % (timestamp, level, args[0] if args else 0)
+    fmt = elf.string(fmt_addr)
+    func = elf.string(func_addr) or "0x%08x" % func_addr
+    if fmt is None:
+        return "%5u:%s:%s: <unknown format 0x%08x> %s" % (
+            timestamp, level, func, fmt_addr, " ".join("0x%08x" % a for a in args))
+    return "%5u:%s:%s: %s" % (timestamp, level, func, format_entry(elf, fmt, args))
+
+
+def frame_at(buf, i):
+    """(words, length in bytes) of a valid frame at buf[i], (None, 0) if more
+    bytes are needed, (None, -1) if the sync bytes are just text."""
+    if len(buf) < i + 3:
+        return None, 0
+    count = buf[i + 2]
+    if not ENTRY_FIXED_WORDS <= count <= ENTRY_FIXED_WORDS + MAX_ARGS:
+        return None, -1
+    size = 3 + count * 4
+    if len(buf) < i + size:
+        return None, 0
+    words = struct.unpack_from("<%dI" % count, buf, i + 3)
+    header = words[0]
+    if (header >> 24) != HEADER_MAGIC or (header & 0xFF) != count \
+            or ((header >> 8) & 0xFF) != count - ENTRY_FIXED_WORDS:
+        return None, -1
+    return words, size
+
+
+def decode_stream(elf, stream, out):
+    # read1() returns what the serial port has instead of waiting for 256 bytes
+    read = getattr(stream, "read1", stream.read)
+    buf = b""
+    while True:
+        chunk = read(256)
+        if not chunk:
+            break
+        buf += chunk
+        while True:
+            i = buf.find(FRAME_SYNC)
+            if i < 0:
+                # Keep a trailing sync byte, its pair may be in the next chunk
+                keep = 1 if buf.endswith(FRAME_SYNC[:1]) else 0
+                out.write(buf[:len(buf) - keep].decode("ascii", "replace"))
+                buf = buf[len(buf) - keep:]
+                break
+            out.write(buf[:i].decode("ascii", "replace"))
+            words, size = frame_at(buf, i)
+            if size == 0:
+                buf = buf[i:]
+                break
+            if size < 0:
+                out.write(buf[i:i + 1].decode("ascii", "replace"))
+                buf = buf[i + 1:]
+                continue
+            out.write(decode_frame(elf, words) + "\n")
+            buf = buf[i + size:]
+        out.flush()
+    out.write(buf.decode("ascii", "replace"))
+
+
+def main(argv):
+    if len(argv) not in (2, 3):
+        sys.stderr.write(__doc__)
+        return 2
+    elf = Elf(argv[1])
+    if len(argv) == 3:
+        with open(argv[2], "rb") as stream:
+            decode_stream(elf, stream, sys.stdout)
+    else:
+        decode_stream(elf, sys.stdin.buffer, sys.stdout)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))